@@ -1,87 +1,309 @@
 #include "AutoPatcher.h"
 #include "Opcode.h"
 #include "Utility.h"
+#include "ByteScan.h"
+#include "MpScan.h"
+#include "PlanCache.h"
+#include "PatchDb.h"
+#include "PatchManifest.h"
+#include "LoadedImageIndex.h"
+#include "FvFileIndex.h"
+#include "StringMatch.h"
+#include "PatchPipeline.h"
+#include "X86Decode.h"
+#include "Logger.h"
+#include "Trace.h"
+#include "Profile.h"
+#include "FwCalls.h"
+#include "TaggedPool.h"
 #include <Library/PrintLib.h>
 
 extern char Log[512];
 extern EFI_FILE *LogFile;
 void LogToFile(EFI_FILE *LogFile, char *String);
 
+// Plan cache state of one module in PatchAllLoadedModules
+typedef struct {
+    UINT8 Hash[PLAN_CACHE_HASH_SIZE];
+    BOOLEAN Hashed;              // Hash is valid, so a scan result can be stored
+    UINTN Entry;                 // Cache entry, PLAN_CACHE_NONE on a miss
+} MODULE_CACHE_STATE;
+
+/**
+ * Helper: Form passes that fit the detected BIOS vendor
+ */
+STATIC UINT32 VendorFormPasses(BIOS_INFO *BiosInfo)
+{
+    if (BiosInfo->Type == BIOS_TYPE_AMI || BiosInfo->Type == BIOS_TYPE_AMI_HP_CUSTOM)
+        return MODULE_PASS_AMI_FORMS;
+    if (BiosInfo->Type == BIOS_TYPE_INSYDE)
+        return MODULE_PASS_INSYDE_FORMS;
+    return 0;
+}
+
+/**
+ * Helper: Run the database patterns of a module, recorded or replayed like PatchModuleImage
+ *
+ * The writes are added to Plan (if not NULL) next to those of PatchModuleImage.
+ */
+STATIC UINTN ApplyDbPatterns(CONST PATCH_DB_MODULE *Module, IMAGE_SECTION_MAP *Map, PATCH_PLAN *Plan)
+{
+    PATCH_PLAN *Journal = gPatchJournal;
+    UINTN PatchCount = 0;
+
+    if (PatchManifestBeginModule(&gPatchManifest, Map))
+    {
+        if (Plan != NULL)
+            gPatchJournal = Plan;
+        PatchCount = PatchDbApplyPatterns(&gPatchDb, Module, Map);
+        gPatchJournal = Journal;
+    }
+    PatchManifestEndModule(&gPatchManifest);
+    return PatchCount;
+}
+
+/**
+ * Helper: Database entry of a module loaded from FV, by its FFS GUID when
+ * the database has it, else by UI name
+ */
+STATIC CONST PATCH_DB_MODULE *FindDbModule(CHAR8 *ModuleName)
+{
+    CHAR16 ModuleName16[255] = {0};
+    CONST FV_FILE_ENTRY *File;
+    CONST PATCH_DB_MODULE *Module = NULL;
+
+    UnicodeSPrint(ModuleName16, sizeof(ModuleName16), L"%a", ModuleName);
+    File = FvFileIndexFindByName(&gFvFileIndex, ModuleName16);
+    if (File != NULL)
+        Module = PatchDbFindModuleByGuid(&gPatchDb, &File->FileGuid);
+
+    return Module != NULL ? Module : PatchDbFindModule(&gPatchDb, ModuleName);
+}
+
 /**
  * Patch all loaded modules that contain IFR data
+ *
+ * Modules are hashed and looked up in the plan cache first. Cached modules
+ * get the writes stored by the run that scanned them and no pass runs; the
+ * rest are scanned on the APs (or serially), patched, and every write made
+ * to them is added to the cache for the next run. An apply-only run writes
+ * the manifest records of each module and scans nothing.
  */
 EFI_STATUS PatchAllLoadedModules(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
 {
     EFI_STATUS Status;
-    UINTN HandleSize = 0;
-    EFI_HANDLE *Handles;
+    LOADED_IMAGE_ENTRY *Images;
     UINTN TotalPatches = 0;
+    PATCH_PLAN Plan;
+    MP_SCAN Scan;
+    PLAN_CACHE Cache;
+    MODULE_CACHE_STATE *States;
+    BOOLEAN CacheReady;
+    BOOLEAN Parallel = FALSE;
 
     AsciiSPrint(Log, 512, "\n--- Scanning All Loaded Modules ---\n\r");
     LogToFile(LogFile, Log);
     Print(L"Scanning loaded modules...\n\r");
 
-    Status = gBS->LocateHandle(ByProtocol, &gEfiLoadedImageProtocolGuid, NULL, &HandleSize, NULL);
-    if (Status == EFI_BUFFER_TOO_SMALL)
+    // Later phases look their modules up in the same index
+    Status = LoadedImageIndexRefresh(&gLoadedImageIndex);
+    if (!EFI_ERROR(Status))
     {
-        Handles = AllocateZeroPool(HandleSize);
-        Status = gBS->LocateHandle(ByProtocol, &gEfiLoadedImageProtocolGuid, NULL, &HandleSize, Handles);
-        
-        if (!EFI_ERROR(Status))
+        UINTN ModuleCount = gLoadedImageIndex.Count;
+        Images = gLoadedImageIndex.Entries;
+
+        if (gPatchManifest.Mode == PATCH_MANIFEST_APPLY)
         {
-            UINTN ModuleCount = HandleSize / sizeof(EFI_HANDLE);
-            AsciiSPrint(Log, 512, "Found %d loaded modules to scan\n\r", ModuleCount);
+            for (UINTN i = 0; i < ModuleCount; i++)
+            {
+                IMAGE_SECTION_MAP Map;
+
+                if (Images[i].ImageBase == NULL)
+                    continue;
+                BuildImageSectionMap(Images[i].ImageBase, Images[i].ImageSize, &Map);
+                (VOID)PatchManifestBeginModule(&gPatchManifest, &Map);
+                PatchManifestEndModule(&gPatchManifest);
+            }
+
+            AsciiSPrint(Log, 512, "Applied %d manifest patches, %d modules changed since planning\n\r",
+                        gPatchManifest.Applied, gPatchManifest.Stale);
             LogToFile(LogFile, Log);
-            Print(L"Scanning %d modules for IFR data...\n\r", ModuleCount);
+            return EFI_SUCCESS;
+        }
+
+        AsciiSPrint(Log, 512, "Found %d loaded modules to scan (%d UI sections read)\n\r",
+                    ModuleCount, gLoadedImageIndex.NamesRead);
+        LogToFile(LogFile, Log);
+        Print(L"Scanning %d modules for IFR data...\n\r", ModuleCount);
+
+        CacheReady = !EFI_ERROR(PlanCacheLoad(&Cache, ImageHandle, BiosInfo));
 
+        // Plan IFR patches on the APs first; the BSP only resolves and hashes the images
+        ZeroMem(&Scan, sizeof(Scan));
+        Scan.Jobs = TaggedAllocateZeroPool(POOL_TAG_PATCH, ModuleCount * sizeof(MODULE_SCAN_JOB));
+        States = TaggedAllocateZeroPool(POOL_TAG_PATCH, ModuleCount * sizeof(MODULE_CACHE_STATE));
+        if (Scan.Jobs != NULL && States != NULL)
+        {
             for (UINTN i = 0; i < ModuleCount; i++)
             {
-                // Show progress every 20 modules
-                if (i > 0 && i % 20 == 0)
+                EFI_LOADED_IMAGE_PROTOCOL *ImageInfo = Images[i].LoadedImage;
+
+                States[i].Entry = PLAN_CACHE_NONE;
+                if (ImageInfo->ImageBase == NULL)
+                    continue;
+
+                if (CacheReady)
                 {
-                    Print(L"  Progress: %d/%d modules scanned\n\r", i, ModuleCount);
+                    // Keyed by the FV file, so a module loaded at another address still hits
+                    States[i].Hashed = !EFI_ERROR(PlanCacheHashImage(&Cache, &Images[i].FileGuid,
+                                                                     ImageInfo->ImageSize, States[i].Hash));
+                    if (States[i].Hashed)
+                        States[i].Entry = PlanCacheFind(&Cache, States[i].Hash, ImageInfo->ImageSize);
                 }
-                
-                EFI_LOADED_IMAGE_PROTOCOL *ImageInfo = NULL;
-                Status = gBS->HandleProtocol(Handles[i], &gEfiLoadedImageProtocolGuid, (VOID **)&ImageInfo);
-                
-                if (!EFI_ERROR(Status) && ImageInfo != NULL && ImageInfo->ImageBase != NULL)
+
+                // Cached modules are not scanned again
+                if (States[i].Entry == PLAN_CACHE_NONE)
                 {
-                    // Get module name if available
-                    CHAR16 *ModuleName = FindLoadedImageFileName(ImageInfo);
-                    
-                    // Parse for IFR data
-                    IFR_PATCH *PatchList = NULL;
-                    Status = ParseIfrData(ImageInfo->ImageBase, ImageInfo->ImageSize, &PatchList);
-                    
-                    if (!EFI_ERROR(Status) && PatchList != NULL)
+                    Scan.Jobs[i].ImageBase = ImageInfo->ImageBase;
+                    Scan.Jobs[i].ImageSize = ImageInfo->ImageSize;
+                }
+            }
+            Scan.JobCount = ModuleCount;
+            Parallel = !EFI_ERROR(MpScanModules(&Scan));
+        }
+
+        if (Parallel)
+        {
+            AsciiSPrint(Log, 512, "Planned %d modules on %d application processors\n\r",
+                        ModuleCount, Scan.ProcessorCount);
+        }
+        else
+        {
+            AsciiSPrint(Log, 512, "MP services unavailable, scanning modules serially\n\r");
+        }
+        LogToFile(LogFile, Log);
+
+        // One plan is reused for every module the APs did not finish
+        PatchPlanInit(&Plan);
+
+        for (UINTN i = 0; i < ModuleCount; i++)
+        {
+            // Show progress every 20 modules
+            if (i > 0 && i % 20 == 0)
+            {
+                Print(L"  Progress: %d/%d modules scanned\n\r", i, ModuleCount);
+            }
+            
+            EFI_LOADED_IMAGE_PROTOCOL *ImageInfo = Images[i].LoadedImage;
+            
+            if (ImageInfo->ImageBase != NULL)
+            {
+                // UI name from the index, NULL if the module has none
+                CHAR16 *ModuleName = Images[i].Name;
+                IMAGE_SECTION_MAP LocalMap;
+                IMAGE_SECTION_MAP *SectionMap = &LocalMap;
+                MODULE_SCAN_JOB *Job = Parallel ? &Scan.Jobs[i] : NULL;
+                MODULE_CACHE_STATE *State = States != NULL ? &States[i] : NULL;
+                MODULE_PATCH_RESULT Result;
+                BOOLEAN Scanned = TRUE;
+
+                if (State != NULL && State->Entry != PLAN_CACHE_NONE)
+                {
+                    // Every write of an earlier run; a stale entry falls through to a rescan
+                    PatchPlanReset(&Plan);
+                    Status = PlanCacheRestore(&Cache, State->Entry, ImageInfo->ImageBase, ImageInfo->ImageSize, &Plan);
+                    if (Status != EFI_VOLUME_CORRUPTED)
                     {
-                        if (ModuleName != NULL)
+                        Scanned = FALSE;
+                        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &LocalMap);
+                        if (!EFI_ERROR(Status))
                         {
-                            AsciiSPrint(Log, 512, "Patching module: %s\n\r", ModuleName);
+                            AsciiSPrint(Log, 512, "Restored %d cached patches\n\r", Plan.Count);
                             LogToFile(LogFile, Log);
                         }
-                        
-                        DisableWriteProtections(ImageInfo->ImageBase, ImageInfo->ImageSize);
-                        
-                        // Apply vendor-specific patches
-                        if (BiosInfo->Type == BIOS_TYPE_AMI || BiosInfo->Type == BIOS_TYPE_AMI_HP_CUSTOM)
-                        {
-                            (VOID)PatchAmiForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-                        }
-                        else if (BiosInfo->Type == BIOS_TYPE_INSYDE)
-                        {
-                            (VOID)PatchInsydeForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-                        }
-                        
-                        ApplyIfrPatches(ImageInfo->ImageBase, ImageInfo->ImageSize, PatchList);
-                        FreeIfrPatchList(PatchList);
-                        TotalPatches++;
                     }
                 }
+
+                if (Scanned && Job != NULL && Job->ImageBase == ImageInfo->ImageBase &&
+                    (Job->Status == EFI_SUCCESS || Job->Status == EFI_NOT_FOUND))
+                {
+                    // Already planned on an AP; the plan is copied out of its workspace,
+                    // which has no room for the writes of the other passes
+                    SectionMap = &Job->Map;
+                    PatchPlanReset(&Plan);
+                    for (UINTN r = 0; r < Job->Plan.Count; r++)
+                    {
+                        PATCH_RECORD *Record = &Job->Plan.Records[r];
+                        (VOID)PatchPlanAdd(&Plan, Record->Offset, Record->OldBytes, Record->NewBytes, Record->Length,
+                                           (PATCH_REASON)Record->Reason);
+                    }
+                    Status = Job->Status;
+                    if (!EFI_ERROR(Status))
+                    {
+                        AsciiSPrint(Log, 512, "Found %d IFR patches in %d FormSets\n\r",
+                                    Plan.Count, Job->FormSetCount);
+                        LogToFile(LogFile, Log);
+                    }
+                }
+                else if (Scanned)
+                {
+                    // Serial path, or the AP ran out of fixed storage
+                    BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &LocalMap);
+                    PatchPlanReset(&Plan);
+                    Status = ParseIfrData(&LocalMap, &Plan);
+                }
+
+                if (!EFI_ERROR(Status))
+                {
+                    if (ModuleName != NULL)
+                    {
+                        AsciiSPrint(Log, 512, "Patching module: %s\n\r", ModuleName);
+                        LogToFile(LogFile, Log);
+                    }
+                    
+                    if (Scanned)
+                    {
+                        // The plan is already made; one traversal writes the rest, applies it and
+                        // leaves every write in the plan
+                        (VOID)PatchModuleImage(SectionMap, MODULE_PASS_WRITE_PROTECT | VendorFormPasses(BiosInfo),
+                                               &Plan, &Result);
+                    }
+                    else
+                    {
+                        // The cached writes are the whole result of the passes; none of them runs
+                        if (PatchManifestBeginModule(&gPatchManifest, SectionMap))
+                            (VOID)PatchPlanApply(&Plan, ImageInfo->ImageBase, ImageInfo->ImageSize);
+                        PatchManifestEndModule(&gPatchManifest);
+                    }
+                    TotalPatches++;
+                }
+
+                // A plan-only run writes nothing, so it has no writes to cache
+                if (Scanned && State != NULL && State->Hashed && (Status == EFI_SUCCESS || Status == EFI_NOT_FOUND) &&
+                    gPatchManifest.Mode != PATCH_MANIFEST_PLAN && !Plan.Overflow)
+                {
+                    PlanCacheStore(&Cache, State->Hash, ImageInfo->ImageSize, EFI_ERROR(Status) ? NULL : &Plan);
+                }
             }
-            
-            FreePool(Handles);
+        }
+        
+        if (CacheReady)
+        {
+            AsciiSPrint(Log, 512, "Plan cache: %d hits, %d misses\n\r", Cache.Hits, Cache.Misses);
+            LogToFile(LogFile, Log);
+            PlanCacheSave(&Cache, ImageHandle);
+            PlanCacheFree(&Cache);
+        }
+
+        PatchPlanFree(&Plan);
+        MpScanFree(&Scan);
+        if (Scan.Jobs != NULL)
+        {
+            TaggedFreePool(Scan.Jobs);
+        }
+        if (States != NULL)
+        {
+            TaggedFreePool(States);
         }
     }
 
@@ -119,27 +341,27 @@ EFI_STATUS LoadAndPatchModule(EFI_HANDLE ImageHandle, CHAR8 *ModuleName, BIOS_IN
     LogToFile(LogFile, Log);
 
     // Apply patches
-    DisableWriteProtections(ImageInfo->ImageBase, ImageInfo->ImageSize);
-    
-    if (BiosInfo->Type == BIOS_TYPE_AMI || BiosInfo->Type == BIOS_TYPE_AMI_HP_CUSTOM)
-    {
-        (VOID)PatchAmiForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-    }
-    else if (BiosInfo->Type == BIOS_TYPE_INSYDE)
-    {
-        (VOID)PatchInsydeForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-    }
-
-    IFR_PATCH *PatchList = NULL;
-    Status = ParseIfrData(ImageInfo->ImageBase, ImageInfo->ImageSize, &PatchList);
-    if (!EFI_ERROR(Status) && PatchList != NULL)
+    IMAGE_SECTION_MAP SectionMap;
+    BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+
+    PATCH_PLAN Plan;
+    MODULE_PATCH_RESULT Result;
+    PatchPlanInit(&Plan);
+    (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_WRITE_PROTECT | MODULE_PASS_IFR | VendorFormPasses(BiosInfo),
+                           &Plan, &Result);
+
+    // Board-specific patterns from the signature database
+    CONST PATCH_DB_MODULE *DbModule = FindDbModule(ModuleName);
+    if (DbModule != NULL && DbModule->PatternCount > 0)
     {
-        ApplyIfrPatches(ImageInfo->ImageBase, ImageInfo->ImageSize, PatchList);
-        FreeIfrPatchList(PatchList);
+        AsciiSPrint(Log, 512, "Applied %d database patches to %a\n\r",
+                    ApplyDbPatterns(DbModule, &SectionMap, &Plan), ModuleName);
+        LogToFile(LogFile, Log);
     }
+    PatchPlanFree(&Plan);
 
-    // Execute if requested
-    if (Execute)
+    // Execute if requested; a plan-only run never starts what it loaded
+    if (Execute && gPatchManifest.Mode != PATCH_MANIFEST_PLAN)
     {
         AsciiSPrint(Log, 512, "Executing %a...\n\r", ModuleName);
         LogToFile(LogFile, Log);
@@ -172,14 +394,30 @@ EFI_STATUS PatchSetupDependencies(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     };
 
     UINTN PatchedCount = 0;
-    for (UINTN i = 0; Dependencies[i] != NULL; i++)
+    if (PatchDbIsLoaded(&gPatchDb))
     {
-        // Try to load and patch each dependency
-        // Don't fail if a dependency is not found
-        EFI_STATUS Status = LoadAndPatchModule(ImageHandle, Dependencies[i], BiosInfo, FALSE);
-        if (!EFI_ERROR(Status))
+        // The signature database replaces the built-in list
+        CONST PATCH_DB_MODULE *Module = NULL;
+        while ((Module = PatchDbNextModule(&gPatchDb, Module, PATCH_DB_ROLE_SETUP_DEPENDENCY, BiosInfo->Type)) != NULL)
+        {
+            EFI_STATUS Status = LoadAndPatchModule(ImageHandle, (CHAR8 *)PatchDbModuleName(&gPatchDb, Module), BiosInfo, FALSE);
+            if (!EFI_ERROR(Status))
+            {
+                PatchedCount++;
+            }
+        }
+    }
+    else
+    {
+        for (UINTN i = 0; Dependencies[i] != NULL; i++)
         {
-            PatchedCount++;
+            // Try to load and patch each dependency
+            // Don't fail if a dependency is not found
+            EFI_STATUS Status = LoadAndPatchModule(ImageHandle, Dependencies[i], BiosInfo, FALSE);
+            if (!EFI_ERROR(Status))
+            {
+                PatchedCount++;
+            }
         }
     }
 
@@ -189,12 +427,67 @@ EFI_STATUS PatchSetupDependencies(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     return EFI_SUCCESS;
 }
 
+/**
+ * Helper: Patch the loaded modules the signature database lists for this vendor
+ */
+STATIC UINTN PatchVendorModulesFromDb(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
+{
+    CONST PATCH_DB_MODULE *Module = NULL;
+    UINTN PatchCount = 0;
+
+    while ((Module = PatchDbNextModule(&gPatchDb, Module, PATCH_DB_ROLE_VENDOR, BiosInfo->Type)) != NULL)
+    {
+        CHAR8 *Name = (CHAR8 *)PatchDbModuleName(&gPatchDb, Module);
+        EFI_LOADED_IMAGE_PROTOCOL *ImageInfo = NULL;
+        IMAGE_SECTION_MAP SectionMap;
+        MODULE_PATCH_RESULT Result;
+        PATCH_PLAN Plan;
+        UINT32 Passes = 0;
+
+        // The FFS GUID is exact when the database has one; otherwise match the UI name
+        if (!IsZeroGuid(&Module->FileGuid))
+        {
+            CONST LOADED_IMAGE_ENTRY *Image = LoadedImageIndexFindByGuid(&gLoadedImageIndex, &Module->FileGuid);
+            ImageInfo = Image != NULL ? Image->LoadedImage : NULL;
+        }
+        else if (EFI_ERROR(FindLoadedImageFromName(ImageHandle, Name, &ImageInfo)))
+        {
+            ImageInfo = NULL;
+        }
+
+        if (ImageInfo == NULL)
+            continue;
+
+        AsciiSPrint(Log, 512, "Found %a module at 0x%x\n\r", Name, ImageInfo->ImageBase);
+        LogToFile(LogFile, Log);
+
+        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+        if ((Module->Actions & PATCH_DB_ACTION_WRITE_PROTECT) != 0)
+            Passes |= MODULE_PASS_WRITE_PROTECT;
+        if ((Module->Actions & PATCH_DB_ACTION_UNLOCK_FORMS) != 0)
+            Passes |= MODULE_PASS_UNLOCK_FORMS;
+        PatchPlanInit(&Plan);
+        if (Passes != 0)
+        {
+            (VOID)PatchModuleImage(&SectionMap, Passes, &Plan, &Result);
+            PatchCount += Result.WriteProtections + Result.FormsUnlocked;
+        }
+        PatchCount += ApplyDbPatterns(Module, &SectionMap, &Plan);
+        PatchPlanFree(&Plan);
+    }
+
+    AsciiSPrint(Log, 512, "Database vendor patching complete: %d patches\n\r", PatchCount);
+    LogToFile(LogFile, Log);
+    return PatchCount;
+}
+
 /**
  * Main auto-patching function
  */
 EFI_STATUS AutoPatchBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
 {
     EFI_STATUS Status;
+    PROFILE_SPAN Span;
 
     if (BiosInfo == NULL)
         return EFI_INVALID_PARAMETER;
@@ -213,16 +506,29 @@ EFI_STATUS AutoPatchBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     // Phase 1: Patch all currently loaded modules
     AsciiSPrint(Log, 512, "\n=== Phase 1: Patching All Loaded Modules ===\n\r");
     LogToFile(LogFile, Log);
+    TRACE1(TRACE_PHASE, 1);
+    ProfileBegin(&Span);
     PatchAllLoadedModules(ImageHandle, BiosInfo);
+    ProfileEndPhase(&Span, PROFILE_PHASE_LOADED_MODULES);
+    LoggerFlush();
 
     // Phase 2: Patch Setup dependencies
     AsciiSPrint(Log, 512, "\n=== Phase 2: Patching Setup Dependencies ===\n\r");
     LogToFile(LogFile, Log);
+    TRACE1(TRACE_PHASE, 2);
+    ProfileBegin(&Span);
     PatchSetupDependencies(ImageHandle, BiosInfo);
 
+    // Phase 2 loaded new images; index them before the vendor lookups
+    LoadedImageIndexRefresh(&gLoadedImageIndex);
+    ProfileEndPhase(&Span, PROFILE_PHASE_SETUP_DEPENDENCIES);
+    LoggerFlush();
+
     // Phase 3: Vendor-specific patching
     AsciiSPrint(Log, 512, "\n=== Phase 3: Vendor-Specific Patching ===\n\r");
     LogToFile(LogFile, Log);
+    TRACE1(TRACE_PHASE, 3);
+    ProfileBegin(&Span);
     switch (BiosInfo->Type)
     {
     case BIOS_TYPE_AMI:
@@ -252,6 +558,12 @@ EFI_STATUS AutoPatchBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
         break;
     }
 
+    if (PatchDbIsLoaded(&gPatchDb))
+    {
+        PatchVendorModulesFromDb(ImageHandle, BiosInfo);
+    }
+    ProfileEndPhase(&Span, PROFILE_PHASE_VENDOR);
+
     if (EFI_ERROR(Status))
     {
         AsciiSPrint(Log, 512, "Patching completed with warnings: %r\n\r", Status);
@@ -262,10 +574,12 @@ EFI_STATUS AutoPatchBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
         AsciiSPrint(Log, 512, "Patching completed successfully\n\r");
         LogToFile(LogFile, Log);
     }
+    LoggerFlush();
 
     // Execute the Setup browser
     AsciiSPrint(Log, 512, "\n=== Launching Setup Browser ===\n\r");
     LogToFile(LogFile, Log);
+    TRACE1(TRACE_PHASE, 4);
     Status = ExecuteSetupBrowser(ImageHandle, BiosInfo);
 
     return Status;
@@ -297,23 +611,19 @@ EFI_STATUS PatchAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
                    ImageInfo->ImageBase, ImageInfo->ImageSize);
         LogToFile(LogFile, Log);
 
-        // Disable write protections
-        UINTN ProtCount = DisableWriteProtections(ImageInfo->ImageBase, ImageInfo->ImageSize);
-        AsciiSPrint(Log, 512, "Disabled %d write protections\n\r", ProtCount);
+        IMAGE_SECTION_MAP SectionMap;
+        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+
+        // Write protections, AMI form patches and IFR data in one traversal
+        PATCH_PLAN Plan;
+        MODULE_PATCH_RESULT Result;
+        PatchPlanInit(&Plan);
+        (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_WRITE_PROTECT | MODULE_PASS_AMI_FORMS | MODULE_PASS_IFR,
+                               &Plan, &Result);
+        PatchPlanFree(&Plan);
+        AsciiSPrint(Log, 512, "Disabled %d write protections\n\r", Result.WriteProtections);
         LogToFile(LogFile, Log);
 
-        // Apply AMI-specific form patches
-        (VOID)PatchAmiForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-
-        // Parse IFR data and apply patches
-        IFR_PATCH *PatchList = NULL;
-        Status = ParseIfrData(ImageInfo->ImageBase, ImageInfo->ImageSize, &PatchList);
-        if (!EFI_ERROR(Status) && PatchList != NULL)
-        {
-            ApplyIfrPatches(ImageInfo->ImageBase, ImageInfo->ImageSize, PatchList);
-            FreeIfrPatchList(PatchList);
-        }
-
         AsciiSPrint(Log, 512, "AMI FormBrowser patching complete\n\r");
         LogToFile(LogFile, Log);
     }
@@ -330,16 +640,15 @@ EFI_STATUS PatchAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
         AsciiSPrint(Log, 512, "Found loaded Setup module at 0x%x\n\r", ImageInfo->ImageBase);
         LogToFile(LogFile, Log);
 
-        DisableWriteProtections(ImageInfo->ImageBase, ImageInfo->ImageSize);
-        (VOID)PatchAmiForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
+        IMAGE_SECTION_MAP SectionMap;
+        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
 
-        IFR_PATCH *PatchList = NULL;
-        Status = ParseIfrData(ImageInfo->ImageBase, ImageInfo->ImageSize, &PatchList);
-        if (!EFI_ERROR(Status) && PatchList != NULL)
-        {
-            ApplyIfrPatches(ImageInfo->ImageBase, ImageInfo->ImageSize, PatchList);
-            FreeIfrPatchList(PatchList);
-        }
+        PATCH_PLAN Plan;
+        MODULE_PATCH_RESULT Result;
+        PatchPlanInit(&Plan);
+        (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_WRITE_PROTECT | MODULE_PASS_AMI_FORMS | MODULE_PASS_IFR,
+                               &Plan, &Result);
+        PatchPlanFree(&Plan);
     }
 
     return EFI_SUCCESS;
@@ -368,23 +677,19 @@ EFI_STATUS PatchInsydeBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
                    ImageInfo->ImageBase, ImageInfo->ImageSize);
         LogToFile(LogFile, Log);
 
-        // Disable write protections
-        UINTN ProtCount = DisableWriteProtections(ImageInfo->ImageBase, ImageInfo->ImageSize);
-        AsciiSPrint(Log, 512, "Disabled %d write protections\n\r", ProtCount);
+        IMAGE_SECTION_MAP SectionMap;
+        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+
+        // Write protections, Insyde form visibility flags and IFR data in one traversal
+        PATCH_PLAN Plan;
+        MODULE_PATCH_RESULT Result;
+        PatchPlanInit(&Plan);
+        (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_WRITE_PROTECT | MODULE_PASS_INSYDE_FORMS | MODULE_PASS_IFR,
+                               &Plan, &Result);
+        PatchPlanFree(&Plan);
+        AsciiSPrint(Log, 512, "Disabled %d write protections\n\r", Result.WriteProtections);
         LogToFile(LogFile, Log);
 
-        // Apply Insyde-specific patches (form visibility flags)
-        (VOID)PatchInsydeForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-
-        // Also parse IFR data
-        IFR_PATCH *PatchList = NULL;
-        Status = ParseIfrData(ImageInfo->ImageBase, ImageInfo->ImageSize, &PatchList);
-        if (!EFI_ERROR(Status) && PatchList != NULL)
-        {
-            ApplyIfrPatches(ImageInfo->ImageBase, ImageInfo->ImageSize, PatchList);
-            FreeIfrPatchList(PatchList);
-        }
-
         AsciiSPrint(Log, 512, "Insyde H2O patching complete\n\r");
         LogToFile(LogFile, Log);
     }
@@ -408,7 +713,9 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     EFI_HANDLE AppImageHandle = NULL;
     CHAR8 SetupName[128];
     EFI_FORM_BROWSER2_PROTOCOL *FormBrowser2 = NULL;
+    PROFILE_SPAN Span;
 
+    ProfileBegin(&Span);
     UnicodeStrToAsciiStrS(BiosInfo->SetupModuleName, SetupName, sizeof(SetupName));
 
     AsciiSPrint(Log, 512, "\n=== Launching Setup Browser ===\n\r");
@@ -439,12 +746,13 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
 
     if (EFI_ERROR(Status))
     {
-        AsciiSPrint(Log, 512, "ERROR: Could not load Setup module: %r\n\r", Status);
-        LogToFile(LogFile, Log);
+        SREP_LOG(LOG_LEVEL_ERROR, "ERROR: Could not load Setup module: %r\n\r", Status);
         Print(L"ERROR: Could not load Setup module: %r\n\r", Status);
+        if (gPatchManifest.Mode == PATCH_MANIFEST_PLAN)
+            return Status;
         Print(L"System will not boot to OS. Press Ctrl+Alt+Del to restart.\n\r");
         
-        if (LogFile != NULL) LogFile->Close(LogFile);
+        LoggerClose();
         while (TRUE) gBS->Stall(1000000);
         
         return Status;
@@ -460,35 +768,42 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     LogToFile(LogFile, Log);
     Print(L"Patching Setup module...\n\r");
 
-    DisableWriteProtections(ImageInfo->ImageBase, ImageInfo->ImageSize);
-    
-    if (BiosInfo->Type == BIOS_TYPE_AMI || BiosInfo->Type == BIOS_TYPE_AMI_HP_CUSTOM)
-    {
-        (VOID)PatchAmiForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-    }
-    else if (BiosInfo->Type == BIOS_TYPE_INSYDE)
-    {
-        (VOID)PatchInsydeForms(ImageInfo->ImageBase, ImageInfo->ImageSize);
-    }
+    IMAGE_SECTION_MAP SectionMap;
+    BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+
+    PATCH_PLAN Plan;
+    MODULE_PATCH_RESULT Result;
+    PatchPlanInit(&Plan);
+    (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_WRITE_PROTECT | MODULE_PASS_IFR | VendorFormPasses(BiosInfo),
+                           &Plan, &Result);
+    PatchPlanFree(&Plan);
 
-    IFR_PATCH *PatchList = NULL;
-    Status = ParseIfrData(ImageInfo->ImageBase, ImageInfo->ImageSize, &PatchList);
-    if (!EFI_ERROR(Status) && PatchList != NULL)
+    // A plan-only run stops here: the images were not patched, so nothing is launched
+    if (gPatchManifest.Mode == PATCH_MANIFEST_PLAN)
     {
-        ApplyIfrPatches(ImageInfo->ImageBase, ImageInfo->ImageSize, PatchList);
-        FreeIfrPatchList(PatchList);
+        AsciiSPrint(Log, 512, "Plan-only run: Setup module planned, not started\n\r");
+        LogToFile(LogFile, Log);
+        gBS->UnloadImage(AppImageHandle);
+        ProfileEndPhase(&Span, PROFILE_PHASE_SETUP_BROWSER);
+        return EFI_SUCCESS;
     }
 
     // Step 3: Start the Setup module (this will register HII forms)
     AsciiSPrint(Log, 512, "Starting Setup module to register HII forms...\n\r");
     LogToFile(LogFile, Log);
     Print(L"Starting Setup module...\n\r");
+    LoggerFlush();
     
     Status = gBS->StartImage(AppImageHandle, NULL, NULL);
     
     AsciiSPrint(Log, 512, "Setup module StartImage returned: %r\n\r", Status);
     LogToFile(LogFile, Log);
 
+    // Everything after this waits on the user; the summary covers boot to Setup
+    ProfileEndPhase(&Span, PROFILE_PHASE_SETUP_BROWSER);
+    ProfileReport(PROFILE_REPORT_LOG | PROFILE_REPORT_SCREEN);
+    FwCallsReport();
+
     // Step 4: Now try to use FormBrowser2 Protocol
     AsciiSPrint(Log, 512, "Locating FormBrowser2 Protocol...\n\r");
     LogToFile(LogFile, Log);
@@ -502,7 +817,8 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
         Print(L"\n\r*** Launching BIOS Setup UI ***\n\r");
         Print(L"*** All hidden menus have been unlocked ***\n\r\n\r");
         
-        // Give a moment for message to display
+        // Give a moment for message to display; the log is on disk before the UI takes over
+        LoggerFlush();
         gBS->Stall(2000000);
         
         // SendForm will display all registered HII forms
@@ -521,8 +837,7 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     }
     else
     {
-        AsciiSPrint(Log, 512, "WARNING: FormBrowser2 Protocol not available: %r\n\r", Status);
-        LogToFile(LogFile, Log);
+        SREP_LOG(LOG_LEVEL_WARN, "WARNING: FormBrowser2 Protocol not available: %r\n\r", Status);
         Print(L"WARNING: FormBrowser2 Protocol not available\n\r");
         Print(L"The Setup module was loaded and patched, but UI could not launch.\n\r");
     }
@@ -538,11 +853,8 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     AsciiSPrint(Log, 512, "Preventing boot to OS - entering infinite loop\n\r");
     LogToFile(LogFile, Log);
     
-    if (LogFile != NULL)
-    {
-        LogFile->Close(LogFile);
-        LogFile = NULL;
-    }
+    LoggerClose();
+    LogFile = NULL;
     
     // Infinite loop to prevent OS boot
     while (TRUE)
@@ -553,77 +865,104 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     return EFI_SUCCESS;
 }
 
+// Compare instructions a write protection check branches on
+#define WP_IDIOM_NONE           0
+#define WP_IDIOM_TEST_AL_AL     1      // test al, al (84 C0)
+#define WP_IDIOM_CMP_EAX_0      2      // cmp eax, 0 (83 F8 00), or cmp rax, 0 with REX.W
+
+// Instruction walk state of the write protection stage
+typedef struct {
+    UINTN Count;
+    UINTN Cursor;                // Next instruction, may lie in the next chunk
+    UINTN PrevEnd;               // End of the last instruction, MAX_UINTN at a section start
+    UINTN PrevOpcode;            // Offset of its opcode byte
+    UINT8 PrevIdiom;             // WP_IDIOM_*
+} WRITE_PROTECT_WALK;
+
 /**
- * Disable write protections - look for common protection checks
+ * Helper: Classify an instruction as the compare half of a check
  */
-UINTN DisableWriteProtections(VOID *ImageBase, UINTN ImageSize)
+STATIC UINT8 WriteProtectIdiom(CONST UINT8 *Code, CONST X86_INSTRUCTION *Instruction)
 {
-    UINT8 *Data = (UINT8 *)ImageBase;
-    UINTN PatchCount = 0;
-
-    // Don't log "Searching for..." for every module - too verbose
+    // Legacy prefixes or REX.R/REX.B would change the registers
+    if (Instruction->Map != X86_MAP_PRIMARY || Instruction->Prefixes != 0 ||
+        (Instruction->Rex & (X86_REX_R | X86_REX_B)) != 0)
+        return WP_IDIOM_NONE;
+
+    if (Instruction->Opcode == 0x84 && Instruction->ModRm == 0xC0 && (Instruction->Rex & X86_REX_W) == 0)
+        return WP_IDIOM_TEST_AL_AL;
+    if (Instruction->Opcode == 0x83 && Instruction->ModRm == 0xF8 && Code[Instruction->ImmOffset] == 0x00)
+        return WP_IDIOM_CMP_EAX_0;
+    return WP_IDIOM_NONE;
+}
 
-    // Common patterns for write protection checks:
-    // 1. Flash write enable/disable checks
-    // 2. Variable attribute checks (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_BOOTSERVICE_ACCESS)
-    // 3. Memory protection attributes
+/**
+ * Helper: X86WalkCode callback of the write protection stage
+ *
+ * A check is a compare immediately followed by a conditional branch. Both
+ * patches keep every instruction length, so the walk stays in step.
+ */
+STATIC BOOLEAN WriteProtectInstruction(VOID *Context, UINT8 *Data, UINTN Offset, CONST X86_INSTRUCTION *Instruction)
+{
+    WRITE_PROTECT_WALK *Walk = (WRITE_PROTECT_WALK *)Context;
+    BOOLEAN Jnz8 = Instruction->Length == 2 && Instruction->Map == X86_MAP_PRIMARY && Instruction->Opcode == 0x75;
+    BOOLEAN Jcc32 = Instruction->Length == 6 && Instruction->Map == X86_MAP_0F && (Instruction->Opcode & 0xF0) == 0x80;
 
-    // Pattern 1: Look for common "test al, al" + "jz" pattern after protection check
-    // This is: test al, al (84 C0) followed by jz (74 XX) or jnz (75 XX)
-    for (UINTN i = 0; i < ImageSize - 8; i++)
+    if (Walk->PrevEnd == Offset)
     {
-        if (Data[i] == 0x84 && Data[i + 1] == 0xC0)  // test al, al
+        if (Walk->PrevIdiom == WP_IDIOM_TEST_AL_AL && Jnz8 && Data[Offset + 1] < 0x20)
         {
-            if ((Data[i + 2] == 0x74 || Data[i + 2] == 0x75) && Data[i + 3] < 0x20)  // jz/jnz short
-            {
-                // Patch to jmp (always jump / never jump depending on what makes sense)
-                // For protection checks, we usually want to skip the protection code
-                // jz -> jmp means "always take the zero branch"
-                if (Data[i + 2] == 0x75)  // jnz - change to jmp to always skip protection
-                {
-                    Data[i + 2] = 0xEB;  // jmp unconditional
-                    PatchCount++;
-                }
-            }
-        }
-    }
+            STATIC CONST UINT8 Jmp = 0xEB;
 
-    // Pattern 2: Look for return value checks (cmp eax, 0 / test eax, eax)
-    for (UINTN i = 0; i < ImageSize - 8; i++)
-    {
-        // cmp eax, 0: 83 F8 00 or 3D 00 00 00 00
-        if ((Data[i] == 0x83 && Data[i + 1] == 0xF8 && Data[i + 2] == 0x00) ||
-            (Data[i] == 0x3D && Data[i + 1] == 0x00 && Data[i + 2] == 0x00 && 
-             Data[i + 3] == 0x00 && Data[i + 4] == 0x00))
+            // jnz -> jmp to always skip the protection code
+            (VOID)PatchPlanWrite(Data, Offset, &Jmp, 1, PATCH_REASON_WRITE_PROTECT);
+            Walk->Count++;
+        }
+        else if (Walk->PrevIdiom == WP_IDIOM_CMP_EAX_0 && (Jnz8 || Jcc32))
         {
-            UINTN JmpOffset = (Data[i] == 0x83) ? (i + 3) : (i + 5);
-            if (JmpOffset < ImageSize - 2)
-            {
-                // Look for jnz/jne after the comparison
-                if (Data[JmpOffset] == 0x75 || Data[JmpOffset] == 0x0F)  // jnz short or long
-                {
-                    // Patch comparison to always return zero (success)
-                    // Change cmp eax, 0 to xor eax, eax (31 C0) + nop
-                    if (Data[i] == 0x83)
-                    {
-                        Data[i] = 0x31;      // xor
-                        Data[i + 1] = 0xC0;  // eax, eax
-                        Data[i + 2] = 0x90;  // nop
-                        PatchCount++;
-                    }
-                }
-            }
+            STATIC CONST UINT8 XorEax[] = {
+                0x31, 0xC0,  // xor eax, eax
+                0x90         // nop
+            };
+
+            // Patch comparison to always return zero (success)
+            // Change cmp eax, 0 to xor eax, eax (31 C0) + nop
+            (VOID)PatchPlanWrite(Data, Walk->PrevOpcode, XorEax, sizeof(XorEax), PATCH_REASON_WRITE_PROTECT);
+            Walk->Count++;
         }
     }
 
-    // Only log if patches were applied
-    if (PatchCount > 0)
+    Walk->PrevIdiom = WriteProtectIdiom(&Data[Offset], Instruction);
+    Walk->PrevOpcode = Offset + Instruction->OpcodeOffset;
+    Walk->PrevEnd = Offset + Instruction->Length;
+    return TRUE;
+}
+
+/**
+ * Helper: Pipeline chunk callback of the write protection stage
+ *
+ * The code sections are walked on instruction boundaries (x86-64), so a
+ * check is only patched where the compare and the branch really are
+ * consecutive instructions, never inside another instruction's operands
+ * or in data embedded in the code.
+ */
+STATIC VOID WriteProtectChunk(
+    VOID *Context,
+    IMAGE_SECTION_MAP *Map,
+    CONST IMAGE_SECTION *Section,
+    UINTN Start,
+    UINTN End)
+{
+    WRITE_PROTECT_WALK *Walk = (WRITE_PROTECT_WALK *)Context;
+
+    if (Start == Section->Offset)
     {
-        AsciiSPrint(Log, 512, "Disabled %d write protections\n\r", PatchCount);
-        LogToFile(LogFile, Log);
+        Walk->Cursor = Start;
+        Walk->PrevEnd = MAX_UINTN;
     }
 
-    return PatchCount;
+    Walk->Cursor = X86WalkCode(Map->ImageBase, MAX(Start, Walk->Cursor), End,
+                               (UINTN)Section->Offset + Section->Size, WriteProtectInstruction, Walk);
 }
 
 /**
@@ -635,12 +974,22 @@ PatchHpAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
 {
     EFI_STATUS Status;
     EFI_LOADED_IMAGE_PROTOCOL *ImageInfo = NULL;
+    IMAGE_SECTION_MAP SectionMap;
+    MODULE_PATCH_RESULT Result;
     UINTN FormsUnlocked = 0;
     
     Print(L"\n=== HP AMI BIOS Specific Patching ===\n");
     AsciiSPrint(Log, 512, "Applying HP-specific patches...\n\r");
     LogToFile(LogFile, Log);
     
+    // With a signature database the HP modules are its vendor entries
+    if (PatchDbIsLoaded(&gPatchDb))
+    {
+        AsciiSPrint(Log, 512, "HP modules come from the signature database\n\r");
+        LogToFile(LogFile, Log);
+        return EFI_SUCCESS;
+    }
+    
     // Try to find HPSetupData or NewHPSetupData module
     Status = FindLoadedImageFromName(ImageHandle, "HPSetupData", &ImageInfo);
     if (!EFI_ERROR(Status) && ImageInfo != NULL)
@@ -648,11 +997,9 @@ PatchHpAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
         Print(L"Found HPSetupData module at 0x%p\n", ImageInfo->ImageBase);
         
         // Unlock forms in HP Setup Data
-        FormsUnlocked += UnlockHiddenForms(
-            ImageInfo->ImageBase,
-            ImageInfo->ImageSize,
-            BiosInfo
-        );
+        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+        (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_UNLOCK_FORMS, NULL, &Result);
+        FormsUnlocked += Result.FormsUnlocked;
     }
     
     // Also try NewHPSetupData
@@ -661,11 +1008,9 @@ PatchHpAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     {
         Print(L"Found NewHPSetupData module at 0x%p\n", ImageInfo->ImageBase);
         
-        FormsUnlocked += UnlockHiddenForms(
-            ImageInfo->ImageBase,
-            ImageInfo->ImageSize,
-            BiosInfo
-        );
+        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+        (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_UNLOCK_FORMS, NULL, &Result);
+        FormsUnlocked += Result.FormsUnlocked;
     }
     
     // Try AMITSESetup (HP uses customized AMI TSE)
@@ -674,15 +1019,11 @@ PatchHpAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     {
         Print(L"Found AMITSESetup module at 0x%p\n", ImageInfo->ImageBase);
         
-        // Disable write protections
-        DisableWriteProtections(ImageInfo->ImageBase, ImageInfo->ImageSize);
-        
-        // Unlock forms
-        FormsUnlocked += UnlockHiddenForms(
-            ImageInfo->ImageBase,
-            ImageInfo->ImageSize,
-            BiosInfo
-        );
+        BuildImageSectionMap(ImageInfo->ImageBase, ImageInfo->ImageSize, &SectionMap);
+
+        // Disable write protections and unlock forms in one traversal
+        (VOID)PatchModuleImage(&SectionMap, MODULE_PASS_WRITE_PROTECT | MODULE_PASS_UNLOCK_FORMS, NULL, &Result);
+        FormsUnlocked += Result.FormsUnlocked;
     }
     
     Print(L"HP AMI patching complete: %u forms unlocked\n", FormsUnlocked);
@@ -692,192 +1033,439 @@ PatchHpAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
     return EFI_SUCCESS;
 }
 
+// Hidden form patterns, one pass over each data section
+#define UNLOCK_PATTERN_SUPPRESSIF   0
+#define UNLOCK_PATTERN_GRAYOUTIF    1
+#define UNLOCK_PATTERN_DISABLEIF    2
+
+STATIC CONST BYTE_PATTERN mUnlockPatterns[] = {
+    // SUPPRESSIF (0x0A 0x82), TRUE (0x46) checked in the callback
+    { { 0x0A, 0x82, 0x00, 0x00 }, { 0xFF, 0xFF, 0x00, 0x00 }, 4 },
+    // GRAYOUTIF (0x19) with TRUE at +2
+    { { 0x19, 0x00, 0x46 }, { 0xFF, 0x00, 0xFF }, 3 },
+    // DISABLEIF (0x1E) with TRUE at +2
+    { { 0x1E, 0x00, 0x46 }, { 0xFF, 0x00, 0xFF }, 3 }
+};
+
 /**
- * Unlock hidden forms by patching visibility flags
- * Searches for form visibility structures and enables them
+ * Helper: ByteScan callback of the hidden form stage
  */
-UINTN 
-UnlockHiddenForms(VOID *ImageBase, UINTN ImageSize, BIOS_INFO *BiosInfo)
+STATIC BOOLEAN UnlockFormMatch(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex)
 {
-    UINT8 *Data = (UINT8 *)ImageBase;
-    UINTN UnlockCount = 0;
-    UINTN i, j;
-    UINT32 *VisibilityFlag;
-    BOOLEAN LooksLikeGuid;
-    UINT8 ZeroCount, FFCount;
-    
-    if (ImageBase == NULL || ImageSize == 0)
-    {
-        return 0;
-    }
-    
-    // Pattern 1: AMI form suppression (suppressif TRUE)
-    // Look for: 0x0A 0x82 (SUPPRESSIF opcode) followed by condition
-    for (i = 0; i < ImageSize - 10; i++)
+    STATIC CONST UINT8 False = 0x47;
+    UINTN *UnlockCount = (UINTN *)Context;
+    UINTN j;
+
+    switch (PatternIndex)
     {
-        // SUPPRESSIF opcode (0x0A) with TRUE condition
-        if (Data[i] == 0x0A && Data[i + 1] == 0x82)
-        {
-            // Check if this is a TRUE condition (0x46)
-            if (Data[i + 2] == 0x46 || Data[i + 3] == 0x46)
-            {
-                // Replace with FALSE condition (0x47) or remove suppressif
-                // Convert SUPPRESSIF TRUE to SUPPRESSIF FALSE
-                for (j = 0; j < 4 && (i + j) < ImageSize; j++)
-                {
-                    if (Data[i + j] == 0x46)
-                    {
-                        Data[i + j] = 0x47;  // TRUE -> FALSE
-                        UnlockCount++;
-                        break;
-                    }
-                }
-            }
-        }
-        
-        // GRAYOUTIF opcode (0x19)
-        if (Data[i] == 0x19 && i + 3 < ImageSize)
-        {
-            if (Data[i + 2] == 0x46)
-            {
-                Data[i + 2] = 0x47;  // TRUE -> FALSE
-                UnlockCount++;
-            }
-        }
-        
-        // DISABLEIF opcode (0x1E)
-        if (Data[i] == 0x1E && i + 3 < ImageSize)
+    case UNLOCK_PATTERN_SUPPRESSIF:
+        // Convert SUPPRESSIF TRUE to SUPPRESSIF FALSE
+        for (j = 2; j < 4; j++)
         {
-            if (Data[i + 2] == 0x46)
+            if (Data[Offset + j] == 0x46)
             {
-                Data[i + 2] = 0x47;  // TRUE -> FALSE
-                UnlockCount++;
+                (VOID)PatchPlanWrite(Data, Offset + j, &False, 1, PATCH_REASON_UNLOCK_FORM);  // TRUE -> FALSE
+                (*UnlockCount)++;
+                break;
             }
         }
+        break;
+
+    case UNLOCK_PATTERN_GRAYOUTIF:
+    case UNLOCK_PATTERN_DISABLEIF:
+        (VOID)PatchPlanWrite(Data, Offset + 2, &False, 1, PATCH_REASON_UNLOCK_FORM);  // TRUE -> FALSE
+        (*UnlockCount)++;
+        break;
     }
-    
-    // Pattern 2: HP-specific form visibility flags
-    // HP uses a different structure for form visibility
-    // Search for patterns like: [GUID][uint32 visibility flag]
-    // When flag is 0x00000000, form is hidden
-    for (i = 0; i < ImageSize - 20; i++)
-    {
-        // Look for GUID pattern followed by 0x00000000 (hidden flag)
-        // GUIDs have specific structure, we can detect them
-        if (i + 20 < ImageSize)
+
+    return TRUE;
+}
+
+/**
+ * Helper: FormSetGuidSetScan callback of the HP form visibility stage
+ */
+STATIC BOOLEAN UnlockVisibilityMatch(VOID *Context, UINT8 *Data, UINTN Offset)
+{
+    UINTN *UnlockCount = (UINTN *)Context;
+    UINT32 Visible = 0x01000000;
+
+    // HP form visibility: [FormSet GUID][UINT32 flag == 0]
+    if (ReadUnaligned32((UINT32 *)&Data[Offset + sizeof(EFI_GUID)]) == 0)
+    {
+        (VOID)PatchPlanWrite(Data, Offset + sizeof(EFI_GUID), &Visible, sizeof(Visible), PATCH_REASON_FORM_VISIBILITY);
+        (*UnlockCount)++;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Run several patchers over a module in one traversal
+ *
+ * IFR planning is registered first, so the FormSets of a chunk are known
+ * (and their GUIDs are in gFormSetGuids) before the visibility stages look
+ * at it. Write protections are found by walking the code instructions of
+ * each chunk; the AMI and unlock predicates share one ByteScan per chunk,
+ * and none of their patches can create or break a match of another.
+ */
+EFI_STATUS PatchModuleImage(
+    IMAGE_SECTION_MAP *Map,
+    UINT32 Passes,
+    PATCH_PLAN *Plan,
+    MODULE_PATCH_RESULT *Result)
+{
+    PATCH_PIPELINE Pipeline;
+    PATCH_PIPELINE_STAGE Stage;
+    PATCH_PLAN *Journal = gPatchJournal;
+    IFR_PLAN_STAGE IfrState;
+    FORMSET_GUID_STAGE InsydeState;
+    FORMSET_GUID_STAGE UnlockState;
+    WRITE_PROTECT_WALK WriteProtect;
+    PROFILE_SPAN Span;
+    BOOLEAN PlanIfr = (Passes & MODULE_PASS_IFR) != 0;
+    BOOLEAN NeedGuids = (Passes & (MODULE_PASS_INSYDE_FORMS | MODULE_PASS_UNLOCK_FORMS)) != 0;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    if (Map == NULL || Map->ImageBase == NULL || Result == NULL || (PlanIfr && Plan == NULL))
+        return EFI_INVALID_PARAMETER;
+
+    ZeroMem(Result, sizeof(MODULE_PATCH_RESULT));
+
+    // Plan-only runs record the writes below; apply-only runs take them from the manifest
+    if (!PatchManifestBeginModule(&gPatchManifest, Map))
+        return EFI_SUCCESS;
+
+    // Every write of the passes lands in the plan too, so one PatchPlanRevert undoes the module
+    if (Plan != NULL)
+        gPatchJournal = Plan;
+
+    TRACE3(TRACE_MODULE_BEGIN, (UINTN)Map->ImageBase, Map->ImageSize, Passes);
+    ProfileBegin(&Span);
+    ZeroMem(&WriteProtect, sizeof(WriteProtect));
+    PatchPipelineInit(&Pipeline);
+
+    // Without MODULE_PASS_IFR the stage only collects FormSet GUIDs
+    if (PlanIfr || NeedGuids)
+    {
+        IfrPlanStageInit(&IfrState, PlanIfr ? Plan : NULL, NeedGuids ? &gFormSetGuids : NULL, &Stage);
+        (VOID)PatchPipelineAddStage(&Pipeline, &Stage);
+    }
+
+    if ((Passes & MODULE_PASS_WRITE_PROTECT) != 0)
+    {
+        ZeroMem(&Stage, sizeof(Stage));
+        Stage.Name = "DisableWriteProtections";
+        Stage.KindMask = IMAGE_SECTION_CODE;
+        Stage.Chunk = WriteProtectChunk;
+        Stage.Context = &WriteProtect;
+        (VOID)PatchPipelineAddStage(&Pipeline, &Stage);
+    }
+
+    if ((Passes & MODULE_PASS_AMI_FORMS) != 0)
+    {
+        PatchAmiFormsStage(&Result->VendorPatches, &Stage);
+        (VOID)PatchPipelineAddStage(&Pipeline, &Stage);
+    }
+
+    if ((Passes & MODULE_PASS_INSYDE_FORMS) != 0)
+    {
+        AsciiSPrint(Log, 512, "Applying Insyde-specific form patches...\n\r");
+        LogToFile(LogFile, Log);
+        PatchInsydeFormsStage(&InsydeState, &Result->VendorPatches, &Stage);
+        (VOID)PatchPipelineAddStage(&Pipeline, &Stage);
+    }
+
+    if ((Passes & MODULE_PASS_UNLOCK_FORMS) != 0)
+    {
+        ZeroMem(&Stage, sizeof(Stage));
+        Stage.Name = "UnlockHiddenForms";
+        Stage.KindMask = IMAGE_SECTION_DATA;
+        Stage.Patterns = mUnlockPatterns;
+        Stage.PatternCount = ARRAY_SIZE(mUnlockPatterns);
+        Stage.Match = UnlockFormMatch;
+        Stage.Context = &Result->FormsUnlocked;
+        (VOID)PatchPipelineAddStage(&Pipeline, &Stage);
+
+        (VOID)FormSetGuidSetAddHii(&gFormSetGuids);
+        FormSetGuidStageInit(&UnlockState, &gFormSetGuids, sizeof(UINT32), UnlockVisibilityMatch,
+                             &Result->FormsUnlocked, &Stage);
+        (VOID)PatchPipelineAddStage(&Pipeline, &Stage);
+    }
+
+    PatchPipelineRun(&Pipeline, Map);
+    Result->WriteProtections = WriteProtect.Count;
+
+    if (PlanIfr || NeedGuids)
+    {
+        Status = IfrPlanStageDone(&IfrState);
+        Result->IfrPatches = IfrState.PatchCount;
+        if (!PlanIfr)
+            Status = EFI_SUCCESS;
+    }
+
+    // Records whose bytes a stage changed are skipped by PatchPlanApply
+    if (Plan != NULL && !EFI_ERROR(Status))
+    {
+        Result->IfrApplied = PatchPlanApply(Plan, Map->ImageBase, Map->ImageSize);
+    }
+    gPatchJournal = Journal;
+    PatchManifestEndModule(&gPatchManifest);
+    ProfileEndModule(&Span, Map->ImageBase, Map->ImageSize, Pipeline.Bytes);
+    TRACE4(TRACE_MODULE_END, (UINTN)Map->ImageBase, Result->WriteProtections, Result->VendorPatches,
+           Result->IfrApplied);
+
+    // Same log lines as the standalone patchers
+    if (Result->WriteProtections > 0)
+    {
+        AsciiSPrint(Log, 512, "Disabled %d write protections\n\r", Result->WriteProtections);
+        LogToFile(LogFile, Log);
+    }
+    if (Result->VendorPatches > 0)
+    {
+        AsciiSPrint(Log, 512, "Applied %d %a-specific patches\n\r", Result->VendorPatches,
+                    (Passes & MODULE_PASS_AMI_FORMS) != 0 ? "AMI" : "Insyde");
+        LogToFile(LogFile, Log);
+    }
+
+    return Status;
+}
+
+// One name occurrence found by PatchBiosDataBatch
+typedef struct {
+    UINTN Offset;
+    UINTN Pattern;               // 2 * patch index, +1 for the UTF-16 form
+} BIOS_DATA_MATCH;
+
+typedef struct {
+    BIOS_DATA_PATCH *Patches;
+    BIOS_DATA_MATCH *Matches;
+    UINTN Count;
+    UINTN Capacity;
+    BOOLEAN OutOfResources;
+} BIOS_DATA_SCAN;
+
+/**
+ * Helper: StringMatcherScan callback for PatchBiosDataBatch
+ */
+STATIC BOOLEAN BiosDataNameMatch(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex)
+{
+    BIOS_DATA_SCAN *Scan = (BIOS_DATA_SCAN *)Context;
+    BIOS_DATA_PATCH *Patch = &Scan->Patches[PatternIndex / 2];
+
+    if (Scan->Count == Scan->Capacity)
+    {
+        UINTN Capacity = Scan->Capacity == 0 ? 64 : Scan->Capacity * 2;
+        BIOS_DATA_MATCH *Matches = TaggedReallocatePool(POOL_TAG_PATCH, Scan->Capacity * sizeof(BIOS_DATA_MATCH),
+                                                        Capacity * sizeof(BIOS_DATA_MATCH), Scan->Matches);
+        if (Matches == NULL)
         {
-            // Check if next 4 bytes after potential GUID (16 bytes) are 0x00000000
-            VisibilityFlag = (UINT32 *)&Data[i + 16];
-            
-            // If we find a 0x00000000 flag that looks like a visibility control
-            // we can try changing it to 0x01000000 (visible)
-            // This is a heuristic and should be used carefully
-            if (*VisibilityFlag == 0x00000000)
-            {
-                // Verify this looks like a form structure
-                // Check for GUID-like pattern (not all zeros, not all FFs)
-                LooksLikeGuid = FALSE;
-                ZeroCount = 0;
-                FFCount = 0;
-                
-                for (j = 0; j < 16; j++)
-                {
-                    if (Data[i + j] == 0x00) ZeroCount++;
-                    if (Data[i + j] == 0xFF) FFCount++;
-                }
-                
-                // GUID should have mix of values
-                if (ZeroCount < 14 && FFCount < 14)
-                {
-                    LooksLikeGuid = TRUE;
-                }
-                
-                if (LooksLikeGuid)
-                {
-                    // Enable this form
-                    *VisibilityFlag = 0x01000000;
-                    UnlockCount++;
-                }
-            }
+            Scan->OutOfResources = TRUE;
+            return FALSE;
         }
+        Scan->Matches = Matches;
+        Scan->Capacity = Capacity;
     }
-    
-    return UnlockCount;
+
+    Print(L"Found variable '%s' (%a) at offset 0x%X\n", Patch->VarName,
+          (PatternIndex & 1) != 0 ? "UTF-16" : "ASCII", Offset);
+    Patch->Matches++;
+    Scan->Matches[Scan->Count].Offset = Offset;
+    Scan->Matches[Scan->Count].Pattern = PatternIndex;
+    Scan->Count++;
+    return TRUE;
 }
 
 /**
- * Save patched values to BIOS data structures
- * This writes directly to in-memory structures, not NVRAM
+ * Helper: ASCII and UTF-16LE forms of every name, for the matcher
  */
+STATIC EFI_STATUS BiosDataBuildMatcher(BIOS_DATA_PATCH *Patches, UINTN Count, STRING_MATCHER *Matcher)
+{
+    EFI_STATUS Status;
+    CONST UINT8 **Patterns;
+    UINTN *Lengths;
+    UINT8 *Bytes;
+    UINTN Total = 0;
+    UINTN Used = 0;
+
+    for (UINTN p = 0; p < Count; p++)
+        Total += 3 * StrLen(Patches[p].VarName);
+
+    Patterns = TaggedAllocatePool(POOL_TAG_PATCH, 2 * Count * sizeof(UINT8 *));
+    Lengths = TaggedAllocatePool(POOL_TAG_PATCH, 2 * Count * sizeof(UINTN));
+    Bytes = TaggedAllocatePool(POOL_TAG_PATCH, Total);
+    if (Patterns == NULL || Lengths == NULL || Bytes == NULL)
+    {
+        if (Patterns != NULL)
+            TaggedFreePool(Patterns);
+        if (Lengths != NULL)
+            TaggedFreePool(Lengths);
+        if (Bytes != NULL)
+            TaggedFreePool(Bytes);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (UINTN p = 0; p < Count; p++)
+    {
+        UINTN Length = StrLen(Patches[p].VarName);
+        UINT8 *Ascii = &Bytes[Used];
+        UINT8 *Wide = &Bytes[Used + Length];
+
+        for (UINTN i = 0; i < Length; i++)
+        {
+            Ascii[i] = (UINT8)Patches[p].VarName[i];
+            Wide[2 * i] = (UINT8)Patches[p].VarName[i];
+            Wide[2 * i + 1] = (UINT8)(Patches[p].VarName[i] >> 8);
+        }
+
+        Patterns[2 * p] = Ascii;
+        Lengths[2 * p] = Length;
+        Patterns[2 * p + 1] = Wide;
+        Lengths[2 * p + 1] = 2 * Length;
+        Used += 3 * Length;
+    }
+
+    // The automaton keeps no reference to the pattern bytes
+    Status = StringMatcherBuild(Matcher, Patterns, Lengths, 2 * Count);
+    TaggedFreePool(Patterns);
+    TaggedFreePool(Lengths);
+    TaggedFreePool(Bytes);
+    return Status;
+}
+
 EFI_STATUS 
-PatchBiosData(
-    VOID *ImageBase,
-    UINTN ImageSize,
-    CHAR16 *VarName,
-    UINTN Offset,
-    VOID *Value,
-    UINTN ValueSize
+PatchBiosDataBatch(
+    IMAGE_SECTION_MAP *Map,
+    BIOS_DATA_PATCH *Patches,
+    UINTN Count
 )
 {
-    UINT8 *Data = (UINT8 *)ImageBase;
-    CHAR8 AsciiVarName[128];
-    UINTN VarNameLen;
-    UINTN MatchCount = 0;
-    
-    if (ImageBase == NULL || VarName == NULL || Value == NULL)
+    EFI_STATUS Status;
+    STRING_MATCHER Matcher;
+    BIOS_DATA_SCAN Scan;
+    UINT8 *Data;
+
+    if (Map == NULL || Map->ImageBase == NULL || Map->ImageSize == 0 || Patches == NULL || Count == 0)
     {
         return EFI_INVALID_PARAMETER;
     }
-    
-    if (ImageSize == 0 || ValueSize == 0)
+
+    for (UINTN p = 0; p < Count; p++)
     {
-        return EFI_INVALID_PARAMETER;
+        UINTN Length;
+
+        if (Patches[p].VarName == NULL || Patches[p].Value == NULL || Patches[p].ValueSize == 0)
+        {
+            return EFI_INVALID_PARAMETER;
+        }
+
+        Length = StrLen(Patches[p].VarName);
+        if (Length == 0 || Length > BIOS_DATA_MAX_NAME_LENGTH)
+        {
+            return EFI_INVALID_PARAMETER;
+        }
+
+        Patches[p].Matches = 0;
+        Patches[p].Applied = 0;
     }
-    
-    // Convert variable name to ASCII for searching
-    VarNameLen = StrLen(VarName);
-    if (VarNameLen >= sizeof(AsciiVarName))
+
+    Status = BiosDataBuildMatcher(Patches, Count, &Matcher);
+    if (EFI_ERROR(Status))
     {
-        return EFI_INVALID_PARAMETER;
+        return Status;
     }
-    
-    for (UINTN i = 0; i < VarNameLen; i++)
+
+    Print(L"Searching for %u variables in BIOS data...\n", Count);
+
+    // One pass over the mapped sections (GenFw merges .rodata into .text, so
+    // both code and data are searched; headers and relocations are not)
+    ZeroMem(&Scan, sizeof(Scan));
+    Scan.Patches = Patches;
+    Data = Map->ImageBase;
+    for (UINTN s = 0; s < Map->SectionCount && !Scan.OutOfResources; s++)
     {
-        AsciiVarName[i] = (CHAR8)VarName[i];
+        IMAGE_SECTION *Section = &Map->Sections[s];
+
+        if (Section->Kind == 0)
+        {
+            continue;
+        }
+
+        StringMatcherScan(&Matcher, Data, Section->Offset, (UINTN)Section->Offset + Section->Size,
+                          BiosDataNameMatch, &Scan);
     }
-    AsciiVarName[VarNameLen] = 0;
-    
-    Print(L"Searching for variable '%s' in BIOS data...\n", VarName);
-    
-    // Search for variable name in the image
-    for (UINTN i = 0; i < ImageSize - VarNameLen; i++)
+    StringMatcherFree(&Matcher);
+
+    if (Scan.OutOfResources)
     {
-        if (CompareMem(&Data[i], AsciiVarName, VarNameLen) == 0)
+        if (Scan.Matches != NULL)
+            TaggedFreePool(Scan.Matches);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    // Write after the scan, in image order
+    for (UINTN m = 0; m < Scan.Count; m++)
+    {
+        BIOS_DATA_PATCH *Patch = &Patches[Scan.Matches[m].Pattern / 2];
+        UINTN Offset = Scan.Matches[m].Offset;
+
+        if (Patch->Applied > 0 && (Patch->Flags & BIOS_DATA_PATCH_EVERY_MATCH) == 0)
         {
-            Print(L"Found variable reference at offset 0x%X\n", i);
-            MatchCount++;
-            
-            // Check if we can apply the patch at the specified offset
-            if (i + Offset + ValueSize <= ImageSize)
-            {
-                Print(L"Patching %u bytes at offset 0x%X + 0x%X\n", 
-                      ValueSize, i, Offset);
-                
-                // Apply the patch
-                CopyMem(&Data[i + Offset], Value, ValueSize);
-                
-                Print(L"Patch applied successfully\n");
-                return EFI_SUCCESS;
-            }
+            continue;
+        }
+
+        // Check if we can apply the patch at the specified offset
+        if (Offset + Patch->Offset + Patch->ValueSize > Map->ImageSize)
+        {
+            continue;
         }
+
+        Print(L"Patching %u bytes of '%s' at offset 0x%X + 0x%X\n",
+              Patch->ValueSize, Patch->VarName, Offset, Patch->Offset);
+        (VOID)PatchPlanWrite(Data, Offset + Patch->Offset, Patch->Value, Patch->ValueSize, PATCH_REASON_BIOS_DATA);
+        Patch->Applied++;
     }
-    
-    if (MatchCount == 0)
+
+    if (Scan.Matches != NULL)
+        TaggedFreePool(Scan.Matches);
+
+    Status = EFI_SUCCESS;
+    for (UINTN p = 0; p < Count; p++)
     {
-        Print(L"Variable '%s' not found in BIOS data\n", VarName);
-        return EFI_NOT_FOUND;
+        if (Patches[p].Matches == 0)
+        {
+            Print(L"Variable '%s' not found in BIOS data\n", Patches[p].VarName);
+            Status = EFI_NOT_FOUND;
+        }
+        else if (Patches[p].Applied == 0)
+        {
+            Print(L"Found variable '%s' but could not apply patch at specified offset\n", Patches[p].VarName);
+            if (Status == EFI_SUCCESS)
+                Status = EFI_INVALID_PARAMETER;
+        }
     }
-    
-    Print(L"Found variable but could not apply patch at specified offset\n");
-    return EFI_INVALID_PARAMETER;
+
+    return Status;
+}
+
+/**
+ * Save patched values to BIOS data structures
+ * This writes directly to in-memory structures, not NVRAM
+ */
+EFI_STATUS 
+PatchBiosData(
+    IMAGE_SECTION_MAP *Map,
+    CHAR16 *VarName,
+    UINTN Offset,
+    VOID *Value,
+    UINTN ValueSize
+)
+{
+    BIOS_DATA_PATCH Patch;
+
+    ZeroMem(&Patch, sizeof(Patch));
+    Patch.VarName = VarName;
+    Patch.Offset = Offset;
+    Patch.Value = Value;
+    Patch.ValueSize = ValueSize;
+    return PatchBiosDataBatch(Map, &Patch, 1);
 }
@@ -46,15 +46,6 @@ EFI_STATUS LoadAndPatchModule(EFI_HANDLE ImageHandle, CHAR8 *ModuleName, BIOS_IN
  */
 EFI_STATUS PatchSetupDependencies(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo);
 
-/**
- * Disable write protections in common locations
- * 
- * @param ImageBase     Base address of module to patch
- * @param ImageSize     Size of the module
- * @return Number of protections disabled
- */
-UINTN DisableWriteProtections(VOID *ImageBase, UINTN ImageSize);
-
 /**
  * Find and patch AMI BIOS specific structures
  * 
@@ -92,23 +83,77 @@ EFI_STATUS ExecuteSetupBrowser(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo);
  */
 EFI_STATUS PatchHpAmiBios(EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo);
 
+// PatchModuleImage passes
+#define MODULE_PASS_WRITE_PROTECT   BIT0   // Write protection checks in code sections
+#define MODULE_PASS_AMI_FORMS       BIT1   // PatchAmiForms
+#define MODULE_PASS_INSYDE_FORMS    BIT2   // PatchInsydeForms
+#define MODULE_PASS_IFR             BIT3   // ParseIfrData, then PatchPlanApply
+#define MODULE_PASS_UNLOCK_FORMS    BIT4   // Hidden form conditions and HP form visibility flags
+
+// What PatchModuleImage did to one module
+typedef struct {
+    UINTN WriteProtections;
+    UINTN VendorPatches;         // AMI and Insyde form patches
+    UINTN IfrPatches;            // Hide-condition patches planned by the IFR pass
+    UINTN IfrApplied;            // Plan records applied
+    UINTN FormsUnlocked;
+} MODULE_PATCH_RESULT;
+
 /**
- * Unlock hidden forms by patching visibility flags in BIOS data
- * This directly modifies form structures in memory
- * 
- * @param ImageBase     Base address of Setup module
- * @param ImageSize     Size of the module
- * @param BiosInfo      BIOS information
- * @return Number of forms unlocked
+ * Run several patchers over a module in one traversal
+ *
+ * The passes become stages of one patch pipeline, so each chunk of the
+ * image is read once while every patcher works on it. The IFR pass plans
+ * from the bytes as they were before the other passes wrote to them; the
+ * plan is applied after the traversal.
+ *
+ * The module is bracketed by PatchManifestBeginModule/EndModule: a
+ * plan-only run records every write instead of making it, and an
+ * apply-only run writes the manifest records and runs no pass.
+ *
+ * The plan also receives every write the passes make (gPatchJournal), so
+ * after the call PatchPlanRevert on it restores the module.
+ *
+ * @param Map           Section map of the module
+ * @param Passes        MODULE_PASS_* flags
+ * @param Plan          Receives the IFR plan with MODULE_PASS_IFR; without it
+ *                      an already computed plan to apply, or NULL. Growable
+ *                      (PatchPlanInit) when given.
+ * @param Result        Receives the patch counts
+ * @return The ParseIfrData result with MODULE_PASS_IFR (the plan is applied
+ *         only on success), otherwise EFI_SUCCESS
  */
-UINTN UnlockHiddenForms(VOID *ImageBase, UINTN ImageSize, BIOS_INFO *BiosInfo);
+EFI_STATUS PatchModuleImage(
+    IMAGE_SECTION_MAP *Map,
+    UINT32 Passes,
+    PATCH_PLAN *Plan,
+    MODULE_PATCH_RESULT *Result
+);
+
+// Longest variable name PatchBiosData/PatchBiosDataBatch accept (characters)
+#define BIOS_DATA_MAX_NAME_LENGTH 127
+
+// BIOS_DATA_PATCH.Flags
+#define BIOS_DATA_PATCH_EVERY_MATCH BIT0   // Patch every occurrence, not just the first that fits
+
+// One in-image variable patch for PatchBiosDataBatch
+typedef struct {
+    CHAR16 *VarName;             // Matched as ASCII and as UTF-16LE
+    UINTN Offset;                // From the first byte of the name
+    VOID *Value;
+    UINTN ValueSize;
+    UINT32 Flags;                // BIOS_DATA_PATCH_*
+    UINTN Matches;               // Out: occurrences of the name
+    UINTN Applied;               // Out: occurrences patched
+} BIOS_DATA_PATCH;
 
 /**
  * Save patched values to BIOS data structures (not NVRAM)
  * This writes directly to in-memory BIOS structures
+ *
+ * A one-entry PatchBiosDataBatch.
  * 
- * @param ImageBase     Base address of target module
- * @param ImageSize     Size of the module
+ * @param Map           Section map of the target module
  * @param VarName       Variable name to modify
  * @param Offset        Offset within variable data
  * @param Value         New value to write
@@ -116,10 +161,31 @@ UINTN UnlockHiddenForms(VOID *ImageBase, UINTN ImageSize, BIOS_INFO *BiosInfo);
  * @return EFI_SUCCESS if successful
  */
 EFI_STATUS PatchBiosData(
-    VOID *ImageBase,
-    UINTN ImageSize,
+    IMAGE_SECTION_MAP *Map,
     CHAR16 *VarName,
     UINTN Offset,
     VOID *Value,
     UINTN ValueSize
 );
+
+/**
+ * Apply many in-image variable patches with one pass over the image
+ *
+ * All names (ASCII and UTF-16LE forms) go into one Aho-Corasick automaton,
+ * so the mapped sections are read once however many variables are patched.
+ * Every occurrence is reported; patches are written after the scan, in
+ * image order, so a patch never hides a later name.
+ *
+ * @param Map           Section map of the target module
+ * @param Patches       Patches; Matches and Applied are filled in
+ * @param Count         Number of patches
+ * @return EFI_SUCCESS if every patch was applied at least once
+ * @return EFI_NOT_FOUND if a name does not occur
+ * @return EFI_INVALID_PARAMETER for a bad entry, or a name whose value never fits
+ * @return EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS PatchBiosDataBatch(
+    IMAGE_SECTION_MAP *Map,
+    BIOS_DATA_PATCH *Patches,
+    UINTN Count
+);
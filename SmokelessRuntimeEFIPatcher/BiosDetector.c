@@ -1,4 +1,5 @@
 #include "BiosDetector.h"
+#include "FvFileIndex.h"
 #include <Guid/SmBios.h>
 #include <Protocol/Smbios.h>
 #include <IndustryStandard/SmBios.h>
@@ -190,20 +191,12 @@ EFI_STATUS DetectBiosType(BIOS_INFO *BiosInfo)
 EFI_STATUS FindSetupModules(BIOS_INFO *BiosInfo)
 {
     EFI_STATUS Status;
-    EFI_HANDLE *HandleBuffer;
-    UINTN NumberOfHandles;
-    UINTN Index;
-    EFI_FIRMWARE_VOLUME2_PROTOCOL *FvInstance;
 
     AsciiSPrint(Log, 512, "Searching for Setup modules in Firmware Volumes...\n\r");
     LogToFile(LogFile, Log);
 
-    Status = gBS->LocateHandleBuffer(
-        ByProtocol,
-        &gEfiFirmwareVolume2ProtocolGuid,
-        NULL,
-        &NumberOfHandles,
-        &HandleBuffer);
+    // One sweep of every FV; LoadFV and the patch phases reuse it
+    Status = FvFileIndexBuild(&gFvFileIndex);
 
     if (EFI_ERROR(Status))
     {
@@ -212,111 +205,75 @@ EFI_STATUS FindSetupModules(BIOS_INFO *BiosInfo)
         return Status;
     }
 
-    AsciiSPrint(Log, 512, "Found %d Firmware Volume instances\n\r", NumberOfHandles);
+    AsciiSPrint(Log, 512, "Found %d Firmware Volume instances (%d memory mapped, %d files, %d UI sections read)\n\r",
+                gFvFileIndex.VolumeCount, gFvFileIndex.MappedVolumeCount, gFvFileIndex.Count, gFvFileIndex.NamesRead);
     LogToFile(LogFile, Log);
 
     BOOLEAN SetupFound = FALSE;
     BOOLEAN FormBrowserFound = FALSE;
     UINTN ModulesWithIfrCount = 0;
 
-    for (Index = 0; Index < NumberOfHandles; Index++)
+    for (UINTN Index = 0; Index < gFvFileIndex.Count; Index++)
     {
-        Status = gBS->HandleProtocol(
-            HandleBuffer[Index],
-            &gEfiFirmwareVolume2ProtocolGuid,
-            (VOID **)&FvInstance);
-        
-        if (EFI_ERROR(Status))
-            continue;
+        CHAR16 *ModuleName = gFvFileIndex.Entries[Index].Name;
 
-        EFI_FV_FILETYPE FileType;
-        EFI_FV_FILE_ATTRIBUTES FileAttributes;
-        UINTN FileSize;
-        EFI_GUID NameGuid;
-        VOID *Keys = AllocateZeroPool(FvInstance->KeySize);
+        if (ModuleName == NULL)
+            continue;
 
-        while (TRUE)
+        // Log modules that might contain IFR data
+        if (ContainsString(ModuleName, L"Setup") || 
+            ContainsString(ModuleName, L"Form") ||
+            ContainsString(ModuleName, L"Hii") ||
+            ContainsString(ModuleName, L"Browser") ||
+            ContainsString(ModuleName, L"HP"))  // Add HP modules
         {
-            FileType = EFI_FV_FILETYPE_ALL;
-            ZeroMem(&NameGuid, sizeof(EFI_GUID));
-            Status = FvInstance->GetNextFile(FvInstance, Keys, &FileType, &NameGuid, &FileAttributes, &FileSize);
-            
-            if (EFI_ERROR(Status))
-                break;
-
-            VOID *String = NULL;
-            UINTN StringSize = 0;
-            UINT32 AuthenticationStatus;
-            
-            Status = FvInstance->ReadSection(FvInstance, &NameGuid, EFI_SECTION_USER_INTERFACE, 
-                                            0, &String, &StringSize, &AuthenticationStatus);
+            ModulesWithIfrCount++;
+            AsciiSPrint(Log, 512, "Module with potential IFR data: %s\n\r", ModuleName);
+            LogToFile(LogFile, Log);
+        }
+        
+        // Look for HP-specific modules
+        if (BiosInfo->Type == BIOS_TYPE_AMI_HP_CUSTOM)
+        {
+            if (ContainsString(ModuleName, L"HPSetup") ||
+                (ContainsString(ModuleName, L"HP") && ContainsString(ModuleName, L"Setup")))
+            {
+                AsciiSPrint(Log, 512, "Found HP Setup Module: %s\n\r", ModuleName);
+                LogToFile(LogFile, Log);
+            }
             
-            if (!EFI_ERROR(Status) && String != NULL)
+            if (ContainsString(ModuleName, L"HPAmiTse") ||
+                ContainsString(ModuleName, L"AMITSE"))
             {
-                CHAR16 *ModuleName = (CHAR16 *)String;
-                
-                // Log modules that might contain IFR data
-                if (ContainsString(ModuleName, L"Setup") || 
-                    ContainsString(ModuleName, L"Form") ||
-                    ContainsString(ModuleName, L"Hii") ||
-                    ContainsString(ModuleName, L"Browser") ||
-                    ContainsString(ModuleName, L"HP"))  // Add HP modules
-                {
-                    ModulesWithIfrCount++;
-                    AsciiSPrint(Log, 512, "Module with potential IFR data: %s\n\r", ModuleName);
-                    LogToFile(LogFile, Log);
-                }
-                
-                // Look for HP-specific modules
-                if (BiosInfo->Type == BIOS_TYPE_AMI_HP_CUSTOM)
-                {
-                    if (ContainsString(ModuleName, L"HPSetup") ||
-                        (ContainsString(ModuleName, L"HP") && ContainsString(ModuleName, L"Setup")))
-                    {
-                        AsciiSPrint(Log, 512, "Found HP Setup Module: %s\n\r", ModuleName);
-                        LogToFile(LogFile, Log);
-                    }
-                    
-                    if (ContainsString(ModuleName, L"HPAmiTse") ||
-                        ContainsString(ModuleName, L"AMITSE"))
-                    {
-                        AsciiSPrint(Log, 512, "Found HP AMI TSE Module: %s\n\r", ModuleName);
-                        LogToFile(LogFile, Log);
-                    }
-                }
-                
-                // Look for Setup module variants (prefer non-PEI modules)
-                if (!SetupFound && (ContainsString(ModuleName, L"Setup") || 
-                    ContainsString(ModuleName, L"SetupUtility")))
-                {
-                    // Skip PEI modules for Setup execution
-                    if (!ContainsString(ModuleName, L"Pei") && !ContainsString(ModuleName, L"PEI"))
-                    {
-                        StrCpyS(BiosInfo->SetupModuleName, 64, ModuleName);
-                        SetupFound = TRUE;
-                        AsciiSPrint(Log, 512, "Found Setup Module: %s\n\r", ModuleName);
-                        LogToFile(LogFile, Log);
-                    }
-                }
-                
-                // Look for FormBrowser variants
-                if (!FormBrowserFound && ContainsString(ModuleName, L"FormBrowser"))
-                {
-                    StrCpyS(BiosInfo->FormBrowserName, 64, ModuleName);
-                    FormBrowserFound = TRUE;
-                    AsciiSPrint(Log, 512, "Found FormBrowser Module: %s\n\r", ModuleName);
-                    LogToFile(LogFile, Log);
-                }
-                
-                FreePool(String);
+                AsciiSPrint(Log, 512, "Found HP AMI TSE Module: %s\n\r", ModuleName);
+                LogToFile(LogFile, Log);
+            }
+        }
+        
+        // Look for Setup module variants (prefer non-PEI modules)
+        if (!SetupFound && (ContainsString(ModuleName, L"Setup") || 
+            ContainsString(ModuleName, L"SetupUtility")))
+        {
+            // Skip PEI modules for Setup execution
+            if (!ContainsString(ModuleName, L"Pei") && !ContainsString(ModuleName, L"PEI"))
+            {
+                StrCpyS(BiosInfo->SetupModuleName, 64, ModuleName);
+                SetupFound = TRUE;
+                AsciiSPrint(Log, 512, "Found Setup Module: %s\n\r", ModuleName);
+                LogToFile(LogFile, Log);
             }
         }
         
-        FreePool(Keys);
+        // Look for FormBrowser variants
+        if (!FormBrowserFound && ContainsString(ModuleName, L"FormBrowser"))
+        {
+            StrCpyS(BiosInfo->FormBrowserName, 64, ModuleName);
+            FormBrowserFound = TRUE;
+            AsciiSPrint(Log, 512, "Found FormBrowser Module: %s\n\r", ModuleName);
+            LogToFile(LogFile, Log);
+        }
     }
 
-    FreePool(HandleBuffer);
-
     AsciiSPrint(Log, 512, "Found %d modules with potential IFR data\n\r", ModulesWithIfrCount);
     LogToFile(LogFile, Log);
 
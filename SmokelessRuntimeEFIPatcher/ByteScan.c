@@ -0,0 +1,477 @@
+#include "ByteScan.h"
+
+//
+// Vector kernels use GCC vector extensions so no intrinsic headers are
+// needed. Other compilers and architectures get the SWAR kernel.
+//
+#if defined(MDE_CPU_X64) && defined(__GNUC__)
+#define BYTE_SCAN_HAVE_SIMD 1
+
+typedef char BYTE_VEC16 __attribute__((vector_size(16)));
+typedef char BYTE_VEC16U __attribute__((vector_size(16), aligned(1)));
+typedef char BYTE_VEC32 __attribute__((vector_size(32)));
+typedef char BYTE_VEC32U __attribute__((vector_size(32), aligned(1)));
+#else
+#define BYTE_SCAN_HAVE_SIMD 0
+#endif
+
+#define SWAR_ONES ((UINTN)0x0101010101010101ULL)
+#define SWAR_LOW7 ((UINTN)0x7F7F7F7F7F7F7F7FULL)
+
+STATIC BYTE_SCAN_KERNEL mKernel = BYTE_SCAN_KERNEL_AUTO;
+
+/**
+ * Check a pattern against memory
+ */
+BOOLEAN ByteScanMatch(CONST BYTE_PATTERN *Pattern, CONST UINT8 *Data)
+{
+    UINTN Index;
+
+    for (Index = 0; Index < Pattern->Length; Index++)
+    {
+        if (((Data[Index] ^ Pattern->Bytes[Index]) & Pattern->Mask[Index]) != 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Prepare a pattern set for scanning
+ */
+EFI_STATUS ByteScanInit(BYTE_SCANNER *Scanner, CONST BYTE_PATTERN *Patterns, UINTN Count)
+{
+    UINTN Index;
+
+    if (Scanner == NULL || Patterns == NULL || Count == 0 || Count > BYTE_SCAN_MAX_PATTERNS)
+        return EFI_INVALID_PARAMETER;
+
+    ZeroMem(Scanner, sizeof(BYTE_SCANNER));
+    Scanner->Patterns = Patterns;
+    Scanner->Count = Count;
+
+    for (Index = 0; Index < Count; Index++)
+    {
+        CONST BYTE_PATTERN *Pattern = &Patterns[Index];
+        INTN First = -1;
+        INTN Last = -1;
+        UINTN Pos;
+
+        if (Pattern->Length == 0 || Pattern->Length > BYTE_PATTERN_MAX_LENGTH)
+            return EFI_INVALID_PARAMETER;
+
+        for (Pos = 0; Pos < Pattern->Length; Pos++)
+        {
+            if (Pattern->Mask[Pos] == 0xFF)
+            {
+                if (First < 0)
+                    First = (INTN)Pos;
+                Last = (INTN)Pos;
+            }
+        }
+
+        if (First < 0)
+            return EFI_INVALID_PARAMETER;
+
+        Scanner->AnchorPos[Index][0] = (UINT8)First;
+        Scanner->AnchorPos[Index][1] = (UINT8)Last;
+        Scanner->AnchorByte[Index][0] = Pattern->Bytes[First];
+        Scanner->AnchorByte[Index][1] = Pattern->Bytes[Last];
+
+        if (Pattern->Length > Scanner->MaxLength)
+            Scanner->MaxLength = Pattern->Length;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Verify the candidates of one block and report matches in order
+ *
+ * Bit b of Masks[k] marks a candidate for pattern k at offset Base + b.
+ */
+STATIC UINTN ReportCandidates(
+    BYTE_SCANNER *Scanner,
+    UINT8 *Data,
+    UINTN Base,
+    UINT64 Union,
+    UINT64 *Masks,
+    BYTE_SCAN_CALLBACK Callback,
+    VOID *Context,
+    BOOLEAN *Stop)
+{
+    UINTN Found = 0;
+
+    while (Union != 0)
+    {
+        UINTN Bit = (UINTN)LowBitSet64(Union);
+        UINTN Index;
+
+        Union &= Union - 1;
+        for (Index = 0; Index < Scanner->Count; Index++)
+        {
+            if ((Masks[Index] & LShiftU64(1, Bit)) == 0 ||
+                !ByteScanMatch(&Scanner->Patterns[Index], &Data[Base + Bit]))
+                continue;
+
+            Found++;
+            if (!Callback(Context, Data, Base + Bit, Index))
+            {
+                *Stop = TRUE;
+                return Found;
+            }
+        }
+    }
+
+    return Found;
+}
+
+/**
+ * Helper: Scalar scan for the tail of a range
+ */
+STATIC UINTN ScanScalar(
+    BYTE_SCANNER *Scanner,
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    BYTE_SCAN_CALLBACK Callback,
+    VOID *Context)
+{
+    UINTN Found = 0;
+    UINTN Offset;
+    UINTN Index;
+
+    for (Offset = Start; Offset < End; Offset++)
+    {
+        for (Index = 0; Index < Scanner->Count; Index++)
+        {
+            CONST BYTE_PATTERN *Pattern = &Scanner->Patterns[Index];
+
+            if (Pattern->Length > End - Offset || !ByteScanMatch(Pattern, &Data[Offset]))
+                continue;
+
+            Found++;
+            if (!Callback(Context, Data, Offset, Index))
+                return Found;
+        }
+    }
+
+    return Found;
+}
+
+/**
+ * Helper: Load a native word without alignment requirements
+ */
+STATIC UINTN LoadWord(CONST UINT8 *Buffer)
+{
+    if (sizeof(UINTN) == sizeof(UINT64))
+        return (UINTN)ReadUnaligned64((CONST UINT64 *)Buffer);
+
+    return (UINTN)ReadUnaligned32((CONST UINT32 *)Buffer);
+}
+
+/**
+ * Helper: SWAR kernel - one native word of offsets per step
+ *
+ * Each byte equal to the anchor gets its top bit set, without carries
+ * across bytes, so the result is exact rather than a probable hit.
+ */
+STATIC UINTN ScanSwar(
+    BYTE_SCANNER *Scanner,
+    UINT8 *Data,
+    UINTN *Cursor,
+    UINTN End,
+    BYTE_SCAN_CALLBACK Callback,
+    VOID *Context,
+    BOOLEAN *Stop)
+{
+    UINT64 Masks[BYTE_SCAN_MAX_PATTERNS];
+    UINTN Found = 0;
+    UINTN Offset = *Cursor;
+
+    while (Offset + sizeof(UINTN) + Scanner->MaxLength - 1 <= End)
+    {
+        UINT64 Union = 0;
+        UINTN Index;
+
+        for (Index = 0; Index < Scanner->Count; Index++)
+        {
+            UINTN Hit;
+            UINTN Word;
+
+            Masks[Index] = 0;
+
+            Word = LoadWord(&Data[Offset + Scanner->AnchorPos[Index][0]]) ^
+                   (SWAR_ONES * Scanner->AnchorByte[Index][0]);
+            Hit = ~(((Word & SWAR_LOW7) + SWAR_LOW7) | Word | SWAR_LOW7);
+            if (Hit == 0)
+                continue;
+
+            if (Scanner->AnchorPos[Index][1] != Scanner->AnchorPos[Index][0])
+            {
+                Word = LoadWord(&Data[Offset + Scanner->AnchorPos[Index][1]]) ^
+                       (SWAR_ONES * Scanner->AnchorByte[Index][1]);
+                Hit &= ~(((Word & SWAR_LOW7) + SWAR_LOW7) | Word | SWAR_LOW7);
+            }
+
+            // Compress the per-byte top bits into one bit per offset
+            while (Hit != 0)
+            {
+                UINTN Bit = (UINTN)LowBitSet64((UINT64)Hit);
+                Masks[Index] |= LShiftU64(1, Bit / 8);
+                Hit &= Hit - 1;
+            }
+            Union |= Masks[Index];
+        }
+
+        if (Union != 0)
+        {
+            Found += ReportCandidates(Scanner, Data, Offset, Union, Masks, Callback, Context, Stop);
+            if (*Stop)
+                break;
+        }
+
+        Offset += sizeof(UINTN);
+    }
+
+    *Cursor = Offset;
+    return Found;
+}
+
+#if BYTE_SCAN_HAVE_SIMD
+
+/**
+ * Helper: SSE2 kernel - 16 offsets per step
+ */
+STATIC UINTN ScanSse2(
+    BYTE_SCANNER *Scanner,
+    UINT8 *Data,
+    UINTN *Cursor,
+    UINTN End,
+    BYTE_SCAN_CALLBACK Callback,
+    VOID *Context,
+    BOOLEAN *Stop)
+{
+    UINT64 Masks[BYTE_SCAN_MAX_PATTERNS];
+    BYTE_VEC16 Anchors[BYTE_SCAN_MAX_PATTERNS][2];
+    UINTN Found = 0;
+    UINTN Offset = *Cursor;
+    UINTN Index;
+
+    for (Index = 0; Index < Scanner->Count; Index++)
+    {
+        Anchors[Index][0] = (BYTE_VEC16){0} + (char)Scanner->AnchorByte[Index][0];
+        Anchors[Index][1] = (BYTE_VEC16){0} + (char)Scanner->AnchorByte[Index][1];
+    }
+
+    while (Offset + 16 + Scanner->MaxLength - 1 <= End)
+    {
+        UINT64 Union = 0;
+
+        for (Index = 0; Index < Scanner->Count; Index++)
+        {
+            BYTE_VEC16 First = *(CONST BYTE_VEC16U *)&Data[Offset + Scanner->AnchorPos[Index][0]];
+            BYTE_VEC16 Last = *(CONST BYTE_VEC16U *)&Data[Offset + Scanner->AnchorPos[Index][1]];
+            BYTE_VEC16 Eq = (BYTE_VEC16)((First == Anchors[Index][0]) & (Last == Anchors[Index][1]));
+
+            Masks[Index] = (UINT32)__builtin_ia32_pmovmskb128(Eq);
+            Union |= Masks[Index];
+        }
+
+        if (Union != 0)
+        {
+            Found += ReportCandidates(Scanner, Data, Offset, Union, Masks, Callback, Context, Stop);
+            if (*Stop)
+                break;
+        }
+
+        Offset += 16;
+    }
+
+    *Cursor = Offset;
+    return Found;
+}
+
+/**
+ * Helper: AVX2 kernel - 32 offsets per step
+ */
+__attribute__((target("avx2")))
+STATIC UINTN ScanAvx2(
+    BYTE_SCANNER *Scanner,
+    UINT8 *Data,
+    UINTN *Cursor,
+    UINTN End,
+    BYTE_SCAN_CALLBACK Callback,
+    VOID *Context,
+    BOOLEAN *Stop)
+{
+    UINT64 Masks[BYTE_SCAN_MAX_PATTERNS];
+    BYTE_VEC32 Anchors[BYTE_SCAN_MAX_PATTERNS][2];
+    UINTN Found = 0;
+    UINTN Offset = *Cursor;
+    UINTN Index;
+
+    for (Index = 0; Index < Scanner->Count; Index++)
+    {
+        Anchors[Index][0] = (BYTE_VEC32){0} + (char)Scanner->AnchorByte[Index][0];
+        Anchors[Index][1] = (BYTE_VEC32){0} + (char)Scanner->AnchorByte[Index][1];
+    }
+
+    while (Offset + 32 + Scanner->MaxLength - 1 <= End)
+    {
+        UINT64 Union = 0;
+
+        for (Index = 0; Index < Scanner->Count; Index++)
+        {
+            BYTE_VEC32 First = *(CONST BYTE_VEC32U *)&Data[Offset + Scanner->AnchorPos[Index][0]];
+            BYTE_VEC32 Last = *(CONST BYTE_VEC32U *)&Data[Offset + Scanner->AnchorPos[Index][1]];
+            BYTE_VEC32 Eq = (BYTE_VEC32)((First == Anchors[Index][0]) & (Last == Anchors[Index][1]));
+
+            Masks[Index] = (UINT32)__builtin_ia32_pmovmskb256(Eq);
+            Union |= Masks[Index];
+        }
+
+        if (Union != 0)
+        {
+            Found += ReportCandidates(Scanner, Data, Offset, Union, Masks, Callback, Context, Stop);
+            if (*Stop)
+                break;
+        }
+
+        Offset += 32;
+    }
+
+    *Cursor = Offset;
+    return Found;
+}
+
+/**
+ * Helper: Check CPU and firmware support for AVX2
+ *
+ * Besides the CPUID feature bit, the firmware must have enabled YMM state
+ * (CR4.OSXSAVE and XCR0 bits 1-2); many do not, and SSE2 is used then.
+ */
+STATIC BOOLEAN CpuHasAvx2(VOID)
+{
+    UINT32 MaxLeaf;
+    UINT32 Ebx;
+    UINT32 Ecx;
+    UINT32 XcrLow;
+    UINT32 XcrHigh;
+
+    AsmCpuid(0, &MaxLeaf, NULL, NULL, NULL);
+    if (MaxLeaf < 7)
+        return FALSE;
+
+    AsmCpuid(1, NULL, NULL, &Ecx, NULL);
+    if ((Ecx & BIT27) == 0 || (Ecx & BIT28) == 0)   // OSXSAVE, AVX
+        return FALSE;
+
+    // XGETBV(0); inline so older BaseLib releases without AsmXGetBv still link
+    __asm__ __volatile__ ("xgetbv" : "=a" (XcrLow), "=d" (XcrHigh) : "c" (0));
+    if ((XcrLow & (BIT1 | BIT2)) != (BIT1 | BIT2))
+        return FALSE;
+
+    AsmCpuidEx(7, 0, NULL, &Ebx, NULL, NULL);
+    return (Ebx & BIT5) != 0;
+}
+
+#endif
+
+/**
+ * Helper: Resolve AUTO to the best kernel available
+ */
+STATIC BYTE_SCAN_KERNEL ResolveKernel(VOID)
+{
+    if (mKernel == BYTE_SCAN_KERNEL_AUTO)
+    {
+#if BYTE_SCAN_HAVE_SIMD
+        mKernel = CpuHasAvx2() ? BYTE_SCAN_KERNEL_AVX2 : BYTE_SCAN_KERNEL_SSE2;
+#else
+        mKernel = BYTE_SCAN_KERNEL_SWAR;
+#endif
+    }
+
+    return mKernel;
+}
+
+/**
+ * Force a scan kernel (AUTO restores CPU detection)
+ */
+EFI_STATUS ByteScanSelectKernel(BYTE_SCAN_KERNEL Kernel)
+{
+    switch (Kernel)
+    {
+    case BYTE_SCAN_KERNEL_AUTO:
+    case BYTE_SCAN_KERNEL_SWAR:
+        break;
+#if BYTE_SCAN_HAVE_SIMD
+    case BYTE_SCAN_KERNEL_SSE2:
+        break;
+    case BYTE_SCAN_KERNEL_AVX2:
+        if (!CpuHasAvx2())
+            return EFI_UNSUPPORTED;
+        break;
+#endif
+    default:
+        return EFI_UNSUPPORTED;
+    }
+
+    mKernel = Kernel;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Name of the kernel ByteScan currently uses
+ */
+CONST CHAR8 *ByteScanKernelName(VOID)
+{
+    switch (ResolveKernel())
+    {
+    case BYTE_SCAN_KERNEL_AVX2:
+        return "avx2";
+    case BYTE_SCAN_KERNEL_SSE2:
+        return "sse2";
+    default:
+        return "swar";
+    }
+}
+
+/**
+ * Scan a range for all patterns in one pass
+ */
+UINTN ByteScan(
+    BYTE_SCANNER *Scanner,
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    BYTE_SCAN_CALLBACK Callback,
+    VOID *Context)
+{
+    UINTN Found = 0;
+    UINTN Cursor = Start;
+    BOOLEAN Stop = FALSE;
+
+    if (Scanner == NULL || Data == NULL || Callback == NULL || Start >= End)
+        return 0;
+
+    switch (ResolveKernel())
+    {
+#if BYTE_SCAN_HAVE_SIMD
+    case BYTE_SCAN_KERNEL_AVX2:
+        Found = ScanAvx2(Scanner, Data, &Cursor, End, Callback, Context, &Stop);
+        break;
+    case BYTE_SCAN_KERNEL_SSE2:
+        Found = ScanSse2(Scanner, Data, &Cursor, End, Callback, Context, &Stop);
+        break;
+#endif
+    default:
+        Found = ScanSwar(Scanner, Data, &Cursor, End, Callback, Context, &Stop);
+        break;
+    }
+
+    if (!Stop)
+        Found += ScanScalar(Scanner, Data, Cursor, End, Callback, Context);
+
+    return Found;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+// Longest pattern accepted (a GUID plus a trailing DWORD is 20 bytes)
+#define BYTE_PATTERN_MAX_LENGTH 24
+
+// Most patterns one scanner can run in a single pass
+#define BYTE_SCAN_MAX_PATTERNS 8
+
+// Byte pattern with a per-byte mask (mask 0x00 = wildcard, 0xFF = exact)
+typedef struct {
+    UINT8 Bytes[BYTE_PATTERN_MAX_LENGTH];
+    UINT8 Mask[BYTE_PATTERN_MAX_LENGTH];
+    UINT8 Length;
+} BYTE_PATTERN;
+
+/**
+ * Called for every verified match, in ascending offset order
+ *
+ * The callback may modify the scanned bytes. Matches are verified against
+ * memory right before the callback runs, but the anchor prefilter of the
+ * current block was computed earlier, so a callback must not create new
+ * matches ahead of the current offset.
+ *
+ * @param Context       Caller context
+ * @param Data          Buffer being scanned
+ * @param Offset        Offset of the match in Data
+ * @param PatternIndex  Index of the matching pattern
+ * @return FALSE to stop the scan
+ */
+typedef BOOLEAN (*BYTE_SCAN_CALLBACK)(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex);
+
+// Scan kernels
+typedef enum {
+    BYTE_SCAN_KERNEL_AUTO = 0,
+    BYTE_SCAN_KERNEL_SWAR,
+    BYTE_SCAN_KERNEL_SSE2,
+    BYTE_SCAN_KERNEL_AVX2
+} BYTE_SCAN_KERNEL;
+
+// Prepared pattern set
+typedef struct {
+    CONST BYTE_PATTERN *Patterns;
+    UINTN Count;
+    UINTN MaxLength;
+    UINT8 AnchorPos[BYTE_SCAN_MAX_PATTERNS][2];   // Two exact bytes used as the SIMD prefilter
+    UINT8 AnchorByte[BYTE_SCAN_MAX_PATTERNS][2];
+} BYTE_SCANNER;
+
+/**
+ * Prepare a pattern set for scanning
+ *
+ * Every pattern needs at least one exact (mask 0xFF) byte. The first and last
+ * exact bytes become the anchors checked by the vector kernels.
+ *
+ * @param Scanner       Scanner to initialize
+ * @param Patterns      Patterns (must stay valid while the scanner is used)
+ * @param Count         Number of patterns
+ * @return EFI_SUCCESS or EFI_INVALID_PARAMETER
+ */
+EFI_STATUS ByteScanInit(BYTE_SCANNER *Scanner, CONST BYTE_PATTERN *Patterns, UINTN Count);
+
+/**
+ * Scan a range for all patterns in one pass
+ *
+ * A pattern matches at offset i when Start <= i and i + Length <= End.
+ *
+ * @param Scanner       Prepared scanner
+ * @param Data          Buffer; offsets are relative to it
+ * @param Start         First offset to scan
+ * @param End           End of the range
+ * @param Callback      Called for each verified match
+ * @param Context       Passed to Callback
+ * @return Number of matches reported
+ */
+UINTN ByteScan(
+    BYTE_SCANNER *Scanner,
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    BYTE_SCAN_CALLBACK Callback,
+    VOID *Context);
+
+/**
+ * Check a pattern against memory
+ *
+ * @param Pattern       Pattern to check
+ * @param Data          Bytes to compare (at least Pattern->Length)
+ * @return TRUE if every masked byte matches
+ */
+BOOLEAN ByteScanMatch(CONST BYTE_PATTERN *Pattern, CONST UINT8 *Data);
+
+/**
+ * Force a scan kernel (AUTO restores CPU detection)
+ *
+ * @param Kernel        Kernel to use
+ * @return EFI_UNSUPPORTED if the kernel is not available on this CPU/build
+ */
+EFI_STATUS ByteScanSelectKernel(BYTE_SCAN_KERNEL Kernel);
+
+/**
+ * Name of the kernel ByteScan currently uses
+ *
+ * @return "avx2", "sse2" or "swar"
+ */
+CONST CHAR8 *ByteScanKernelName(VOID);
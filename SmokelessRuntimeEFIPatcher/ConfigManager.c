@@ -1,4 +1,5 @@
 #include "ConfigManager.h"
+#include "TaggedPool.h"
 #include <Library/MemoryAllocationLib.h>
 #include <Library/DebugLib.h>
 #include <Library/PrintLib.h>
@@ -43,7 +44,7 @@ ConfigAddEntry(
     }
 
     // Reallocate entries array
-    NewEntries = AllocateZeroPool(sizeof(CONFIG_ENTRY) * (Manager->EntryCount + 1));
+    NewEntries = TaggedAllocateZeroPool(POOL_TAG_NVRAM, sizeof(CONFIG_ENTRY) * (Manager->EntryCount + 1));
     if (NewEntries == NULL) {
         return EFI_OUT_OF_RESOURCES;
     }
@@ -51,14 +52,14 @@ ConfigAddEntry(
     // Copy existing entries
     if (Manager->Entries != NULL) {
         CopyMem(NewEntries, Manager->Entries, sizeof(CONFIG_ENTRY) * Manager->EntryCount);
-        FreePool(Manager->Entries);
+        TaggedFreePool(Manager->Entries);
     }
 
     Manager->Entries = NewEntries;
     Entry = &Manager->Entries[Manager->EntryCount];
 
     // Allocate and copy variable name
-    Entry->VariableName = AllocateZeroPool(StrSize(VariableName));
+    Entry->VariableName = TaggedAllocateZeroPool(POOL_TAG_NVRAM, StrSize(VariableName));
     if (Entry->VariableName == NULL) {
         return EFI_OUT_OF_RESOURCES;
     }
@@ -72,9 +73,9 @@ ConfigAddEntry(
     Entry->Size = Size;
 
     // Allocate and copy value
-    Entry->Value = AllocateZeroPool(Size);
+    Entry->Value = TaggedAllocateZeroPool(POOL_TAG_NVRAM, Size);
     if (Entry->Value == NULL) {
-        FreePool(Entry->VariableName);
+        TaggedFreePool(Entry->VariableName);
         return EFI_OUT_OF_RESOURCES;
     }
     CopyMem(Entry->Value, Value, Size);
@@ -82,7 +83,7 @@ ConfigAddEntry(
     // Copy description if provided
     if (Description != NULL) {
         UINTN DescLen = AsciiStrLen(Description) + 1;
-        Entry->Description = AllocateZeroPool(DescLen);
+        Entry->Description = TaggedAllocateZeroPool(POOL_TAG_NVRAM, DescLen);
         if (Entry->Description != NULL) {
             AsciiStrCpyS(Entry->Description, DescLen, Description);
         }
@@ -323,17 +324,17 @@ ConfigCleanup(CONFIG_MANAGER *Manager)
             Entry = &Manager->Entries[i];
             
             if (Entry->VariableName != NULL) {
-                FreePool(Entry->VariableName);
+                TaggedFreePool(Entry->VariableName);
             }
             if (Entry->Value != NULL) {
-                FreePool(Entry->Value);
+                TaggedFreePool(Entry->Value);
             }
             if (Entry->Description != NULL) {
-                FreePool(Entry->Description);
+                TaggedFreePool(Entry->Description);
             }
         }
         
-        FreePool(Manager->Entries);
+        TaggedFreePool(Manager->Entries);
     }
 
     ZeroMem(Manager, sizeof(CONFIG_MANAGER));
@@ -28,6 +28,10 @@
 #define AUTO_MODE_FLAG_FILE     L"SREP_Auto.flag"
 #define INTERACTIVE_FLAG_FILE   L"SREP_Interactive.flag"
 #define BIOS_TAB_FLAG_FILE      L"SREP_BiosTab.flag"
+#define PLAN_MODE_FLAG_FILE     L"SREP_Plan.flag"
+#define TRACE_FLAG_FILE         L"SREP_Trace.flag"
+#define PROFILE_FLAG_FILE       L"SREP_Profile.flag"
+#define FWCALLS_FLAG_FILE       L"SREP_FwCalls.flag"
 #define LOG_FILE_NAME           L"SREP.log"
 
 // Common string lengths
@@ -0,0 +1,287 @@
+#include "FfsWalk.h"
+#include <Guid/FirmwareFileSystem2.h>
+#include <Guid/FirmwareFileSystem3.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+// Volumes are 8-byte aligned in a ROM image
+#define FFS_VOLUME_ALIGNMENT 8
+
+STATIC CONST EFI_GUID mFfs2Guid = EFI_FIRMWARE_FILE_SYSTEM2_GUID;
+STATIC CONST EFI_GUID mFfs3Guid = EFI_FIRMWARE_FILE_SYSTEM3_GUID;
+
+EFI_STATUS FfsVolumeOpen(FFS_VOLUME *Volume, CONST VOID *Buffer, UINTN Size)
+{
+    CONST EFI_FIRMWARE_VOLUME_HEADER *Header = (CONST EFI_FIRMWARE_VOLUME_HEADER *)Buffer;
+    CONST UINT16 *Words = (CONST UINT16 *)Buffer;
+    UINT16 Sum = 0;
+    UINTN FilesOffset;
+
+    if (Volume == NULL || Buffer == NULL || Size < sizeof(EFI_FIRMWARE_VOLUME_HEADER))
+        return EFI_VOLUME_CORRUPTED;
+
+    if (Header->Signature != EFI_FVH_SIGNATURE ||
+        Header->HeaderLength < sizeof(EFI_FIRMWARE_VOLUME_HEADER) ||
+        (Header->HeaderLength & 1) != 0 ||
+        Header->FvLength < Header->HeaderLength ||
+        Header->FvLength > Size)
+        return EFI_VOLUME_CORRUPTED;
+
+    for (UINTN i = 0; i < Header->HeaderLength / sizeof(UINT16); i++)
+        Sum = (UINT16)(Sum + Words[i]);
+    if (Sum != 0)
+        return EFI_VOLUME_CORRUPTED;
+
+    if (!CompareGuid(&Header->FileSystemGuid, &mFfs2Guid) && !CompareGuid(&Header->FileSystemGuid, &mFfs3Guid))
+        return EFI_UNSUPPORTED;
+
+    FilesOffset = Header->HeaderLength;
+    if (Header->ExtHeaderOffset != 0)
+    {
+        CONST EFI_FIRMWARE_VOLUME_EXT_HEADER *Ext;
+
+        if ((UINT64)Header->ExtHeaderOffset + sizeof(EFI_FIRMWARE_VOLUME_EXT_HEADER) > Header->FvLength)
+            return EFI_VOLUME_CORRUPTED;
+        Ext = (CONST EFI_FIRMWARE_VOLUME_EXT_HEADER *)((CONST UINT8 *)Buffer + Header->ExtHeaderOffset);
+        FilesOffset = Header->ExtHeaderOffset + Ext->ExtHeaderSize;
+    }
+    FilesOffset = ALIGN_VALUE(FilesOffset, 8);
+    if (FilesOffset > Header->FvLength)
+        return EFI_VOLUME_CORRUPTED;
+
+    Volume->Base = (CONST UINT8 *)Buffer;
+    Volume->Size = (UINTN)Header->FvLength;
+    Volume->FilesOffset = FilesOffset;
+    Volume->ErasePolarity = (Header->Attributes & EFI_FVB2_ERASE_POLARITY) != 0 ? 0xFF : 0x00;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS FfsVolumeFind(CONST VOID *Buffer, UINTN Size, UINTN *Offset, FFS_VOLUME *Volume)
+{
+    CONST UINT8 *Bytes = (CONST UINT8 *)Buffer;
+    UINTN Position;
+
+    if (Buffer == NULL || Offset == NULL || Volume == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    // The signature sits at a fixed offset; only headers that pass it are checksummed
+    for (Position = ALIGN_VALUE(*Offset, FFS_VOLUME_ALIGNMENT);
+         Position + sizeof(EFI_FIRMWARE_VOLUME_HEADER) <= Size;
+         Position += FFS_VOLUME_ALIGNMENT)
+    {
+        if (ReadUnaligned32((CONST UINT32 *)&Bytes[Position + OFFSET_OF(EFI_FIRMWARE_VOLUME_HEADER, Signature)]) != EFI_FVH_SIGNATURE)
+            continue;
+
+        if (!EFI_ERROR(FfsVolumeOpen(Volume, &Bytes[Position], Size - Position)))
+        {
+            *Offset = Position;
+            return EFI_SUCCESS;
+        }
+    }
+
+    return EFI_NOT_FOUND;
+}
+
+/**
+ * Helper: State bit that decides whether a file is live
+ */
+STATIC UINT8 FfsFileState(CONST FFS_VOLUME *Volume, CONST EFI_FFS_FILE_HEADER *Header)
+{
+    UINT8 State = Header->State;
+    UINT8 HighestBit = 0x80;
+
+    if (Volume->ErasePolarity != 0)
+        State = (UINT8)~State;
+
+    while (HighestBit != 0 && (HighestBit & State) == 0)
+        HighestBit >>= 1;
+    return HighestBit;
+}
+
+/**
+ * Helper: Check whether a file header is still erased flash (free space)
+ */
+STATIC BOOLEAN FfsHeaderErased(CONST FFS_VOLUME *Volume, CONST UINT8 *Header)
+{
+    for (UINTN i = 0; i < sizeof(EFI_FFS_FILE_HEADER); i++)
+    {
+        if (Header[i] != Volume->ErasePolarity)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+EFI_STATUS FfsNextFile(CONST FFS_VOLUME *Volume, FFS_FILE *File)
+{
+    UINTN Offset;
+
+    if (Volume == NULL || File == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    if (File->Header == NULL)
+        Offset = Volume->FilesOffset;
+    else
+        Offset = ALIGN_VALUE((UINTN)(File->Data - Volume->Base) + File->DataSize, 8);
+
+    while (Offset + sizeof(EFI_FFS_FILE_HEADER) <= Volume->Size)
+    {
+        CONST EFI_FFS_FILE_HEADER *Header = (CONST EFI_FFS_FILE_HEADER *)&Volume->Base[Offset];
+        UINTN HeaderSize = sizeof(EFI_FFS_FILE_HEADER);
+        UINTN FileSize;
+        UINT8 State;
+
+        if (FfsHeaderErased(Volume, (CONST UINT8 *)Header))
+            break;
+
+        if (IS_FFS_FILE2(Header))
+        {
+            HeaderSize = sizeof(EFI_FFS_FILE_HEADER2);
+            if (Offset + HeaderSize > Volume->Size)
+                return EFI_VOLUME_CORRUPTED;
+            FileSize = (UINTN)FFS_FILE2_SIZE(Header);
+        }
+        else
+        {
+            FileSize = FFS_FILE_SIZE(Header);
+        }
+
+        if (FileSize < HeaderSize || FileSize > Volume->Size - Offset)
+            return EFI_VOLUME_CORRUPTED;
+
+        State = FfsFileState(Volume, Header);
+        if ((State == EFI_FILE_DATA_VALID || State == EFI_FILE_MARKED_FOR_UPDATE) &&
+            Header->Type != EFI_FV_FILETYPE_FFS_PAD)
+        {
+            File->Header = Header;
+            File->Name = &Header->Name;
+            File->Type = Header->Type;
+            File->Attributes = Header->Attributes;
+            File->Data = (CONST UINT8 *)Header + HeaderSize;
+            File->DataSize = FileSize - HeaderSize;
+            return EFI_SUCCESS;
+        }
+
+        Offset = ALIGN_VALUE(Offset + FileSize, 8);
+    }
+
+    return EFI_NOT_FOUND;
+}
+
+/**
+ * Helper: Search one section stream, descending into encapsulations
+ */
+STATIC EFI_STATUS FfsFindSectionAt(CONST UINT8 *Data, UINTN Size, UINT8 Type, UINTN Depth, FFS_SECTION *Section)
+{
+    EFI_STATUS Result = EFI_NOT_FOUND;
+    UINTN Offset = 0;
+
+    while (Offset + sizeof(EFI_COMMON_SECTION_HEADER) <= Size)
+    {
+        CONST EFI_COMMON_SECTION_HEADER *Header = (CONST EFI_COMMON_SECTION_HEADER *)&Data[Offset];
+        UINTN HeaderSize = sizeof(EFI_COMMON_SECTION_HEADER);
+        UINTN SectionSize = SECTION_SIZE(Header);
+        CONST UINT8 *Body;
+        UINTN BodySize;
+
+        if (IS_SECTION2(Header))
+        {
+            HeaderSize = sizeof(EFI_COMMON_SECTION_HEADER2);
+            if (Offset + HeaderSize > Size)
+                return EFI_VOLUME_CORRUPTED;
+            SectionSize = SECTION2_SIZE(Header);
+        }
+
+        if (SectionSize < HeaderSize || SectionSize > Size - Offset)
+            return EFI_VOLUME_CORRUPTED;
+
+        Body = &Data[Offset + HeaderSize];
+        BodySize = SectionSize - HeaderSize;
+
+        if (Header->Type == Type)
+        {
+            Section->Type = Type;
+            Section->Data = Body;
+            Section->DataSize = BodySize;
+            return EFI_SUCCESS;
+        }
+
+        if (Depth < FFS_MAX_SECTION_DEPTH)
+        {
+            EFI_STATUS Status = EFI_NOT_FOUND;
+
+            if (Header->Type == EFI_SECTION_COMPRESSION)
+            {
+                // Body starts with UncompressedLength and CompressionType
+                if (BodySize < sizeof(UINT32) + sizeof(UINT8))
+                    return EFI_VOLUME_CORRUPTED;
+                if (Body[sizeof(UINT32)] == EFI_NOT_COMPRESSED)
+                    Status = FfsFindSectionAt(Body + sizeof(UINT32) + sizeof(UINT8),
+                                              BodySize - sizeof(UINT32) - sizeof(UINT8), Type, Depth + 1, Section);
+                else
+                    Status = EFI_UNSUPPORTED;
+            }
+            else if (Header->Type == EFI_SECTION_GUID_DEFINED)
+            {
+                // Body starts with SectionDefinitionGuid, DataOffset (from the section start) and Attributes
+                UINT16 DataOffset;
+                UINT16 Attributes;
+
+                if (BodySize < sizeof(EFI_GUID) + 2 * sizeof(UINT16))
+                    return EFI_VOLUME_CORRUPTED;
+                DataOffset = ReadUnaligned16((CONST UINT16 *)(Body + sizeof(EFI_GUID)));
+                Attributes = ReadUnaligned16((CONST UINT16 *)(Body + sizeof(EFI_GUID) + sizeof(UINT16)));
+                if (DataOffset < HeaderSize || DataOffset > SectionSize)
+                    return EFI_VOLUME_CORRUPTED;
+
+                if ((Attributes & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) == 0)
+                    Status = FfsFindSectionAt(&Data[Offset + DataOffset], SectionSize - DataOffset, Type, Depth + 1, Section);
+                else
+                    Status = EFI_UNSUPPORTED;
+            }
+            else if (Header->Type == EFI_SECTION_DISPOSABLE)
+            {
+                Status = FfsFindSectionAt(Body, BodySize, Type, Depth + 1, Section);
+            }
+
+            if (Status == EFI_SUCCESS || Status == EFI_VOLUME_CORRUPTED)
+                return Status;
+            if (Status == EFI_UNSUPPORTED)
+                Result = EFI_UNSUPPORTED;
+        }
+
+        Offset = ALIGN_VALUE(Offset + SectionSize, 4);
+    }
+
+    return Result;
+}
+
+EFI_STATUS FfsFindSection(CONST UINT8 *Data, UINTN Size, UINT8 Type, FFS_SECTION *Section)
+{
+    if (Data == NULL || Section == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    return FfsFindSectionAt(Data, Size, Type, 0, Section);
+}
+
+CONST CHAR16 *FfsFileName(CONST FFS_FILE *File)
+{
+    FFS_SECTION Section;
+    CONST CHAR16 *Name;
+    UINTN Length;
+
+    // Raw and pad files carry no sections
+    if (File == NULL || File->Header == NULL || File->Type == EFI_FV_FILETYPE_RAW)
+        return NULL;
+
+    if (EFI_ERROR(FfsFindSection(File->Data, File->DataSize, EFI_SECTION_USER_INTERFACE, &Section)))
+        return NULL;
+
+    // Must be NUL-terminated inside the section to be used in place
+    Name = (CONST CHAR16 *)Section.Data;
+    for (Length = 0; Length < Section.DataSize / sizeof(CHAR16); Length++)
+    {
+        if (Name[Length] == 0)
+            return Name;
+    }
+    return NULL;
+}
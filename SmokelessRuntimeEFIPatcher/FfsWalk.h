@@ -0,0 +1,90 @@
+#pragma once
+#include <Uefi.h>
+#include <PiDxe.h>
+
+// Nesting of encapsulation sections followed by FfsFindSection
+#define FFS_MAX_SECTION_DEPTH 4
+
+// One firmware volume in memory (flash mapping, decompressed FV or ROM dump)
+typedef struct {
+    CONST UINT8 *Base;           // EFI_FIRMWARE_VOLUME_HEADER
+    UINTN Size;                  // FvLength
+    UINTN FilesOffset;           // First file, after the (extended) header
+    UINT8 ErasePolarity;         // Value of an erased byte (0x00 or 0xFF)
+} FFS_VOLUME;
+
+// One file of a volume; all pointers point into the volume
+typedef struct {
+    CONST EFI_FFS_FILE_HEADER *Header;  // NULL before the first FfsNextFile
+    CONST EFI_GUID *Name;
+    UINT8 Type;                  // EFI_FV_FILETYPE_*
+    UINT8 Attributes;            // FFS_ATTRIB_*
+    CONST UINT8 *Data;           // File contents (sections for most types)
+    UINTN DataSize;
+} FFS_FILE;
+
+// One leaf section; Data points into the volume
+typedef struct {
+    UINT8 Type;                  // EFI_SECTION_*
+    CONST UINT8 *Data;           // Section body, after the (extended) header
+    UINTN DataSize;
+} FFS_SECTION;
+
+/**
+ * Validate a firmware volume header over a memory buffer
+ *
+ * Checks the signature, header checksum, length and file system GUID
+ * (FFS2 or FFS3). Nothing is copied.
+ *
+ * @param Volume        Volume to initialize
+ * @param Buffer        Start of the volume header
+ * @param Size          Bytes available at Buffer
+ * @return EFI_SUCCESS, EFI_VOLUME_CORRUPTED, or EFI_UNSUPPORTED for non-FFS volumes (NVRAM)
+ */
+EFI_STATUS FfsVolumeOpen(FFS_VOLUME *Volume, CONST VOID *Buffer, UINTN Size);
+
+/**
+ * Find the next FFS volume in a ROM image
+ *
+ * @param Buffer        ROM image
+ * @param Size          Size of the ROM image
+ * @param Offset        Where to start looking; receives the volume offset
+ * @param Volume        Receives the volume
+ * @return EFI_SUCCESS, or EFI_NOT_FOUND when no volume is left
+ */
+EFI_STATUS FfsVolumeFind(CONST VOID *Buffer, UINTN Size, UINTN *Offset, FFS_VOLUME *Volume);
+
+/**
+ * Step to the next valid file of a volume
+ *
+ * Pad files and deleted or incomplete files are skipped. Start with a
+ * zeroed File.
+ *
+ * @param Volume        Opened volume
+ * @param File          Previous file; receives the next one
+ * @return EFI_SUCCESS, EFI_NOT_FOUND at the end, or EFI_VOLUME_CORRUPTED
+ */
+EFI_STATUS FfsNextFile(CONST FFS_VOLUME *Volume, FFS_FILE *File);
+
+/**
+ * Find the first section of a type in a section stream
+ *
+ * Uncompressed compression sections, GUID-defined sections that need no
+ * processing and disposable sections are searched in place. Sections that
+ * need decoding (compressed or signed) are skipped.
+ *
+ * @param Data          Section stream (FFS_FILE.Data)
+ * @param Size          Size of the stream
+ * @param Type          EFI_SECTION_* to find
+ * @param Section       Receives the section
+ * @return EFI_SUCCESS, EFI_NOT_FOUND, or EFI_UNSUPPORTED if it may sit in a skipped section
+ */
+EFI_STATUS FfsFindSection(CONST UINT8 *Data, UINTN Size, UINT8 Type, FFS_SECTION *Section);
+
+/**
+ * UI name of a file, read in place
+ *
+ * @param File          File from FfsNextFile
+ * @return NUL-terminated name inside the volume, or NULL
+ */
+CONST CHAR16 *FfsFileName(CONST FFS_FILE *File);
@@ -0,0 +1,416 @@
+#include "FormSetGuids.h"
+#include "IndexHash.h"
+#include "TaggedPool.h"
+#include "FwCalls.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/HiiDatabase.h>
+#include <Uefi/UefiInternalFormRepresentation.h>
+
+// 32 - log2(FORMSET_GUID_PREFIX_BITS): keep the top bits of the multiplicative hash
+#define FORMSET_GUID_PREFIX_SHIFT 20
+
+FORMSET_GUID_SET gFormSetGuids;
+
+/**
+ * Helper: Prefilter bit of a GUID's first DWORD
+ */
+STATIC UINT32 FormSetGuidPrefixBit(UINT32 Dword)
+{
+    return (UINT32)(Dword * 0x9E3779B1) >> FORMSET_GUID_PREFIX_SHIFT;
+}
+
+/**
+ * Helper: Slot holding Guid, or the free slot where it belongs
+ */
+STATIC EFI_GUID *FormSetGuidSlot(EFI_GUID *Slots, UINTN Capacity, CONST EFI_GUID *Guid)
+{
+    UINTN Mask = Capacity - 1;
+    UINTN i = IndexHashGuid(Guid) & Mask;
+
+    // Linear probing; the table is never more than half full
+    while (!IsZeroGuid(&Slots[i]) && !CompareGuid(&Slots[i], Guid))
+        i = (i + 1) & Mask;
+    return &Slots[i];
+}
+
+/**
+ * Helper: Double the table and reinsert every GUID
+ */
+STATIC EFI_STATUS FormSetGuidSetGrow(FORMSET_GUID_SET *Set)
+{
+    UINTN Capacity = Set->Capacity == 0 ? 64 : Set->Capacity * 2;
+    EFI_GUID *Slots;
+    EFI_GUID *Order;
+
+    Slots = TaggedAllocateZeroPool(POOL_TAG_IFR, Capacity * sizeof(EFI_GUID));
+    if (Slots == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    // The table is never more than half full, nor is the order list
+    Order = TaggedReallocatePool(POOL_TAG_IFR, Set->Count * sizeof(EFI_GUID), Capacity / 2 * sizeof(EFI_GUID),
+                                 Set->Order);
+    if (Order == NULL)
+    {
+        TaggedFreePool(Slots);
+        return EFI_OUT_OF_RESOURCES;
+    }
+    Set->Order = Order;
+
+    for (UINTN i = 0; i < Set->Capacity; i++)
+    {
+        if (!IsZeroGuid(&Set->Slots[i]))
+            CopyGuid(FormSetGuidSlot(Slots, Capacity, &Set->Slots[i]), &Set->Slots[i]);
+    }
+
+    if (Set->Slots != NULL)
+        TaggedFreePool(Set->Slots);
+    Set->Slots = Slots;
+    Set->Capacity = Capacity;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS FormSetGuidSetAdd(FORMSET_GUID_SET *Set, CONST EFI_GUID *Guid)
+{
+    EFI_GUID *Slot;
+    UINT32 Bit;
+
+    if (Set == NULL || Guid == NULL)
+        return EFI_INVALID_PARAMETER;
+    if (IsZeroGuid(Guid))
+        return EFI_SUCCESS;
+
+    if (2 * (Set->Count + 1) > Set->Capacity)
+    {
+        EFI_STATUS Status = FormSetGuidSetGrow(Set);
+        if (EFI_ERROR(Status))
+            return Status;
+    }
+
+    Slot = FormSetGuidSlot(Set->Slots, Set->Capacity, Guid);
+    if (!IsZeroGuid(Slot))
+        return EFI_SUCCESS;
+
+    CopyGuid(Slot, Guid);
+    CopyGuid(&Set->Order[Set->Count], Guid);
+    Set->Count++;
+
+    Bit = FormSetGuidPrefixBit(Guid->Data1);
+    Set->Prefix[Bit / 8] |= (UINT8)(1 << (Bit % 8));
+    return EFI_SUCCESS;
+}
+
+BOOLEAN FormSetGuidSetContains(CONST FORMSET_GUID_SET *Set, CONST VOID *Guid)
+{
+    EFI_GUID Value;
+
+    if (Set == NULL || Guid == NULL || Set->Count == 0)
+        return FALSE;
+
+    CopyMem(&Value, Guid, sizeof(Value));
+    if (IsZeroGuid(&Value))
+        return FALSE;
+    return !IsZeroGuid(FormSetGuidSlot(Set->Slots, Set->Capacity, &Value));
+}
+
+/**
+ * Helper: Add the FormSet GUIDs of one exported package list
+ */
+STATIC VOID FormSetGuidSetAddPackageList(FORMSET_GUID_SET *Set, CONST EFI_HII_PACKAGE_LIST_HEADER *PackageList)
+{
+    CONST UINT8 *PackageData = (CONST UINT8 *)(PackageList + 1);
+    UINTN TotalSize = PackageList->PackageLength - sizeof(EFI_HII_PACKAGE_LIST_HEADER);
+    UINTN PackageOffset = 0;
+
+    while (PackageOffset + sizeof(EFI_HII_PACKAGE_HEADER) <= TotalSize)
+    {
+        CONST EFI_HII_PACKAGE_HEADER *Package = (CONST EFI_HII_PACKAGE_HEADER *)&PackageData[PackageOffset];
+        CONST UINT8 *Ifr;
+        UINTN IfrSize;
+        UINTN Offset = 0;
+
+        if (Package->Length < sizeof(EFI_HII_PACKAGE_HEADER) || Package->Length > TotalSize - PackageOffset)
+            break;
+        PackageOffset += Package->Length;
+
+        if ((Package->Type & 0x7F) != EFI_HII_PACKAGE_FORMS)
+            continue;
+
+        Ifr = (CONST UINT8 *)(Package + 1);
+        IfrSize = Package->Length - sizeof(EFI_HII_PACKAGE_HEADER);
+        while (Offset + sizeof(EFI_IFR_OP_HEADER) <= IfrSize)
+        {
+            CONST EFI_IFR_OP_HEADER *Op = (CONST EFI_IFR_OP_HEADER *)&Ifr[Offset];
+
+            if (Op->Length < sizeof(EFI_IFR_OP_HEADER) || Op->Length > IfrSize - Offset)
+                break;
+
+            if (Op->OpCode == EFI_IFR_FORM_SET_OP && Op->Length >= sizeof(EFI_IFR_FORM_SET))
+            {
+                EFI_GUID Guid;
+
+                CopyMem(&Guid, &((CONST EFI_IFR_FORM_SET *)Op)->Guid, sizeof(Guid));
+                FormSetGuidSetAdd(Set, &Guid);
+            }
+            Offset += Op->Length;
+        }
+    }
+}
+
+/**
+ * Helper: Check whether the last FormSetGuidSetAddHii read a package list
+ */
+STATIC BOOLEAN FormSetGuidSetSeenHii(CONST FORMSET_GUID_SET *Set, EFI_HII_HANDLE Handle)
+{
+    for (UINTN i = 0; i < Set->HiiHandleCount; i++)
+    {
+        if (Set->HiiHandles[i] == Handle)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+EFI_STATUS FormSetGuidSetAddHii(FORMSET_GUID_SET *Set)
+{
+    EFI_STATUS Status;
+    EFI_HII_DATABASE_PROTOCOL *HiiDatabase;
+    EFI_HII_HANDLE *Handles = NULL;
+    UINTN HandleSize = 0;
+    EFI_HII_PACKAGE_LIST_HEADER *PackageList = NULL;
+    UINTN PackageListCapacity = 0;
+
+    if (Set == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    Status = gBS->LocateProtocol(&gEfiHiiDatabaseProtocolGuid, NULL, (VOID **)&HiiDatabase);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Status = HiiDatabase->ListPackageLists(HiiDatabase, EFI_HII_PACKAGE_FORMS, NULL, &HandleSize, Handles);
+    if (Status != EFI_BUFFER_TOO_SMALL)
+        return Status;
+
+    Handles = TaggedAllocatePool(POOL_TAG_IFR, HandleSize);
+    if (Handles == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    Status = HiiDatabase->ListPackageLists(HiiDatabase, EFI_HII_PACKAGE_FORMS, NULL, &HandleSize, Handles);
+    if (EFI_ERROR(Status))
+    {
+        TaggedFreePool(Handles);
+        return Status;
+    }
+
+    // ListPackageLists works in bytes
+    for (UINTN i = 0; i < HandleSize / sizeof(EFI_HII_HANDLE); i++)
+    {
+        UINTN BufferSize = PackageListCapacity;
+
+        // Its GUIDs are already in the set
+        if (FormSetGuidSetSeenHii(Set, Handles[i]))
+            continue;
+
+        Status = gFwCalls.ExportPackageLists(HiiDatabase, Handles[i], &BufferSize, PackageList);
+        if (Status == EFI_BUFFER_TOO_SMALL)
+        {
+            // One buffer, grown to the largest list, serves every export
+            if (PackageList != NULL)
+                TaggedFreePool(PackageList);
+            PackageList = TaggedAllocatePool(POOL_TAG_IFR, BufferSize);
+            PackageListCapacity = PackageList != NULL ? BufferSize : 0;
+            if (PackageList == NULL)
+            {
+                // Keep the old handles so the lists not read yet are tried again
+                TaggedFreePool(Handles);
+                return EFI_OUT_OF_RESOURCES;
+            }
+            Status = gFwCalls.ExportPackageLists(HiiDatabase, Handles[i], &BufferSize, PackageList);
+        }
+
+        if (EFI_ERROR(Status) || PackageList->PackageLength > BufferSize ||
+            PackageList->PackageLength < sizeof(EFI_HII_PACKAGE_LIST_HEADER))
+            continue;
+
+        FormSetGuidSetAddPackageList(Set, PackageList);
+    }
+
+    // The handles read this time replace the old ones; removed lists drop out
+    if (Set->HiiHandles != NULL)
+        TaggedFreePool(Set->HiiHandles);
+    Set->HiiHandles = Handles;
+    Set->HiiHandleCount = HandleSize / sizeof(EFI_HII_HANDLE);
+    if (PackageList != NULL)
+        TaggedFreePool(PackageList);
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Report the known GUIDs that start in [Start, End) and fit before Limit
+ */
+STATIC UINTN FormSetGuidSetScanRange(
+    CONST FORMSET_GUID_SET *Set,
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    UINTN Limit,
+    UINTN TailSize,
+    FORMSET_GUID_CALLBACK Callback,
+    VOID *Context)
+{
+    UINTN Matches = 0;
+    UINTN Offset = Start;
+    UINT32 Prefix;
+
+    if (Limit < sizeof(EFI_GUID) + TailSize)
+        return 0;
+    End = MIN(End, Limit - sizeof(EFI_GUID) - TailSize + 1);
+    if (Offset >= End)
+        return 0;
+
+    // Rolling little-endian DWORD at Offset: shift out one byte, shift in the next
+    Prefix = ReadUnaligned32((UINT32 *)&Data[Offset]);
+    for (; Offset < End; Offset++)
+    {
+        UINT32 Bit = FormSetGuidPrefixBit(Prefix);
+
+        if ((Set->Prefix[Bit / 8] & (1 << (Bit % 8))) != 0 && FormSetGuidSetContains(Set, &Data[Offset]))
+        {
+            Matches++;
+            if (!Callback(Context, Data, Offset))
+                return Matches;
+        }
+
+        Prefix = (Prefix >> 8) | ((UINT32)Data[Offset + sizeof(UINT32)] << 24);
+    }
+
+    return Matches;
+}
+
+UINTN FormSetGuidSetScan(
+    CONST FORMSET_GUID_SET *Set,
+    IMAGE_SECTION_MAP *Map,
+    UINTN TailSize,
+    FORMSET_GUID_CALLBACK Callback,
+    VOID *Context)
+{
+    UINTN Matches = 0;
+
+    if (Set == NULL || Set->Count == 0 || Map == NULL || Map->ImageBase == NULL || Callback == NULL)
+        return 0;
+
+    for (UINTN s = 0; s < Map->SectionCount; s++)
+    {
+        IMAGE_SECTION *Section = &Map->Sections[s];
+        UINTN End = (UINTN)Section->Offset + Section->Size;
+
+        if ((Section->Kind & IMAGE_SECTION_DATA) == 0)
+            continue;
+
+        Matches += FormSetGuidSetScanRange(Set, Map->ImageBase, Section->Offset, End, End, TailSize, Callback, Context);
+    }
+
+    return Matches;
+}
+
+/**
+ * Helper: FormSetGuidSetScanRange callback of a replay, passing on only the
+ * GUIDs added during the traversal
+ */
+STATIC BOOLEAN FormSetGuidStageReplayMatch(VOID *Context, UINT8 *Data, UINTN Offset)
+{
+    FORMSET_GUID_STAGE *State = (FORMSET_GUID_STAGE *)Context;
+
+    // Matches of the GUIDs known before were reported by the traversal
+    for (UINTN i = State->ReplayStart; i < State->ReplayEnd; i++)
+    {
+        if (CompareMem(&State->Set->Order[i], &Data[Offset], sizeof(EFI_GUID)) == 0)
+        {
+            State->Matches++;
+            return State->Callback(State->Context, Data, Offset);
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Helper: Pipeline chunk callback of a FormSet GUID stage
+ */
+STATIC VOID FormSetGuidStageChunk(
+    VOID *Context,
+    IMAGE_SECTION_MAP *Map,
+    CONST IMAGE_SECTION *Section,
+    UINTN Start,
+    UINTN End)
+{
+    FORMSET_GUID_STAGE *State = (FORMSET_GUID_STAGE *)Context;
+    UINTN Limit = (UINTN)Section->Offset + Section->Size;
+
+    if (State->Set->Count == 0)
+        return;
+
+    if (State->ReplayEnd != 0)
+    {
+        (VOID)FormSetGuidSetScanRange(State->Set, Map->ImageBase, Start, End, Limit, State->TailSize,
+                                      FormSetGuidStageReplayMatch, State);
+        return;
+    }
+
+    State->Matches += FormSetGuidSetScanRange(State->Set, Map->ImageBase, Start, End, Limit,
+                                              State->TailSize, State->Callback, State->Context);
+}
+
+/**
+ * Helper: Pipeline finish callback of a FormSet GUID stage
+ */
+STATIC BOOLEAN FormSetGuidStageFinish(VOID *Context)
+{
+    FORMSET_GUID_STAGE *State = (FORMSET_GUID_STAGE *)Context;
+
+    if (State->Set->Count == State->GuidCount)
+        return FALSE;
+
+    // GUIDs learned during the traversal may sit behind offsets already passed
+    State->ReplayStart = State->GuidCount;
+    State->ReplayEnd = State->Set->Count;
+    State->GuidCount = State->Set->Count;
+    return TRUE;
+}
+
+VOID FormSetGuidStageInit(
+    FORMSET_GUID_STAGE *State,
+    FORMSET_GUID_SET *Set,
+    UINTN TailSize,
+    FORMSET_GUID_CALLBACK Callback,
+    VOID *Context,
+    PATCH_PIPELINE_STAGE *Stage)
+{
+    ZeroMem(State, sizeof(FORMSET_GUID_STAGE));
+    State->Set = Set;
+    State->TailSize = TailSize;
+    State->Callback = Callback;
+    State->Context = Context;
+    State->GuidCount = Set->Count;
+
+    ZeroMem(Stage, sizeof(PATCH_PIPELINE_STAGE));
+    Stage->Name = "FormSetGuidScan";
+    Stage->KindMask = IMAGE_SECTION_DATA;
+    Stage->Chunk = FormSetGuidStageChunk;
+    Stage->Finish = FormSetGuidStageFinish;
+    Stage->Context = State;
+}
+
+VOID FormSetGuidSetFree(FORMSET_GUID_SET *Set)
+{
+    if (Set == NULL)
+        return;
+
+    if (Set->Slots != NULL)
+        TaggedFreePool(Set->Slots);
+    if (Set->Order != NULL)
+        TaggedFreePool(Set->Order);
+    if (Set->HiiHandles != NULL)
+        TaggedFreePool(Set->HiiHandles);
+    ZeroMem(Set, sizeof(FORMSET_GUID_SET));
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <Uefi.h>
+#include <Uefi/UefiInternalFormRepresentation.h>
+#include "ImageSections.h"
+#include "PatchPipeline.h"
+
+// Bits in the first-DWORD prefilter (power of two)
+#define FORMSET_GUID_PREFIX_BITS 4096
+
+// Real FormSet GUIDs (from IFR), in an open-addressing table
+typedef struct {
+    EFI_GUID *Slots;             // Zero GUID marks a free slot
+    UINTN Capacity;              // Power of two, 0 while empty
+    UINTN Count;
+    EFI_GUID *Order;             // The Count GUIDs in the order they were added
+    UINT8 Prefix[FORMSET_GUID_PREFIX_BITS / 8];   // Hashes of each GUID's first DWORD
+    EFI_HII_HANDLE *HiiHandles;  // Forms package lists read by FormSetGuidSetAddHii
+    UINTN HiiHandleCount;
+} FORMSET_GUID_SET;
+
+// GUIDs found so far this session (HII database and scanned images)
+extern FORMSET_GUID_SET gFormSetGuids;
+
+/**
+ * Called for every place a known FormSet GUID starts
+ *
+ * @param Context       Caller context
+ * @param Data          Image base
+ * @param Offset        Offset of the GUID in Data
+ * @return FALSE to stop the scan
+ */
+typedef BOOLEAN (*FORMSET_GUID_CALLBACK)(VOID *Context, UINT8 *Data, UINTN Offset);
+
+/**
+ * Add a FormSet GUID
+ *
+ * @param Set           GUID set (zero-initialize before first use)
+ * @param Guid          GUID to add; the zero GUID is ignored
+ * @return EFI_SUCCESS (also if already present) or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS FormSetGuidSetAdd(FORMSET_GUID_SET *Set, CONST EFI_GUID *Guid);
+
+/**
+ * Check whether a GUID is a known FormSet
+ *
+ * @param Set           GUID set
+ * @param Guid          GUID to look up (may be unaligned)
+ * @return TRUE if present
+ */
+BOOLEAN FormSetGuidSetContains(CONST FORMSET_GUID_SET *Set, CONST VOID *Guid);
+
+/**
+ * Add the FormSet GUIDs of every forms package in the HII database
+ *
+ * Only the package lists whose handles were not seen by an earlier call
+ * are exported.
+ *
+ * @param Set           GUID set
+ * @return EFI_SUCCESS, or the HII database error (the set is left as is)
+ */
+EFI_STATUS FormSetGuidSetAddHii(FORMSET_GUID_SET *Set);
+
+/**
+ * Find every known FormSet GUID in the data sections of an image
+ *
+ * A rolling first-DWORD prefilter rejects almost every offset before the
+ * table is probed, so only real FormSet GUIDs reach Callback.
+ *
+ * @param Set           GUID set
+ * @param Map           Section map of the image
+ * @param TailSize      Bytes needed after the GUID for a match to be reported
+ * @param Callback      Called for each match, in ascending offset order
+ * @param Context       Passed to Callback
+ * @return Number of matches reported
+ */
+UINTN FormSetGuidSetScan(
+    CONST FORMSET_GUID_SET *Set,
+    IMAGE_SECTION_MAP *Map,
+    UINTN TailSize,
+    FORMSET_GUID_CALLBACK Callback,
+    VOID *Context);
+
+// State of a FormSet GUID scan run as a patch pipeline stage
+typedef struct {
+    FORMSET_GUID_SET *Set;
+    UINTN TailSize;
+    FORMSET_GUID_CALLBACK Callback;
+    VOID *Context;
+    UINTN GuidCount;             // Set size when the traversal started
+    UINTN ReplayStart;           // Order range of the GUIDs the replay looks for
+    UINTN ReplayEnd;
+    UINTN Matches;
+} FORMSET_GUID_STAGE;
+
+/**
+ * Prepare FormSetGuidSetScan as a patch pipeline stage
+ *
+ * GUIDs another stage adds during the traversal are used from then on; if
+ * any were added the stage asks to be run once more, so a GUID defined
+ * after its use in the image is still found. That run reports only the
+ * added GUIDs, so no match reaches Callback twice.
+ *
+ * @param State         Stage state; must outlive the pipeline run
+ * @param Set           GUID set
+ * @param TailSize      Bytes needed after the GUID for a match to be reported
+ * @param Callback      Called for each match
+ * @param Context       Passed to Callback
+ * @param Stage         Receives the stage to register
+ */
+VOID FormSetGuidStageInit(
+    FORMSET_GUID_STAGE *State,
+    FORMSET_GUID_SET *Set,
+    UINTN TailSize,
+    FORMSET_GUID_CALLBACK Callback,
+    VOID *Context,
+    PATCH_PIPELINE_STAGE *Stage);
+
+/**
+ * Free a GUID set
+ *
+ * @param Set           Set to free
+ */
+VOID FormSetGuidSetFree(FORMSET_GUID_SET *Set);
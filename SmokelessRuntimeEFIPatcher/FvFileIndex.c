@@ -0,0 +1,362 @@
+#include "FvFileIndex.h"
+#include "IndexHash.h"
+#include "TaggedPool.h"
+#include "FwCalls.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/FirmwareVolumeBlock.h>
+
+FV_FILE_INDEX gFvFileIndex;
+
+/**
+ * Helper: Append an entry, growing the array by doubling
+ */
+STATIC FV_FILE_ENTRY *FvFileIndexAppend(FV_FILE_INDEX *Index)
+{
+    if (Index->Count == Index->Capacity)
+    {
+        UINTN NewCapacity = Index->Capacity == 0 ? 256 : Index->Capacity * 2;
+        FV_FILE_ENTRY *NewEntries = TaggedAllocatePool(POOL_TAG_FV, NewCapacity * sizeof(FV_FILE_ENTRY));
+
+        if (NewEntries == NULL)
+            return NULL;
+        if (Index->Entries != NULL)
+        {
+            CopyMem(NewEntries, Index->Entries, Index->Count * sizeof(FV_FILE_ENTRY));
+            TaggedFreePool(Index->Entries);
+        }
+        Index->Entries = NewEntries;
+        Index->Capacity = NewCapacity;
+    }
+
+    ZeroMem(&Index->Entries[Index->Count], sizeof(FV_FILE_ENTRY));
+    return &Index->Entries[Index->Count++];
+}
+
+/**
+ * Helper: Build the name and GUID hash tables over Entries
+ */
+STATIC EFI_STATUS FvFileIndexRehash(FV_FILE_INDEX *Index)
+{
+    UINT32 *NameBuckets;
+    UINT32 *GuidBuckets;
+    UINTN Mask;
+    UINTN i;
+
+    Index->BucketCount = 64;
+    while (Index->BucketCount < 2 * Index->Count)
+        Index->BucketCount *= 2;
+
+    Index->Buckets = TaggedAllocatePool(POOL_TAG_FV, 2 * Index->BucketCount * sizeof(UINT32));
+    if (Index->Buckets == NULL)
+        return EFI_OUT_OF_RESOURCES;
+    SetMem(Index->Buckets, 2 * Index->BucketCount * sizeof(UINT32), 0xFF);
+
+    NameBuckets = Index->Buckets;
+    GuidBuckets = Index->Buckets + Index->BucketCount;
+    Mask = Index->BucketCount - 1;
+
+    // Inserted back to front so each chain keeps sweep order (first match wins, as before)
+    for (i = Index->Count; i-- > 0;)
+    {
+        FV_FILE_ENTRY *Entry = &Index->Entries[i];
+        UINTN Slot;
+
+        Entry->NextByName = FV_FILE_NONE;
+        if (Entry->Name != NULL)
+        {
+            Slot = IndexHashName(Entry->Name) & Mask;
+            Entry->NextByName = NameBuckets[Slot];
+            NameBuckets[Slot] = (UINT32)i;
+        }
+
+        Slot = IndexHashGuid(&Entry->FileGuid) & Mask;
+        Entry->NextByGuid = GuidBuckets[Slot];
+        GuidBuckets[Slot] = (UINT32)i;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Open the in-memory copy of a volume through its FVB
+ */
+STATIC BOOLEAN FvFileIndexMapVolume(EFI_HANDLE FvHandle, FFS_VOLUME *Volume)
+{
+    EFI_FIRMWARE_VOLUME_BLOCK2_PROTOCOL *Fvb;
+    EFI_PHYSICAL_ADDRESS Address;
+    CONST EFI_FIRMWARE_VOLUME_HEADER *Header;
+
+    if (EFI_ERROR(gBS->HandleProtocol(FvHandle, &gEfiFirmwareVolumeBlock2ProtocolGuid, (VOID **)&Fvb)) ||
+        EFI_ERROR(Fvb->GetPhysicalAddress(Fvb, &Address)) || Address == 0)
+        return FALSE;
+
+    Header = (CONST EFI_FIRMWARE_VOLUME_HEADER *)(UINTN)Address;
+    if (Header->Signature != EFI_FVH_SIGNATURE)
+        return FALSE;
+    return !EFI_ERROR(FfsVolumeOpen(Volume, Header, (UINTN)Header->FvLength));
+}
+
+/**
+ * Helper: Check whether the UI section of a file type is read
+ */
+STATIC BOOLEAN FvFileIndexWantsName(FV_FILE_INDEX *Index, EFI_FV_FILETYPE FileType)
+{
+    return FileType < 64 && (Index->NamedTypes & FV_FILE_TYPE_BIT(FileType)) != 0;
+}
+
+/**
+ * Helper: Index the files of a memory-mapped volume in place
+ */
+STATIC EFI_STATUS FvFileIndexAddMapped(
+    FV_FILE_INDEX *Index,
+    EFI_HANDLE FvHandle,
+    EFI_FIRMWARE_VOLUME2_PROTOCOL *Fv,
+    CONST FFS_VOLUME *Volume)
+{
+    FFS_FILE File;
+
+    ZeroMem(&File, sizeof(File));
+    while (!EFI_ERROR(FfsNextFile(Volume, &File)))
+    {
+        FV_FILE_ENTRY *Entry = FvFileIndexAppend(Index);
+        UINTN StringSize = 0;
+        UINT32 AuthenticationStatus;
+
+        if (Entry == NULL)
+            return EFI_OUT_OF_RESOURCES;
+
+        Entry->FvHandle = FvHandle;
+        Entry->Fv = Fv;
+        CopyGuid(&Entry->FileGuid, File.Name);
+        Entry->FileType = File.Type;
+        Entry->Attributes = EFI_FV_FILE_ATTRIB_MEMORY_MAPPED |
+                            ((File.Attributes & FFS_ATTRIB_FIXED) != 0 ? EFI_FV_FILE_ATTRIB_FIXED : 0);
+        Entry->FileSize = File.DataSize;
+        Entry->Data = File.Data;
+
+        if (!FvFileIndexWantsName(Index, File.Type))
+            continue;
+
+        Index->NamesRead++;
+        Entry->Name = (CHAR16 *)FfsFileName(&File);
+        if (Entry->Name != NULL)
+            continue;
+
+        // UI section inside a compressed encapsulation
+        if (!EFI_ERROR(gFwCalls.ReadSection(Fv, File.Name, EFI_SECTION_USER_INTERFACE, 0, (VOID **)&Entry->Name, &StringSize, &AuthenticationStatus)))
+            Entry->NameOwned = TRUE;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS FvFileIndexBuild(FV_FILE_INDEX *Index)
+{
+    EFI_STATUS Status;
+    EFI_HANDLE *HandleBuffer;
+    UINTN NumberOfHandles;
+
+    if (Index == NULL)
+        return EFI_INVALID_PARAMETER;
+    if (Index->Buckets != NULL)
+        return EFI_SUCCESS;
+    if (Index->NamedTypes == 0)
+        Index->NamedTypes = FV_FILE_INDEX_LOADABLE_TYPES;
+
+    Status = gBS->LocateHandleBuffer(ByProtocol, &gEfiFirmwareVolume2ProtocolGuid, NULL, &NumberOfHandles, &HandleBuffer);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Status = EFI_SUCCESS;
+    for (UINTN v = 0; v < NumberOfHandles && !EFI_ERROR(Status); v++)
+    {
+        EFI_FIRMWARE_VOLUME2_PROTOCOL *Fv;
+        FFS_VOLUME Mapped;
+        VOID *Keys;
+
+        if (EFI_ERROR(gBS->HandleProtocol(HandleBuffer[v], &gEfiFirmwareVolume2ProtocolGuid, (VOID **)&Fv)))
+            continue;
+
+        // Walk memory-mapped volumes directly; no per-file protocol calls or copies
+        if (FvFileIndexMapVolume(HandleBuffer[v], &Mapped))
+        {
+            Index->VolumeCount++;
+            Index->MappedVolumeCount++;
+            Status = FvFileIndexAddMapped(Index, HandleBuffer[v], Fv, &Mapped);
+            continue;
+        }
+
+        Keys = TaggedAllocateZeroPool(POOL_TAG_FV, Fv->KeySize);
+        if (Keys == NULL)
+        {
+            Status = EFI_OUT_OF_RESOURCES;
+            break;
+        }
+        Index->VolumeCount++;
+
+        while (TRUE)
+        {
+            EFI_FV_FILETYPE FileType = EFI_FV_FILETYPE_ALL;
+            EFI_FV_FILE_ATTRIBUTES Attributes;
+            EFI_GUID NameGuid;
+            UINTN FileSize;
+            FV_FILE_ENTRY *Entry;
+            VOID *String = NULL;
+            UINTN StringSize = 0;
+            UINT32 AuthenticationStatus;
+
+            if (EFI_ERROR(Fv->GetNextFile(Fv, Keys, &FileType, &NameGuid, &Attributes, &FileSize)))
+                break;
+
+            Entry = FvFileIndexAppend(Index);
+            if (Entry == NULL)
+            {
+                Status = EFI_OUT_OF_RESOURCES;
+                break;
+            }
+
+            Entry->FvHandle = HandleBuffer[v];
+            Entry->Fv = Fv;
+            CopyGuid(&Entry->FileGuid, &NameGuid);
+            Entry->FileType = FileType;
+            Entry->Attributes = Attributes;
+            Entry->FileSize = FileSize;
+
+            // Only files that can be loaded by name need one
+            if (!FvFileIndexWantsName(Index, FileType))
+                continue;
+
+            Index->NamesRead++;
+            if (!EFI_ERROR(gFwCalls.ReadSection(Fv, &NameGuid, EFI_SECTION_USER_INTERFACE, 0, &String, &StringSize, &AuthenticationStatus)))
+            {
+                Entry->Name = String;
+                Entry->NameOwned = TRUE;
+            }
+        }
+
+        TaggedFreePool(Keys);
+    }
+    FreePool(HandleBuffer);
+
+    if (!EFI_ERROR(Status))
+        Status = FvFileIndexRehash(Index);
+    if (EFI_ERROR(Status))
+        FvFileIndexFree(Index);
+    return Status;
+}
+
+CONST FV_FILE_ENTRY *FvFileIndexFindByName(FV_FILE_INDEX *Index, CONST CHAR16 *Name)
+{
+    UINT32 i;
+
+    if (Name == NULL || EFI_ERROR(FvFileIndexBuild(Index)))
+        return NULL;
+
+    for (i = Index->Buckets[IndexHashName(Name) & (Index->BucketCount - 1)];
+         i != FV_FILE_NONE;
+         i = Index->Entries[i].NextByName)
+    {
+        if (StrCmp(Index->Entries[i].Name, Name) == 0)
+            return &Index->Entries[i];
+    }
+    return NULL;
+}
+
+CONST FV_FILE_ENTRY *FvFileIndexFindByGuid(FV_FILE_INDEX *Index, CONST EFI_GUID *FileGuid)
+{
+    UINT32 *GuidBuckets;
+    UINT32 i;
+
+    if (FileGuid == NULL || EFI_ERROR(FvFileIndexBuild(Index)))
+        return NULL;
+
+    GuidBuckets = Index->Buckets + Index->BucketCount;
+    for (i = GuidBuckets[IndexHashGuid(FileGuid) & (Index->BucketCount - 1)];
+         i != FV_FILE_NONE;
+         i = Index->Entries[i].NextByGuid)
+    {
+        if (CompareGuid(&Index->Entries[i].FileGuid, FileGuid))
+            return &Index->Entries[i];
+    }
+    return NULL;
+}
+
+EFI_STATUS FvFileIndexReadSection(
+    CONST FV_FILE_ENTRY *Entry,
+    EFI_SECTION_TYPE SectionType,
+    VOID **Buffer,
+    UINTN *BufferSize,
+    UINT32 *AuthenticationStatus)
+{
+    if (Entry == NULL || Buffer == NULL || BufferSize == NULL || AuthenticationStatus == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    return gFwCalls.ReadSection(Entry->Fv, &Entry->FileGuid, SectionType, 0, Buffer, BufferSize, AuthenticationStatus);
+}
+
+EFI_STATUS FvFileIndexReadFile(
+    CONST FV_FILE_ENTRY *Entry,
+    VOID **Buffer,
+    UINTN *BufferSize,
+    UINT32 *AuthenticationStatus)
+{
+    EFI_FV_FILETYPE FileType;
+    EFI_FV_FILE_ATTRIBUTES Attributes;
+
+    if (Entry == NULL || Buffer == NULL || BufferSize == NULL || AuthenticationStatus == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    *Buffer = NULL;
+    return Entry->Fv->ReadFile(Entry->Fv, &Entry->FileGuid, Buffer, BufferSize, &FileType, &Attributes,
+                               AuthenticationStatus);
+}
+
+EFI_STATUS FvFileIndexMapSection(
+    CONST FV_FILE_ENTRY *Entry,
+    EFI_SECTION_TYPE SectionType,
+    CONST VOID **Data,
+    UINTN *DataSize)
+{
+    FFS_SECTION Section;
+    EFI_STATUS Status;
+
+    if (Entry == NULL || Data == NULL || DataSize == NULL)
+        return EFI_INVALID_PARAMETER;
+    if (Entry->Data == NULL)
+        return EFI_UNSUPPORTED;
+
+    Status = FfsFindSection(Entry->Data, Entry->FileSize, SectionType, &Section);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    *Data = Section.Data;
+    *DataSize = Section.DataSize;
+    return EFI_SUCCESS;
+}
+
+VOID FvFileIndexFree(FV_FILE_INDEX *Index)
+{
+    UINT64 NamedTypes;
+
+    if (Index == NULL)
+        return;
+
+    for (UINTN i = 0; i < Index->Count; i++)
+    {
+        if (Index->Entries[i].NameOwned)
+            FreePool(Index->Entries[i].Name);
+    }
+
+    if (Index->Entries != NULL)
+        TaggedFreePool(Index->Entries);
+    if (Index->Buckets != NULL)
+        TaggedFreePool(Index->Buckets);
+
+    // The type filter is configuration, not contents
+    NamedTypes = Index->NamedTypes;
+    ZeroMem(Index, sizeof(FV_FILE_INDEX));
+    Index->NamedTypes = NamedTypes;
+}
@@ -0,0 +1,142 @@
+#pragma once
+#include <Uefi.h>
+#include <PiDxe.h>
+#include <Library/BaseLib.h>
+#include "FfsWalk.h"
+#include <Protocol/FirmwareVolume2.h>
+
+// End of a hash chain
+#define FV_FILE_NONE MAX_UINT32
+
+// Bit of an FV file type in FV_FILE_INDEX.NamedTypes (types 0x00..0x3F)
+#define FV_FILE_TYPE_BIT(Type) (LShiftU64(1, (Type)))
+
+// File types SREP loads by name: DXE drivers, applications, combined SMM/DXE
+#define FV_FILE_INDEX_LOADABLE_TYPES (FV_FILE_TYPE_BIT(EFI_FV_FILETYPE_DRIVER) | \
+                                      FV_FILE_TYPE_BIT(EFI_FV_FILETYPE_APPLICATION) | \
+                                      FV_FILE_TYPE_BIT(EFI_FV_FILETYPE_COMBINED_SMM_DXE))
+
+// One file of a firmware volume
+typedef struct {
+    EFI_HANDLE FvHandle;
+    EFI_FIRMWARE_VOLUME2_PROTOCOL *Fv;
+    EFI_GUID FileGuid;
+    EFI_FV_FILETYPE FileType;
+    EFI_FV_FILE_ATTRIBUTES Attributes;
+    UINTN FileSize;
+    CONST UINT8 *Data;           // File contents in a memory-mapped volume, else NULL
+    CHAR16 *Name;                // UI section, NULL if none or not read
+    BOOLEAN NameOwned;           // Name is a pool copy (FV2 ReadSection), not in place
+    UINT32 NextByName;           // Hash chains (entry indices)
+    UINT32 NextByGuid;
+} FV_FILE_ENTRY;
+
+// Every file of every firmware volume, in GetNextFile order
+typedef struct {
+    FV_FILE_ENTRY *Entries;
+    UINTN Count;
+    UINTN Capacity;
+    UINT32 *Buckets;             // 2 * BucketCount heads: name, GUID
+    UINTN BucketCount;           // Power of two
+    UINTN VolumeCount;
+    UINTN MappedVolumeCount;     // Volumes walked in place with FfsWalk
+    UINT64 NamedTypes;           // FV_FILE_TYPE_BIT of types whose UI section is read
+    UINTN NamesRead;             // UI sections read
+} FV_FILE_INDEX;
+
+// Index shared by BIOS detection and the FV loaders; built on first use
+extern FV_FILE_INDEX gFvFileIndex;
+
+/**
+ * Sweep every firmware volume once and index its files
+ *
+ * Volumes whose FVB maps them in memory are walked in place with FfsWalk,
+ * so their names are not copied; the rest go through the FV2 protocol.
+ * Every file is indexed by GUID, but the UI section is read only for the
+ * types in NamedTypes (FV_FILE_INDEX_LOADABLE_TYPES if 0). Raw, freeform,
+ * PEIM and FV image files are never looked up by name, and their section
+ * reads can walk encapsulations or decompress. Does nothing if the index
+ * is built.
+ *
+ * @param Index         Index to build
+ * @return EFI_SUCCESS, EFI_OUT_OF_RESOURCES, or the LocateHandleBuffer error
+ */
+EFI_STATUS FvFileIndexBuild(FV_FILE_INDEX *Index);
+
+/**
+ * Find a file by UI name, building the index if needed
+ *
+ * @param Index         Index
+ * @param Name          UI name (case sensitive)
+ * @return First file with that name in sweep order, or NULL (also for
+ *         files whose type is not in NamedTypes)
+ */
+CONST FV_FILE_ENTRY *FvFileIndexFindByName(FV_FILE_INDEX *Index, CONST CHAR16 *Name);
+
+/**
+ * Find a file by FFS GUID, building the index if needed
+ *
+ * @param Index         Index
+ * @param FileGuid      FFS file name
+ * @return First file with that GUID in sweep order, or NULL
+ */
+CONST FV_FILE_ENTRY *FvFileIndexFindByGuid(FV_FILE_INDEX *Index, CONST EFI_GUID *FileGuid);
+
+/**
+ * Read a section of an indexed file from its volume
+ *
+ * @param Entry         Indexed file
+ * @param SectionType   Section to read
+ * @param Buffer        Receives a pool buffer the caller frees
+ * @param BufferSize    Receives the section size
+ * @param AuthenticationStatus Receives the authentication status
+ * @return ReadSection status
+ */
+EFI_STATUS FvFileIndexReadSection(
+    CONST FV_FILE_ENTRY *Entry,
+    EFI_SECTION_TYPE SectionType,
+    VOID **Buffer,
+    UINTN *BufferSize,
+    UINT32 *AuthenticationStatus);
+
+/**
+ * Read the raw contents of an indexed file from its volume
+ *
+ * The sections come back as stored, so nothing is decompressed.
+ *
+ * @param Entry         Indexed file
+ * @param Buffer        Receives a pool buffer the caller frees
+ * @param BufferSize    Receives the file size
+ * @param AuthenticationStatus Receives the authentication status
+ * @return ReadFile status
+ */
+EFI_STATUS FvFileIndexReadFile(
+    CONST FV_FILE_ENTRY *Entry,
+    VOID **Buffer,
+    UINTN *BufferSize,
+    UINT32 *AuthenticationStatus);
+
+/**
+ * Point at a section of an indexed file without copying it
+ *
+ * Works for files of memory-mapped volumes whose section is not inside a
+ * compressed or signed encapsulation.
+ *
+ * @param Entry         Indexed file
+ * @param SectionType   Section to find
+ * @param Data          Receives a pointer into the volume (read only)
+ * @param DataSize      Receives the section size
+ * @return EFI_SUCCESS, or EFI_UNSUPPORTED/EFI_NOT_FOUND (use FvFileIndexReadSection)
+ */
+EFI_STATUS FvFileIndexMapSection(
+    CONST FV_FILE_ENTRY *Entry,
+    EFI_SECTION_TYPE SectionType,
+    CONST VOID **Data,
+    UINTN *DataSize);
+
+/**
+ * Free an index and the names it holds
+ *
+ * @param Index         Index to free
+ */
+VOID FvFileIndexFree(FV_FILE_INDEX *Index);
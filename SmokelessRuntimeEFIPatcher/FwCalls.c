@@ -0,0 +1,268 @@
+#include "FwCalls.h"
+#include "Trace.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+STATIC CONST CHAR8 *mFwCallNames[FW_CALL_MAX] = {
+    "GetVariable",
+    "ReadSection",
+    "ExportPackageLists",
+    "GetString"
+};
+
+STATIC FW_CALL_STATS mFwCallStats[FW_CALL_MAX];
+STATIC UINT64 mFwCallTscFrequency;
+STATIC BOOLEAN mFwCallsEnabled;
+
+/**
+ * Helper: Microseconds of a tick count, 0 without a measured frequency
+ */
+STATIC UINT64 FwCallMicroseconds(UINT64 Ticks)
+{
+    if (mFwCallTscFrequency == 0)
+        return 0;
+
+    return DivU64x64Remainder(MultU64x32(Ticks, 1000000), mFwCallTscFrequency, NULL);
+}
+
+/**
+ * Helper: Charge one call to a service
+ */
+STATIC VOID FwCallRecord(FW_CALL Call, UINT64 Start, EFI_STATUS Status, UINT64 Bytes)
+{
+    FW_CALL_STATS *Stats = &mFwCallStats[Call];
+    UINT64 Ticks = TraceTicks() - Start;
+    UINT64 Us = FwCallMicroseconds(Ticks);
+    UINTN Bucket = Us == 0 ? 0 : (UINTN)HighBitSet64(Us) + 1;
+
+    Stats->Calls++;
+    Stats->Ticks += Ticks;
+    if (Ticks > Stats->MaxTicks)
+        Stats->MaxTicks = Ticks;
+    if (EFI_ERROR(Status))
+        Stats->Failed++;
+    else
+        Stats->Bytes += Bytes;
+    Stats->Histogram[MIN(Bucket, FW_CALL_BUCKETS - 1)]++;
+}
+
+//
+// Direct entry points
+//
+
+STATIC EFI_STATUS EFIAPI FwDirectGetVariable(
+    IN CHAR16 *VariableName,
+    IN EFI_GUID *VendorGuid,
+    OUT UINT32 *Attributes OPTIONAL,
+    IN OUT UINTN *DataSize,
+    OUT VOID *Data OPTIONAL)
+{
+    return gRT->GetVariable(VariableName, VendorGuid, Attributes, DataSize, Data);
+}
+
+STATIC EFI_STATUS EFIAPI FwDirectReadSection(
+    IN CONST EFI_FIRMWARE_VOLUME2_PROTOCOL *This,
+    IN CONST EFI_GUID *NameGuid,
+    IN EFI_SECTION_TYPE SectionType,
+    IN UINTN SectionInstance,
+    IN OUT VOID **Buffer,
+    IN OUT UINTN *BufferSize,
+    OUT UINT32 *AuthenticationStatus)
+{
+    return This->ReadSection(This, NameGuid, SectionType, SectionInstance, Buffer, BufferSize, AuthenticationStatus);
+}
+
+STATIC EFI_STATUS EFIAPI FwDirectExportPackageLists(
+    IN CONST EFI_HII_DATABASE_PROTOCOL *This,
+    IN EFI_HII_HANDLE Handle,
+    IN OUT UINTN *BufferSize,
+    OUT EFI_HII_PACKAGE_LIST_HEADER *Buffer)
+{
+    return This->ExportPackageLists(This, Handle, BufferSize, Buffer);
+}
+
+STATIC EFI_STATUS EFIAPI FwDirectGetString(
+    IN CONST EFI_HII_STRING_PROTOCOL *This,
+    IN CONST CHAR8 *Language,
+    IN EFI_HII_HANDLE PackageList,
+    IN EFI_STRING_ID StringId,
+    OUT EFI_STRING String,
+    IN OUT UINTN *StringSize,
+    OUT EFI_FONT_INFO **StringFontInfo OPTIONAL)
+{
+    return This->GetString(This, Language, PackageList, StringId, String, StringSize, StringFontInfo);
+}
+
+//
+// Measuring entry points
+//
+
+STATIC EFI_STATUS EFIAPI FwTimedGetVariable(
+    IN CHAR16 *VariableName,
+    IN EFI_GUID *VendorGuid,
+    OUT UINT32 *Attributes OPTIONAL,
+    IN OUT UINTN *DataSize,
+    OUT VOID *Data OPTIONAL)
+{
+    UINT64 Start = TraceTicks();
+    EFI_STATUS Status = gRT->GetVariable(VariableName, VendorGuid, Attributes, DataSize, Data);
+
+    FwCallRecord(FW_CALL_GET_VARIABLE, Start, Status, Data != NULL ? *DataSize : 0);
+    return Status;
+}
+
+STATIC EFI_STATUS EFIAPI FwTimedReadSection(
+    IN CONST EFI_FIRMWARE_VOLUME2_PROTOCOL *This,
+    IN CONST EFI_GUID *NameGuid,
+    IN EFI_SECTION_TYPE SectionType,
+    IN UINTN SectionInstance,
+    IN OUT VOID **Buffer,
+    IN OUT UINTN *BufferSize,
+    OUT UINT32 *AuthenticationStatus)
+{
+    UINT64 Start = TraceTicks();
+    EFI_STATUS Status = This->ReadSection(This, NameGuid, SectionType, SectionInstance, Buffer, BufferSize,
+                                          AuthenticationStatus);
+
+    FwCallRecord(FW_CALL_READ_SECTION, Start, Status, *BufferSize);
+    return Status;
+}
+
+STATIC EFI_STATUS EFIAPI FwTimedExportPackageLists(
+    IN CONST EFI_HII_DATABASE_PROTOCOL *This,
+    IN EFI_HII_HANDLE Handle,
+    IN OUT UINTN *BufferSize,
+    OUT EFI_HII_PACKAGE_LIST_HEADER *Buffer)
+{
+    UINT64 Start = TraceTicks();
+    EFI_STATUS Status = This->ExportPackageLists(This, Handle, BufferSize, Buffer);
+
+    FwCallRecord(FW_CALL_EXPORT_PACKAGE_LISTS, Start, Status, *BufferSize);
+    return Status;
+}
+
+STATIC EFI_STATUS EFIAPI FwTimedGetString(
+    IN CONST EFI_HII_STRING_PROTOCOL *This,
+    IN CONST CHAR8 *Language,
+    IN EFI_HII_HANDLE PackageList,
+    IN EFI_STRING_ID StringId,
+    OUT EFI_STRING String,
+    IN OUT UINTN *StringSize,
+    OUT EFI_FONT_INFO **StringFontInfo OPTIONAL)
+{
+    UINT64 Start = TraceTicks();
+    EFI_STATUS Status = This->GetString(This, Language, PackageList, StringId, String, StringSize, StringFontInfo);
+
+    FwCallRecord(FW_CALL_GET_STRING, Start, Status, *StringSize);
+    return Status;
+}
+
+FW_CALL_TABLE gFwCalls = {
+    FwDirectGetVariable,
+    FwDirectReadSection,
+    FwDirectExportPackageLists,
+    FwDirectGetString
+};
+
+STATIC CONST FW_CALL_TABLE mFwTimedCalls = {
+    FwTimedGetVariable,
+    FwTimedReadSection,
+    FwTimedExportPackageLists,
+    FwTimedGetString
+};
+
+/**
+ * Measure the firmware services if the flag file exists
+ */
+EFI_STATUS FwCallsOpen(EFI_FILE *Root, CONST CHAR16 *FlagFile, UINT64 TscFrequency)
+{
+    EFI_FILE *Flag;
+
+    if (EFI_ERROR(Root->Open(Root, &Flag, (CHAR16 *)FlagFile, EFI_FILE_MODE_READ, 0)))
+        return EFI_NOT_FOUND;
+    Flag->Close(Flag);
+
+    // No time stamp counter (or no calibration): keep calling the firmware directly
+    if (TscFrequency == 0)
+    {
+        AsciiSPrint(Log, 512, "Firmware calls not measured: no time stamp counter\n\r");
+        LogToFile(LogFile, Log);
+        return EFI_UNSUPPORTED;
+    }
+
+    ZeroMem(mFwCallStats, sizeof(mFwCallStats));
+    mFwCallTscFrequency = TscFrequency;
+    mFwCallsEnabled = TRUE;
+    CopyMem(&gFwCalls, &mFwTimedCalls, sizeof(gFwCalls));
+
+    AsciiSPrint(Log, 512, "Measuring firmware calls\n\r");
+    LogToFile(LogFile, Log);
+    return EFI_SUCCESS;
+}
+
+/**
+ * Log calls, failures, time, bytes and the latency histogram of every service
+ */
+VOID FwCallsReport(VOID)
+{
+    if (!mFwCallsEnabled)
+        return;
+
+    AsciiSPrint(Log, 512, "\n=== Firmware calls ===\n\r");
+    LogToFile(LogFile, Log);
+    AsciiSPrint(Log, 512, "  %-20a %7a %7a %12a %9a %9a %9a\n\r",
+                "Service", "Calls", "Failed", "Total ms", "Max us", "Avg us", "KB");
+    LogToFile(LogFile, Log);
+
+    for (UINTN i = 0; i < FW_CALL_MAX; i++)
+    {
+        FW_CALL_STATS *Stats = &mFwCallStats[i];
+        UINT64 TotalUs = FwCallMicroseconds(Stats->Ticks);
+        UINT32 Fraction;
+        UINT64 TotalMs = DivU64x32Remainder(TotalUs, 1000, &Fraction);
+
+        if (Stats->Calls == 0)
+            continue;
+        AsciiSPrint(Log, 512, "  %-20a %7d %7d %8ld.%03d %9ld %9ld %9ld\n\r", mFwCallNames[i],
+                    Stats->Calls, Stats->Failed, TotalMs, Fraction, FwCallMicroseconds(Stats->MaxTicks),
+                    DivU64x32(TotalUs, (UINT32)Stats->Calls), DivU64x32(Stats->Bytes, 1024));
+        LogToFile(LogFile, Log);
+    }
+
+    // One line per service: calls per latency bucket, empty buckets left out
+    AsciiSPrint(Log, 512, "  Latency histogram (us):\n\r");
+    LogToFile(LogFile, Log);
+
+    for (UINTN i = 0; i < FW_CALL_MAX; i++)
+    {
+        FW_CALL_STATS *Stats = &mFwCallStats[i];
+        UINTN Length;
+
+        if (Stats->Calls == 0)
+            continue;
+
+        Length = AsciiSPrint(Log, 512, "  %-20a", mFwCallNames[i]);
+        for (UINTN Bucket = 0; Bucket < FW_CALL_BUCKETS; Bucket++)
+        {
+            if (Stats->Histogram[Bucket] == 0)
+                continue;
+
+            if (Bucket == 0)
+                Length += AsciiSPrint(&Log[Length], 512 - Length, " <1:%d", Stats->Histogram[Bucket]);
+            else if (Bucket == FW_CALL_BUCKETS - 1)
+                Length += AsciiSPrint(&Log[Length], 512 - Length, " %ld+:%d",
+                                      LShiftU64(1, Bucket - 1), Stats->Histogram[Bucket]);
+            else
+                Length += AsciiSPrint(&Log[Length], 512 - Length, " %ld-%ld:%d",
+                                      LShiftU64(1, Bucket - 1), LShiftU64(1, Bucket), Stats->Histogram[Bucket]);
+        }
+        AsciiSPrint(&Log[Length], 512 - Length, "\n\r");
+        LogToFile(LogFile, Log);
+    }
+}
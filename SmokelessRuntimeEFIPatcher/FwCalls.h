@@ -0,0 +1,58 @@
+#pragma once
+#include <Uefi.h>
+#include <PiDxe.h>
+#include <Protocol/FirmwareVolume2.h>
+#include <Protocol/HiiDatabase.h>
+#include <Protocol/HiiString.h>
+#include <Protocol/SimpleFileSystem.h>
+
+// Latency buckets: below 1 us, then one per power of two microseconds;
+// the last one also takes everything slower
+#define FW_CALL_BUCKETS 18
+
+// Interposed firmware services
+typedef enum {
+    FW_CALL_GET_VARIABLE = 0,    // gRT->GetVariable
+    FW_CALL_READ_SECTION,        // EFI_FIRMWARE_VOLUME2_PROTOCOL.ReadSection
+    FW_CALL_EXPORT_PACKAGE_LISTS,// EFI_HII_DATABASE_PROTOCOL.ExportPackageLists
+    FW_CALL_GET_STRING,          // EFI_HII_STRING_PROTOCOL.GetString
+    FW_CALL_MAX
+} FW_CALL;
+
+// Counters of one service
+typedef struct {
+    UINTN Calls;
+    UINTN Failed;                // Includes EFI_BUFFER_TOO_SMALL size probes
+    UINT64 Ticks;
+    UINT64 MaxTicks;
+    UINT64 Bytes;                // Data returned by successful calls
+    UINTN Histogram[FW_CALL_BUCKETS];
+} FW_CALL_STATS;
+
+// Entry points SREP calls the services through. They go straight to the
+// firmware until FwCallsOpen switches them to the measuring versions.
+typedef struct {
+    EFI_GET_VARIABLE GetVariable;
+    EFI_FV_READ_SECTION ReadSection;
+    EFI_HII_DATABASE_EXPORT_PACKAGE_LISTS ExportPackageLists;
+    EFI_HII_GET_STRING GetString;
+} FW_CALL_TABLE;
+
+extern FW_CALL_TABLE gFwCalls;
+
+/**
+ * Measure the firmware services if the flag file exists
+ *
+ * @param Root          Directory holding the flag file
+ * @param FlagFile      Name of the flag file
+ * @param TscFrequency  Time stamp counter ticks per second, for the report
+ * @return EFI_SUCCESS, EFI_NOT_FOUND without the flag file, or
+ *         EFI_UNSUPPORTED when TscFrequency is 0 (the direct table stays)
+ */
+EFI_STATUS FwCallsOpen(EFI_FILE *Root, CONST CHAR16 *FlagFile, UINT64 TscFrequency);
+
+/**
+ * Log calls, failures, time, bytes and the latency histogram of every
+ * service; nothing unless FwCallsOpen enabled the measurements
+ */
+VOID FwCallsReport(VOID);
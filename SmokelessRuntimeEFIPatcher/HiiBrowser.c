@@ -1,6 +1,8 @@
 #include "HiiBrowser.h"
 #include "Constants.h"
 #include "IfrOpcodes.h"
+#include "TaggedPool.h"
+#include "FwCalls.h"
 #include <Library/DebugLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
@@ -17,8 +19,6 @@ extern EFI_RUNTIME_SERVICES      *gRT;
 #include <Protocol/HiiString.h>
 
 // Forward declarations for helper functions
-STATIC VENDOR_TYPE DetectVendor(CHAR16 *Title, EFI_GUID *FormSetGuid);
-STATIC UINT8 DetectFormCategory(CHAR16 *Title);
 STATIC UINTN CategorizeForm(CHAR16 *Title);
 
 /**
@@ -66,7 +66,7 @@ EFI_STATUS HiiBrowserInitialize(HII_BROWSER_CONTEXT *Context)
     // Don't fail if FormBrowser2 is not available yet
     
     // Initialize NVRAM manager
-    Context->NvramManager = AllocateZeroPool(sizeof(NVRAM_MANAGER));
+    Context->NvramManager = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(NVRAM_MANAGER));
     if (Context->NvramManager == NULL)
         return EFI_OUT_OF_RESOURCES;
     
@@ -74,7 +74,7 @@ EFI_STATUS HiiBrowserInitialize(HII_BROWSER_CONTEXT *Context)
     if (EFI_ERROR(Status))
     {
         Print(L"Failed to initialize NVRAM manager: %r\n", Status);
-        FreePool(Context->NvramManager);
+        TaggedFreePool(Context->NvramManager);
         Context->NvramManager = NULL;
         return Status;
     }
@@ -88,7 +88,7 @@ EFI_STATUS HiiBrowserInitialize(HII_BROWSER_CONTEXT *Context)
     }
     
     // Initialize configuration database
-    Context->Database = AllocateZeroPool(sizeof(DATABASE_CONTEXT));
+    Context->Database = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(DATABASE_CONTEXT));
     if (Context->Database == NULL)
     {
         Print(L"Warning: Could not allocate database context\n");
@@ -100,7 +100,7 @@ EFI_STATUS HiiBrowserInitialize(HII_BROWSER_CONTEXT *Context)
         if (EFI_ERROR(Status))
         {
             Print(L"Warning: Failed to initialize database: %r\n", Status);
-            FreePool(Context->Database);
+            TaggedFreePool(Context->Database);
             Context->Database = NULL;
             // Continue anyway
         }
@@ -113,183 +113,12 @@ EFI_STATUS HiiBrowserInitialize(HII_BROWSER_CONTEXT *Context)
     return EFI_SUCCESS;
 }
 
-/**
- * Parse IFR package to extract real form information
- */
-STATIC EFI_STATUS ParseIfrPackage(
-    HII_BROWSER_CONTEXT *Context,
-    EFI_HII_HANDLE HiiHandle,
-    UINT8 *IfrData,
-    UINTN IfrSize,
-    HII_FORM_INFO **FormList,
-    UINTN *FormCount
-)
-{
-    if (IfrData == NULL || IfrSize == 0 || FormList == NULL || FormCount == NULL)
-        return EFI_INVALID_PARAMETER;
-    
-    UINT8 *Data = IfrData;
-    UINTN Offset = 0;
-    HII_FORM_INFO *Forms = NULL;
-    UINTN Count = 0;
-    UINTN Capacity = 10;  // Initial capacity
-    
-    EFI_GUID CurrentFormSetGuid = {0};
-    UINT16 CurrentFormId = 0;
-    BOOLEAN InSuppressIf = FALSE;
-    
-    // Allocate initial form array
-    Forms = AllocateZeroPool(sizeof(HII_FORM_INFO) * Capacity);
-    if (Forms == NULL)
-        return EFI_OUT_OF_RESOURCES;
-    
-    // Parse IFR opcodes
-    while (Offset < IfrSize)
-    {
-        if (Offset + sizeof(EFI_IFR_OP_HEADER) > IfrSize)
-            break;
-        
-        EFI_IFR_OP_HEADER *OpHeader = (EFI_IFR_OP_HEADER *)&Data[Offset];
-        
-        if (OpHeader->Length == 0 || OpHeader->Length > IfrSize - Offset)
-            break;
-        
-        switch (OpHeader->OpCode)
-        {
-            case EFI_IFR_FORM_SET_OP:
-            {
-                if (Offset + sizeof(EFI_IFR_FORM_SET) <= IfrSize)
-                {
-                    EFI_IFR_FORM_SET *FormSet = (EFI_IFR_FORM_SET *)OpHeader;
-                    CopyMem(&CurrentFormSetGuid, &FormSet->Guid, sizeof(EFI_GUID));
-                }
-                break;
-            }
-            
-            case EFI_IFR_FORM_OP:
-            {
-                if (Offset + sizeof(EFI_IFR_FORM) <= IfrSize)
-                {
-                    EFI_IFR_FORM *Form = (EFI_IFR_FORM *)OpHeader;
-                    CurrentFormId = Form->FormId;
-                    
-                    // Get form title string
-                    EFI_STRING_ID TitleStringId = Form->FormTitle;
-                    CHAR16 *TitleStr = NULL;
-                    
-                    if (Context->HiiDatabase != NULL)
-                    {
-                        EFI_HII_STRING_PROTOCOL *HiiString = NULL;
-                        EFI_STATUS Status = gBS->LocateProtocol(
-                            &gEfiHiiStringProtocolGuid,
-                            NULL,
-                            (VOID **)&HiiString
-                        );
-                        
-                        if (!EFI_ERROR(Status) && HiiString != NULL)
-                        {
-                            UINTN StringSize = 0;
-                            HiiString->GetString(
-                                HiiString,
-                                "en-US",
-                                HiiHandle,
-                                TitleStringId,
-                                NULL,
-                                &StringSize,
-                                NULL
-                            );
-                            
-                            if (StringSize > 0)
-                            {
-                                TitleStr = AllocateZeroPool(StringSize);
-                                if (TitleStr != NULL)
-                                {
-                                    HiiString->GetString(
-                                        HiiString,
-                                        "en-US",
-                                        HiiHandle,
-                                        TitleStringId,
-                                        TitleStr,
-                                        &StringSize,
-                                        NULL
-                                    );
-                                }
-                            }
-                        }
-                    }
-                    
-                    // Add form to list
-                    if (Count >= Capacity)
-                    {
-                        // Expand array
-                        Capacity *= 2;
-                        HII_FORM_INFO *NewForms = AllocateZeroPool(sizeof(HII_FORM_INFO) * Capacity);
-                        if (NewForms != NULL)
-                        {
-                            CopyMem(NewForms, Forms, sizeof(HII_FORM_INFO) * Count);
-                            FreePool(Forms);
-                            Forms = NewForms;
-                        }
-                        else
-                        {
-                            if (TitleStr != NULL)
-                                FreePool(TitleStr);
-                            break;  // Out of memory
-                        }
-                    }
-                    
-                    // Fill form info
-                    Forms[Count].HiiHandle = HiiHandle;
-                    CopyMem(&Forms[Count].FormSetGuid, &CurrentFormSetGuid, sizeof(EFI_GUID));
-                    Forms[Count].FormId = CurrentFormId;
-                    
-                    if (TitleStr != NULL)
-                    {
-                        Forms[Count].Title = TitleStr;
-                    }
-                    else
-                    {
-                        // Fallback title
-                        Forms[Count].Title = AllocateCopyPool(StrSize(L"BIOS Form"), L"BIOS Form");
-                    }
-                    
-                    Forms[Count].IsHidden = InSuppressIf;
-                    
-                    // Detect vendor and category
-                    Forms[Count].Vendor = DetectVendor(Forms[Count].Title, &CurrentFormSetGuid);
-                    Forms[Count].CategoryFlags = DetectFormCategory(Forms[Count].Title);
-                    
-                    Count++;
-                }
-                break;
-            }
-            
-            case EFI_IFR_SUPPRESS_IF_OP:
-            {
-                // NEW: Ignore SUPPRESS_IF - always show all forms
-                // InSuppressIf = TRUE;  // DISABLED per requirements
-                break;
-            }
-            
-            case EFI_IFR_END_OP:
-            {
-                // End of suppress/grayout scope
-                InSuppressIf = FALSE;
-                break;
-            }
-        }
-        
-        Offset += OpHeader->Length;
-    }
-    
-    *FormList = Forms;
-    *FormCount = Count;
-    
-    return EFI_SUCCESS;
-}
-
 /**
  * Enumerate all HII forms in the system
+ *
+ * Each package list is exported once and kept; every IFR package in it is
+ * indexed once, and forms remember their package and node so opening a form
+ * later is an index walk.
  */
 EFI_STATUS HiiBrowserEnumerateForms(HII_BROWSER_CONTEXT *Context)
 {
@@ -311,7 +140,7 @@ EFI_STATUS HiiBrowserEnumerateForms(HII_BROWSER_CONTEXT *Context)
     
     if (Status == EFI_BUFFER_TOO_SMALL)
     {
-        HiiHandles = AllocateZeroPool(HandleCount * sizeof(EFI_HII_HANDLE));
+        HiiHandles = TaggedAllocateZeroPool(POOL_TAG_HII, HandleCount);
         if (HiiHandles == NULL)
             return EFI_OUT_OF_RESOURCES;
         
@@ -327,10 +156,13 @@ EFI_STATUS HiiBrowserEnumerateForms(HII_BROWSER_CONTEXT *Context)
     if (EFI_ERROR(Status))
     {
         if (HiiHandles != NULL)
-            FreePool(HiiHandles);
+            TaggedFreePool(HiiHandles);
         return Status;
     }
     
+    // ListPackageLists works in bytes
+    HandleCount /= sizeof(EFI_HII_HANDLE);
+    
     Print(L"Found %d HII package lists\n\r", HandleCount);
     
     // Parse each HII package to extract real forms
@@ -338,11 +170,14 @@ EFI_STATUS HiiBrowserEnumerateForms(HII_BROWSER_CONTEXT *Context)
     HII_FORM_INFO *AllForms = NULL;
     UINTN AllFormsCapacity = HandleCount * 10;  // Estimate
     
-    AllForms = AllocateZeroPool(sizeof(HII_FORM_INFO) * AllFormsCapacity);
-    if (AllForms == NULL)
+    AllForms = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_FORM_INFO) * AllFormsCapacity);
+    Context->PackageLists = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(EFI_HII_PACKAGE_LIST_HEADER *) * HandleCount);
+    if (AllForms == NULL || Context->PackageLists == NULL)
     {
+        if (AllForms != NULL)
+            TaggedFreePool(AllForms);
         if (HiiHandles != NULL)
-            FreePool(HiiHandles);
+            TaggedFreePool(HiiHandles);
         return EFI_OUT_OF_RESOURCES;
     }
     
@@ -352,78 +187,85 @@ EFI_STATUS HiiBrowserEnumerateForms(HII_BROWSER_CONTEXT *Context)
         UINTN BufferSize = 0;
         EFI_HII_PACKAGE_LIST_HEADER *PackageList = NULL;
         
-        Status = Context->HiiDatabase->ExportPackageLists(
+        Status = gFwCalls.ExportPackageLists(
             Context->HiiDatabase,
             HiiHandles[i],
             &BufferSize,
             PackageList
         );
         
-        if (Status == EFI_BUFFER_TOO_SMALL)
+        if (Status != EFI_BUFFER_TOO_SMALL)
+            continue;
+        
+        PackageList = TaggedAllocateZeroPool(POOL_TAG_HII, BufferSize);
+        if (PackageList == NULL)
+            continue;
+        
+        Status = gFwCalls.ExportPackageLists(
+            Context->HiiDatabase,
+            HiiHandles[i],
+            &BufferSize,
+            PackageList
+        );
+        
+        if (EFI_ERROR(Status) || PackageList->PackageLength > BufferSize)
+        {
+            TaggedFreePool(PackageList);
+            continue;
+        }
+        
+        // The context owns the exported list from here on
+        Context->PackageLists[Context->PackageListCount++] = PackageList;
+        
+        // Index IFR packages within this package list
+        UINT8 *PackageData = (UINT8 *)PackageList + sizeof(EFI_HII_PACKAGE_LIST_HEADER);
+        UINTN PackageOffset = 0;
+        UINTN TotalPackageSize = PackageList->PackageLength - sizeof(EFI_HII_PACKAGE_LIST_HEADER);
+        
+        while (PackageOffset + sizeof(EFI_HII_PACKAGE_HEADER) <= TotalPackageSize)
         {
-            PackageList = AllocateZeroPool(BufferSize);
-            if (PackageList != NULL)
+            EFI_HII_PACKAGE_HEADER *PackageHeader = (EFI_HII_PACKAGE_HEADER *)&PackageData[PackageOffset];
+            
+            if (PackageHeader->Length < sizeof(EFI_HII_PACKAGE_HEADER) ||
+                PackageHeader->Length > TotalPackageSize - PackageOffset)
+                break;
+            
+            // Check if this is an IFR package
+            if ((PackageHeader->Type & 0x7F) == EFI_HII_PACKAGE_FORMS)
             {
-                Status = Context->HiiDatabase->ExportPackageLists(
-                    Context->HiiDatabase,
-                    HiiHandles[i],
-                    &BufferSize,
-                    PackageList
-                );
+                UINT8 *IfrData = (UINT8 *)PackageHeader + sizeof(EFI_HII_PACKAGE_HEADER);
+                UINTN IfrSize = PackageHeader->Length - sizeof(EFI_HII_PACKAGE_HEADER);
+                UINTN PackageIndex;
+                
+                HII_FORM_INFO *FormList = NULL;
+                UINTN FormCount = 0;
+                
+                Status = HiiBrowserAddIfrPackage(Context, HiiHandles[i], IfrData, IfrSize, &PackageIndex);
+                if (!EFI_ERROR(Status))
+                    Status = ParseIfrPackage(Context, PackageIndex, &FormList, &FormCount);
                 
                 if (!EFI_ERROR(Status))
                 {
-                    // Parse IFR packages within this package list
-                    UINT8 *PackageData = (UINT8 *)PackageList + sizeof(EFI_HII_PACKAGE_LIST_HEADER);
-                    UINTN PackageOffset = 0;
-                    UINTN TotalPackageSize = PackageList->PackageLength - sizeof(EFI_HII_PACKAGE_LIST_HEADER);
-                    
-                    while (PackageOffset < TotalPackageSize)
+                    // Add to overall list
+                    for (UINTN j = 0; j < FormCount; j++)
                     {
-                        EFI_HII_PACKAGE_HEADER *PackageHeader = (EFI_HII_PACKAGE_HEADER *)&PackageData[PackageOffset];
-                        
-                        if (PackageHeader->Length == 0)
-                            break;
-                        
-                        // Check if this is an IFR package
-                        if ((PackageHeader->Type & 0x7F) == EFI_HII_PACKAGE_FORMS)
+                        if (TotalFormCount < AllFormsCapacity)
                         {
-                            // Parse IFR data
-                            UINT8 *IfrData = (UINT8 *)PackageHeader + sizeof(EFI_HII_PACKAGE_HEADER);
-                            UINTN IfrSize = PackageHeader->Length - sizeof(EFI_HII_PACKAGE_HEADER);
-                            
-                            HII_FORM_INFO *FormList = NULL;
-                            UINTN FormCount = 0;
-                            
-                            Status = ParseIfrPackage(
-                                Context,
-                                HiiHandles[i],
-                                IfrData,
-                                IfrSize,
-                                &FormList,
-                                &FormCount
-                            );
-                            
-                            if (!EFI_ERROR(Status) && FormCount > 0)
-                            {
-                                // Add to overall list
-                                for (UINTN j = 0; j < FormCount && TotalFormCount < AllFormsCapacity; j++)
-                                {
-                                    CopyMem(&AllForms[TotalFormCount], &FormList[j], sizeof(HII_FORM_INFO));
-                                    TotalFormCount++;
-                                }
-                                
-                                if (FormList != NULL)
-                                    FreePool(FormList);
-                            }
+                            CopyMem(&AllForms[TotalFormCount], &FormList[j], sizeof(HII_FORM_INFO));
+                            TotalFormCount++;
+                        }
+                        else if (FormList[j].Title != NULL)
+                        {
+                            TaggedFreePool(FormList[j].Title);
                         }
-                        
-                        PackageOffset += PackageHeader->Length;
                     }
+                    
+                    if (FormList != NULL)
+                        TaggedFreePool(FormList);
                 }
-                
-                FreePool(PackageList);
             }
+            
+            PackageOffset += PackageHeader->Length;
         }
     }
     
@@ -435,38 +277,37 @@ EFI_STATUS HiiBrowserEnumerateForms(HII_BROWSER_CONTEXT *Context)
     
     // Always free HiiHandles after use
     if (HiiHandles != NULL)
-        FreePool(HiiHandles);
+        TaggedFreePool(HiiHandles);
     
     return EFI_SUCCESS;
 }
 
 /**
- * Parse questions from IFR data for a specific form
+ * Parse questions of one form by walking its subtree in the IFR index
  */
 STATIC EFI_STATUS ParseFormQuestions(
     HII_BROWSER_CONTEXT *Context,
     EFI_HII_HANDLE HiiHandle,
-    UINT16 FormId,
-    UINT8 *IfrData,
-    UINTN IfrSize,
+    IFR_INDEX *Index,
+    UINTN FormNode,
     HII_QUESTION_INFO **QuestionList,
     UINTN *QuestionCount
 )
 {
-    if (IfrData == NULL || IfrSize == 0 || QuestionList == NULL || QuestionCount == NULL)
+    if (Index == NULL || FormNode >= Index->Count || QuestionList == NULL || QuestionCount == NULL)
         return EFI_INVALID_PARAMETER;
     
-    UINT8 *Data = IfrData;
+    UINT8 *Data = Index->Data;
+    UINTN IfrSize = Index->Size;
     UINTN Offset = 0;
     HII_QUESTION_INFO *Questions = NULL;
     UINTN Count = 0;
     UINTN Capacity = 20;  // Initial capacity
-    BOOLEAN InTargetForm = FALSE;
-    BOOLEAN InSuppressIf = FALSE;
     BOOLEAN InGrayoutIf = FALSE;
+    UINTN FormEnd = IfrIndexScopeEnd(Index, FormNode);
     
     // Allocate initial question array
-    Questions = AllocateZeroPool(sizeof(HII_QUESTION_INFO) * Capacity);
+    Questions = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_QUESTION_INFO) * Capacity);
     if (Questions == NULL)
         return EFI_OUT_OF_RESOURCES;
     
@@ -478,65 +319,29 @@ STATIC EFI_STATUS ParseFormQuestions(
         (VOID **)&HiiString
     );
     
-    // Parse IFR opcodes
-    while (Offset < IfrSize)
+    // Walk the opcodes inside the form's scope
+    for (UINTN Node = FormNode + 1; Node < FormEnd; Node++)
     {
-        if (Offset + sizeof(EFI_IFR_OP_HEADER) > IfrSize)
-            break;
-        
+        Offset = Index->Nodes[Node].Offset;
         EFI_IFR_OP_HEADER *OpHeader = (EFI_IFR_OP_HEADER *)&Data[Offset];
         
-        if (OpHeader->Length == 0 || OpHeader->Length > IfrSize - Offset)
-            break;
+        // SUPPRESS_IF is ignored (always show); GRAY_OUT_IF is still tracked
+        InGrayoutIf = IfrIndexInScopeOf(Index, Node, EFI_IFR_GRAY_OUT_IF_OP, FormNode);
         
         switch (OpHeader->OpCode)
         {
-            case EFI_IFR_FORM_OP:
-            {
-                if (Offset + sizeof(EFI_IFR_FORM) <= IfrSize)
-                {
-                    EFI_IFR_FORM *Form = (EFI_IFR_FORM *)OpHeader;
-                    InTargetForm = (Form->FormId == FormId);
-                }
-                break;
-            }
-            
-            case EFI_IFR_END_OP:
-            {
-                // End of form or suppress scope
-                if ((OpHeader->Scope) == 0)
-                {
-                    InSuppressIf = FALSE;
-                    InGrayoutIf = FALSE;
-                }
-                break;
-            }
-            
-            case EFI_IFR_SUPPRESS_IF_OP:
-                // NEW: Ignore SUPPRESS_IF - always show all options
-                // InSuppressIf = TRUE;  // DISABLED per requirements
-                break;
-            
-            case EFI_IFR_GRAY_OUT_IF_OP:
-                // Still track grayout state (not suppressed per requirements)
-                InGrayoutIf = TRUE;
-                break;
-            
             // TEXT opcode - Display read-only information
             case EFI_IFR_TEXT_OP:
             {
-                if (!InTargetForm)
-                    break;
-                
                 // Check capacity
                 if (Count >= Capacity)
                 {
                     Capacity *= 2;
-                    HII_QUESTION_INFO *NewQuestions = AllocateZeroPool(sizeof(HII_QUESTION_INFO) * Capacity);
+                    HII_QUESTION_INFO *NewQuestions = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_QUESTION_INFO) * Capacity);
                     if (NewQuestions != NULL)
                     {
                         CopyMem(NewQuestions, Questions, sizeof(HII_QUESTION_INFO) * Count);
-                        FreePool(Questions);
+                        TaggedFreePool(Questions);
                         Questions = NewQuestions;
                     }
                 }
@@ -555,15 +360,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                     if (!EFI_ERROR(Status) && HiiString != NULL && Text->Statement.Prompt != 0)
                     {
                         UINTN StringSize = 0;
-                        HiiString->GetString(HiiString, "en-US", HiiHandle, Text->Statement.Prompt, NULL, &StringSize, NULL);
+                        gFwCalls.GetString(HiiString, "en-US", HiiHandle, Text->Statement.Prompt, NULL, &StringSize, NULL);
                         
                         if (StringSize > 0)
                         {
-                            Question->Prompt = AllocateZeroPool(StringSize);
+                            Question->Prompt = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                             if (Question->Prompt != NULL)
                             {
-                                HiiString->GetString(HiiString, "en-US", HiiHandle, Text->Statement.Prompt,
-                                                    Question->Prompt, &StringSize, NULL);
+                                gFwCalls.GetString(HiiString, "en-US", HiiHandle, Text->Statement.Prompt,
+                                                  Question->Prompt, &StringSize, NULL);
                             }
                         }
                     }
@@ -572,15 +377,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                     if (!EFI_ERROR(Status) && HiiString != NULL && Text->TextTwo != 0)
                     {
                         UINTN StringSize = 0;
-                        HiiString->GetString(HiiString, "en-US", HiiHandle, Text->TextTwo, NULL, &StringSize, NULL);
+                        gFwCalls.GetString(HiiString, "en-US", HiiHandle, Text->TextTwo, NULL, &StringSize, NULL);
                         
                         if (StringSize > 0)
                         {
-                            Question->HelpText = AllocateZeroPool(StringSize);
+                            Question->HelpText = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                             if (Question->HelpText != NULL)
                             {
-                                HiiString->GetString(HiiString, "en-US", HiiHandle, Text->TextTwo,
-                                                    Question->HelpText, &StringSize, NULL);
+                                gFwCalls.GetString(HiiString, "en-US", HiiHandle, Text->TextTwo,
+                                                  Question->HelpText, &StringSize, NULL);
                             }
                         }
                     }
@@ -594,18 +399,15 @@ STATIC EFI_STATUS ParseFormQuestions(
             // SUBTITLE opcode - Section headers
             case EFI_IFR_SUBTITLE_OP:
             {
-                if (!InTargetForm)
-                    break;
-                
                 // Check capacity
                 if (Count >= Capacity)
                 {
                     Capacity *= 2;
-                    HII_QUESTION_INFO *NewQuestions = AllocateZeroPool(sizeof(HII_QUESTION_INFO) * Capacity);
+                    HII_QUESTION_INFO *NewQuestions = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_QUESTION_INFO) * Capacity);
                     if (NewQuestions != NULL)
                     {
                         CopyMem(NewQuestions, Questions, sizeof(HII_QUESTION_INFO) * Count);
-                        FreePool(Questions);
+                        TaggedFreePool(Questions);
                         Questions = NewQuestions;
                     }
                 }
@@ -623,15 +425,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                     if (!EFI_ERROR(Status) && HiiString != NULL && Subtitle->Statement.Prompt != 0)
                     {
                         UINTN StringSize = 0;
-                        HiiString->GetString(HiiString, "en-US", HiiHandle, Subtitle->Statement.Prompt, NULL, &StringSize, NULL);
+                        gFwCalls.GetString(HiiString, "en-US", HiiHandle, Subtitle->Statement.Prompt, NULL, &StringSize, NULL);
                         
                         if (StringSize > 0)
                         {
-                            Question->Prompt = AllocateZeroPool(StringSize);
+                            Question->Prompt = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                             if (Question->Prompt != NULL)
                             {
-                                HiiString->GetString(HiiString, "en-US", HiiHandle, Subtitle->Statement.Prompt,
-                                                    Question->Prompt, &StringSize, NULL);
+                                gFwCalls.GetString(HiiString, "en-US", HiiHandle, Subtitle->Statement.Prompt,
+                                                  Question->Prompt, &StringSize, NULL);
                             }
                         }
                     }
@@ -645,18 +447,15 @@ STATIC EFI_STATUS ParseFormQuestions(
             // REF opcode - Form references (submenus)
             case EFI_IFR_REF_OP:
             {
-                if (!InTargetForm)
-                    break;
-                
                 // Check capacity
                 if (Count >= Capacity)
                 {
                     Capacity *= 2;
-                    HII_QUESTION_INFO *NewQuestions = AllocateZeroPool(sizeof(HII_QUESTION_INFO) * Capacity);
+                    HII_QUESTION_INFO *NewQuestions = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_QUESTION_INFO) * Capacity);
                     if (NewQuestions != NULL)
                     {
                         CopyMem(NewQuestions, Questions, sizeof(HII_QUESTION_INFO) * Count);
-                        FreePool(Questions);
+                        TaggedFreePool(Questions);
                         Questions = NewQuestions;
                     }
                 }
@@ -677,15 +476,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                     if (!EFI_ERROR(Status) && HiiString != NULL && Ref->Question.Header.Prompt != 0)
                     {
                         UINTN StringSize = 0;
-                        HiiString->GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Prompt, NULL, &StringSize, NULL);
+                        gFwCalls.GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Prompt, NULL, &StringSize, NULL);
                         
                         if (StringSize > 0)
                         {
-                            Question->Prompt = AllocateZeroPool(StringSize);
+                            Question->Prompt = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                             if (Question->Prompt != NULL)
                             {
-                                HiiString->GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Prompt,
-                                                    Question->Prompt, &StringSize, NULL);
+                                gFwCalls.GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Prompt,
+                                                  Question->Prompt, &StringSize, NULL);
                             }
                         }
                     }
@@ -694,15 +493,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                     if (!EFI_ERROR(Status) && HiiString != NULL && Ref->Question.Header.Help != 0)
                     {
                         UINTN StringSize = 0;
-                        HiiString->GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Help, NULL, &StringSize, NULL);
+                        gFwCalls.GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Help, NULL, &StringSize, NULL);
                         
                         if (StringSize > 0)
                         {
-                            Question->HelpText = AllocateZeroPool(StringSize);
+                            Question->HelpText = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                             if (Question->HelpText != NULL)
                             {
-                                HiiString->GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Help,
-                                                    Question->HelpText, &StringSize, NULL);
+                                gFwCalls.GetString(HiiString, "en-US", HiiHandle, Ref->Question.Header.Help,
+                                                  Question->HelpText, &StringSize, NULL);
                             }
                         }
                     }
@@ -716,18 +515,15 @@ STATIC EFI_STATUS ParseFormQuestions(
             // ACTION opcode - Action buttons
             case EFI_IFR_ACTION_OP:
             {
-                if (!InTargetForm)
-                    break;
-                
                 // Check capacity
                 if (Count >= Capacity)
                 {
                     Capacity *= 2;
-                    HII_QUESTION_INFO *NewQuestions = AllocateZeroPool(sizeof(HII_QUESTION_INFO) * Capacity);
+                    HII_QUESTION_INFO *NewQuestions = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_QUESTION_INFO) * Capacity);
                     if (NewQuestions != NULL)
                     {
                         CopyMem(NewQuestions, Questions, sizeof(HII_QUESTION_INFO) * Count);
-                        FreePool(Questions);
+                        TaggedFreePool(Questions);
                         Questions = NewQuestions;
                     }
                 }
@@ -746,15 +542,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                     if (!EFI_ERROR(Status) && HiiString != NULL && Action->Question.Header.Prompt != 0)
                     {
                         UINTN StringSize = 0;
-                        HiiString->GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Prompt, NULL, &StringSize, NULL);
+                        gFwCalls.GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Prompt, NULL, &StringSize, NULL);
                         
                         if (StringSize > 0)
                         {
-                            Question->Prompt = AllocateZeroPool(StringSize);
+                            Question->Prompt = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                             if (Question->Prompt != NULL)
                             {
-                                HiiString->GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Prompt,
-                                                    Question->Prompt, &StringSize, NULL);
+                                gFwCalls.GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Prompt,
+                                                  Question->Prompt, &StringSize, NULL);
                             }
                         }
                     }
@@ -763,15 +559,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                     if (!EFI_ERROR(Status) && HiiString != NULL && Action->Question.Header.Help != 0)
                     {
                         UINTN StringSize = 0;
-                        HiiString->GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Help, NULL, &StringSize, NULL);
+                        gFwCalls.GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Help, NULL, &StringSize, NULL);
                         
                         if (StringSize > 0)
                         {
-                            Question->HelpText = AllocateZeroPool(StringSize);
+                            Question->HelpText = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                             if (Question->HelpText != NULL)
                             {
-                                HiiString->GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Help,
-                                                    Question->HelpText, &StringSize, NULL);
+                                gFwCalls.GetString(HiiString, "en-US", HiiHandle, Action->Question.Header.Help,
+                                                  Question->HelpText, &StringSize, NULL);
                             }
                         }
                     }
@@ -788,18 +584,15 @@ STATIC EFI_STATUS ParseFormQuestions(
             case EFI_IFR_NUMERIC_OP:
             case EFI_IFR_STRING_OP:
             {
-                if (!InTargetForm)
-                    break;
-                
                 // Check capacity
                 if (Count >= Capacity)
                 {
                     Capacity *= 2;
-                    HII_QUESTION_INFO *NewQuestions = AllocateZeroPool(sizeof(HII_QUESTION_INFO) * Capacity);
+                    HII_QUESTION_INFO *NewQuestions = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_QUESTION_INFO) * Capacity);
                     if (NewQuestions != NULL)
                     {
                         CopyMem(NewQuestions, Questions, sizeof(HII_QUESTION_INFO) * Count);
-                        FreePool(Questions);
+                        TaggedFreePool(Questions);
                         Questions = NewQuestions;
                     }
                 }
@@ -892,37 +685,37 @@ STATIC EFI_STATUS ParseFormQuestions(
                         if (!EFI_ERROR(Status) && HiiString != NULL && PromptId != 0)
                         {
                             UINTN StringSize = 0;
-                            HiiString->GetString(HiiString, "en-US", HiiHandle, PromptId, NULL, &StringSize, NULL);
+                            gFwCalls.GetString(HiiString, "en-US", HiiHandle, PromptId, NULL, &StringSize, NULL);
                             
                             if (StringSize > 0)
                             {
-                                Question->Prompt = AllocateZeroPool(StringSize);
+                                Question->Prompt = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                                 if (Question->Prompt != NULL)
                                 {
-                                    HiiString->GetString(HiiString, "en-US", HiiHandle, PromptId,
-                                                        Question->Prompt, &StringSize, NULL);
+                                    gFwCalls.GetString(HiiString, "en-US", HiiHandle, PromptId,
+                                                      Question->Prompt, &StringSize, NULL);
                                 }
                             }
                         }
                         
                         if (Question->Prompt == NULL)
                         {
-                            Question->Prompt = AllocateCopyPool(StrSize(L"BIOS Option"), L"BIOS Option");
+                            Question->Prompt = TaggedAllocateCopyPool(POOL_TAG_HII, StrSize(L"BIOS Option"), L"BIOS Option");
                         }
                         
                         // Get help string
                         if (!EFI_ERROR(Status) && HiiString != NULL && HelpId != 0)
                         {
                             UINTN StringSize = 0;
-                            HiiString->GetString(HiiString, "en-US", HiiHandle, HelpId, NULL, &StringSize, NULL);
+                            gFwCalls.GetString(HiiString, "en-US", HiiHandle, HelpId, NULL, &StringSize, NULL);
                             
                             if (StringSize > 0)
                             {
-                                Question->HelpText = AllocateZeroPool(StringSize);
+                                Question->HelpText = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                                 if (Question->HelpText != NULL)
                                 {
-                                    HiiString->GetString(HiiString, "en-US", HiiHandle, HelpId,
-                                                        Question->HelpText, &StringSize, NULL);
+                                    gFwCalls.GetString(HiiString, "en-US", HiiHandle, HelpId,
+                                                      Question->HelpText, &StringSize, NULL);
                                 }
                             }
                         }
@@ -946,18 +739,18 @@ STATIC EFI_STATUS ParseFormQuestions(
                     // Expand options array if needed
                     if (Question->Options == NULL)
                     {
-                        Question->Options = AllocateZeroPool(sizeof(HII_OPTION_INFO) * 4);
+                        Question->Options = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_OPTION_INFO) * 4);
                         Question->OptionCount = 0;
                     }
                     else if ((Question->OptionCount % 4) == 0 && Question->OptionCount > 0)
                     {
                         // Need to expand
                         UINTN NewCapacity = Question->OptionCount + 4;
-                        HII_OPTION_INFO *NewOptions = AllocateZeroPool(sizeof(HII_OPTION_INFO) * NewCapacity);
+                        HII_OPTION_INFO *NewOptions = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_OPTION_INFO) * NewCapacity);
                         if (NewOptions)
                         {
                             CopyMem(NewOptions, Question->Options, sizeof(HII_OPTION_INFO) * Question->OptionCount);
-                            FreePool(Question->Options);
+                            TaggedFreePool(Question->Options);
                             Question->Options = NewOptions;
                         }
                     }
@@ -970,15 +763,15 @@ STATIC EFI_STATUS ParseFormQuestions(
                         if (!EFI_ERROR(Status) && HiiString != NULL && Option->Option != 0)
                         {
                             UINTN StringSize = 0;
-                            HiiString->GetString(HiiString, "en-US", HiiHandle, Option->Option, NULL, &StringSize, NULL);
+                            gFwCalls.GetString(HiiString, "en-US", HiiHandle, Option->Option, NULL, &StringSize, NULL);
                             
                             if (StringSize > 0)
                             {
-                                Question->Options[OptIndex].Text = AllocateZeroPool(StringSize);
+                                Question->Options[OptIndex].Text = TaggedAllocateZeroPool(POOL_TAG_HII, StringSize);
                                 if (Question->Options[OptIndex].Text != NULL)
                                 {
-                                    HiiString->GetString(HiiString, "en-US", HiiHandle, Option->Option,
-                                                        Question->Options[OptIndex].Text, &StringSize, NULL);
+                                    gFwCalls.GetString(HiiString, "en-US", HiiHandle, Option->Option,
+                                                      Question->Options[OptIndex].Text, &StringSize, NULL);
                                 }
                             }
                         }
@@ -1048,14 +841,12 @@ STATIC EFI_STATUS ParseFormQuestions(
                     // Store default value
                     if (Question->DefaultValue == NULL)
                     {
-                        Question->DefaultValue = AllocateCopyPool(sizeof(UINT64), &DefaultValue);
+                        Question->DefaultValue = TaggedAllocateCopyPool(POOL_TAG_HII, sizeof(UINT64), &DefaultValue);
                     }
                 }
                 break;
             }
         }
-        
-        Offset += OpHeader->Length;
     }
     
     *QuestionList = Questions;
@@ -1077,72 +868,23 @@ EFI_STATUS HiiBrowserGetFormQuestions(
     if (Context == NULL || Form == NULL || Questions == NULL || QuestionCount == NULL)
         return EFI_INVALID_PARAMETER;
     
-    // Get the IFR package for this form's HII handle
-    UINTN BufferSize = 0;
-    EFI_HII_PACKAGE_LIST_HEADER *PackageList = NULL;
-    EFI_STATUS Status;
-    
-    Status = Context->HiiDatabase->ExportPackageLists(
-        Context->HiiDatabase,
-        Form->HiiHandle,
-        &BufferSize,
-        PackageList
-    );
+    // The form's IFR package was indexed during enumeration
+    if (Form->PackageIndex >= Context->IfrPackageCount)
+        return EFI_NOT_FOUND;
     
-    if (Status == EFI_BUFFER_TOO_SMALL)
-    {
-        PackageList = AllocateZeroPool(BufferSize);
-        if (PackageList != NULL)
-        {
-            Status = Context->HiiDatabase->ExportPackageLists(
-                Context->HiiDatabase,
-                Form->HiiHandle,
-                &BufferSize,
-                PackageList
-            );
-            
-            if (!EFI_ERROR(Status))
-            {
-                // Parse IFR packages
-                UINT8 *PackageData = (UINT8 *)PackageList + sizeof(EFI_HII_PACKAGE_LIST_HEADER);
-                UINTN PackageOffset = 0;
-                UINTN TotalPackageSize = PackageList->PackageLength - sizeof(EFI_HII_PACKAGE_LIST_HEADER);
-                
-                while (PackageOffset < TotalPackageSize)
-                {
-                    EFI_HII_PACKAGE_HEADER *PackageHeader = (EFI_HII_PACKAGE_HEADER *)&PackageData[PackageOffset];
-                    
-                    if (PackageHeader->Length == 0)
-                        break;
-                    
-                    if ((PackageHeader->Type & 0x7F) == EFI_HII_PACKAGE_FORMS)
-                    {
-                        UINT8 *IfrData = (UINT8 *)PackageHeader + sizeof(EFI_HII_PACKAGE_HEADER);
-                        UINTN IfrSize = PackageHeader->Length - sizeof(EFI_HII_PACKAGE_HEADER);
-                        
-                        Status = ParseFormQuestions(
-                            Context,
-                            Form->HiiHandle,
-                            Form->FormId,
-                            IfrData,
-                            IfrSize,
-                            Questions,
-                            QuestionCount
-                        );
-                        
-                        FreePool(PackageList);
-                        return Status;
-                    }
-                    
-                    PackageOffset += PackageHeader->Length;
-                }
-            }
-            
-            FreePool(PackageList);
-        }
-    }
+    HII_IFR_PACKAGE *Package = &Context->IfrPackages[Form->PackageIndex];
+    if (Form->FormNode >= Package->Index.Count ||
+        Package->Index.Nodes[Form->FormNode].OpCode != EFI_IFR_FORM_OP)
+        return EFI_NOT_FOUND;
     
-    return EFI_NOT_FOUND;
+    return ParseFormQuestions(
+        Context,
+        Package->HiiHandle,
+        &Package->Index,
+        Form->FormNode,
+        Questions,
+        QuestionCount
+    );
 }
 
 /**
@@ -1181,7 +923,7 @@ EFI_STATUS HiiBrowserCallback_OpenForm(MENU_ITEM *Item, VOID *Context)
     if (QuestionsPage == NULL)
     {
         if (Questions)
-            FreePool(Questions);
+            TaggedFreePool(Questions);
         MenuShowMessage(MenuCtx, L"Error", L"Failed to create questions menu!");
         return EFI_OUT_OF_RESOURCES;
     }
@@ -1337,7 +1079,7 @@ MENU_PAGE *HiiBrowserCreateQuestionsMenu(
         }
         
         // Allocate and copy the title
-        CHAR16 *AllocatedTitle = AllocateCopyPool(StrSize(TitleWithValue), TitleWithValue);
+        CHAR16 *AllocatedTitle = TaggedAllocateCopyPool(POOL_TAG_HII, StrSize(TitleWithValue), TitleWithValue);
         
         MenuAddActionItem(
             Page,
@@ -1403,10 +1145,10 @@ EFI_STATUS HiiBrowserGetQuestionValue(
             if (Question->VariableOffset < VarSize)
             {
                 CopyMem(Value, (UINT8 *)VarData + Question->VariableOffset, sizeof(UINT64));
-                FreePool(VarData);
+                TaggedFreePool(VarData);
                 return EFI_SUCCESS;
             }
-            FreePool(VarData);
+            TaggedFreePool(VarData);
         }
     }
     
@@ -1451,7 +1193,7 @@ EFI_STATUS HiiBrowserSetQuestionValue(
         {
             // Variable doesn't exist, create it
             VarSize = Question->VariableOffset + sizeof(UINT64);
-            VarData = AllocateZeroPool(VarSize);
+            VarData = TaggedAllocateZeroPool(POOL_TAG_HII, VarSize);
             if (!VarData)
                 return EFI_OUT_OF_RESOURCES;
         }
@@ -1468,7 +1210,7 @@ EFI_STATUS HiiBrowserSetQuestionValue(
             VarSize
         );
         
-        FreePool(VarData);
+        TaggedFreePool(VarData);
         
         if (!EFI_ERROR(Status))
         {
@@ -1730,9 +1472,9 @@ EFI_STATUS HiiBrowserEditOneOfQuestion(
             
             // Update menu item title
             if (Item->Title)
-                FreePool((VOID *)Item->Title);
+                TaggedFreePool((VOID *)Item->Title);
             
-            CHAR16 *NewTitle = AllocatePool(512 * sizeof(CHAR16));
+            CHAR16 *NewTitle = TaggedAllocatePool(POOL_TAG_HII, 512 * sizeof(CHAR16));
             if (NewTitle)
             {
                 UnicodeSPrint(NewTitle, 512 * sizeof(CHAR16), 
@@ -1856,21 +1598,21 @@ EFI_STATUS HiiBrowserEditStringQuestion(
         if (Key.UnicodeChar == CHAR_CARRIAGE_RETURN)
         {
             // Save the string
-            CHAR16 *NewString = AllocateCopyPool(StrSize(InputBuffer), InputBuffer);
+            CHAR16 *NewString = TaggedAllocateCopyPool(POOL_TAG_HII, StrSize(InputBuffer), InputBuffer);
             if (NewString != NULL)
             {
                 if (Question->CurrentValue != NULL)
                 {
-                    FreePool(Question->CurrentValue);
+                    TaggedFreePool(Question->CurrentValue);
                 }
                 Question->CurrentValue = NewString;
                 HiiBrowserSetQuestionValue(Context, Question, NewString);
                 
                 // Update menu item title
                 if (Item->Title)
-                    FreePool((VOID *)Item->Title);
+                    TaggedFreePool((VOID *)Item->Title);
                 
-                CHAR16 *NewTitle = AllocatePool(512 * sizeof(CHAR16));
+                CHAR16 *NewTitle = TaggedAllocatePool(POOL_TAG_HII, 512 * sizeof(CHAR16));
                 if (NewTitle)
                 {
                     UnicodeSPrint(NewTitle, 512 * sizeof(CHAR16), 
@@ -1943,9 +1685,9 @@ EFI_STATUS HiiBrowserCallback_EditQuestion(MENU_ITEM *Item, VOID *Context)
         {
             // Free old title and allocate new one
             if (Item->Title)
-                FreePool((VOID *)Item->Title);
+                TaggedFreePool((VOID *)Item->Title);
             
-            CHAR16 *NewTitle = AllocatePool(256 * sizeof(CHAR16));
+            CHAR16 *NewTitle = TaggedAllocatePool(POOL_TAG_HII, 256 * sizeof(CHAR16));
             if (NewTitle)
             {
                 UnicodeSPrint(NewTitle, 256 * sizeof(CHAR16), 
@@ -2033,21 +1775,35 @@ VOID HiiBrowserCleanup(HII_BROWSER_CONTEXT *Context)
         {
             HII_FORM_INFO *Form = &Context->Forms[i];
             if (Form->Title)
-                FreePool(Form->Title);
+                TaggedFreePool(Form->Title);
         }
-        FreePool(Context->Forms);
+        TaggedFreePool(Context->Forms);
+    }
+    
+    if (Context->IfrPackages)
+    {
+        for (UINTN i = 0; i < Context->IfrPackageCount; i++)
+            IfrIndexFree(&Context->IfrPackages[i].Index);
+        TaggedFreePool(Context->IfrPackages);
+    }
+    
+    if (Context->PackageLists)
+    {
+        for (UINTN i = 0; i < Context->PackageListCount; i++)
+            TaggedFreePool(Context->PackageLists[i]);
+        TaggedFreePool(Context->PackageLists);
     }
     
     if (Context->Database)
     {
         DatabaseCleanup(Context->Database);
-        FreePool(Context->Database);
+        TaggedFreePool(Context->Database);
     }
     
     if (Context->NvramManager)
     {
         NvramCleanup(Context->NvramManager);
-        FreePool(Context->NvramManager);
+        TaggedFreePool(Context->NvramManager);
     }
 }
 
@@ -2060,93 +1816,6 @@ VOID HiiBrowserCleanup(HII_BROWSER_CONTEXT *Context)
  * @param Title  Form title to categorize (NULL safe)
  * @return       Tab index (0=Main, 1=Advanced, 2=Power, 3=Boot, 4=Security, 5=Save&Exit)
  */
-/**
- * Detect vendor from form title and GUID
- */
-STATIC VENDOR_TYPE DetectVendor(CHAR16 *Title, EFI_GUID *FormSetGuid)
-{
-    if (Title == NULL)
-        return VENDOR_UNKNOWN;
-    
-    // Convert to uppercase for case-insensitive matching
-    CHAR16 Upper[MAX_TITLE_LENGTH];
-    UINTN TitleLen = StrLen(Title);
-    UINTN CopyLen = (TitleLen < MAX_TITLE_LENGTH - 1) ? TitleLen : (MAX_TITLE_LENGTH - 1);
-    
-    for (UINTN i = 0; i < CopyLen; i++)
-    {
-        if (Title[i] >= L'a' && Title[i] <= L'z')
-            Upper[i] = Title[i] - 32;
-        else
-            Upper[i] = Title[i];
-    }
-    Upper[CopyLen] = L'\0';
-    
-    // Check for HP
-    if (StrStr(Upper, KEYWORD_HP) != NULL)
-        return VENDOR_HP;
-    
-    // Check for AMD (CBS, Promontory, etc.)
-    if (StrStr(Upper, KEYWORD_AMD) != NULL || 
-        StrStr(Upper, KEYWORD_CBS) != NULL || 
-        StrStr(Upper, KEYWORD_PROMONTORY) != NULL)
-        return VENDOR_AMD;
-    
-    // Check for Intel (ME, Management Engine, etc.)
-    if (StrStr(Upper, KEYWORD_INTEL) != NULL || 
-        StrStr(Upper, KEYWORD_ME) != NULL)
-        return VENDOR_INTEL;
-    
-    return VENDOR_GENERIC;
-}
-
-/**
- * Detect form category flags (manufacturing, engineering, debug, etc.)
- */
-STATIC UINT8 DetectFormCategory(CHAR16 *Title)
-{
-    UINT8 Flags = FORM_CATEGORY_STANDARD;
-    
-    if (Title == NULL)
-        return Flags;
-    
-    // Convert to uppercase
-    CHAR16 Upper[MAX_TITLE_LENGTH];
-    UINTN TitleLen = StrLen(Title);
-    UINTN CopyLen = (TitleLen < MAX_TITLE_LENGTH - 1) ? TitleLen : (MAX_TITLE_LENGTH - 1);
-    
-    for (UINTN i = 0; i < CopyLen; i++)
-    {
-        if (Title[i] >= L'a' && Title[i] <= L'z')
-            Upper[i] = Title[i] - 32;
-        else
-            Upper[i] = Title[i];
-    }
-    Upper[CopyLen] = L'\0';
-    
-    // Check for special categories
-    if (StrStr(Upper, KEYWORD_MANUFACTURING) != NULL)
-        Flags |= FORM_CATEGORY_MANUFACTURING;
-    
-    if (StrStr(Upper, KEYWORD_ENGINEER) != NULL)
-        Flags |= FORM_CATEGORY_ENGINEERING;
-    
-    if (StrStr(Upper, KEYWORD_DEBUG) != NULL)
-        Flags |= FORM_CATEGORY_DEBUG;
-    
-    if (StrStr(Upper, KEYWORD_DEMO) != NULL)
-        Flags |= FORM_CATEGORY_DEMO;
-    
-    if (StrStr(Upper, KEYWORD_OEM) != NULL || 
-        StrStr(Upper, KEYWORD_VENDOR) != NULL)
-        Flags |= FORM_CATEGORY_OEM;
-    
-    if (StrStr(Upper, KEYWORD_HIDDEN) != NULL)
-        Flags |= FORM_CATEGORY_HIDDEN;
-    
-    return Flags;
-}
-
 /**
  * Categorize form into tab by analyzing title keywords
  */
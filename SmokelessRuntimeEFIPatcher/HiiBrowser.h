@@ -12,6 +12,7 @@
 #include <Protocol/FormBrowser2.h>
 #include "MenuUI.h"
 #include "NvramManager.h"
+#include "IfrIndex.h"
 
 // Vendor type enumeration
 typedef enum {
@@ -40,8 +41,16 @@ typedef struct {
     BOOLEAN IsHidden;       // Was this form suppressed/hidden
     VENDOR_TYPE Vendor;     // Detected vendor (HP, AMD, Intel, etc.)
     UINT8 CategoryFlags;    // Form category flags (manufacturing, engineering, etc.)
+    UINTN PackageIndex;     // Entry in HII_BROWSER_CONTEXT.IfrPackages holding this form
+    UINTN FormNode;         // FORM opcode node in that package's IFR index
 } HII_FORM_INFO;
 
+// IFR package of an exported HII package list, indexed once at enumeration
+typedef struct {
+    EFI_HII_HANDLE HiiHandle;
+    IFR_INDEX Index;        // Points into the owning entry of HII_BROWSER_CONTEXT.PackageLists
+} HII_IFR_PACKAGE;
+
 // HII OneOf Option information
 typedef struct {
     CHAR16 *Text;           // Option display text
@@ -86,6 +95,13 @@ typedef struct {
     HII_FORM_INFO *Forms;
     UINTN FormCount;
     
+    // Exported package lists and their indexed IFR packages (owned)
+    EFI_HII_PACKAGE_LIST_HEADER **PackageLists;
+    UINTN PackageListCount;
+    HII_IFR_PACKAGE *IfrPackages;
+    UINTN IfrPackageCount;
+    UINTN IfrPackageCapacity;
+    
     NVRAM_MANAGER *NvramManager;  // NVRAM manager
     DATABASE_CONTEXT *Database;   // Configuration database
     MENU_CONTEXT *MenuContext;
@@ -101,6 +117,34 @@ EFI_STATUS HiiBrowserInitialize(HII_BROWSER_CONTEXT *Context);
  */
 EFI_STATUS HiiBrowserEnumerateForms(HII_BROWSER_CONTEXT *Context);
 
+/**
+ * Index one IFR package and add it to the context
+ *
+ * @param Context       Browser context that receives the package
+ * @param HiiHandle     Handle the package was exported from
+ * @param IfrData       IFR opcode stream (must stay valid while indexed)
+ * @param IfrSize       Size of the stream
+ * @param PackageIndex  Receives the entry in Context->IfrPackages
+ * @return EFI_SUCCESS, EFI_NOT_FOUND if nothing decoded, or an index error
+ */
+EFI_STATUS HiiBrowserAddIfrPackage(
+    HII_BROWSER_CONTEXT *Context,
+    EFI_HII_HANDLE HiiHandle,
+    UINT8 *IfrData,
+    UINTN IfrSize,
+    UINTN *PackageIndex
+);
+
+/**
+ * Extract the forms of an indexed IFR package (caller frees the list and titles)
+ */
+EFI_STATUS ParseIfrPackage(
+    HII_BROWSER_CONTEXT *Context,
+    UINTN PackageIndex,
+    HII_FORM_INFO **FormList,
+    UINTN *FormCount
+);
+
 /**
  * Get questions for a specific form
  */
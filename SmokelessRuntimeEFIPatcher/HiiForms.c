@@ -0,0 +1,278 @@
+#include "HiiBrowser.h"
+#include "Constants.h"
+#include "TaggedPool.h"
+#include "FwCalls.h"
+#include <Library/BaseLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/HiiString.h>
+
+//
+// Form extraction from indexed IFR packages. Kept apart from the UI code of
+// HiiBrowser.c so the host benchmark can link it on its own.
+//
+
+STATIC VENDOR_TYPE DetectVendor(CHAR16 *Title, EFI_GUID *FormSetGuid);
+STATIC UINT8 DetectFormCategory(CHAR16 *Title);
+
+/**
+ * Helper: Get a string from the HII database (caller frees)
+ */
+STATIC CHAR16 *HiiBrowserGetString(
+    EFI_HII_STRING_PROTOCOL *HiiString,
+    EFI_HII_HANDLE HiiHandle,
+    EFI_STRING_ID StringId
+)
+{
+    CHAR16 *String = NULL;
+    UINTN StringSize = 0;
+    
+    if (HiiString == NULL || StringId == 0)
+        return NULL;
+    
+    gFwCalls.GetString(HiiString, "en-US", HiiHandle, StringId, NULL, &StringSize, NULL);
+    if (StringSize == 0)
+        return NULL;
+    
+    String = TaggedAllocateZeroPool(POOL_TAG_IFR, StringSize);
+    if (String != NULL)
+    {
+        gFwCalls.GetString(HiiString, "en-US", HiiHandle, StringId, String, &StringSize, NULL);
+    }
+    
+    return String;
+}
+
+/**
+ * Parse an indexed IFR package to extract real form information
+ */
+EFI_STATUS ParseIfrPackage(
+    HII_BROWSER_CONTEXT *Context,
+    UINTN PackageIndex,
+    HII_FORM_INFO **FormList,
+    UINTN *FormCount
+)
+{
+    if (Context == NULL || PackageIndex >= Context->IfrPackageCount || FormList == NULL || FormCount == NULL)
+        return EFI_INVALID_PARAMETER;
+    
+    HII_IFR_PACKAGE *Package = &Context->IfrPackages[PackageIndex];
+    IFR_INDEX *Index = &Package->Index;
+    HII_FORM_INFO *Forms = NULL;
+    UINTN Count = 0;
+    UINTN Capacity = 10;  // Initial capacity
+    
+    EFI_GUID CurrentFormSetGuid = {0};
+    
+    // Allocate initial form array
+    Forms = TaggedAllocateZeroPool(POOL_TAG_IFR, sizeof(HII_FORM_INFO) * Capacity);
+    if (Forms == NULL)
+        return EFI_OUT_OF_RESOURCES;
+    
+    // Get HII String Protocol once for all form titles
+    EFI_HII_STRING_PROTOCOL *HiiString = NULL;
+    gBS->LocateProtocol(&gEfiHiiStringProtocolGuid, NULL, (VOID **)&HiiString);
+    
+    // Walk the indexed opcodes
+    for (UINTN Node = 0; Node < Index->Count; Node++)
+    {
+        IFR_OP_NODE *OpNode = &Index->Nodes[Node];
+        
+        if (OpNode->OpCode == EFI_IFR_FORM_SET_OP && OpNode->Length >= sizeof(EFI_IFR_FORM_SET))
+        {
+            EFI_IFR_FORM_SET *FormSet = (EFI_IFR_FORM_SET *)IfrIndexOp(Index, Node);
+            CopyMem(&CurrentFormSetGuid, &FormSet->Guid, sizeof(EFI_GUID));
+            continue;
+        }
+        
+        if (OpNode->OpCode != EFI_IFR_FORM_OP || OpNode->Length < sizeof(EFI_IFR_FORM))
+            continue;
+        
+        EFI_IFR_FORM *Form = (EFI_IFR_FORM *)IfrIndexOp(Index, Node);
+        
+        // Get form title string
+        CHAR16 *TitleStr = HiiBrowserGetString(HiiString, Package->HiiHandle, Form->FormTitle);
+        
+        // Add form to list
+        if (Count >= Capacity)
+        {
+            // Expand array
+            Capacity *= 2;
+            HII_FORM_INFO *NewForms = TaggedAllocateZeroPool(POOL_TAG_IFR, sizeof(HII_FORM_INFO) * Capacity);
+            if (NewForms != NULL)
+            {
+                CopyMem(NewForms, Forms, sizeof(HII_FORM_INFO) * Count);
+                TaggedFreePool(Forms);
+                Forms = NewForms;
+            }
+            else
+            {
+                if (TitleStr != NULL)
+                    TaggedFreePool(TitleStr);
+                break;  // Out of memory
+            }
+        }
+        
+        // Fill form info
+        Forms[Count].HiiHandle = Package->HiiHandle;
+        CopyMem(&Forms[Count].FormSetGuid, &CurrentFormSetGuid, sizeof(EFI_GUID));
+        Forms[Count].FormId = Form->FormId;
+        Forms[Count].PackageIndex = PackageIndex;
+        Forms[Count].FormNode = Node;
+        
+        if (TitleStr != NULL)
+        {
+            Forms[Count].Title = TitleStr;
+        }
+        else
+        {
+            // Fallback title
+            Forms[Count].Title = TaggedAllocateCopyPool(POOL_TAG_IFR, StrSize(L"BIOS Form"), L"BIOS Form");
+        }
+        
+        // SUPPRESS_IF is ignored - always show all forms
+        Forms[Count].IsHidden = FALSE;
+        
+        // Detect vendor and category
+        Forms[Count].Vendor = DetectVendor(Forms[Count].Title, &CurrentFormSetGuid);
+        Forms[Count].CategoryFlags = DetectFormCategory(Forms[Count].Title);
+        
+        Count++;
+    }
+    
+    *FormList = Forms;
+    *FormCount = Count;
+    
+    return EFI_SUCCESS;
+}
+
+/**
+ * Index one IFR package and add it to the context
+ */
+EFI_STATUS HiiBrowserAddIfrPackage(
+    HII_BROWSER_CONTEXT *Context,
+    EFI_HII_HANDLE HiiHandle,
+    UINT8 *IfrData,
+    UINTN IfrSize,
+    UINTN *PackageIndex
+)
+{
+    if (Context->IfrPackageCount >= Context->IfrPackageCapacity)
+    {
+        UINTN NewCapacity = Context->IfrPackageCapacity == 0 ? 16 : Context->IfrPackageCapacity * 2;
+        HII_IFR_PACKAGE *NewPackages = TaggedAllocateZeroPool(POOL_TAG_IFR, sizeof(HII_IFR_PACKAGE) * NewCapacity);
+        if (NewPackages == NULL)
+            return EFI_OUT_OF_RESOURCES;
+        
+        if (Context->IfrPackages != NULL)
+        {
+            CopyMem(NewPackages, Context->IfrPackages, sizeof(HII_IFR_PACKAGE) * Context->IfrPackageCount);
+            TaggedFreePool(Context->IfrPackages);
+        }
+        Context->IfrPackages = NewPackages;
+        Context->IfrPackageCapacity = NewCapacity;
+    }
+    
+    HII_IFR_PACKAGE *Package = &Context->IfrPackages[Context->IfrPackageCount];
+    ZeroMem(Package, sizeof(HII_IFR_PACKAGE));
+    Package->HiiHandle = HiiHandle;
+    
+    // Keep whatever decoded before a malformed opcode, like the old byte walker did
+    EFI_STATUS Status = IfrIndexBuild(&Package->Index, IfrData, IfrSize, 0);
+    if (Package->Index.Count == 0)
+    {
+        IfrIndexFree(&Package->Index);
+        return EFI_ERROR(Status) ? Status : EFI_NOT_FOUND;
+    }
+    
+    *PackageIndex = Context->IfrPackageCount;
+    Context->IfrPackageCount++;
+    
+    return EFI_SUCCESS;
+}
+
+/**
+ * Detect vendor from form title and GUID
+ */
+STATIC VENDOR_TYPE DetectVendor(CHAR16 *Title, EFI_GUID *FormSetGuid)
+{
+    if (Title == NULL)
+        return VENDOR_UNKNOWN;
+    
+    // Convert to uppercase for case-insensitive matching
+    CHAR16 Upper[MAX_TITLE_LENGTH];
+    UINTN TitleLen = StrLen(Title);
+    UINTN CopyLen = (TitleLen < MAX_TITLE_LENGTH - 1) ? TitleLen : (MAX_TITLE_LENGTH - 1);
+    
+    for (UINTN i = 0; i < CopyLen; i++)
+    {
+        if (Title[i] >= L'a' && Title[i] <= L'z')
+            Upper[i] = Title[i] - 32;
+        else
+            Upper[i] = Title[i];
+    }
+    Upper[CopyLen] = L'\0';
+    
+    // Check for HP
+    if (StrStr(Upper, KEYWORD_HP) != NULL)
+        return VENDOR_HP;
+    
+    // Check for AMD (CBS, Promontory, etc.)
+    if (StrStr(Upper, KEYWORD_AMD) != NULL || 
+        StrStr(Upper, KEYWORD_CBS) != NULL || 
+        StrStr(Upper, KEYWORD_PROMONTORY) != NULL)
+        return VENDOR_AMD;
+    
+    // Check for Intel (ME, Management Engine, etc.)
+    if (StrStr(Upper, KEYWORD_INTEL) != NULL || 
+        StrStr(Upper, KEYWORD_ME) != NULL)
+        return VENDOR_INTEL;
+    
+    return VENDOR_GENERIC;
+}
+
+/**
+ * Detect form category flags (manufacturing, engineering, debug, etc.)
+ */
+STATIC UINT8 DetectFormCategory(CHAR16 *Title)
+{
+    UINT8 Flags = FORM_CATEGORY_STANDARD;
+    
+    if (Title == NULL)
+        return Flags;
+    
+    // Convert to uppercase
+    CHAR16 Upper[MAX_TITLE_LENGTH];
+    UINTN TitleLen = StrLen(Title);
+    UINTN CopyLen = (TitleLen < MAX_TITLE_LENGTH - 1) ? TitleLen : (MAX_TITLE_LENGTH - 1);
+    
+    for (UINTN i = 0; i < CopyLen; i++)
+    {
+        if (Title[i] >= L'a' && Title[i] <= L'z')
+            Upper[i] = Title[i] - 32;
+        else
+            Upper[i] = Title[i];
+    }
+    Upper[CopyLen] = L'\0';
+    
+    // Check for special categories
+    if (StrStr(Upper, KEYWORD_MANUFACTURING) != NULL)
+        Flags |= FORM_CATEGORY_MANUFACTURING;
+    
+    if (StrStr(Upper, KEYWORD_ENGINEER) != NULL)
+        Flags |= FORM_CATEGORY_ENGINEERING;
+    
+    if (StrStr(Upper, KEYWORD_DEBUG) != NULL)
+        Flags |= FORM_CATEGORY_DEBUG;
+    
+    if (StrStr(Upper, KEYWORD_DEMO) != NULL)
+        Flags |= FORM_CATEGORY_DEMO;
+    
+    if (StrStr(Upper, KEYWORD_OEM) != NULL || 
+        StrStr(Upper, KEYWORD_VENDOR) != NULL)
+        Flags |= FORM_CATEGORY_OEM;
+    
+    if (StrStr(Upper, KEYWORD_HIDDEN) != NULL)
+        Flags |= FORM_CATEGORY_HIDDEN;
+    
+    return Flags;
+}
@@ -0,0 +1,471 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <cpuid.h>
+#include <x86intrin.h>
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Protocol/HiiString.h>
+#include <Protocol/HiiDatabase.h>
+#include "HostShim.h"
+
+//
+// Globals normally provided by SmokelessRuntimeEFIPatcher.c and the UEFI
+// table libraries. gBS only answers LocateProtocol (with EFI_NOT_FOUND), so
+// form titles fall back to their defaults on the host. There is no gRT.
+//
+char Log[512];
+EFI_FILE *LogFile = NULL;
+BOOLEAN gHostLogEnabled = FALSE;
+
+EFI_GUID gEfiHiiStringProtocolGuid = EFI_HII_STRING_PROTOCOL_GUID;
+EFI_GUID gEfiHiiDatabaseProtocolGuid = EFI_HII_DATABASE_PROTOCOL_GUID;
+
+STATIC EFI_STATUS EFIAPI HostLocateProtocol(EFI_GUID *Protocol, VOID *Registration, VOID **Interface)
+{
+    if (Interface != NULL)
+        *Interface = NULL;
+    return EFI_NOT_FOUND;
+}
+
+STATIC EFI_BOOT_SERVICES mHostBootServices = {
+    .LocateProtocol = HostLocateProtocol
+};
+
+EFI_BOOT_SERVICES *gBS = &mHostBootServices;
+EFI_RUNTIME_SERVICES *gRT = NULL;
+
+void LogToFile(EFI_FILE *LogFile, char *String)
+{
+    if (gHostLogEnabled)
+        fputs(String, stderr);
+}
+
+/**
+ * Monotonic time in nanoseconds
+ */
+UINT64 HostTimeNs(VOID)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (UINT64)Now.tv_sec * 1000000000ULL + (UINT64)Now.tv_nsec;
+}
+
+/**
+ * Read a whole file into a pool buffer
+ */
+EFI_STATUS HostReadFile(CONST CHAR8 *Path, UINT8 **Buffer, UINTN *Size)
+{
+    FILE *File;
+    long Length;
+    UINT8 *Data;
+
+    File = fopen(Path, "rb");
+    if (File == NULL)
+        return EFI_NOT_FOUND;
+
+    if (fseek(File, 0, SEEK_END) != 0 || (Length = ftell(File)) <= 0 || fseek(File, 0, SEEK_SET) != 0)
+    {
+        fclose(File);
+        return EFI_NOT_FOUND;
+    }
+
+    Data = AllocatePool((UINTN)Length);
+    if (Data == NULL)
+    {
+        fclose(File);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    if (fread(Data, 1, (size_t)Length, File) != (size_t)Length)
+    {
+        FreePool(Data);
+        fclose(File);
+        return EFI_NOT_FOUND;
+    }
+
+    fclose(File);
+    *Buffer = Data;
+    *Size = (UINTN)Length;
+    return EFI_SUCCESS;
+}
+
+// ---- MemoryAllocationLib ----
+
+VOID *EFIAPI AllocatePool(IN UINTN AllocationSize)
+{
+    return malloc(AllocationSize != 0 ? AllocationSize : 1);
+}
+
+VOID *EFIAPI AllocateZeroPool(IN UINTN AllocationSize)
+{
+    return calloc(1, AllocationSize != 0 ? AllocationSize : 1);
+}
+
+VOID *EFIAPI AllocateCopyPool(IN UINTN AllocationSize, IN CONST VOID *Buffer)
+{
+    VOID *Copy = AllocatePool(AllocationSize);
+
+    if (Copy != NULL)
+        memcpy(Copy, Buffer, AllocationSize);
+    return Copy;
+}
+
+VOID EFIAPI FreePool(IN VOID *Buffer)
+{
+    free(Buffer);
+}
+
+// ---- BaseMemoryLib ----
+
+VOID *EFIAPI CopyMem(OUT VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length)
+{
+    return memmove(DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID *EFIAPI SetMem(OUT VOID *Buffer, IN UINTN Length, IN UINT8 Value)
+{
+    return memset(Buffer, Value, Length);
+}
+
+VOID *EFIAPI ZeroMem(OUT VOID *Buffer, IN UINTN Length)
+{
+    return memset(Buffer, 0, Length);
+}
+
+INTN EFIAPI CompareMem(IN CONST VOID *DestinationBuffer, IN CONST VOID *SourceBuffer, IN UINTN Length)
+{
+    return memcmp(DestinationBuffer, SourceBuffer, Length);
+}
+
+VOID *EFIAPI ScanMem8(IN CONST VOID *Buffer, IN UINTN Length, IN UINT8 Value)
+{
+    return Length != 0 ? memchr(Buffer, Value, Length) : NULL;
+}
+
+BOOLEAN EFIAPI CompareGuid(IN CONST GUID *Guid1, IN CONST GUID *Guid2)
+{
+    return memcmp(Guid1, Guid2, sizeof(GUID)) == 0;
+}
+
+BOOLEAN EFIAPI IsZeroGuid(IN CONST GUID *Guid)
+{
+    STATIC CONST GUID Zero;
+
+    return CompareGuid(Guid, &Zero);
+}
+
+GUID *EFIAPI CopyGuid(OUT GUID *DestinationGuid, IN CONST GUID *SourceGuid)
+{
+    memcpy(DestinationGuid, SourceGuid, sizeof(GUID));
+    return DestinationGuid;
+}
+
+// ---- BaseLib ----
+
+UINTN EFIAPI StrLen(IN CONST CHAR16 *String)
+{
+    UINTN Length = 0;
+
+    while (String[Length] != 0)
+        Length++;
+    return Length;
+}
+
+UINTN EFIAPI StrSize(IN CONST CHAR16 *String)
+{
+    return (StrLen(String) + 1) * sizeof(CHAR16);
+}
+
+CHAR16 *EFIAPI StrStr(IN CONST CHAR16 *String, IN CONST CHAR16 *SearchString)
+{
+    UINTN Length = StrLen(SearchString);
+
+    for (; *String != 0; String++)
+    {
+        if (memcmp(String, SearchString, Length * sizeof(CHAR16)) == 0)
+            return (CHAR16 *)String;
+    }
+    return Length == 0 ? (CHAR16 *)String : NULL;
+}
+
+INTN EFIAPI StrCmp(IN CONST CHAR16 *FirstString, IN CONST CHAR16 *SecondString)
+{
+    while (*FirstString != 0 && *FirstString == *SecondString)
+    {
+        FirstString++;
+        SecondString++;
+    }
+    return (INTN)*FirstString - (INTN)*SecondString;
+}
+
+INTN EFIAPI AsciiStrCmp(IN CONST CHAR8 *FirstString, IN CONST CHAR8 *SecondString)
+{
+    return strcmp(FirstString, SecondString);
+}
+
+UINT16 EFIAPI ReadUnaligned16(IN CONST UINT16 *Buffer)
+{
+    UINT16 Value;
+
+    memcpy(&Value, Buffer, sizeof(Value));
+    return Value;
+}
+
+UINT32 EFIAPI ReadUnaligned32(IN CONST UINT32 *Buffer)
+{
+    UINT32 Value;
+
+    memcpy(&Value, Buffer, sizeof(Value));
+    return Value;
+}
+
+UINT64 EFIAPI ReadUnaligned64(IN CONST UINT64 *Buffer)
+{
+    UINT64 Value;
+
+    memcpy(&Value, Buffer, sizeof(Value));
+    return Value;
+}
+
+UINT32 EFIAPI WriteUnaligned32(OUT UINT32 *Buffer, IN UINT32 Value)
+{
+    memcpy(Buffer, &Value, sizeof(Value));
+    return Value;
+}
+
+INTN EFIAPI LowBitSet64(IN UINT64 Operand)
+{
+    return Operand == 0 ? -1 : (INTN)__builtin_ctzll(Operand);
+}
+
+UINT64 EFIAPI LShiftU64(IN UINT64 Operand, IN UINTN Count)
+{
+    return Operand << Count;
+}
+
+INTN EFIAPI HighBitSet64(IN UINT64 Operand)
+{
+    return Operand == 0 ? -1 : 63 - (INTN)__builtin_clzll(Operand);
+}
+
+UINT64 EFIAPI MultU64x32(IN UINT64 Multiplicand, IN UINT32 Multiplier)
+{
+    return Multiplicand * Multiplier;
+}
+
+UINT64 EFIAPI DivU64x32(IN UINT64 Dividend, IN UINT32 Divisor)
+{
+    return Dividend / Divisor;
+}
+
+UINT64 EFIAPI DivU64x32Remainder(IN UINT64 Dividend, IN UINT32 Divisor, OUT UINT32 *Remainder OPTIONAL)
+{
+    if (Remainder != NULL)
+        *Remainder = (UINT32)(Dividend % Divisor);
+    return Dividend / Divisor;
+}
+
+UINT64 EFIAPI DivU64x64Remainder(IN UINT64 Dividend, IN UINT64 Divisor, OUT UINT64 *Remainder OPTIONAL)
+{
+    if (Remainder != NULL)
+        *Remainder = Dividend % Divisor;
+    return Dividend / Divisor;
+}
+
+UINT32 EFIAPI AsmCpuidEx(
+    IN UINT32 Index,
+    IN UINT32 SubIndex,
+    OUT UINT32 *RegisterEax,
+    OUT UINT32 *RegisterEbx,
+    OUT UINT32 *RegisterEcx,
+    OUT UINT32 *RegisterEdx)
+{
+    UINT32 Eax, Ebx, Ecx, Edx;
+
+    __cpuid_count(Index, SubIndex, Eax, Ebx, Ecx, Edx);
+    if (RegisterEax != NULL) *RegisterEax = Eax;
+    if (RegisterEbx != NULL) *RegisterEbx = Ebx;
+    if (RegisterEcx != NULL) *RegisterEcx = Ecx;
+    if (RegisterEdx != NULL) *RegisterEdx = Edx;
+    return Index;
+}
+
+UINT32 EFIAPI AsmCpuid(
+    IN UINT32 Index,
+    OUT UINT32 *RegisterEax,
+    OUT UINT32 *RegisterEbx,
+    OUT UINT32 *RegisterEcx,
+    OUT UINT32 *RegisterEdx)
+{
+    return AsmCpuidEx(Index, 0, RegisterEax, RegisterEbx, RegisterEcx, RegisterEdx);
+}
+
+UINT64 EFIAPI AsmReadTsc(VOID)
+{
+    return __rdtsc();
+}
+
+// ---- PrintLib ----
+
+/**
+ * Helper: Append one character, always leaving room for the terminator
+ */
+STATIC VOID HostPut(CHAR8 *Buffer, UINTN Size, UINTN *Length, CHAR8 Char)
+{
+    if (*Length + 1 < Size)
+        Buffer[(*Length)++] = Char;
+}
+
+STATIC VOID HostPutString(CHAR8 *Buffer, UINTN Size, UINTN *Length, CONST CHAR8 *String)
+{
+    while (*String != 0)
+        HostPut(Buffer, Size, Length, *String++);
+}
+
+STATIC CONST CHAR8 *HostStatusName(EFI_STATUS Status)
+{
+    switch (Status)
+    {
+    case EFI_SUCCESS:           return "Success";
+    case EFI_INVALID_PARAMETER: return "Invalid Parameter";
+    case EFI_UNSUPPORTED:       return "Unsupported";
+    case EFI_BUFFER_TOO_SMALL:  return "Buffer Too Small";
+    case EFI_OUT_OF_RESOURCES:  return "Out of Resources";
+    case EFI_VOLUME_CORRUPTED:  return "Volume Corrupt";
+    case EFI_NOT_FOUND:         return "Not Found";
+    default:                    return NULL;
+    }
+}
+
+/**
+ * Subset of the PrintLib format syntax used by the parsers:
+ * %a %s %c %d %u %x %X %p %r %g %%, with 0-padding, width and l/L
+ */
+STATIC UINTN HostVSPrint(CHAR8 *Buffer, UINTN Size, CONST CHAR8 *Format, VA_LIST Marker)
+{
+    UINTN Length = 0;
+    char Text[64];
+
+    if (Buffer == NULL || Size == 0)
+        return 0;
+
+    for (; *Format != 0; Format++)
+    {
+        BOOLEAN ZeroPad = FALSE;
+        BOOLEAN Long = FALSE;
+        UINTN Width = 0;
+
+        if (*Format != '%')
+        {
+            HostPut(Buffer, Size, &Length, *Format);
+            continue;
+        }
+
+        Format++;
+        if (*Format == '0')
+        {
+            ZeroPad = TRUE;
+            Format++;
+        }
+        while (*Format >= '0' && *Format <= '9')
+            Width = Width * 10 + (UINTN)(*Format++ - '0');
+        if (*Format == 'l' || *Format == 'L')
+        {
+            Long = TRUE;
+            Format++;
+        }
+
+        Text[0] = 0;
+        switch (*Format)
+        {
+        case 'a':
+            HostPutString(Buffer, Size, &Length, VA_ARG(Marker, CHAR8 *));
+            continue;
+        case 's':
+        {
+            CHAR16 *Wide = VA_ARG(Marker, CHAR16 *);
+            while (Wide != NULL && *Wide != 0)
+                HostPut(Buffer, Size, &Length, (CHAR8)*Wide++);
+            continue;
+        }
+        case 'c':
+            HostPut(Buffer, Size, &Length, (CHAR8)VA_ARG(Marker, UINTN));
+            continue;
+        case 'd':
+            if (Long)
+                snprintf(Text, sizeof(Text), "%*lld", (int)Width, (long long)VA_ARG(Marker, INT64));
+            else
+                snprintf(Text, sizeof(Text), "%*d", (int)Width, (int)VA_ARG(Marker, INT32));
+            break;
+        case 'u':
+            if (Long)
+                snprintf(Text, sizeof(Text), "%*llu", (int)Width, (unsigned long long)VA_ARG(Marker, UINT64));
+            else
+                snprintf(Text, sizeof(Text), "%*u", (int)Width, (unsigned)VA_ARG(Marker, UINT32));
+            break;
+        case 'x':
+        case 'X':
+        {
+            UINT64 Value = Long ? VA_ARG(Marker, UINT64) : VA_ARG(Marker, UINT32);
+            snprintf(Text, sizeof(Text), ZeroPad ? (*Format == 'x' ? "%0*llx" : "%0*llX") : (*Format == 'x' ? "%*llx" : "%*llX"),
+                     (int)Width, (unsigned long long)Value);
+            break;
+        }
+        case 'p':
+            snprintf(Text, sizeof(Text), "%p", VA_ARG(Marker, VOID *));
+            break;
+        case 'r':
+        {
+            EFI_STATUS Status = VA_ARG(Marker, EFI_STATUS);
+            CONST CHAR8 *Name = HostStatusName(Status);
+            if (Name != NULL)
+                snprintf(Text, sizeof(Text), "%s", Name);
+            else
+                snprintf(Text, sizeof(Text), "%llX", (unsigned long long)Status);
+            break;
+        }
+        case 'g':
+        {
+            EFI_GUID *Guid = VA_ARG(Marker, EFI_GUID *);
+            snprintf(Text, sizeof(Text), "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+                     Guid->Data1, Guid->Data2, Guid->Data3,
+                     Guid->Data4[0], Guid->Data4[1], Guid->Data4[2], Guid->Data4[3],
+                     Guid->Data4[4], Guid->Data4[5], Guid->Data4[6], Guid->Data4[7]);
+            break;
+        }
+        case '%':
+            HostPut(Buffer, Size, &Length, '%');
+            continue;
+        default:
+            if (*Format == 0)
+                Format--;
+            continue;
+        }
+
+        HostPutString(Buffer, Size, &Length, Text);
+    }
+
+    Buffer[Length] = 0;
+    return Length;
+}
+
+UINTN EFIAPI AsciiSPrint(OUT CHAR8 *StartOfBuffer, IN UINTN BufferSize, IN CONST CHAR8 *FormatString, ...)
+{
+    VA_LIST Marker;
+    UINTN Length;
+
+    VA_START(Marker, FormatString);
+    Length = HostVSPrint(StartOfBuffer, BufferSize, FormatString, Marker);
+    VA_END(Marker);
+
+    return Length;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <Uefi.h>
+
+//
+// Host (Linux) replacements for the EDK2 library pieces used by the IFR
+// parsers. Only what the parsers call is provided.
+//
+
+// Lines passed to LogToFile are echoed to stderr when TRUE
+extern BOOLEAN gHostLogEnabled;
+
+/**
+ * Monotonic time in nanoseconds
+ */
+UINT64 HostTimeNs(VOID);
+
+/**
+ * Read a whole file into a pool buffer (caller frees)
+ *
+ * @param Path          File to read
+ * @param Buffer        Receives the contents
+ * @param Size          Receives the size
+ * @return EFI_SUCCESS, EFI_NOT_FOUND or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS HostReadFile(CONST CHAR8 *Path, UINT8 **Buffer, UINTN *Size);
@@ -0,0 +1,683 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostShim.h"
+#include "../IfrParser.h"
+#include "../HiiBrowser.h"
+#include "../ByteScan.h"
+#include "../FfsWalk.h"
+#include "../StringMatch.h"
+#include "../X86Decode.h"
+#include "../TaggedPool.h"
+
+//
+// Micro-benchmark for the IFR scan paths. Every image of the corpus (dumped
+// Setup/FormBrowser modules, or a synthetic image) is restored from a pristine
+// copy before each iteration, so every run does the same work.
+//
+
+// Synthetic FormSets per MB of generated image
+#define BENCH_SYNTHETIC_FORMSETS_PER_MB 64
+
+// Hide conditions per synthetic form
+#define BENCH_SYNTHETIC_CONDITIONS 8
+
+// Variable names located by the StringMatch phase (ASCII and UTF-16 forms)
+STATIC CONST CHAR8 *mBenchVariableNames[] = {
+    "Setup", "SetupVolatile", "AMITSESetup", "PchSetup", "SaSetup", "CpuSetup",
+    "MeSetup", "SecureBootSetup", "PlatformLang", "BootOrder", "Timeout", "ConIn"
+};
+
+// Longest module name accepted by -m
+#define BENCH_MODULE_NAME_MAX 64
+
+typedef struct {
+    CONST CHAR8 *Name;
+    UINT64 Nanoseconds;
+    UINT64 Bytes;
+    UINTN Found;
+} BENCH_PHASE;
+
+enum {
+    BENCH_PARSE_IFR_DATA = 0,
+    BENCH_PATCH_PLAN_APPLY,
+    BENCH_PATCH_AMI_FORMS,
+    BENCH_PATCH_INSYDE_FORMS,
+    BENCH_PATCH_PIPELINE,
+    BENCH_STRING_MATCH,
+    BENCH_PARSE_IFR_PACKAGE,
+    BENCH_X86_WALK,
+    BENCH_PHASE_COUNT
+};
+
+typedef struct {
+    UINT32 Offset;               // Offset of the IFR stream (after the package header)
+    UINT32 Size;
+} BENCH_PACKAGE;
+
+/**
+ * Helper: Find the HII forms packages of an image
+ *
+ * In firmware the packages come from the HII database; in a dumped image
+ * they are the FORMS package headers right in front of a FormSet.
+ */
+STATIC UINTN FindFormsPackages(UINT8 *Data, UINTN Size, BENCH_PACKAGE *Packages, UINTN Max)
+{
+    UINTN Count = 0;
+    UINTN Offset = sizeof(EFI_HII_PACKAGE_HEADER);
+
+    while (Count < Max && Offset < Size)
+    {
+        UINT8 *Hit = ScanMem8(&Data[Offset], Size - Offset, EFI_IFR_FORM_SET_OP);
+        EFI_HII_PACKAGE_HEADER *Header;
+        UINTN Start;
+
+        if (Hit == NULL)
+            break;
+
+        Start = (UINTN)(Hit - Data);
+        Header = (EFI_HII_PACKAGE_HEADER *)&Data[Start - sizeof(EFI_HII_PACKAGE_HEADER)];
+        if (Header->Type == EFI_HII_PACKAGE_FORMS &&
+            Header->Length > sizeof(EFI_HII_PACKAGE_HEADER) + sizeof(EFI_IFR_FORM_SET) &&
+            Header->Length <= Size - (Start - sizeof(EFI_HII_PACKAGE_HEADER)))
+        {
+            Packages[Count].Offset = (UINT32)Start;
+            Packages[Count].Size = Header->Length - sizeof(EFI_HII_PACKAGE_HEADER);
+            Count++;
+            Offset = Start + Packages[Count - 1].Size;
+            continue;
+        }
+
+        Offset = Start + 1;
+    }
+
+    return Count;
+}
+
+/**
+ * Helper: Append one opcode to a synthetic stream
+ */
+STATIC UINT8 *EmitOp(UINT8 *Out, UINT8 OpCode, UINT8 Length, BOOLEAN Scope)
+{
+    EFI_IFR_OP_HEADER *Header = (EFI_IFR_OP_HEADER *)Out;
+
+    ZeroMem(Out, Length);
+    Header->OpCode = OpCode;
+    Header->Length = Length;
+    Header->Scope = Scope ? 1 : 0;
+    return Out + Length;
+}
+
+/**
+ * Helper: Write one synthetic forms package (FormSet, one form, hide conditions)
+ */
+STATIC UINTN EmitFormsPackage(UINT8 *Out, UINT32 Seed)
+{
+    EFI_HII_PACKAGE_HEADER *Package = (EFI_HII_PACKAGE_HEADER *)Out;
+    EFI_IFR_FORM_SET *FormSet;
+    EFI_IFR_FORM *Form;
+    UINT8 *Cursor = Out + sizeof(EFI_HII_PACKAGE_HEADER);
+    UINTN Index;
+
+    FormSet = (EFI_IFR_FORM_SET *)Cursor;
+    Cursor = EmitOp(Cursor, EFI_IFR_FORM_SET_OP, sizeof(EFI_IFR_FORM_SET) + sizeof(EFI_GUID), TRUE);
+    FormSet->Guid.Data1 = Seed | 1;
+    FormSet->Guid.Data2 = 0x5EED;
+    FormSet->FormSetTitle = 1;
+    FormSet->Flags = 1;
+    SetMem(FormSet + 1, sizeof(EFI_GUID), 0xA5);
+
+    Form = (EFI_IFR_FORM *)Cursor;
+    Cursor = EmitOp(Cursor, EFI_IFR_FORM_OP, sizeof(EFI_IFR_FORM), TRUE);
+    Form->FormId = (UINT16)(Seed & 0x7FFF) + 1;
+    Form->FormTitle = 2;
+
+    for (Index = 0; Index < BENCH_SYNTHETIC_CONDITIONS; Index++)
+    {
+        Cursor = EmitOp(Cursor, (Index % 3) == 0 ? EFI_IFR_SUPPRESS_IF_OP :
+                                (Index % 3) == 1 ? EFI_IFR_GRAY_OUT_IF_OP : EFI_IFR_DISABLE_IF_OP,
+                        sizeof(EFI_IFR_OP_HEADER), TRUE);
+        Cursor = EmitOp(Cursor, EFI_IFR_TRUE_OP, sizeof(EFI_IFR_OP_HEADER), FALSE);
+        Cursor = EmitOp(Cursor, EFI_IFR_SUBTITLE_OP, sizeof(EFI_IFR_SUBTITLE), FALSE);
+        Cursor = EmitOp(Cursor, EFI_IFR_END_OP, sizeof(EFI_IFR_END), FALSE);
+    }
+
+    Cursor = EmitOp(Cursor, EFI_IFR_END_OP, sizeof(EFI_IFR_END), FALSE);   // Form
+    Cursor = EmitOp(Cursor, EFI_IFR_END_OP, sizeof(EFI_IFR_END), FALSE);   // FormSet
+
+    Package->Length = (UINT32)(Cursor - Out);
+    Package->Type = EFI_HII_PACKAGE_FORMS;
+    return Package->Length;
+}
+
+/**
+ * Helper: Build a synthetic image of noise with forms packages spread through it
+ *
+ * There are no PE headers, so the section map falls back to the whole image.
+ */
+STATIC UINT8 *BuildSyntheticImage(UINTN Megabytes, UINTN *Size)
+{
+    UINTN ImageSize = Megabytes * 1024 * 1024;
+    UINTN FormSets = Megabytes * BENCH_SYNTHETIC_FORMSETS_PER_MB;
+    UINTN Stride;
+    UINT32 Seed = 0x1234567;
+    UINT8 *Image;
+    UINTN Index;
+
+    Image = AllocatePool(ImageSize);
+    if (Image == NULL)
+        return NULL;
+
+    for (Index = 0; Index < ImageSize; Index++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        Image[Index] = (UINT8)(Seed >> 16);
+    }
+
+    Stride = ImageSize / (FormSets + 1);
+    for (Index = 1; Index <= FormSets; Index++)
+        EmitFormsPackage(&Image[Index * Stride], (UINT32)Index);
+
+    *Size = ImageSize;
+    return Image;
+}
+
+/**
+ * Helper: StringMatcherScan callback that only counts
+ */
+STATIC BOOLEAN CountMatch(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex)
+{
+    return TRUE;
+}
+
+/**
+ * Helper: X86WalkCode callback that counts instructions
+ */
+STATIC BOOLEAN CountInstruction(VOID *Context, UINT8 *Data, UINTN Offset, CONST X86_INSTRUCTION *Instruction)
+{
+    (*(UINTN *)Context)++;
+    return TRUE;
+}
+
+/**
+ * Helper: Matcher over mBenchVariableNames, as PatchBiosDataBatch builds it
+ */
+STATIC EFI_STATUS BuildVariableMatcher(STRING_MATCHER *Matcher)
+{
+    UINT8 Bytes[ARRAY_SIZE(mBenchVariableNames)][2][32];
+    CONST UINT8 *Patterns[2 * ARRAY_SIZE(mBenchVariableNames)];
+    UINTN Lengths[2 * ARRAY_SIZE(mBenchVariableNames)];
+    UINTN Index;
+
+    for (Index = 0; Index < ARRAY_SIZE(mBenchVariableNames); Index++)
+    {
+        UINTN Length = strlen(mBenchVariableNames[Index]);
+        UINTN i;
+
+        ZeroMem(Bytes[Index], sizeof(Bytes[Index]));
+        for (i = 0; i < Length; i++)
+        {
+            Bytes[Index][0][i] = (UINT8)mBenchVariableNames[Index][i];
+            Bytes[Index][1][2 * i] = (UINT8)mBenchVariableNames[Index][i];
+        }
+        Patterns[2 * Index] = Bytes[Index][0];
+        Lengths[2 * Index] = Length;
+        Patterns[2 * Index + 1] = Bytes[Index][1];
+        Lengths[2 * Index + 1] = 2 * Length;
+    }
+
+    return StringMatcherBuild(Matcher, Patterns, Lengths, ARRAY_SIZE(Patterns));
+}
+
+/**
+ * Helper: Run every phase over one image
+ */
+STATIC VOID BenchImage(
+    CONST CHAR8 *Name,
+    UINT8 *Pristine,
+    UINTN Size,
+    UINTN Iterations,
+    BENCH_PHASE *Total)
+{
+    BENCH_PHASE Phases[BENCH_PHASE_COUNT];
+    BENCH_PACKAGE *Packages;
+    STRING_MATCHER Matcher;
+    UINTN PackageCount;
+    UINTN PackageBytes = 0;
+    UINT8 *Work;
+    PATCH_PLAN Plan;
+    UINTN Iteration;
+    UINTN Phase;
+    UINTN Index;
+
+    Work = AllocatePool(Size);
+    Packages = AllocatePool(sizeof(BENCH_PACKAGE) * 4096);
+    if (Work == NULL || Packages == NULL)
+    {
+        fprintf(stderr, "%s: out of memory\n", Name);
+        if (Work != NULL)
+            FreePool(Work);
+        if (Packages != NULL)
+            FreePool(Packages);
+        return;
+    }
+
+    PackageCount = FindFormsPackages(Pristine, Size, Packages, 4096);
+    for (Index = 0; Index < PackageCount; Index++)
+        PackageBytes += Packages[Index].Size;
+
+    ZeroMem(Phases, sizeof(Phases));
+    PatchPlanInit(&Plan);
+    if (EFI_ERROR(BuildVariableMatcher(&Matcher)))
+        ZeroMem(&Matcher, sizeof(Matcher));
+
+    for (Iteration = 0; Iteration < Iterations; Iteration++)
+    {
+        IMAGE_SECTION_MAP Map;
+        HII_BROWSER_CONTEXT Context;
+        UINT64 Start;
+
+        // ParseIfrData: locate FormSets and plan hide-condition patches
+        CopyMem(Work, Pristine, Size);
+        BuildImageSectionMap(Work, Size, &Map);
+        PatchPlanReset(&Plan);
+        Start = HostTimeNs();
+        ParseIfrData(&Map, &Plan);
+        Phases[BENCH_PARSE_IFR_DATA].Nanoseconds += HostTimeNs() - Start;
+        Phases[BENCH_PARSE_IFR_DATA].Bytes += ImageSectionBytes(&Map, IMAGE_SECTION_DATA);
+        Phases[BENCH_PARSE_IFR_DATA].Found = Plan.Count;
+
+        // PatchPlanApply: verified apply of that plan (replaces ApplyIfrPatches)
+        Start = HostTimeNs();
+        Phases[BENCH_PATCH_PLAN_APPLY].Found = PatchPlanApply(&Plan, Work, Size);
+        Phases[BENCH_PATCH_PLAN_APPLY].Nanoseconds += HostTimeNs() - Start;
+        Phases[BENCH_PATCH_PLAN_APPLY].Bytes += Plan.Count * sizeof(PATCH_RECORD);
+
+        // PatchAmiForms: masked pattern scan of the data sections
+        CopyMem(Work, Pristine, Size);
+        Start = HostTimeNs();
+        Phases[BENCH_PATCH_AMI_FORMS].Found = PatchAmiForms(&Map);
+        Phases[BENCH_PATCH_AMI_FORMS].Nanoseconds += HostTimeNs() - Start;
+        Phases[BENCH_PATCH_AMI_FORMS].Bytes += ImageSectionBytes(&Map, IMAGE_SECTION_DATA);
+
+        // PatchInsydeForms: FormSet GUID collection and prefiltered GUID scan
+        CopyMem(Work, Pristine, Size);
+        Start = HostTimeNs();
+        Phases[BENCH_PATCH_INSYDE_FORMS].Found = PatchInsydeForms(&Map);
+        Phases[BENCH_PATCH_INSYDE_FORMS].Nanoseconds += HostTimeNs() - Start;
+        Phases[BENCH_PATCH_INSYDE_FORMS].Bytes += ImageSectionBytes(&Map, IMAGE_SECTION_DATA);
+
+        // PatchPipeline: the four phases above fused into one traversal
+        CopyMem(Work, Pristine, Size);
+        PatchPlanReset(&Plan);
+        Start = HostTimeNs();
+        {
+            PATCH_PIPELINE Pipeline;
+            PATCH_PIPELINE_STAGE Stage;
+            IFR_PLAN_STAGE IfrState;
+            FORMSET_GUID_STAGE InsydeState;
+            UINTN VendorPatches = 0;
+
+            PatchPipelineInit(&Pipeline);
+            IfrPlanStageInit(&IfrState, &Plan, &gFormSetGuids, &Stage);
+            PatchPipelineAddStage(&Pipeline, &Stage);
+            PatchAmiFormsStage(&VendorPatches, &Stage);
+            PatchPipelineAddStage(&Pipeline, &Stage);
+            PatchInsydeFormsStage(&InsydeState, &VendorPatches, &Stage);
+            PatchPipelineAddStage(&Pipeline, &Stage);
+            PatchPipelineRun(&Pipeline, &Map);
+            if (!EFI_ERROR(IfrPlanStageDone(&IfrState)))
+                VendorPatches += PatchPlanApply(&Plan, Work, Size);
+            Phases[BENCH_PATCH_PIPELINE].Found = VendorPatches;
+            Phases[BENCH_PATCH_PIPELINE].Bytes += Pipeline.Bytes;
+        }
+        Phases[BENCH_PATCH_PIPELINE].Nanoseconds += HostTimeNs() - Start;
+
+        // StringMatch: every variable name, both encodings, in one pass (PatchBiosDataBatch)
+        Phases[BENCH_STRING_MATCH].Found = 0;
+        Start = HostTimeNs();
+        for (Index = 0; Index < Map.SectionCount; Index++)
+        {
+            if (Map.Sections[Index].Kind == 0)
+                continue;
+            Phases[BENCH_STRING_MATCH].Found += StringMatcherScan(&Matcher, Pristine, Map.Sections[Index].Offset,
+                                                                  (UINTN)Map.Sections[Index].Offset + Map.Sections[Index].Size,
+                                                                  CountMatch, NULL);
+            Phases[BENCH_STRING_MATCH].Bytes += Map.Sections[Index].Size;
+        }
+        Phases[BENCH_STRING_MATCH].Nanoseconds += HostTimeNs() - Start;
+
+        // ParseIfrPackage: index each forms package and extract its forms
+        ZeroMem(&Context, sizeof(Context));
+        Phases[BENCH_PARSE_IFR_PACKAGE].Found = 0;
+        Start = HostTimeNs();
+        for (Index = 0; Index < PackageCount; Index++)
+        {
+            HII_FORM_INFO *Forms = NULL;
+            UINTN FormCount = 0;
+            UINTN PackageIndex;
+            UINTN Form;
+
+            if (EFI_ERROR(HiiBrowserAddIfrPackage(&Context, NULL, &Pristine[Packages[Index].Offset],
+                                                  Packages[Index].Size, &PackageIndex)))
+                continue;
+
+            if (EFI_ERROR(ParseIfrPackage(&Context, PackageIndex, &Forms, &FormCount)))
+                continue;
+
+            Phases[BENCH_PARSE_IFR_PACKAGE].Found += FormCount;
+            for (Form = 0; Form < FormCount; Form++)
+                TaggedFreePool(Forms[Form].Title);
+            TaggedFreePool(Forms);
+        }
+        Phases[BENCH_PARSE_IFR_PACKAGE].Nanoseconds += HostTimeNs() - Start;
+        Phases[BENCH_PARSE_IFR_PACKAGE].Bytes += PackageBytes;
+
+        // X86WalkCode: instruction-boundary walk of the code sections (write protection stage)
+        Phases[BENCH_X86_WALK].Found = 0;
+        Start = HostTimeNs();
+        for (Index = 0; Index < Map.SectionCount; Index++)
+        {
+            if ((Map.Sections[Index].Kind & IMAGE_SECTION_CODE) == 0)
+                continue;
+            X86WalkCode(Pristine, Map.Sections[Index].Offset, (UINTN)Map.Sections[Index].Offset + Map.Sections[Index].Size,
+                        (UINTN)Map.Sections[Index].Offset + Map.Sections[Index].Size, CountInstruction,
+                        &Phases[BENCH_X86_WALK].Found);
+        }
+        Phases[BENCH_X86_WALK].Nanoseconds += HostTimeNs() - Start;
+        Phases[BENCH_X86_WALK].Bytes += ImageSectionBytes(&Map, IMAGE_SECTION_CODE);
+
+        for (Index = 0; Index < Context.IfrPackageCount; Index++)
+            IfrIndexFree(&Context.IfrPackages[Index].Index);
+        if (Context.IfrPackages != NULL)
+            TaggedFreePool(Context.IfrPackages);
+    }
+
+    PatchPlanFree(&Plan);
+    StringMatcherFree(&Matcher);
+
+    printf("%s (%lu bytes, %lu forms packages)\n", Name, (unsigned long)Size, (unsigned long)PackageCount);
+    for (Phase = 0; Phase < BENCH_PHASE_COUNT; Phase++)
+    {
+        BENCH_PHASE *Result = &Phases[Phase];
+        double Seconds = (double)Result->Nanoseconds / 1e9;
+
+        printf("  %-16s %10.1f MB/s %10.3f ms/iter %8lu found\n",
+               Total[Phase].Name,
+               Seconds > 0 ? (double)Result->Bytes / (1024.0 * 1024.0) / Seconds : 0.0,
+               (double)Result->Nanoseconds / 1e6 / (double)Iterations,
+               (unsigned long)Result->Found);
+
+        Total[Phase].Nanoseconds += Result->Nanoseconds;
+        Total[Phase].Bytes += Result->Bytes;
+        Total[Phase].Found += Result->Found;
+    }
+
+    FreePool(Packages);
+    FreePool(Work);
+}
+
+// What one walk of a ROM dump saw
+typedef struct {
+    UINTN Volumes;
+    UINTN Files;
+    UINTN Named;
+    UINTN Encoded;               // FV image files behind compressed/signed sections
+    CONST CHAR16 *Module;        // Module whose PE32 section is wanted
+    FFS_SECTION ModuleImage;     // Its PE32 section, Data NULL if not found
+} ROM_WALK;
+
+/**
+ * Helper: Walk the files of one volume and the uncompressed volumes nested in it
+ */
+STATIC VOID WalkVolume(CONST FFS_VOLUME *Volume, UINTN Depth, ROM_WALK *Walk)
+{
+    FFS_FILE File;
+
+    Walk->Volumes++;
+    ZeroMem(&File, sizeof(File));
+    while (!EFI_ERROR(FfsNextFile(Volume, &File)))
+    {
+        CONST CHAR16 *Name = FfsFileName(&File);
+        FFS_SECTION Section;
+        EFI_STATUS Status;
+
+        Walk->Files++;
+        if (Name != NULL)
+        {
+            Walk->Named++;
+            if (Walk->ModuleImage.Data == NULL && StrCmp(Name, Walk->Module) == 0)
+                FfsFindSection(File.Data, File.DataSize, EFI_SECTION_PE32, &Walk->ModuleImage);
+        }
+
+        if (File.Type != EFI_FV_FILETYPE_FIRMWARE_VOLUME_IMAGE || Depth >= FFS_MAX_SECTION_DEPTH)
+            continue;
+
+        Status = FfsFindSection(File.Data, File.DataSize, EFI_SECTION_FIRMWARE_VOLUME_IMAGE, &Section);
+        if (!EFI_ERROR(Status))
+        {
+            FFS_VOLUME Inner;
+
+            if (!EFI_ERROR(FfsVolumeOpen(&Inner, Section.Data, Section.DataSize)))
+                WalkVolume(&Inner, Depth + 1, Walk);
+        }
+        else if (Status == EFI_UNSUPPORTED)
+        {
+            Walk->Encoded++;
+        }
+    }
+}
+
+/**
+ * Helper: Walk every volume of a ROM dump
+ */
+STATIC VOID WalkRom(CONST UINT8 *Rom, UINTN Size, ROM_WALK *Walk)
+{
+    FFS_VOLUME Volume;
+    UINTN Offset = 0;
+
+    while (!EFI_ERROR(FfsVolumeFind(Rom, Size, &Offset, &Volume)))
+    {
+        WalkVolume(&Volume, 0, Walk);
+        Offset += Volume.Size;
+    }
+}
+
+/**
+ * Helper: Time the FFS walk of a ROM dump and bench the module found in it
+ *
+ * The module's PE32 section is used where it lies in the dump, as SREP
+ * does with memory-mapped volumes.
+ */
+STATIC BOOLEAN BenchRom(
+    CONST CHAR8 *Path,
+    CONST CHAR8 *ModuleName,
+    CONST CHAR16 *Module,
+    UINTN Iterations,
+    BENCH_PHASE *Total)
+{
+    ROM_WALK Walk;
+    UINT8 *Rom;
+    UINTN Size;
+    UINT64 Nanoseconds = 0;
+    UINTN Iteration;
+    double Seconds;
+
+    if (EFI_ERROR(HostReadFile(Path, &Rom, &Size)))
+    {
+        fprintf(stderr, "%s: cannot read\n", Path);
+        return FALSE;
+    }
+
+    for (Iteration = 0; Iteration < Iterations; Iteration++)
+    {
+        UINT64 Start;
+
+        ZeroMem(&Walk, sizeof(Walk));
+        Walk.Module = Module;
+        Start = HostTimeNs();
+        WalkRom(Rom, Size, &Walk);
+        Nanoseconds += HostTimeNs() - Start;
+    }
+
+    Seconds = (double)Nanoseconds / 1e9;
+    printf("%s (%lu bytes, %lu volumes, %lu files, %lu named, %lu encoded FV images)\n",
+           Path, (unsigned long)Size, (unsigned long)Walk.Volumes, (unsigned long)Walk.Files,
+           (unsigned long)Walk.Named, (unsigned long)Walk.Encoded);
+    printf("  %-16s %10.1f MB/s %10.3f ms/iter\n", "FfsWalk",
+           Seconds > 0 ? (double)Size * (double)Iterations / (1024.0 * 1024.0) / Seconds : 0.0,
+           (double)Nanoseconds / 1e6 / (double)Iterations);
+
+    if (Walk.ModuleImage.Data == NULL)
+    {
+        printf("  %s: no uncompressed PE32 section\n", ModuleName);
+        FreePool(Rom);
+        return FALSE;
+    }
+
+    BenchImage(Path, (UINT8 *)Walk.ModuleImage.Data, Walk.ModuleImage.DataSize, Iterations, Total);
+    FreePool(Rom);
+    return TRUE;
+}
+
+STATIC VOID Usage(CONST CHAR8 *Program)
+{
+    fprintf(stderr,
+            "usage: %s [-n iterations] [-k auto|swar|sse2|avx2] [-s megabytes] [-r rom] [-m module] [-v] [image...]\n"
+            "  image  dumped Setup/FormBrowser module (PE32+/TE or raw)\n"
+            "  -s     add a synthetic image of the given size\n"
+            "  -r     walk the firmware volumes of a ROM dump and bench the module in it\n"
+            "  -m     UI name of that module (default Setup)\n"
+            "  -v     echo the parser log to stderr\n",
+            Program);
+}
+
+int main(int argc, char **argv)
+{
+    BENCH_PHASE Total[BENCH_PHASE_COUNT] = {
+        { "ParseIfrData" },
+        { "PatchPlanApply" },
+        { "PatchAmiForms" },
+        { "PatchInsydeForms" },
+        { "PatchPipeline" },
+        { "StringMatch" },
+        { "ParseIfrPackage" },
+        { "X86WalkCode" }
+    };
+    UINTN Iterations = 20;
+    UINTN Synthetic = 0;
+    UINTN Images = 0;
+    CONST CHAR8 *RomPath = NULL;
+    CONST CHAR8 *ModuleName = "Setup";
+    CHAR16 Module[BENCH_MODULE_NAME_MAX];
+    UINTN Phase;
+    int Arg;
+
+    for (Arg = 1; Arg < argc && argv[Arg][0] == '-'; Arg++)
+    {
+        if (strcmp(argv[Arg], "-n") == 0 && Arg + 1 < argc)
+        {
+            Iterations = strtoul(argv[++Arg], NULL, 0);
+        }
+        else if (strcmp(argv[Arg], "-s") == 0 && Arg + 1 < argc)
+        {
+            Synthetic = strtoul(argv[++Arg], NULL, 0);
+        }
+        else if (strcmp(argv[Arg], "-k") == 0 && Arg + 1 < argc)
+        {
+            CONST CHAR8 *Kernel = argv[++Arg];
+            BYTE_SCAN_KERNEL Selected = strcmp(Kernel, "swar") == 0 ? BYTE_SCAN_KERNEL_SWAR :
+                                        strcmp(Kernel, "sse2") == 0 ? BYTE_SCAN_KERNEL_SSE2 :
+                                        strcmp(Kernel, "avx2") == 0 ? BYTE_SCAN_KERNEL_AVX2 :
+                                                                      BYTE_SCAN_KERNEL_AUTO;
+            if (EFI_ERROR(ByteScanSelectKernel(Selected)))
+            {
+                fprintf(stderr, "Kernel %s is not available\n", Kernel);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[Arg], "-r") == 0 && Arg + 1 < argc)
+        {
+            RomPath = argv[++Arg];
+        }
+        else if (strcmp(argv[Arg], "-m") == 0 && Arg + 1 < argc && strlen(argv[Arg + 1]) < BENCH_MODULE_NAME_MAX)
+        {
+            ModuleName = argv[++Arg];
+        }
+        else if (strcmp(argv[Arg], "-v") == 0)
+        {
+            gHostLogEnabled = TRUE;
+        }
+        else
+        {
+            Usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (Iterations == 0 || (Arg == argc && Synthetic == 0 && RomPath == NULL))
+    {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    printf("ByteScan kernel: %s, %lu iterations\n", ByteScanKernelName(), (unsigned long)Iterations);
+
+    if (Synthetic > 0)
+    {
+        UINTN Size;
+        UINT8 *Image = BuildSyntheticImage(Synthetic, &Size);
+
+        if (Image == NULL)
+        {
+            fprintf(stderr, "Could not build a %lu MB synthetic image\n", (unsigned long)Synthetic);
+            return 1;
+        }
+
+        BenchImage("<synthetic>", Image, Size, Iterations, Total);
+        FreePool(Image);
+        Images++;
+    }
+
+    if (RomPath != NULL)
+    {
+        UINTN Index;
+
+        for (Index = 0; ModuleName[Index] != 0; Index++)
+            Module[Index] = (CHAR16)ModuleName[Index];
+        Module[Index] = 0;
+
+        if (BenchRom(RomPath, ModuleName, Module, Iterations, Total))
+            Images++;
+    }
+
+    for (; Arg < argc; Arg++)
+    {
+        UINT8 *Image;
+        UINTN Size;
+
+        if (EFI_ERROR(HostReadFile(argv[Arg], &Image, &Size)))
+        {
+            fprintf(stderr, "%s: cannot read\n", argv[Arg]);
+            continue;
+        }
+
+        BenchImage(argv[Arg], Image, Size, Iterations, Total);
+        FreePool(Image);
+        Images++;
+    }
+
+    printf("Total over %lu images\n", (unsigned long)Images);
+    for (Phase = 0; Phase < BENCH_PHASE_COUNT; Phase++)
+    {
+        double Seconds = (double)Total[Phase].Nanoseconds / 1e9;
+
+        printf("  %-16s %10.1f MB/s %8lu found\n",
+               Total[Phase].Name,
+               Seconds > 0 ? (double)Total[Phase].Bytes / (1024.0 * 1024.0) / Seconds : 0.0,
+               (unsigned long)Total[Phase].Found);
+    }
+
+    return Images > 0 ? 0 : 1;
+}
@@ -0,0 +1,713 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostShim.h"
+#include "../PatchDb.h"
+#include "../PatchPlan.h"
+
+//
+// Compiles the text signature list (PatchDb.txt) into the binary SREP.db the
+// firmware loads, lists an existing database, and checks that every pattern
+// of a database matches, writes its bytes and reverts to the original image.
+//
+//   PatchDbTool PatchDb.txt SREP.db
+//   PatchDbTool -l SREP.db
+//   PatchDbTool -c SREP.db
+//
+// Input lines ('#' starts a comment):
+//
+//   guid     <alias> <xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx>
+//   module   <UiName> [guid=<guid>] [vendor=<v,...>] [role=<r,...>] [action=<a,...>]
+//   pattern  <code|data> <hex, ?? = any byte> <patch offset> <new bytes hex>
+//   variable <Name> <guid>[,<guid>...] [vendor=<v,...>]
+//
+// <guid> is a GUID or an alias. Vendors: ami, ami-hp, insyde, phoenix, award.
+// Roles: setup-dependency, vendor. Actions: write-protect, unlock-forms.
+// A pattern belongs to the module above it.
+//
+
+#define TOOL_MAX_NAME 64
+#define TOOL_MAX_ITEMS 4096
+#define TOOL_MAX_LINE 512
+
+typedef struct {
+    CHAR8 Name[TOOL_MAX_NAME];
+    EFI_GUID Guid;
+} TOOL_GUID;
+
+typedef struct {
+    CHAR8 Name[TOOL_MAX_NAME];
+    EFI_GUID FileGuid;
+    BOOLEAN HasGuid;
+    UINT16 VendorMask;
+    UINT16 Roles;
+    UINT16 Actions;
+} TOOL_MODULE;
+
+typedef struct {
+    UINTN Module;
+    BYTE_PATTERN Pattern;
+    PATCH_DB_PATCH Patch;
+} TOOL_PATTERN;
+
+typedef struct {
+    CHAR8 Name[TOOL_MAX_NAME];
+    EFI_GUID Guid;
+    UINT16 VendorMask;
+} TOOL_VARIABLE;
+
+typedef struct {
+    CONST CHAR8 *Name;
+    UINT16 Value;
+} TOOL_KEYWORD;
+
+STATIC CONST TOOL_KEYWORD mVendors[] = {
+    { "ami", PATCH_DB_VENDOR(BIOS_TYPE_AMI) },
+    { "ami-hp", PATCH_DB_VENDOR(BIOS_TYPE_AMI_HP_CUSTOM) },
+    { "insyde", PATCH_DB_VENDOR(BIOS_TYPE_INSYDE) },
+    { "phoenix", PATCH_DB_VENDOR(BIOS_TYPE_PHOENIX) },
+    { "award", PATCH_DB_VENDOR(BIOS_TYPE_AWARD) },
+    { NULL, 0 }
+};
+
+STATIC CONST TOOL_KEYWORD mRoles[] = {
+    { "setup-dependency", PATCH_DB_ROLE_SETUP_DEPENDENCY },
+    { "vendor", PATCH_DB_ROLE_VENDOR },
+    { NULL, 0 }
+};
+
+STATIC CONST TOOL_KEYWORD mActions[] = {
+    { "write-protect", PATCH_DB_ACTION_WRITE_PROTECT },
+    { "unlock-forms", PATCH_DB_ACTION_UNLOCK_FORMS },
+    { NULL, 0 }
+};
+
+STATIC TOOL_GUID mGuids[TOOL_MAX_ITEMS];
+STATIC UINTN mGuidCount;
+STATIC TOOL_MODULE mModules[TOOL_MAX_ITEMS];
+STATIC UINTN mModuleCount;
+STATIC TOOL_PATTERN mPatterns[TOOL_MAX_ITEMS];
+STATIC UINTN mPatternCount;
+STATIC TOOL_VARIABLE mVariables[TOOL_MAX_ITEMS];
+STATIC UINTN mVariableCount;
+
+STATIC CONST CHAR8 *mInputName;
+STATIC UINTN mLine;
+
+/**
+ * Helper: Report an input error and exit
+ */
+STATIC VOID ToolFail(CONST CHAR8 *Message, CONST CHAR8 *Token)
+{
+    fprintf(stderr, "%s:%lu: %s%s%s\n", mInputName, (unsigned long)mLine, Message,
+            Token != NULL ? ": " : "", Token != NULL ? Token : "");
+    exit(1);
+}
+
+/**
+ * Helper: Copy a name, rejecting ones that do not fit
+ */
+STATIC VOID ToolCopyName(CHAR8 *Destination, CONST CHAR8 *Name)
+{
+    if (strlen(Name) >= TOOL_MAX_NAME)
+        ToolFail("name too long", Name);
+    strcpy(Destination, Name);
+}
+
+/**
+ * Helper: Parse a GUID or a GUID alias
+ */
+STATIC VOID ToolParseGuid(CONST CHAR8 *Text, EFI_GUID *Guid)
+{
+    unsigned int Data1;
+    unsigned int Data2;
+    unsigned int Data3;
+    unsigned int Data4[8];
+    UINTN Index;
+
+    for (Index = 0; Index < mGuidCount; Index++)
+    {
+        if (strcmp(mGuids[Index].Name, Text) == 0)
+        {
+            *Guid = mGuids[Index].Guid;
+            return;
+        }
+    }
+
+    if (strlen(Text) != 36 ||
+        sscanf(Text, "%8x-%4x-%4x-%2x%2x-%2x%2x%2x%2x%2x%2x", &Data1, &Data2, &Data3,
+               &Data4[0], &Data4[1], &Data4[2], &Data4[3], &Data4[4], &Data4[5], &Data4[6], &Data4[7]) != 11)
+        ToolFail("bad GUID", Text);
+
+    Guid->Data1 = Data1;
+    Guid->Data2 = (UINT16)Data2;
+    Guid->Data3 = (UINT16)Data3;
+    for (Index = 0; Index < 8; Index++)
+        Guid->Data4[Index] = (UINT8)Data4[Index];
+}
+
+/**
+ * Helper: Parse a comma separated keyword list into a mask
+ */
+STATIC UINT16 ToolParseMask(CHAR8 *Text, CONST TOOL_KEYWORD *Keywords)
+{
+    UINT16 Mask = 0;
+    CHAR8 *Save = NULL;
+    CHAR8 *Word;
+
+    for (Word = strtok_r(Text, ",", &Save); Word != NULL; Word = strtok_r(NULL, ",", &Save))
+    {
+        CONST TOOL_KEYWORD *Keyword;
+
+        for (Keyword = Keywords; Keyword->Name != NULL; Keyword++)
+        {
+            if (strcmp(Keyword->Name, Word) == 0)
+                break;
+        }
+
+        if (Keyword->Name == NULL)
+            ToolFail("unknown keyword", Word);
+        Mask |= Keyword->Value;
+    }
+
+    return Mask;
+}
+
+/**
+ * Helper: Parse hex byte pairs ("??" allowed when Mask is not NULL)
+ */
+STATIC UINTN ToolParseHex(CONST CHAR8 *Text, UINT8 *Bytes, UINT8 *Mask, UINTN Max)
+{
+    UINTN Length = 0;
+
+    if (strlen(Text) % 2 != 0)
+        ToolFail("odd number of hex digits", Text);
+
+    for (; *Text != '\0'; Text += 2)
+    {
+        unsigned int Value;
+
+        if (Length == Max)
+            ToolFail("too many bytes", NULL);
+
+        if (Text[0] == '?' && Text[1] == '?' && Mask != NULL)
+        {
+            Bytes[Length] = 0;
+            Mask[Length] = 0x00;
+        }
+        else
+        {
+            CHAR8 Pair[3] = { Text[0], Text[1], '\0' };
+            CHAR8 *End;
+
+            Value = (unsigned int)strtoul(Pair, &End, 16);
+            if (*End != '\0')
+                ToolFail("bad hex byte", Pair);
+            Bytes[Length] = (UINT8)Value;
+            if (Mask != NULL)
+                Mask[Length] = 0xFF;
+        }
+        Length++;
+    }
+
+    return Length;
+}
+
+/**
+ * Helper: Parse one input line
+ */
+STATIC VOID ToolParseLine(CHAR8 *Line)
+{
+    CHAR8 *Save = NULL;
+    CHAR8 *Keyword;
+    CHAR8 *Token;
+
+    Token = strchr(Line, '#');
+    if (Token != NULL)
+        *Token = '\0';
+
+    Keyword = strtok_r(Line, " \t\r\n", &Save);
+    if (Keyword == NULL)
+        return;
+
+    if (strcmp(Keyword, "guid") == 0)
+    {
+        CHAR8 *Name = strtok_r(NULL, " \t\r\n", &Save);
+        CHAR8 *Value = strtok_r(NULL, " \t\r\n", &Save);
+
+        if (Name == NULL || Value == NULL || mGuidCount == TOOL_MAX_ITEMS)
+            ToolFail("usage: guid <alias> <GUID>", NULL);
+        ToolParseGuid(Value, &mGuids[mGuidCount].Guid);
+        ToolCopyName(mGuids[mGuidCount].Name, Name);
+        mGuidCount++;
+    }
+    else if (strcmp(Keyword, "module") == 0)
+    {
+        TOOL_MODULE *Module;
+        CHAR8 *Name = strtok_r(NULL, " \t\r\n", &Save);
+
+        if (Name == NULL || mModuleCount == TOOL_MAX_ITEMS)
+            ToolFail("usage: module <UiName> [key=value...]", NULL);
+
+        Module = &mModules[mModuleCount++];
+        memset(Module, 0, sizeof(*Module));
+        ToolCopyName(Module->Name, Name);
+
+        while ((Token = strtok_r(NULL, " \t\r\n", &Save)) != NULL)
+        {
+            if (strncmp(Token, "guid=", 5) == 0)
+            {
+                ToolParseGuid(Token + 5, &Module->FileGuid);
+                Module->HasGuid = TRUE;
+            }
+            else if (strncmp(Token, "vendor=", 7) == 0)
+                Module->VendorMask = ToolParseMask(Token + 7, mVendors);
+            else if (strncmp(Token, "role=", 5) == 0)
+                Module->Roles = ToolParseMask(Token + 5, mRoles);
+            else if (strncmp(Token, "action=", 7) == 0)
+                Module->Actions = ToolParseMask(Token + 7, mActions);
+            else
+                ToolFail("unknown module attribute", Token);
+        }
+    }
+    else if (strcmp(Keyword, "pattern") == 0)
+    {
+        TOOL_PATTERN *Pattern;
+        CHAR8 *Kind = strtok_r(NULL, " \t\r\n", &Save);
+        CHAR8 *Bytes = strtok_r(NULL, " \t\r\n", &Save);
+        CHAR8 *Offset = strtok_r(NULL, " \t\r\n", &Save);
+        CHAR8 *NewBytes = strtok_r(NULL, " \t\r\n", &Save);
+        UINTN Index;
+
+        if (Kind == NULL || Bytes == NULL || Offset == NULL || NewBytes == NULL || mPatternCount == TOOL_MAX_ITEMS)
+            ToolFail("usage: pattern <code|data> <hex> <patch offset> <new bytes>", NULL);
+        if (mModuleCount == 0)
+            ToolFail("pattern before any module", NULL);
+
+        Pattern = &mPatterns[mPatternCount++];
+        memset(Pattern, 0, sizeof(*Pattern));
+        Pattern->Module = mModuleCount - 1;
+
+        if (strcmp(Kind, "code") == 0)
+            Pattern->Patch.Kind = IMAGE_SECTION_CODE;
+        else if (strcmp(Kind, "data") == 0)
+            Pattern->Patch.Kind = IMAGE_SECTION_DATA;
+        else
+            ToolFail("pattern kind must be code or data", Kind);
+
+        Pattern->Pattern.Length = (UINT8)ToolParseHex(Bytes, Pattern->Pattern.Bytes, Pattern->Pattern.Mask,
+                                                      BYTE_PATTERN_MAX_LENGTH);
+        Pattern->Patch.PatchOffset = (UINT8)strtoul(Offset, NULL, 0);
+        Pattern->Patch.PatchLength = (UINT8)ToolParseHex(NewBytes, Pattern->Patch.NewBytes, NULL,
+                                                         PATCH_RECORD_MAX_BYTES);
+
+        for (Index = 0; Index < Pattern->Pattern.Length && Pattern->Pattern.Mask[Index] != 0xFF; Index++)
+            ;
+        if (Index == Pattern->Pattern.Length)
+            ToolFail("pattern needs at least one exact byte", Bytes);
+        if ((UINTN)Pattern->Patch.PatchOffset + Pattern->Patch.PatchLength > Pattern->Pattern.Length)
+            ToolFail("patch runs past the end of the pattern", NULL);
+    }
+    else if (strcmp(Keyword, "variable") == 0)
+    {
+        CHAR8 *Name = strtok_r(NULL, " \t\r\n", &Save);
+        CHAR8 *Guids = strtok_r(NULL, " \t\r\n", &Save);
+        CHAR8 *GuidSave = NULL;
+        UINT16 VendorMask = 0;
+
+        if (Name == NULL || Guids == NULL)
+            ToolFail("usage: variable <Name> <guid>[,<guid>...] [vendor=...]", NULL);
+
+        while ((Token = strtok_r(NULL, " \t\r\n", &Save)) != NULL)
+        {
+            if (strncmp(Token, "vendor=", 7) != 0)
+                ToolFail("unknown variable attribute", Token);
+            VendorMask = ToolParseMask(Token + 7, mVendors);
+        }
+
+        for (Token = strtok_r(Guids, ",", &GuidSave); Token != NULL; Token = strtok_r(NULL, ",", &GuidSave))
+        {
+            TOOL_VARIABLE *Variable;
+
+            if (mVariableCount == TOOL_MAX_ITEMS)
+                ToolFail("too many variables", NULL);
+
+            Variable = &mVariables[mVariableCount++];
+            ToolCopyName(Variable->Name, Name);
+            ToolParseGuid(Token, &Variable->Guid);
+            Variable->VendorMask = VendorMask;
+        }
+    }
+    else
+    {
+        ToolFail("unknown keyword", Keyword);
+    }
+}
+
+STATIC int ToolCompareModules(CONST VOID *Left, CONST VOID *Right)
+{
+    return strcmp(mModules[*(CONST UINTN *)Left].Name, mModules[*(CONST UINTN *)Right].Name);
+}
+
+STATIC int ToolCompareGuidIndex(CONST VOID *Left, CONST VOID *Right)
+{
+    return memcmp(&mModules[*(CONST UINTN *)Left].FileGuid, &mModules[*(CONST UINTN *)Right].FileGuid,
+                  sizeof(EFI_GUID));
+}
+
+STATIC int ToolCompareVariables(CONST VOID *Left, CONST VOID *Right)
+{
+    CONST TOOL_VARIABLE *A = (CONST TOOL_VARIABLE *)Left;
+    CONST TOOL_VARIABLE *B = (CONST TOOL_VARIABLE *)Right;
+    int Order = memcmp(&A->Guid, &B->Guid, sizeof(EFI_GUID));
+
+    return Order != 0 ? Order : strcmp(A->Name, B->Name);
+}
+
+/**
+ * Helper: Round an offset up to a table alignment
+ */
+STATIC UINT32 ToolAlign(UINT32 Offset, UINT32 Alignment)
+{
+    return (Offset + Alignment - 1) & ~(Alignment - 1);
+}
+
+/**
+ * Helper: Lay the parsed input out as a database image
+ */
+STATIC UINT8 *ToolBuild(UINTN *Size)
+{
+    STATIC UINTN Order[TOOL_MAX_ITEMS];
+    STATIC UINTN GuidOrder[TOOL_MAX_ITEMS];
+    PATCH_DB_HEADER Header;
+    UINTN GuidCount = 0;
+    UINTN AsciiSize = 0;
+    UINTN UnicodeSize = 0;
+    UINTN Index;
+    UINTN Kept = 0;
+    UINT8 *Buffer;
+
+    for (Index = 0; Index < mModuleCount; Index++)
+    {
+        Order[Index] = Index;
+        AsciiSize += strlen(mModules[Index].Name) + 1;
+    }
+    qsort(Order, mModuleCount, sizeof(UINTN), ToolCompareModules);
+
+    for (Index = 1; Index < mModuleCount; Index++)
+    {
+        if (ToolCompareModules(&Order[Index - 1], &Order[Index]) == 0)
+        {
+            fprintf(stderr, "%s: duplicate module %s\n", mInputName, mModules[Order[Index]].Name);
+            exit(1);
+        }
+    }
+
+    // Same GUID and name listed twice (e.g. two GUID aliases for one value)
+    qsort(mVariables, mVariableCount, sizeof(TOOL_VARIABLE), ToolCompareVariables);
+    for (Index = 0; Index < mVariableCount; Index++)
+    {
+        if (Kept > 0 && ToolCompareVariables(&mVariables[Kept - 1], &mVariables[Index]) == 0)
+            continue;
+        mVariables[Kept++] = mVariables[Index];
+    }
+    mVariableCount = Kept;
+
+    for (Index = 0; Index < mVariableCount; Index++)
+        UnicodeSize += strlen(mVariables[Index].Name) + 1;
+
+    for (Index = 0; Index < mModuleCount; Index++)
+    {
+        if (mModules[Order[Index]].HasGuid)
+            GuidOrder[GuidCount++] = Order[Index];
+    }
+    qsort(GuidOrder, GuidCount, sizeof(UINTN), ToolCompareGuidIndex);
+
+    memset(&Header, 0, sizeof(Header));
+    Header.Signature = PATCH_DB_SIGNATURE;
+    Header.Version = PATCH_DB_VERSION;
+    Header.HeaderSize = sizeof(PATCH_DB_HEADER);
+    Header.Modules.Offset = ToolAlign(sizeof(PATCH_DB_HEADER), 8);
+    Header.Modules.Count = (UINT32)mModuleCount;
+    Header.GuidIndex.Offset = ToolAlign(Header.Modules.Offset + Header.Modules.Count * sizeof(PATCH_DB_MODULE), 8);
+    Header.GuidIndex.Count = (UINT32)GuidCount;
+    Header.Patterns.Offset = ToolAlign(Header.GuidIndex.Offset + Header.GuidIndex.Count * sizeof(UINT16), 8);
+    Header.Patterns.Count = (UINT32)mPatternCount;
+    Header.Actions.Offset = ToolAlign(Header.Patterns.Offset + Header.Patterns.Count * sizeof(BYTE_PATTERN), 8);
+    Header.Actions.Count = (UINT32)mPatternCount;
+    Header.Variables.Offset = ToolAlign(Header.Actions.Offset + Header.Actions.Count * sizeof(PATCH_DB_PATCH), 8);
+    Header.Variables.Count = (UINT32)mVariableCount;
+    Header.AsciiStrings.Offset = ToolAlign(Header.Variables.Offset + Header.Variables.Count * sizeof(PATCH_DB_VARIABLE), 8);
+    Header.AsciiStrings.Count = (UINT32)AsciiSize;
+    Header.UnicodeStrings.Offset = ToolAlign(Header.AsciiStrings.Offset + Header.AsciiStrings.Count, 8);
+    Header.UnicodeStrings.Count = (UINT32)UnicodeSize;
+    Header.FileSize = Header.UnicodeStrings.Offset + Header.UnicodeStrings.Count * sizeof(CHAR16);
+
+    Buffer = calloc(1, Header.FileSize);
+    if (Buffer == NULL)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memcpy(Buffer, &Header, sizeof(Header));
+
+    {
+        PATCH_DB_MODULE *Modules = (PATCH_DB_MODULE *)(Buffer + Header.Modules.Offset);
+        UINT16 *GuidIndex = (UINT16 *)(Buffer + Header.GuidIndex.Offset);
+        BYTE_PATTERN *Patterns = (BYTE_PATTERN *)(Buffer + Header.Patterns.Offset);
+        PATCH_DB_PATCH *Actions = (PATCH_DB_PATCH *)(Buffer + Header.Actions.Offset);
+        PATCH_DB_VARIABLE *Variables = (PATCH_DB_VARIABLE *)(Buffer + Header.Variables.Offset);
+        CHAR8 *Ascii = (CHAR8 *)(Buffer + Header.AsciiStrings.Offset);
+        CHAR16 *Unicode = (CHAR16 *)(Buffer + Header.UnicodeStrings.Offset);
+        UINTN Position[TOOL_MAX_ITEMS];
+        UINT32 NextPattern = 0;
+        UINT32 NextAscii = 0;
+        UINT32 NextUnicode = 0;
+
+        for (Index = 0; Index < mModuleCount; Index++)
+        {
+            TOOL_MODULE *Source = &mModules[Order[Index]];
+            PATCH_DB_MODULE *Module = &Modules[Index];
+            UINT8 Kinds[2] = { IMAGE_SECTION_CODE, IMAGE_SECTION_DATA };
+            UINTN Pass;
+            UINTN p;
+
+            Position[Order[Index]] = Index;
+            Module->FileGuid = Source->FileGuid;
+            Module->NameOffset = NextAscii;
+            Module->VendorMask = Source->VendorMask;
+            Module->Roles = Source->Roles;
+            Module->Actions = Source->Actions;
+            Module->FirstPattern = NextPattern;
+
+            strcpy(&Ascii[NextAscii], Source->Name);
+            NextAscii += (UINT32)strlen(Source->Name) + 1;
+
+            // Code patterns first, then data patterns, so each kind is one run
+            for (Pass = 0; Pass < 2; Pass++)
+            {
+                for (p = 0; p < mPatternCount; p++)
+                {
+                    if (mPatterns[p].Module != Order[Index] || mPatterns[p].Patch.Kind != Kinds[Pass])
+                        continue;
+                    Patterns[NextPattern] = mPatterns[p].Pattern;
+                    Actions[NextPattern] = mPatterns[p].Patch;
+                    NextPattern++;
+                    Module->PatternCount++;
+                }
+            }
+        }
+
+        for (Index = 0; Index < GuidCount; Index++)
+            GuidIndex[Index] = (UINT16)Position[GuidOrder[Index]];
+
+        for (Index = 0; Index < mVariableCount; Index++)
+        {
+            CONST CHAR8 *Name = mVariables[Index].Name;
+
+            Variables[Index].Guid = mVariables[Index].Guid;
+            Variables[Index].NameOffset = NextUnicode;
+            Variables[Index].VendorMask = mVariables[Index].VendorMask;
+            do
+            {
+                Unicode[NextUnicode++] = (CHAR16)(UINT8)*Name;
+            } while (*Name++ != '\0');
+        }
+    }
+
+    *Size = Header.FileSize;
+    return Buffer;
+}
+
+/**
+ * Helper: Print the contents of a database
+ */
+STATIC VOID ToolList(PATCH_DB *Db)
+{
+    CONST PATCH_DB_MODULE *Module = NULL;
+    UINTN Index;
+
+    printf("%u modules, %u patterns, %u variables\n", Db->Header->Modules.Count,
+           Db->Header->Patterns.Count, Db->Header->Variables.Count);
+
+    for (Index = 0; Index < Db->Header->Modules.Count; Index++)
+    {
+        Module = &Db->Modules[Index];
+        printf("module %-32s vendors=0x%02x roles=0x%x actions=0x%x patterns=%u\n",
+               PatchDbModuleName(Db, Module), Module->VendorMask, Module->Roles, Module->Actions,
+               Module->PatternCount);
+    }
+
+    for (Index = 0; Index < Db->Header->Variables.Count; Index++)
+    {
+        CONST PATCH_DB_VARIABLE *Variable = &Db->Variables[Index];
+        CONST CHAR16 *Name = PatchDbVariableName(Db, Variable);
+
+        printf("variable %08x-%04x-%04x ", Variable->Guid.Data1, Variable->Guid.Data2, Variable->Guid.Data3);
+        while (*Name != 0)
+            putchar((char)*Name++);
+        putchar('\n');
+    }
+}
+
+/**
+ * Helper: Run every pattern of a database over an image holding just its
+ * match, and check the module lookups and the bytes written
+ *
+ * The writes are journaled into a plan; reverting it must give back the
+ * original image, and applying it again the patched one.
+ *
+ * @return Number of failed checks
+ */
+STATIC UINTN ToolCheck(PATCH_DB *Db)
+{
+    UINTN Failures = 0;
+    UINTN Index;
+
+    for (Index = 0; Index < Db->Header->Modules.Count; Index++)
+    {
+        CONST PATCH_DB_MODULE *Module = &Db->Modules[Index];
+        CONST CHAR8 *Name = PatchDbModuleName(Db, Module);
+        UINTN Pattern;
+
+        if (PatchDbFindModule(Db, Name) != Module ||
+            (!IsZeroGuid(&Module->FileGuid) && PatchDbFindModuleByGuid(Db, &Module->FileGuid) != Module))
+        {
+            fprintf(stderr, "module %s: lookup failed\n", Name);
+            Failures++;
+        }
+
+        for (Pattern = Module->FirstPattern; Pattern < Module->FirstPattern + Module->PatternCount; Pattern++)
+        {
+            CONST BYTE_PATTERN *Bytes = &Db->Patterns[Pattern];
+            CONST PATCH_DB_PATCH *Patch = &Db->Actions[Pattern];
+            UINT8 Image[64 + BYTE_PATTERN_MAX_LENGTH + 64];
+            UINT8 Original[sizeof(Image)];
+            UINT8 Patched[sizeof(Image)];
+            IMAGE_SECTION_MAP Map;
+            PATCH_PLAN Plan;
+            UINTN Written;
+
+            // The match in the middle of one section of the pattern's kind; "??" bytes are 0
+            memset(Image, 0xCC, sizeof(Image));
+            memcpy(&Image[64], Bytes->Bytes, Bytes->Length);
+            memset(&Map, 0, sizeof(Map));
+            Map.ImageBase = Image;
+            Map.ImageSize = sizeof(Image);
+            Map.SectionCount = 1;
+            Map.Sections[0].Size = sizeof(Image);
+            Map.Sections[0].Kind = Patch->Kind;
+
+            memcpy(Original, Image, sizeof(Image));
+
+            PatchPlanInit(&Plan);
+            gPatchJournal = &Plan;
+            Written = PatchDbApplyPatterns(Db, Module, &Map);
+            gPatchJournal = NULL;
+            if (Written == 0 || memcmp(&Image[64 + Patch->PatchOffset], Patch->NewBytes, Patch->PatchLength) != 0)
+            {
+                fprintf(stderr, "module %s: pattern %lu did not write its bytes\n", Name,
+                        (unsigned long)(Pattern - Module->FirstPattern));
+                Failures++;
+            }
+
+            memcpy(Patched, Image, sizeof(Image));
+            PatchPlanRevert(&Plan, Image, sizeof(Image));
+            if (memcmp(Image, Original, sizeof(Image)) != 0)
+            {
+                fprintf(stderr, "module %s: pattern %lu did not revert\n", Name,
+                        (unsigned long)(Pattern - Module->FirstPattern));
+                Failures++;
+            }
+
+            PatchPlanApply(&Plan, Image, sizeof(Image));
+            if (memcmp(Image, Patched, sizeof(Image)) != 0 ||
+                PatchPlanRevert(&Plan, Image, sizeof(Image)) != Plan.Count ||
+                memcmp(Image, Original, sizeof(Image)) != 0)
+            {
+                fprintf(stderr, "module %s: pattern %lu did not apply and revert from its plan\n", Name,
+                        (unsigned long)(Pattern - Module->FirstPattern));
+                Failures++;
+            }
+            PatchPlanFree(&Plan);
+        }
+    }
+
+    printf("%u modules, %u patterns checked, %lu failures\n", Db->Header->Modules.Count,
+           Db->Header->Patterns.Count, (unsigned long)Failures);
+    return Failures;
+}
+
+int main(int Argc, char **Argv)
+{
+    PATCH_DB Db;
+    EFI_STATUS Status;
+    UINT8 *Buffer;
+    UINTN Size;
+
+    if (Argc == 3 && (strcmp(Argv[1], "-l") == 0 || strcmp(Argv[1], "-c") == 0))
+    {
+        Status = HostReadFile(Argv[2], &Buffer, &Size);
+        if (!EFI_ERROR(Status))
+            Status = PatchDbOpen(&Db, Buffer, Size);
+        if (EFI_ERROR(Status))
+        {
+            fprintf(stderr, "%s: not a valid database\n", Argv[2]);
+            return 1;
+        }
+        if (Argv[1][1] == 'c')
+            return ToolCheck(&Db) == 0 ? 0 : 1;
+        ToolList(&Db);
+        return 0;
+    }
+
+    if (Argc != 3)
+    {
+        fprintf(stderr, "usage: %s <PatchDb.txt> <SREP.db>\n       %s -l|-c <SREP.db>\n", Argv[0], Argv[0]);
+        return 2;
+    }
+
+    {
+        CHAR8 Line[TOOL_MAX_LINE];
+        FILE *Input = fopen(Argv[1], "r");
+
+        if (Input == NULL)
+        {
+            perror(Argv[1]);
+            return 1;
+        }
+
+        mInputName = Argv[1];
+        while (fgets(Line, sizeof(Line), Input) != NULL)
+        {
+            mLine++;
+            ToolParseLine(Line);
+        }
+        fclose(Input);
+    }
+
+    Buffer = ToolBuild(&Size);
+
+    // The firmware runs the same checks, so a bad build never ships
+    if (EFI_ERROR(PatchDbOpen(&Db, Buffer, Size)))
+    {
+        fprintf(stderr, "%s: generated database failed validation\n", Argv[2]);
+        return 1;
+    }
+
+    {
+        FILE *Output = fopen(Argv[2], "wb");
+
+        if (Output == NULL || fwrite(Buffer, 1, Size, Output) != Size || fclose(Output) != 0)
+        {
+            perror(Argv[2]);
+            return 1;
+        }
+    }
+
+    printf("%s: %lu modules, %lu patterns, %lu variables, %lu bytes\n", Argv[2], (unsigned long)mModuleCount,
+           (unsigned long)mPatternCount, (unsigned long)mVariableCount, (unsigned long)Size);
+    free(Buffer);
+    return 0;
+}
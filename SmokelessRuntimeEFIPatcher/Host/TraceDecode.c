@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HostShim.h"
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include "../Trace.h"
+
+//
+// Turns the binary SREP.trace written by the firmware into text or CSV.
+//
+//   TraceDecode SREP.trace           (one line per event)
+//   TraceDecode -c SREP.trace        (CSV: tsc,elapsed_us,event,arg1..arg4)
+//
+// Event names and argument layouts come from TRACE_EVENT_LIST, so the tool
+// always matches the firmware it was built with. Elapsed time is relative
+// to the first event; without a measured TSC frequency it is left empty.
+//
+
+#define TOOL_MAX_FIELD 64
+
+typedef struct {
+    UINT16 Id;
+    CONST CHAR8 *Name;
+    CONST CHAR8 *Args;
+} TOOL_EVENT;
+
+#define TRACE_EVENT_ENTRY(Name, Id, Args) { Id, #Name, Args },
+STATIC CONST TOOL_EVENT mEvents[] = {
+    TRACE_EVENT_LIST(TRACE_EVENT_ENTRY)
+};
+#undef TRACE_EVENT_ENTRY
+
+/**
+ * Helper: Catalog entry of an event id, NULL if the build does not know it
+ */
+STATIC CONST TOOL_EVENT *ToolFindEvent(UINT16 Id)
+{
+    for (UINTN i = 0; i < ARRAY_SIZE(mEvents); i++)
+    {
+        if (mEvents[i].Id == Id)
+            return &mEvents[i];
+    }
+    return NULL;
+}
+
+/**
+ * Helper: Format the arguments of a record as (name, value) fields
+ *
+ * @return Number of fields
+ */
+STATIC UINTN ToolFormatArgs(
+    CONST TOOL_EVENT *Event,
+    CONST UINT64 *Args,
+    UINTN ArgCount,
+    CHAR8 Names[TRACE_MAX_ARGS][TOOL_MAX_FIELD],
+    CHAR8 Values[TRACE_MAX_ARGS][TOOL_MAX_FIELD])
+{
+    CONST CHAR8 *Spec = Event != NULL ? Event->Args : "";
+    UINTN Field = 0;
+    UINTN Arg = 0;
+
+    while (Arg < ArgCount && Field < TRACE_MAX_ARGS)
+    {
+        CHAR8 Kind = 'x';
+        UINTN NameLength = 0;
+
+        // "<kind> <name>", comma separated; unknown events print raw hex
+        while (*Spec == ' ' || *Spec == ',')
+            Spec++;
+        if (*Spec != 0)
+        {
+            Kind = *Spec++;
+            while (*Spec == ' ')
+                Spec++;
+            while (*Spec != 0 && *Spec != ',' && NameLength + 1 < TOOL_MAX_FIELD)
+                Names[Field][NameLength++] = *Spec++;
+        }
+        if (NameLength == 0)
+            NameLength = AsciiSPrint(Names[Field], TOOL_MAX_FIELD, "arg%d", Arg + 1);
+        Names[Field][NameLength] = 0;
+
+        switch (Kind)
+        {
+        case 'u':
+            AsciiSPrint(Values[Field], TOOL_MAX_FIELD, "%lu", Args[Arg]);
+            break;
+        case 'r':
+            AsciiSPrint(Values[Field], TOOL_MAX_FIELD, "%r", (EFI_STATUS)Args[Arg]);
+            break;
+        case 'g':
+        {
+            EFI_GUID Guid;
+
+            if (Arg + 1 >= ArgCount)
+                return Field;
+            CopyMem(&Guid, &Args[Arg], sizeof(Guid));
+            AsciiSPrint(Values[Field], TOOL_MAX_FIELD, "%g", &Guid);
+            Arg++;
+            break;
+        }
+        case 'b':
+        {
+            UINTN Count = Arg > 0 ? (UINTN)MIN(Args[Arg - 1], sizeof(UINT64)) : sizeof(UINT64);
+            UINTN Length = 0;
+
+            Values[Field][0] = 0;
+            for (UINTN i = 0; i < Count; i++)
+                Length += AsciiSPrint(&Values[Field][Length], TOOL_MAX_FIELD - Length, "%a%02x",
+                                      i > 0 ? " " : "", (UINT8)(Args[Arg] >> (i * 8)));
+            break;
+        }
+        default:
+            AsciiSPrint(Values[Field], TOOL_MAX_FIELD, "0x%lx", Args[Arg]);
+            break;
+        }
+
+        Arg++;
+        Field++;
+    }
+
+    return Field;
+}
+
+int main(int Argc, char **Argv)
+{
+    TRACE_FILE_HEADER *Header;
+    BOOLEAN Csv = FALSE;
+    CONST CHAR8 *Path;
+    UINT8 *Buffer;
+    UINTN Size;
+    UINTN Offset;
+    UINT64 FirstTimestamp = 0;
+    UINTN Events = 0;
+
+    if (Argc == 3 && strcmp(Argv[1], "-c") == 0)
+    {
+        Csv = TRUE;
+        Path = Argv[2];
+    }
+    else if (Argc == 2)
+    {
+        Path = Argv[1];
+    }
+    else
+    {
+        fprintf(stderr, "usage: %s [-c] <SREP.trace>\n", Argv[0]);
+        return 2;
+    }
+
+    if (EFI_ERROR(HostReadFile(Path, &Buffer, &Size)))
+    {
+        perror(Path);
+        return 1;
+    }
+
+    Header = (TRACE_FILE_HEADER *)Buffer;
+    if (Size < sizeof(TRACE_FILE_HEADER) || Header->Signature != TRACE_FILE_SIGNATURE ||
+        Header->Version != TRACE_FILE_VERSION)
+    {
+        fprintf(stderr, "%s: not a trace file\n", Path);
+        return 1;
+    }
+
+    if (Csv)
+        printf("tsc,elapsed_us,event,arg1,arg2,arg3,arg4\n");
+
+    for (Offset = sizeof(TRACE_FILE_HEADER); Offset + sizeof(TRACE_RECORD) <= Size; Events++)
+    {
+        CONST TRACE_RECORD *Record = (CONST TRACE_RECORD *)&Buffer[Offset];
+        CONST TOOL_EVENT *Event;
+        CHAR8 Names[TRACE_MAX_ARGS][TOOL_MAX_FIELD];
+        CHAR8 Values[TRACE_MAX_ARGS][TOOL_MAX_FIELD];
+        CHAR8 Elapsed[32] = "";
+        CHAR8 Unknown[16];
+        CONST CHAR8 *EventName;
+        UINTN Fields;
+
+        if (Record->ArgCount > TRACE_MAX_ARGS ||
+            Offset + sizeof(TRACE_RECORD) + Record->ArgCount * sizeof(UINT64) > Size)
+        {
+            fprintf(stderr, "%s: damaged record at offset 0x%lx\n", Path, (unsigned long)Offset);
+            break;
+        }
+
+        if (Events == 0)
+            FirstTimestamp = Record->Timestamp;
+        if (Header->TscFrequency != 0)
+            snprintf(Elapsed, sizeof(Elapsed), "%.3f",
+                     (double)(Record->Timestamp - FirstTimestamp) * 1e6 / (double)Header->TscFrequency);
+
+        Event = ToolFindEvent(Record->Event);
+        if (Event != NULL)
+        {
+            // Catalog names without the TRACE_ prefix
+            EventName = Event->Name + sizeof("TRACE_") - 1;
+        }
+        else
+        {
+            AsciiSPrint(Unknown, sizeof(Unknown), "EVENT_%d", Record->Event);
+            EventName = Unknown;
+        }
+
+        Fields = ToolFormatArgs(Event, (CONST UINT64 *)(Record + 1), Record->ArgCount, Names, Values);
+
+        if (Csv)
+        {
+            printf("%llu,%s,%s", (unsigned long long)Record->Timestamp, Elapsed, EventName);
+            for (UINTN i = 0; i < TRACE_MAX_ARGS; i++)
+                printf(",%s", i < Fields ? Values[i] : "");
+            printf("\n");
+        }
+        else
+        {
+            if (Header->TscFrequency != 0)
+                printf("%14s us  %-14s", Elapsed, EventName);
+            else
+                printf("%14llu tsc %-14s", (unsigned long long)(Record->Timestamp - FirstTimestamp), EventName);
+            for (UINTN i = 0; i < Fields; i++)
+                printf(" %s=%s", Names[i], Values[i]);
+            printf("\n");
+        }
+
+        Offset += sizeof(TRACE_RECORD) + Record->ArgCount * sizeof(UINT64);
+    }
+
+    if (!Csv)
+        fprintf(stderr, "%lu events\n", (unsigned long)Events);
+
+    FreePool(Buffer);
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "IfrIndex.h"
+#include "TaggedPool.h"
+
+// Initial node capacity; a Setup FormSet typically decodes to a few thousand nodes
+#define IFR_INDEX_INITIAL_CAPACITY 256
+
+/**
+ * Helper: Make room for one more node
+ */
+STATIC BOOLEAN IfrIndexReserve(IFR_INDEX *Index)
+{
+    IFR_OP_NODE *NewNodes;
+    UINTN NewCapacity;
+
+    if (Index->Count < Index->Capacity)
+        return TRUE;
+
+    if (Index->FixedCapacity)
+        return FALSE;
+
+    NewCapacity = Index->Capacity == 0 ? IFR_INDEX_INITIAL_CAPACITY : Index->Capacity * 2;
+    NewNodes = TaggedAllocatePool(POOL_TAG_IFR, NewCapacity * sizeof(IFR_OP_NODE));
+    if (NewNodes == NULL)
+        return FALSE;
+
+    if (Index->Nodes != NULL)
+    {
+        CopyMem(NewNodes, Index->Nodes, Index->Count * sizeof(IFR_OP_NODE));
+        TaggedFreePool(Index->Nodes);
+    }
+
+    Index->Nodes = NewNodes;
+    Index->Capacity = NewCapacity;
+    return TRUE;
+}
+
+/**
+ * Initialize an index backed by caller storage
+ */
+VOID IfrIndexInitFixed(IFR_INDEX *Index, IFR_OP_NODE *Buffer, UINTN Capacity)
+{
+    ZeroMem(Index, sizeof(IFR_INDEX));
+    Index->Nodes = Buffer;
+    Index->Capacity = Capacity;
+    Index->FixedCapacity = TRUE;
+}
+
+/**
+ * Decode an IFR opcode stream into a flat node array
+ */
+EFI_STATUS IfrIndexBuild(IFR_INDEX *Index, UINT8 *Data, UINTN Size, UINT32 Flags)
+{
+    UINT32 Scopes[IFR_INDEX_MAX_DEPTH];
+    UINTN Depth = 0;
+    UINTN Offset = 0;
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    if (Index == NULL || Data == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    if (Size > MAX_UINT32)
+        Size = MAX_UINT32;
+
+    Index->Data = Data;
+    Index->Size = Size;
+    Index->End = 0;
+    Index->Count = 0;
+
+    while (Offset + sizeof(EFI_IFR_OP_HEADER) <= Size)
+    {
+        EFI_IFR_OP_HEADER *OpHeader = (EFI_IFR_OP_HEADER *)&Data[Offset];
+        IFR_OP_NODE *Node;
+
+        if (OpHeader->Length < sizeof(EFI_IFR_OP_HEADER) || OpHeader->Length > Size - Offset)
+        {
+            Status = EFI_VOLUME_CORRUPTED;
+            break;
+        }
+
+        if (OpHeader->OpCode == EFI_IFR_END_OP && Depth == 0)
+        {
+            Status = EFI_VOLUME_CORRUPTED;
+            break;
+        }
+
+        if (OpHeader->Scope && Depth == IFR_INDEX_MAX_DEPTH)
+        {
+            Status = EFI_VOLUME_CORRUPTED;
+            break;
+        }
+
+        if (!IfrIndexReserve(Index))
+        {
+            Status = EFI_OUT_OF_RESOURCES;
+            break;
+        }
+
+        Node = &Index->Nodes[Index->Count];
+        Node->Offset = (UINT32)Offset;
+        Node->Parent = Depth > 0 ? Scopes[Depth - 1] : IFR_NODE_NONE;
+        Node->OpCode = OpHeader->OpCode;
+        Node->Length = OpHeader->Length;
+        Node->Depth = (UINT16)Depth;
+
+        if (OpHeader->Scope)
+            Scopes[Depth++] = (UINT32)Index->Count;
+        else if (OpHeader->OpCode == EFI_IFR_END_OP)
+            Depth--;
+
+        Index->Count++;
+        Offset += OpHeader->Length;
+
+        if ((Flags & IFR_INDEX_STOP_AT_ROOT_END) != 0 && Depth == 0)
+            break;
+    }
+
+    Index->End = Offset;
+
+    if (!EFI_ERROR(Status) && Depth != 0)
+        Status = EFI_VOLUME_CORRUPTED;
+
+    return Status;
+}
+
+/**
+ * Free the node buffer of an index (caller storage is left alone)
+ */
+VOID IfrIndexFree(IFR_INDEX *Index)
+{
+    if (Index == NULL)
+        return;
+
+    if (Index->Nodes != NULL && !Index->FixedCapacity)
+        TaggedFreePool(Index->Nodes);
+
+    ZeroMem(Index, sizeof(IFR_INDEX));
+}
+
+/**
+ * Get the opcode header of a node
+ */
+EFI_IFR_OP_HEADER *IfrIndexOp(IFR_INDEX *Index, UINTN Node)
+{
+    return (EFI_IFR_OP_HEADER *)&Index->Data[Index->Nodes[Node].Offset];
+}
+
+/**
+ * Find the end of a node's scope
+ */
+UINTN IfrIndexScopeEnd(IFR_INDEX *Index, UINTN Node)
+{
+    UINT16 Depth = Index->Nodes[Node].Depth;
+    UINTN Next;
+
+    for (Next = Node + 1; Next < Index->Count; Next++)
+    {
+        if (Index->Nodes[Next].Depth <= Depth)
+            break;
+    }
+
+    return Next;
+}
+
+/**
+ * Check whether a node is nested inside an opcode of the given type
+ */
+BOOLEAN IfrIndexInScopeOf(IFR_INDEX *Index, UINTN Node, UINT8 OpCode, UINTN Stop)
+{
+    UINT32 Parent = Index->Nodes[Node].Parent;
+
+    while (Parent != IFR_NODE_NONE && Parent != Stop)
+    {
+        if (Index->Nodes[Parent].OpCode == OpCode)
+            return TRUE;
+        Parent = Index->Nodes[Parent].Parent;
+    }
+
+    return FALSE;
+}
+
+/**
+ * Find the FORM node with the given form ID
+ */
+UINTN IfrIndexFindForm(IFR_INDEX *Index, UINT16 FormId)
+{
+    UINTN Node;
+
+    for (Node = 0; Node < Index->Count; Node++)
+    {
+        if (Index->Nodes[Node].OpCode == EFI_IFR_FORM_OP &&
+            Index->Nodes[Node].Length >= sizeof(EFI_IFR_FORM) &&
+            ((EFI_IFR_FORM *)IfrIndexOp(Index, Node))->FormId == FormId)
+            return Node;
+    }
+
+    return IFR_NODE_NONE;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Uefi/UefiInternalFormRepresentation.h>
+
+// Parent index of nodes that are not inside any scope
+#define IFR_NODE_NONE MAX_UINT32
+
+// Deepest scope nesting accepted before the stream is considered malformed
+#define IFR_INDEX_MAX_DEPTH 64
+
+// IfrIndexBuild flags
+#define IFR_INDEX_STOP_AT_ROOT_END BIT0   // Stop once the first opcode's scope closes
+
+// One decoded opcode
+typedef struct {
+    UINT32 Offset;               // Offset of the opcode from the start of the stream
+    UINT32 Parent;               // Node whose scope contains this one (END belongs to the scope it closes)
+    UINT8 OpCode;
+    UINT8 Length;
+    UINT16 Depth;                // Number of open scopes around this opcode
+} IFR_OP_NODE;
+
+// Flat opcode index of one IFR stream
+typedef struct {
+    UINT8 *Data;                 // Stream the node offsets refer to (not owned)
+    UINTN Size;                  // Bytes available in the stream
+    UINTN End;                   // Bytes consumed by the last build
+    IFR_OP_NODE *Nodes;
+    UINTN Count;
+    UINTN Capacity;
+    BOOLEAN FixedCapacity;       // Nodes is caller storage and never grows
+} IFR_INDEX;
+
+/**
+ * Initialize an index backed by caller storage
+ *
+ * The index never allocates; a stream with more than Capacity opcodes fails
+ * with EFI_OUT_OF_RESOURCES. Such an index can be built on an AP.
+ *
+ * @param Index         Index to initialize
+ * @param Buffer        Node storage
+ * @param Capacity      Number of nodes in Buffer
+ */
+VOID IfrIndexInitFixed(IFR_INDEX *Index, IFR_OP_NODE *Buffer, UINTN Capacity);
+
+/**
+ * Decode an IFR opcode stream into a flat node array
+ *
+ * The node buffer of Index is reused across builds and grown as needed.
+ * Nodes decoded before a malformed opcode are kept.
+ *
+ * @param Index         Index to fill (zero-initialize before first use)
+ * @param Data          IFR opcode stream
+ * @param Size          Size of the stream
+ * @param Flags         IFR_INDEX_* flags
+ * @return EFI_SUCCESS if the stream (or root scope) decoded cleanly
+ * @return EFI_VOLUME_CORRUPTED on a malformed or unterminated stream
+ * @return EFI_OUT_OF_RESOURCES if the node buffer could not grow
+ */
+EFI_STATUS IfrIndexBuild(IFR_INDEX *Index, UINT8 *Data, UINTN Size, UINT32 Flags);
+
+/**
+ * Free the node buffer of an index (caller storage is left alone)
+ *
+ * @param Index         Index to free
+ */
+VOID IfrIndexFree(IFR_INDEX *Index);
+
+/**
+ * Get the opcode header of a node
+ *
+ * @param Index         IFR index
+ * @param Node          Node index
+ * @return Pointer to the opcode in the indexed stream
+ */
+EFI_IFR_OP_HEADER *IfrIndexOp(IFR_INDEX *Index, UINTN Node);
+
+/**
+ * Find the end of a node's scope
+ *
+ * @param Index         IFR index
+ * @param Node          Node index
+ * @return Index one past the last node inside the scope (its END included)
+ */
+UINTN IfrIndexScopeEnd(IFR_INDEX *Index, UINTN Node);
+
+/**
+ * Check whether a node is nested inside an opcode of the given type
+ *
+ * @param Index         IFR index
+ * @param Node          Node index
+ * @param OpCode        Opcode to look for among the ancestors
+ * @param Stop          Ancestor at which the search stops (IFR_NODE_NONE for the root)
+ * @return TRUE if an ancestor below Stop has that opcode
+ */
+BOOLEAN IfrIndexInScopeOf(IFR_INDEX *Index, UINTN Node, UINT8 OpCode, UINTN Stop);
+
+/**
+ * Find the FORM node with the given form ID
+ *
+ * @param Index         IFR index
+ * @param FormId        Form ID to look for
+ * @return Node index, or IFR_NODE_NONE if not found
+ */
+UINTN IfrIndexFindForm(IFR_INDEX *Index, UINT16 FormId);
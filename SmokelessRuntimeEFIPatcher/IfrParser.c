@@ -1,220 +1,403 @@
 #include "IfrParser.h"
+#include "ByteScan.h"
 #include <Library/PrintLib.h>
 
 extern char Log[512];
 extern EFI_FILE *LogFile;
 void LogToFile(EFI_FILE *LogFile, char *String);
 
+// Low two bits of EFI_IFR_FORM_SET.Flags hold the number of class GUIDs
+#define IFR_FORM_SET_CLASS_GUID_MASK 0x03
+
+// Longest walk of a FormSet that no package header bounds
+#define IFR_FORM_SET_MAX_UNBOUNDED SIZE_64KB
+
+/**
+ * Helper: Validate a full EFI_IFR_FORM_SET header at Data
+ *
+ * Returns the size of the header including its class GUIDs, or 0 when the
+ * bytes cannot be a FormSet (wrong length for the class GUID count, no scope,
+ * reserved flag bits set, blank GUID or a malformed first child opcode).
+ */
+STATIC UINTN IfrFormSetHeaderSize(UINT8 *Data, UINTN Size)
+{
+    EFI_IFR_FORM_SET *FormSet = (EFI_IFR_FORM_SET *)Data;
+    EFI_IFR_OP_HEADER *FirstChild;
+    UINTN ClassGuidCount;
+    UINTN HeaderSize;
+    UINTN Index;
+
+    if (Size < sizeof(EFI_IFR_FORM_SET) + sizeof(EFI_IFR_OP_HEADER))
+        return 0;
+
+    if (FormSet->Header.OpCode != EFI_IFR_FORM_SET_OP || FormSet->Header.Scope == 0)
+        return 0;
+
+    if ((FormSet->Flags & ~IFR_FORM_SET_CLASS_GUID_MASK) != 0)
+        return 0;
+
+    // 0 to 3 class GUIDs follow the fixed header
+    ClassGuidCount = FormSet->Flags & IFR_FORM_SET_CLASS_GUID_MASK;
+    HeaderSize = sizeof(EFI_IFR_FORM_SET) + ClassGuidCount * sizeof(EFI_GUID);
+    if (FormSet->Header.Length != HeaderSize || HeaderSize + sizeof(EFI_IFR_OP_HEADER) > Size)
+        return 0;
+
+    if (FormSet->FormSetTitle == 0 || IsZeroGuid(&FormSet->Guid))
+        return 0;
+
+    // Erased flash reads back as 0xFF
+    for (Index = 0; Index < sizeof(EFI_GUID); Index++)
+    {
+        if (((UINT8 *)&FormSet->Guid)[Index] != 0xFF)
+            break;
+    }
+    if (Index == sizeof(EFI_GUID))
+        return 0;
+
+    FirstChild = (EFI_IFR_OP_HEADER *)(Data + HeaderSize);
+    if (FirstChild->Length < sizeof(EFI_IFR_OP_HEADER))
+        return 0;
+
+    return HeaderSize;
+}
+
 /**
  * Helper: Check if data is likely IFR opcode stream
  */
 BOOLEAN IsIfrData(UINT8 *Data, UINTN Size)
 {
-    if (Size < 4)
-        return FALSE;
+    return IfrFormSetHeaderSize(Data, Size) != 0;
+}
+
+/**
+ * Helper: Upper bound for a FormSet at Offset
+ *
+ * VFR output places the FormSet right after an EFI_HII_PACKAGE_HEADER of type
+ * FORMS. When that header is present its length bounds the walk, otherwise
+ * the rest of the section does, up to IFR_FORM_SET_MAX_UNBOUNDED bytes. A
+ * malformed candidate is retried one byte later, so without that cap a run
+ * of them would walk the section over and over.
+ */
+STATIC UINTN IfrFormSetLimit(UINT8 *Data, UINTN RangeStart, UINTN RangeEnd, UINTN Offset, UINTN HeaderSize)
+{
+    EFI_HII_PACKAGE_HEADER *Package;
+    UINTN PackageStart;
+    UINTN Unbounded = RangeEnd;
+
+    if (RangeEnd - Offset > IFR_FORM_SET_MAX_UNBOUNDED)
+        Unbounded = Offset + IFR_FORM_SET_MAX_UNBOUNDED;
 
-    // Look for IFR FormSet opcode at the start
-    if (Data[0] == EFI_IFR_FORM_SET_OP && Data[1] >= 0x1C)
-        return TRUE;
+    if (Offset - RangeStart < sizeof(EFI_HII_PACKAGE_HEADER))
+        return Unbounded;
 
-    return FALSE;
+    PackageStart = Offset - sizeof(EFI_HII_PACKAGE_HEADER);
+    Package = (EFI_HII_PACKAGE_HEADER *)&Data[PackageStart];
+    if (Package->Type != EFI_HII_PACKAGE_FORMS ||
+        Package->Length < sizeof(EFI_HII_PACKAGE_HEADER) + HeaderSize ||
+        Package->Length > RangeEnd - PackageStart)
+        return Unbounded;
+
+    return PackageStart + Package->Length;
 }
 
 /**
- * Parse IFR data and generate patch list
+ * Helper: Index one FormSet scope and plan hide-condition patches
+ *
+ * The FormSet at Start is decoded into Index (stopping after the END that
+ * closes it) and the patches are planned from the nodes. On success *End is
+ * the offset just past that END. Any malformed opcode fails the whole FormSet.
  */
-EFI_STATUS ParseIfrData(VOID *ImageBase, UINTN ImageSize, IFR_PATCH **PatchList)
+STATIC EFI_STATUS ParseIfrFormSet(
+    UINT8 *Data,
+    UINTN Start,
+    UINTN Limit,
+    IFR_INDEX *Index,
+    UINTN *End,
+    PATCH_PLAN *Plan,
+    UINTN *PatchCount)
 {
-    UINT8 *Data = (UINT8 *)ImageBase;
-    UINTN Offset = 0;
-    IFR_PATCH *Head = NULL;
-    IFR_PATCH *Current = NULL;
-    UINTN PatchCount = 0;
+    STATIC CONST UINT8 FalseOp = EFI_IFR_FALSE_OP;
+    EFI_STATUS Status;
+    UINTN Node;
 
-    if (ImageBase == NULL || PatchList == NULL)
-        return EFI_INVALID_PARAMETER;
+    Status = IfrIndexBuild(Index, &Data[Start], Limit - Start, IFR_INDEX_STOP_AT_ROOT_END);
+    if (EFI_ERROR(Status))
+        return Status;
 
-    *PatchList = NULL;
+    for (Node = 0; Node + 1 < Index->Count; Node++)
+    {
+        IFR_OP_NODE *HideOp = &Index->Nodes[Node];
+        IFR_OP_NODE *Condition = &Index->Nodes[Node + 1];
+        PATCH_REASON Reason;
+
+        // Check for opcodes that hide forms/menus
+        if (HideOp->OpCode == EFI_IFR_SUPPRESS_IF_OP)
+            Reason = PATCH_REASON_SUPPRESS_IF;
+        else if (HideOp->OpCode == EFI_IFR_GRAY_OUT_IF_OP)
+            Reason = PATCH_REASON_GRAY_OUT_IF;
+        else if (HideOp->OpCode == EFI_IFR_DISABLE_IF_OP)
+            Reason = PATCH_REASON_DISABLE_IF;
+        else
+            continue;
+
+        // Strategy: Patch the condition (first opcode inside the scope)
+        // to FALSE so the suppress/grayout/disable never triggers
+        if (Condition->Parent != Node)
+            continue;
+
+        if (!EFI_ERROR(PatchPlanAdd(Plan, Start + Condition->Offset, &Condition->OpCode, &FalseOp, 1, Reason)))
+            (*PatchCount)++;
+    }
 
-    // Don't log for every module - too verbose
-    // Only log when patches are found
+    *End = Start + Index->End;
+    return EFI_SUCCESS;
+}
 
-    // Search for IFR data in the image
-    for (Offset = 0; Offset < ImageSize - 4; Offset++)
+/**
+ * Helper: Plan the FormSets whose FORM_SET opcode lies in [Start, End)
+ *
+ * FormSets are validated and indexed up to the end of the section. Offsets
+ * below *Cursor are skipped, and *Cursor is left past the last FormSet
+ * indexed (or at End), so a range can be planned in consecutive pieces.
+ * With Guids the GUID of every valid FormSet header is added to it; without
+ * a Plan only the GUIDs are collected.
+ */
+STATIC EFI_STATUS IfrPlanRange(
+    UINT8 *Data,
+    CONST IMAGE_SECTION *Section,
+    UINTN Start,
+    UINTN End,
+    UINTN *Cursor,
+    PATCH_PLAN *Plan,
+    IFR_INDEX *Index,
+    FORMSET_GUID_SET *Guids,
+    UINTN *FormSetCount,
+    UINTN *PatchCount)
+{
+    UINTN SectionEnd = (UINTN)Section->Offset + Section->Size;
+    UINTN Offset = MAX(Start, *Cursor);
+
+    while (Offset < End)
     {
-        if (IsIfrData(&Data[Offset], ImageSize - Offset))
+        UINT8 *Hit = ScanMem8(&Data[Offset], End - Offset, EFI_IFR_FORM_SET_OP);
+        UINTN Candidate;
+        UINTN HeaderSize;
+        UINTN Limit;
+        UINTN FormSetEnd;
+        EFI_STATUS Status;
+
+        if (Hit == NULL)
+            break;
+
+        Candidate = (UINTN)(Hit - Data);
+        HeaderSize = IfrFormSetHeaderSize(Hit, SectionEnd - Candidate);
+        if (HeaderSize == 0)
+        {
+            Offset = Candidate + 1;
+            continue;
+        }
+
+        if (Guids != NULL)
         {
-            // Don't log every IFR data location - too verbose
-            // Will log summary at the end
+            EFI_GUID Guid;
 
-            UINTN IfrOffset = Offset;
-            UINTN IfrEnd = ImageSize;
+            CopyMem(&Guid, &((EFI_IFR_FORM_SET *)Hit)->Guid, sizeof(Guid));
+            (VOID)FormSetGuidSetAdd(Guids, &Guid);
+        }
 
-            // Parse IFR opcodes
-            while (IfrOffset < IfrEnd - 2)
-            {
-                EFI_IFR_OP_HEADER *OpHeader = (EFI_IFR_OP_HEADER *)&Data[IfrOffset];
-
-                if (OpHeader->Length == 0 || OpHeader->Length > 0xFF)
-                    break;
-
-                // Check for opcodes that hide forms/menus
-                if (OpHeader->OpCode == EFI_IFR_SUPPRESS_IF_OP ||
-                    OpHeader->OpCode == EFI_IFR_GRAY_OUT_IF_OP ||
-                    OpHeader->OpCode == EFI_IFR_DISABLE_IF_OP)
-                {
-                    // Don't log every hideable element - too verbose
-                    // Will create patch and log when applied
-
-                    // Strategy: Patch the condition following these opcodes
-                    // Look at the next opcode to see what condition it is
-                    UINTN NextOffset = IfrOffset + OpHeader->Length;
-                    if (NextOffset < IfrEnd - 2)
-                    {
-                        EFI_IFR_OP_HEADER *NextOp = (EFI_IFR_OP_HEADER *)&Data[NextOffset];
-                        
-                        // Create a patch to change the condition to FALSE
-                        // This way, the suppress/grayout/disable will never trigger
-                        IFR_PATCH *Patch = AllocateZeroPool(sizeof(IFR_PATCH));
-                        if (Patch != NULL)
-                        {
-                            Patch->Offset = NextOffset;
-                            Patch->OriginalOpCode = NextOp->OpCode;
-                            Patch->NewOpCode = EFI_IFR_FALSE_OP;
-                            
-                            if (OpHeader->OpCode == EFI_IFR_SUPPRESS_IF_OP)
-                                UnicodeSPrint(Patch->Description, sizeof(Patch->Description), 
-                                            L"Patch SuppressIf condition at 0x%x", NextOffset);
-                            else if (OpHeader->OpCode == EFI_IFR_GRAY_OUT_IF_OP)
-                                UnicodeSPrint(Patch->Description, sizeof(Patch->Description), 
-                                            L"Patch GrayoutIf condition at 0x%x", NextOffset);
-                            else
-                                UnicodeSPrint(Patch->Description, sizeof(Patch->Description), 
-                                            L"Patch DisableIf condition at 0x%x", NextOffset);
-
-                            // Add to linked list
-                            if (Head == NULL)
-                            {
-                                Head = Patch;
-                                Current = Patch;
-                            }
-                            else
-                            {
-                                Current->Next = Patch;
-                                Current = Patch;
-                            }
-                            PatchCount++;
-                        }
-                    }
-                }
-
-                IfrOffset += OpHeader->Length;
-
-                // Safety check: if we hit EndFormSet, we're done with this IFR section
-                if (OpHeader->OpCode == EFI_IFR_END_OP)
-                    break;
-            }
+        if (Plan == NULL)
+        {
+            Offset = Candidate + HeaderSize;
+            continue;
         }
-    }
 
-    *PatchList = Head;
-    
-    // Only log if patches were found (reduce verbosity)
-    if (PatchCount > 0)
-    {
-        AsciiSPrint(Log, 512, "Found %d IFR patches in module\n\r", PatchCount);
-        LogToFile(LogFile, Log);
+        Limit = IfrFormSetLimit(Data, Section->Offset, SectionEnd, Candidate, HeaderSize);
+        Status = ParseIfrFormSet(Data, Candidate, Limit, Index, &FormSetEnd, Plan, PatchCount);
+        if (Status == EFI_OUT_OF_RESOURCES)
+            return Status;
+
+        if (EFI_ERROR(Status))
+        {
+            Offset = Candidate + 1;
+            continue;
+        }
+
+        (*FormSetCount)++;
+        Offset = FormSetEnd;
     }
 
-    return PatchCount > 0 ? EFI_SUCCESS : EFI_NOT_FOUND;
+    *Cursor = MAX(Offset, End);
+    return EFI_SUCCESS;
 }
 
 /**
- * Apply IFR patches to a module
+ * Plan hide-condition patches for the FormSets of an image
+ *
+ * Only data sections are searched. Candidate FORM_SET bytes are located with
+ * ScanMem8 and validated before they are indexed. Once a FormSet indexes
+ * cleanly the cursor resumes after its closing END, so the bytes of a FormSet
+ * are decoded exactly once. Patch offsets are relative to the image base.
  */
-EFI_STATUS ApplyIfrPatches(VOID *ImageBase, UINTN ImageSize, IFR_PATCH *PatchList)
+EFI_STATUS IfrPlanHideConditions(
+    IMAGE_SECTION_MAP *Map,
+    PATCH_PLAN *Plan,
+    IFR_INDEX *Index,
+    UINTN *FormSetCount)
 {
-    UINT8 *Data = (UINT8 *)ImageBase;
-    IFR_PATCH *Current = PatchList;
-    UINTN AppliedCount = 0;
+    UINTN PatchCount = 0;
+    UINTN s;
 
-    if (ImageBase == NULL || PatchList == NULL)
+    if (Map == NULL || Map->ImageBase == NULL || Plan == NULL || Index == NULL || FormSetCount == NULL)
         return EFI_INVALID_PARAMETER;
 
-    // Don't log "Applying IFR patches..." for every module - too verbose
-    // Will log summary at the end
+    *FormSetCount = 0;
 
-    while (Current != NULL)
+    for (s = 0; s < Map->SectionCount; s++)
     {
-        if (Current->Offset < ImageSize)
-        {
-            // Verify original opcode matches
-            if (Data[Current->Offset] == Current->OriginalOpCode)
-            {
-                Data[Current->Offset] = Current->NewOpCode;
-                AppliedCount++;
-                
-                // Only log individual patches if there are few of them
-                // Otherwise just log the count
-                if (AppliedCount <= 5)
-                {
-                    AsciiSPrint(Log, 512, "  Patched: %s (0x%02x -> 0x%02x)\n\r",
-                               Current->Description, Current->OriginalOpCode, Current->NewOpCode);
-                    LogToFile(LogFile, Log);
-                }
-            }
-            // Don't log warnings for mismatches - already patched locations will show this
-        }
-        Current = Current->Next;
+        IMAGE_SECTION *Section = &Map->Sections[s];
+        UINTN Cursor = Section->Offset;
+
+        if ((Section->Kind & IMAGE_SECTION_DATA) == 0)
+            continue;
+
+        if (IfrPlanRange(Map->ImageBase, Section, Section->Offset, (UINTN)Section->Offset + Section->Size,
+                         &Cursor, Plan, Index, NULL, FormSetCount, &PatchCount) == EFI_OUT_OF_RESOURCES)
+            return EFI_OUT_OF_RESOURCES;
     }
 
-    // Only log if patches were applied
-    if (AppliedCount > 0)
+    // A fixed-capacity plan that filled up is incomplete
+    if (Plan->Overflow)
+        return EFI_OUT_OF_RESOURCES;
+
+    return PatchCount > 0 ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+/**
+ * Helper: Pipeline chunk callback of the IFR planning stage
+ */
+STATIC VOID IfrPlanStageChunk(
+    VOID *Context,
+    IMAGE_SECTION_MAP *Map,
+    CONST IMAGE_SECTION *Section,
+    UINTN Start,
+    UINTN End)
+{
+    IFR_PLAN_STAGE *State = (IFR_PLAN_STAGE *)Context;
+
+    if (State->Status == EFI_OUT_OF_RESOURCES)
+        return;
+
+    // The cursor is absolute; a new section starts over
+    if (Start == Section->Offset)
+        State->Cursor = Start;
+
+    State->Status = IfrPlanRange(Map->ImageBase, Section, Start, End, &State->Cursor, State->Plan,
+                                 &State->Index, State->Guids, &State->FormSetCount, &State->PatchCount);
+}
+
+VOID IfrPlanStageInit(IFR_PLAN_STAGE *State, PATCH_PLAN *Plan, FORMSET_GUID_SET *Guids, PATCH_PIPELINE_STAGE *Stage)
+{
+    ZeroMem(State, sizeof(IFR_PLAN_STAGE));
+    State->Plan = Plan;
+    State->Guids = Guids;
+
+    ZeroMem(Stage, sizeof(PATCH_PIPELINE_STAGE));
+    Stage->Name = "ParseIfrData";
+    Stage->KindMask = IMAGE_SECTION_DATA;
+    Stage->Chunk = IfrPlanStageChunk;
+    Stage->Context = State;
+}
+
+EFI_STATUS IfrPlanStageDone(IFR_PLAN_STAGE *State)
+{
+    IfrIndexFree(&State->Index);
+    if (State->Plan == NULL)
+        return State->Status == EFI_OUT_OF_RESOURCES ? EFI_OUT_OF_RESOURCES : EFI_NOT_FOUND;
+
+    // Same log line and result as ParseIfrData
+    if (State->PatchCount > 0)
     {
-        AsciiSPrint(Log, 512, "Applied %d IFR patches\n\r", AppliedCount);
+        AsciiSPrint(Log, 512, "Found %d IFR patches in %d FormSets\n\r", State->PatchCount, State->FormSetCount);
         LogToFile(LogFile, Log);
     }
 
-    return EFI_SUCCESS;
+    if (State->Status == EFI_OUT_OF_RESOURCES || State->Plan->Overflow)
+        return EFI_OUT_OF_RESOURCES;
+    return State->PatchCount > 0 ? EFI_SUCCESS : EFI_NOT_FOUND;
 }
 
 /**
- * Free IFR patch list
+ * Parse IFR data and generate patch list
  */
-VOID FreeIfrPatchList(IFR_PATCH *PatchList)
+EFI_STATUS ParseIfrData(IMAGE_SECTION_MAP *Map, PATCH_PLAN *Plan)
 {
-    IFR_PATCH *Current = PatchList;
-    while (Current != NULL)
+    EFI_STATUS Status;
+    UINTN PatchCount;
+    UINTN FormSetCount = 0;
+    IFR_INDEX Index;
+
+    if (Plan == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    ZeroMem(&Index, sizeof(Index));
+    PatchCount = Plan->Count;
+    Status = IfrPlanHideConditions(Map, Plan, &Index, &FormSetCount);
+    PatchCount = Plan->Count - PatchCount;
+    IfrIndexFree(&Index);
+
+    // Only log if patches were found (reduce verbosity)
+    if (PatchCount > 0)
     {
-        IFR_PATCH *Next = Current->Next;
-        FreePool(Current);
-        Current = Next;
+        AsciiSPrint(Log, 512, "Found %d IFR patches in %d FormSets\n\r", PatchCount, FormSetCount);
+        LogToFile(LogFile, Log);
     }
+
+    if (Status == EFI_INVALID_PARAMETER || Status == EFI_OUT_OF_RESOURCES)
+        return Status;
+
+    return PatchCount > 0 ? EFI_SUCCESS : EFI_NOT_FOUND;
 }
 
+// SuppressIf { TRUE } around advanced menus: 0A xx xx 46
+STATIC CONST BYTE_PATTERN mAmiSuppressTruePattern[] = {
+    { { EFI_IFR_SUPPRESS_IF_OP, 0x00, 0x00, EFI_IFR_TRUE_OP }, { 0xFF, 0x00, 0x00, 0xFF }, 4 }
+};
+
 /**
- * Patch AMI BIOS forms - look for specific patterns
+ * Helper: ByteScan callback for PatchAmiForms
  */
-UINTN PatchAmiForms(VOID *ImageBase, UINTN ImageSize)
+STATIC BOOLEAN AmiSuppressTrueMatch(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex)
 {
-    UINT8 *Data = (UINT8 *)ImageBase;
+    STATIC CONST UINT8 False = EFI_IFR_FALSE_OP;
+
+    // Patch TRUE to FALSE
+    (VOID)PatchPlanWrite(Data, Offset + 3, &False, 1, PATCH_REASON_AMI_FORM);
+    (*(UINTN *)Context)++;
+    return TRUE;
+}
+
+/**
+ * Patch AMI BIOS forms - look for specific patterns in data sections
+ */
+UINTN PatchAmiForms(IMAGE_SECTION_MAP *Map)
+{
+    BYTE_SCANNER Scanner;
     UINTN PatchCount = 0;
 
     // Don't log "Applying AMI-specific..." for every module - too verbose
 
     // AMI often uses specific patterns for advanced menus
     // Look for common suppress patterns
-    for (UINTN i = 0; i < ImageSize - 16; i++)
+    ByteScanInit(&Scanner, mAmiSuppressTruePattern, ARRAY_SIZE(mAmiSuppressTruePattern));
+    for (UINTN s = 0; s < Map->SectionCount; s++)
     {
-        // Pattern: SuppressIf { TRUE } around advanced menus
-        if (Data[i] == EFI_IFR_SUPPRESS_IF_OP &&
-            i + 4 < ImageSize &&
-            Data[i + 3] == EFI_IFR_TRUE_OP)
-        {
-            // Patch TRUE to FALSE
-            Data[i + 3] = EFI_IFR_FALSE_OP;
-            PatchCount++;
-        }
+        IMAGE_SECTION *Section = &Map->Sections[s];
+
+        if ((Section->Kind & IMAGE_SECTION_DATA) == 0)
+            continue;
+
+        ByteScan(&Scanner, Map->ImageBase, Section->Offset, (UINTN)Section->Offset + Section->Size,
+                 AmiSuppressTrueMatch, &PatchCount);
     }
 
     // Only log if patches were applied
@@ -227,63 +410,105 @@ UINTN PatchAmiForms(VOID *ImageBase, UINTN ImageSize)
     return PatchCount;
 }
 
+VOID PatchAmiFormsStage(UINTN *PatchCount, PATCH_PIPELINE_STAGE *Stage)
+{
+    ZeroMem(Stage, sizeof(PATCH_PIPELINE_STAGE));
+    Stage->Name = "PatchAmiForms";
+    Stage->KindMask = IMAGE_SECTION_DATA;
+    Stage->Patterns = mAmiSuppressTruePattern;
+    Stage->PatternCount = ARRAY_SIZE(mAmiSuppressTruePattern);
+    Stage->Match = AmiSuppressTrueMatch;
+    Stage->Context = PatchCount;
+}
+
 /**
- * Patch Insyde H2O forms
+ * Collect the FormSet GUIDs of an image's IFR
+ *
+ * Candidates are validated like the ones ParseIfrData indexes.
  */
-UINTN PatchInsydeForms(VOID *ImageBase, UINTN ImageSize)
+UINTN IfrCollectFormSetGuids(IMAGE_SECTION_MAP *Map, FORMSET_GUID_SET *Set)
 {
-    UINT8 *Data = (UINT8 *)ImageBase;
-    UINTN PatchCount = 0;
+    UINT8 *Data;
+    UINTN Found = 0;
 
-    AsciiSPrint(Log, 512, "Applying Insyde-specific form patches...\n\r");
-    LogToFile(LogFile, Log);
+    if (Map == NULL || Map->ImageBase == NULL || Set == NULL)
+        return 0;
 
-    // Insyde H2O uses a different mechanism - form visibility flags
-    // The README example shows patching uint32_t isShown flags from 0 to 1
-    // Look for GUID + 00000000 pattern and change to GUID + 01000000
+    Data = Map->ImageBase;
+    for (UINTN s = 0; s < Map->SectionCount; s++)
+    {
+        IMAGE_SECTION *Section = &Map->Sections[s];
+        UINTN SectionEnd = (UINTN)Section->Offset + Section->Size;
+        UINTN Offset = Section->Offset;
 
-    // This is handled separately in the main code by searching for specific form GUIDs
-    // Here we can look for generic patterns
+        if ((Section->Kind & IMAGE_SECTION_DATA) == 0)
+            continue;
 
-    for (UINTN i = 0; i < ImageSize - 20; i++)
-    {
-        // Look for 16-byte GUID followed by 4-byte zero (little-endian)
-        // This might be a form visibility structure
-        if (Data[i + 16] == 0x00 &&
-            Data[i + 17] == 0x00 &&
-            Data[i + 18] == 0x00 &&
-            Data[i + 19] == 0x00)
+        while (Offset < SectionEnd)
         {
-            // Check if this looks like it might be after a GUID
-            // (very heuristic - would need more context in real implementation)
-            BOOLEAN MightBeFormStruct = TRUE;
-            
-            // Simple heuristic: check if bytes before look somewhat random (like a GUID)
-            if (i >= 16)
-            {
-                // Check for some variation in the previous 16 bytes
-                UINT8 FirstByte = Data[i - 16];
-                BOOLEAN HasVariation = FALSE;
-                for (UINTN j = 1; j < 16; j++)
-                {
-                    if (Data[i - 16 + j] != FirstByte)
-                    {
-                        HasVariation = TRUE;
-                        break;
-                    }
-                }
-                MightBeFormStruct = HasVariation;
-            }
+            UINT8 *Hit = ScanMem8(&Data[Offset], SectionEnd - Offset, EFI_IFR_FORM_SET_OP);
+            UINTN Candidate;
+            UINTN HeaderSize;
+            EFI_GUID Guid;
+
+            if (Hit == NULL)
+                break;
 
-            if (MightBeFormStruct)
+            Candidate = (UINTN)(Hit - Data);
+            HeaderSize = IfrFormSetHeaderSize(Hit, SectionEnd - Candidate);
+            if (HeaderSize == 0)
             {
-                // Patch to 0x01000000
-                Data[i + 16] = 0x01;
-                PatchCount++;
+                Offset = Candidate + 1;
+                continue;
             }
+
+            CopyMem(&Guid, &((EFI_IFR_FORM_SET *)Hit)->Guid, sizeof(Guid));
+            if (!EFI_ERROR(FormSetGuidSetAdd(Set, &Guid)))
+                Found++;
+            Offset = Candidate + HeaderSize;
         }
     }
 
+    return Found;
+}
+
+/**
+ * Helper: FormSetGuidSetScan callback for PatchInsydeForms
+ */
+STATIC BOOLEAN InsydeFlagMatch(VOID *Context, UINT8 *Data, UINTN Offset)
+{
+    STATIC CONST UINT8 Shown = 0x01;
+    UINTN *PatchCount = (UINTN *)Context;
+
+    // [FormSet GUID][UINT32 isShown == 0] -> isShown = 1
+    if (ReadUnaligned32((UINT32 *)&Data[Offset + sizeof(EFI_GUID)]) == 0)
+    {
+        (VOID)PatchPlanWrite(Data, Offset + sizeof(EFI_GUID), &Shown, 1, PATCH_REASON_INSYDE_FORM);
+        (*PatchCount)++;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Patch Insyde H2O forms
+ */
+UINTN PatchInsydeForms(IMAGE_SECTION_MAP *Map)
+{
+    UINTN PatchCount = 0;
+
+    AsciiSPrint(Log, 512, "Applying Insyde-specific form patches...\n\r");
+    LogToFile(LogFile, Log);
+
+    // Insyde H2O uses a different mechanism - form visibility flags
+    // The README example shows patching uint32_t isShown flags from 0 to 1
+    // Only GUIDs of real FormSets (HII database and this image's IFR) are
+    // considered, so arbitrary 20-byte windows ending in zero are left alone
+    (VOID)FormSetGuidSetAddHii(&gFormSetGuids);
+    (VOID)IfrCollectFormSetGuids(Map, &gFormSetGuids);
+
+    FormSetGuidSetScan(&gFormSetGuids, Map, sizeof(UINT32), InsydeFlagMatch, &PatchCount);
+
     // Only log if patches were applied
     if (PatchCount > 0)
     {
@@ -293,3 +518,11 @@ UINTN PatchInsydeForms(VOID *ImageBase, UINTN ImageSize)
 
     return PatchCount;
 }
+
+VOID PatchInsydeFormsStage(FORMSET_GUID_STAGE *State, UINTN *PatchCount, PATCH_PIPELINE_STAGE *Stage)
+{
+    // This image's own FormSets come from the IFR planning stage as it goes
+    (VOID)FormSetGuidSetAddHii(&gFormSetGuids);
+    FormSetGuidStageInit(State, &gFormSetGuids, sizeof(UINT32), InsydeFlagMatch, PatchCount, Stage);
+    Stage->Name = "PatchInsydeForms";
+}
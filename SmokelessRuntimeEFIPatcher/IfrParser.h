@@ -4,15 +4,10 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Uefi/UefiInternalFormRepresentation.h>
-
-// Patch information structure
-typedef struct _IFR_PATCH {
-    UINTN Offset;                // Offset in the image
-    UINT8 OriginalOpCode;        // Original opcode
-    UINT8 NewOpCode;             // New opcode to patch (usually EFI_IFR_TRUE_OP)
-    CHAR16 Description[128];     // Description of the patch
-    struct _IFR_PATCH *Next;
-} IFR_PATCH;
+#include "ImageSections.h"
+#include "IfrIndex.h"
+#include "PatchPlan.h"
+#include "FormSetGuids.h"
 
 // Form information
 typedef struct {
@@ -23,52 +18,111 @@ typedef struct {
 } FORM_INFO;
 
 /**
- * Parse IFR data from a loaded module image
+ * Parse IFR data from the data sections of a loaded module image
  * 
- * @param ImageBase     Base address of the loaded module
- * @param ImageSize     Size of the module image
- * @param PatchList     Pointer to receive list of patches (caller frees)
- * @return EFI_SUCCESS if parsing successful
+ * @param Map           Section map of the loaded module
+ * @param Plan          Plan that receives the hide-condition patches
+ * @return EFI_SUCCESS if patches were planned, EFI_NOT_FOUND if none
  */
 EFI_STATUS ParseIfrData(
-    VOID *ImageBase,
-    UINTN ImageSize,
-    IFR_PATCH **PatchList);
+    IMAGE_SECTION_MAP *Map,
+    PATCH_PLAN *Plan);
 
 /**
- * Apply IFR patches to a module
- * 
- * @param ImageBase     Base address of the loaded module
- * @param ImageSize     Size of the module image
- * @param PatchList     List of patches to apply
- * @return EFI_SUCCESS if patching successful
+ * Plan hide-condition patches without logging
+ *
+ * The worker behind ParseIfrData. It allocates only through Index and Plan,
+ * so with fixed-capacity storage it is safe to run on an AP.
+ *
+ * @param Map           Section map of the loaded module
+ * @param Plan          Plan that receives the hide-condition patches
+ * @param Index         IFR index reused for every FormSet
+ * @param FormSetCount  Receives the number of FormSets indexed
+ * @return EFI_SUCCESS if patches were planned, EFI_NOT_FOUND if none
+ * @return EFI_OUT_OF_RESOURCES if Index or Plan ran out of room
  */
-EFI_STATUS ApplyIfrPatches(
-    VOID *ImageBase,
-    UINTN ImageSize,
-    IFR_PATCH *PatchList);
+EFI_STATUS IfrPlanHideConditions(
+    IMAGE_SECTION_MAP *Map,
+    PATCH_PLAN *Plan,
+    IFR_INDEX *Index,
+    UINTN *FormSetCount);
+
+// State of the IFR planning stage of a patch pipeline (ParseIfrData, streamed)
+typedef struct {
+    PATCH_PLAN *Plan;
+    FORMSET_GUID_SET *Guids;     // Optional: receives the GUID of every FormSet header found
+    IFR_INDEX Index;
+    UINTN Cursor;                // Next offset to plan; FormSets may run past their chunk
+    UINTN FormSetCount;
+    UINTN PatchCount;
+    EFI_STATUS Status;
+} IFR_PLAN_STAGE;
 
 /**
- * Free IFR patch list
- * 
- * @param PatchList     List of patches to free
+ * Prepare ParseIfrData as a patch pipeline stage
+ *
+ * A FormSet is planned from the chunk its FORM_SET opcode is in; it is
+ * indexed to its END even if that lies in a later chunk.
+ *
+ * @param State         Stage state; must outlive the pipeline run
+ * @param Plan          Plan that receives the hide-condition patches, NULL
+ *                      to only collect the FormSet GUIDs
+ * @param Guids         Optional set that receives the FormSet GUIDs
+ * @param Stage         Receives the stage to register
  */
-VOID FreeIfrPatchList(IFR_PATCH *PatchList);
+VOID IfrPlanStageInit(IFR_PLAN_STAGE *State, PATCH_PLAN *Plan, FORMSET_GUID_SET *Guids, PATCH_PIPELINE_STAGE *Stage);
+
+/**
+ * Finish an IFR planning stage after the pipeline ran
+ *
+ * @param State         Stage state
+ * @return As ParseIfrData, or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS IfrPlanStageDone(IFR_PLAN_STAGE *State);
 
 /**
  * Find and patch common AMI BIOS form structures
  * 
- * @param ImageBase     Base address of the loaded module
- * @param ImageSize     Size of the module image
+ * @param Map           Section map of the loaded module
  * @return Number of patches applied
  */
-UINTN PatchAmiForms(VOID *ImageBase, UINTN ImageSize);
+UINTN PatchAmiForms(IMAGE_SECTION_MAP *Map);
+
+/**
+ * Prepare PatchAmiForms as a patch pipeline stage
+ *
+ * @param PatchCount    Incremented for every patch (initialize to 0)
+ * @param Stage         Receives the stage to register
+ */
+VOID PatchAmiFormsStage(UINTN *PatchCount, PATCH_PIPELINE_STAGE *Stage);
+
+/**
+ * Add the GUIDs of the FormSets in an image's IFR to a set
+ *
+ * @param Map           Section map of the module
+ * @param Set           Set that receives the GUIDs
+ * @return Number of FormSets found
+ */
+UINTN IfrCollectFormSetGuids(IMAGE_SECTION_MAP *Map, FORMSET_GUID_SET *Set);
 
 /**
  * Find and patch common Insyde H2O form structures
+ *
+ * Visibility flags are patched only behind known FormSet GUIDs.
  * 
- * @param ImageBase     Base address of the loaded module
- * @param ImageSize     Size of the module image
+ * @param Map           Section map of the loaded module
  * @return Number of patches applied
  */
-UINTN PatchInsydeForms(VOID *ImageBase, UINTN ImageSize);
+UINTN PatchInsydeForms(IMAGE_SECTION_MAP *Map);
+
+/**
+ * Prepare PatchInsydeForms as a patch pipeline stage
+ *
+ * The HII database GUIDs are added up front; register an IFR planning
+ * stage with gFormSetGuids before this one to add the image's own.
+ *
+ * @param State         Stage state; must outlive the pipeline run
+ * @param PatchCount    Incremented for every patch (initialize to 0)
+ * @param Stage         Receives the stage to register
+ */
+VOID PatchInsydeFormsStage(FORMSET_GUID_STAGE *State, UINTN *PatchCount, PATCH_PIPELINE_STAGE *Stage);
@@ -0,0 +1,182 @@
+#include "ImageSections.h"
+
+/**
+ * Helper: Classify a section header
+ */
+STATIC UINT8 ClassifySection(UINT32 Characteristics)
+{
+    if ((Characteristics & EFI_IMAGE_SCN_MEM_DISCARDABLE) != 0)
+        return 0;
+
+    if ((Characteristics & (EFI_IMAGE_SCN_CNT_CODE | EFI_IMAGE_SCN_MEM_EXECUTE)) != 0)
+        return IMAGE_SECTION_CODE;
+
+    if ((Characteristics & EFI_IMAGE_SCN_CNT_INITIALIZED_DATA) != 0)
+        return IMAGE_SECTION_DATA;
+
+    return 0;
+}
+
+/**
+ * Helper: Add the sections of a header table to the map
+ *
+ * Adjust converts a section VirtualAddress into an offset from the image
+ * base (non-zero for TE images, whose stripped header shifts everything).
+ */
+STATIC EFI_STATUS AddSections(
+    IMAGE_SECTION_MAP *Map,
+    UINTN TableOffset,
+    UINTN Count,
+    INTN Adjust)
+{
+    EFI_IMAGE_SECTION_HEADER *Header;
+    UINTN Index;
+
+    if (Count == 0 || Count > IMAGE_SECTION_MAX)
+        return EFI_UNSUPPORTED;
+
+    if (TableOffset > Map->ImageSize ||
+        Count * sizeof(EFI_IMAGE_SECTION_HEADER) > Map->ImageSize - TableOffset)
+        return EFI_UNSUPPORTED;
+
+    Header = (EFI_IMAGE_SECTION_HEADER *)(Map->ImageBase + TableOffset);
+    for (Index = 0; Index < Count; Index++, Header++)
+    {
+        IMAGE_SECTION *Section = &Map->Sections[Map->SectionCount];
+        INTN Start = (INTN)Header->VirtualAddress + Adjust;
+        UINTN Size = Header->Misc.VirtualSize != 0 ? Header->Misc.VirtualSize : Header->SizeOfRawData;
+
+        if (Start < 0 || (UINTN)Start >= Map->ImageSize || Size == 0)
+            continue;
+
+        if (Size > Map->ImageSize - (UINTN)Start)
+            Size = Map->ImageSize - (UINTN)Start;
+
+        Section->Offset = (UINT32)Start;
+        Section->Size = (UINT32)Size;
+        Section->Characteristics = Header->Characteristics;
+        Section->Kind = ClassifySection(Header->Characteristics);
+        CopyMem(Section->Name, Header->Name, EFI_IMAGE_SIZEOF_SHORT_NAME);
+        Section->Name[EFI_IMAGE_SIZEOF_SHORT_NAME] = 0;
+        Map->SectionCount++;
+    }
+
+    return Map->SectionCount > 0 ? EFI_SUCCESS : EFI_UNSUPPORTED;
+}
+
+/**
+ * Helper: Parse PE32/PE32+ headers (with or without a DOS stub)
+ */
+STATIC EFI_STATUS ParsePeSections(IMAGE_SECTION_MAP *Map)
+{
+    EFI_IMAGE_DOS_HEADER *DosHeader = (EFI_IMAGE_DOS_HEADER *)Map->ImageBase;
+    EFI_IMAGE_FILE_HEADER *FileHeader;
+    UINTN PeOffset = 0;
+    UINTN OptionalOffset;
+    UINT16 Magic;
+
+    if (Map->ImageSize < sizeof(EFI_IMAGE_DOS_HEADER))
+        return EFI_UNSUPPORTED;
+
+    if (DosHeader->e_magic == EFI_IMAGE_DOS_SIGNATURE)
+        PeOffset = DosHeader->e_lfanew;
+
+    if (PeOffset > Map->ImageSize ||
+        Map->ImageSize - PeOffset < sizeof(UINT32) + sizeof(EFI_IMAGE_FILE_HEADER) + sizeof(UINT16))
+        return EFI_UNSUPPORTED;
+
+    if (ReadUnaligned32((UINT32 *)(Map->ImageBase + PeOffset)) != EFI_IMAGE_NT_SIGNATURE)
+        return EFI_UNSUPPORTED;
+
+    FileHeader = (EFI_IMAGE_FILE_HEADER *)(Map->ImageBase + PeOffset + sizeof(UINT32));
+    OptionalOffset = PeOffset + sizeof(UINT32) + sizeof(EFI_IMAGE_FILE_HEADER);
+
+    Magic = ReadUnaligned16((UINT16 *)(Map->ImageBase + OptionalOffset));
+    if (Magic != EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC && Magic != EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+        return EFI_UNSUPPORTED;
+
+    return AddSections(Map,
+                       OptionalOffset + FileHeader->SizeOfOptionalHeader,
+                       FileHeader->NumberOfSections,
+                       0);
+}
+
+/**
+ * Helper: Parse TE headers
+ */
+STATIC EFI_STATUS ParseTeSections(IMAGE_SECTION_MAP *Map)
+{
+    EFI_TE_IMAGE_HEADER *TeHeader = (EFI_TE_IMAGE_HEADER *)Map->ImageBase;
+
+    if (Map->ImageSize < sizeof(EFI_TE_IMAGE_HEADER) ||
+        TeHeader->Signature != EFI_TE_IMAGE_HEADER_SIGNATURE ||
+        TeHeader->StrippedSize < sizeof(EFI_TE_IMAGE_HEADER))
+        return EFI_UNSUPPORTED;
+
+    return AddSections(Map,
+                       sizeof(EFI_TE_IMAGE_HEADER),
+                       TeHeader->NumberOfSections,
+                       (INTN)sizeof(EFI_TE_IMAGE_HEADER) - (INTN)TeHeader->StrippedSize);
+}
+
+/**
+ * Build the section map of a loaded image
+ */
+EFI_STATUS BuildImageSectionMap(VOID *ImageBase, UINTN ImageSize, IMAGE_SECTION_MAP *Map)
+{
+    EFI_STATUS Status;
+
+    if (Map == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    ZeroMem(Map, sizeof(IMAGE_SECTION_MAP));
+    Map->ImageBase = (UINT8 *)ImageBase;
+    Map->ImageSize = ImageBase != NULL ? ImageSize : 0;
+
+    if (Map->ImageSize > MAX_UINT32)
+        Map->ImageSize = MAX_UINT32;
+
+    Status = ParsePeSections(Map);
+    if (EFI_ERROR(Status))
+    {
+        Map->SectionCount = 0;
+        Status = ParseTeSections(Map);
+    }
+
+    if (!EFI_ERROR(Status))
+    {
+        Map->FromHeaders = TRUE;
+        return EFI_SUCCESS;
+    }
+
+    // Unknown layout - scan everything like before
+    ZeroMem(Map->Sections, sizeof(Map->Sections));
+    Map->SectionCount = 0;
+    if (Map->ImageSize > 0)
+    {
+        Map->Sections[0].Offset = 0;
+        Map->Sections[0].Size = (UINT32)Map->ImageSize;
+        Map->Sections[0].Kind = IMAGE_SECTION_CODE | IMAGE_SECTION_DATA;
+        CopyMem(Map->Sections[0].Name, "<image>", sizeof("<image>"));
+        Map->SectionCount = 1;
+    }
+
+    return EFI_UNSUPPORTED;
+}
+
+/**
+ * Total number of bytes covered by sections of the given kinds
+ */
+UINTN ImageSectionBytes(IMAGE_SECTION_MAP *Map, UINT8 KindMask)
+{
+    UINTN Total = 0;
+    UINTN Index;
+
+    for (Index = 0; Index < Map->SectionCount; Index++)
+    {
+        if ((Map->Sections[Index].Kind & KindMask) != 0)
+            Total += Map->Sections[Index].Size;
+    }
+
+    return Total;
+}
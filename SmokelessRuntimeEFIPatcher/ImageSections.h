@@ -0,0 +1,53 @@
+#pragma once
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <IndustryStandard/PeImage.h>
+
+// Maximum number of sections tracked per image (EDK2 images carry 3-6)
+#define IMAGE_SECTION_MAX 16
+
+// Section kinds, used as a mask by the scanners
+#define IMAGE_SECTION_CODE BIT0
+#define IMAGE_SECTION_DATA BIT1
+
+// One mapped section of a loaded image
+typedef struct {
+    UINT32 Offset;               // Offset of the section from the image base
+    UINT32 Size;                 // Bytes mapped, clamped to the image size
+    UINT32 Characteristics;      // EFI_IMAGE_SCN_* flags from the section header
+    UINT8 Kind;                  // IMAGE_SECTION_CODE/DATA, 0 for skipped sections
+    CHAR8 Name[EFI_IMAGE_SIZEOF_SHORT_NAME + 1];
+} IMAGE_SECTION;
+
+// Section layout of one loaded image, built once and shared by all scanners
+typedef struct {
+    UINT8 *ImageBase;
+    UINTN ImageSize;
+    BOOLEAN FromHeaders;         // FALSE when the whole image is used as a fallback
+    UINTN SectionCount;
+    IMAGE_SECTION Sections[IMAGE_SECTION_MAX];
+} IMAGE_SECTION_MAP;
+
+/**
+ * Build the section map of a loaded PE32/PE32+ or TE image
+ *
+ * Discardable sections (.reloc), uninitialized data and the headers are not
+ * mapped. If the headers cannot be parsed the map holds a single range that
+ * covers the whole image as both code and data, so it is always usable.
+ *
+ * @param ImageBase     Base address of the loaded image
+ * @param ImageSize     Size of the loaded image
+ * @param Map           Map to fill
+ * @return EFI_SUCCESS if the map was built from the headers
+ * @return EFI_UNSUPPORTED if the whole-image fallback is used
+ */
+EFI_STATUS BuildImageSectionMap(VOID *ImageBase, UINTN ImageSize, IMAGE_SECTION_MAP *Map);
+
+/**
+ * Total number of bytes covered by sections of the given kinds
+ *
+ * @param Map           Section map
+ * @param KindMask      IMAGE_SECTION_CODE and/or IMAGE_SECTION_DATA
+ * @return Number of bytes a scanner with this mask visits
+ */
+UINTN ImageSectionBytes(IMAGE_SECTION_MAP *Map, UINT8 KindMask);
@@ -0,0 +1,28 @@
+#include "IndexHash.h"
+#include <Library/BaseMemoryLib.h>
+
+/**
+ * FNV-1a over the UTF-16 code units of a name
+ */
+UINT32 IndexHashName(CONST CHAR16 *Name)
+{
+    UINT32 Hash = 0x811C9DC5;
+
+    for (; *Name != 0; Name++)
+    {
+        Hash ^= *Name;
+        Hash *= 0x01000193;
+    }
+    return Hash;
+}
+
+/**
+ * Fold the four dwords of a GUID
+ */
+UINT32 IndexHashGuid(CONST EFI_GUID *Guid)
+{
+    UINT32 Words[4];
+
+    CopyMem(Words, Guid, sizeof(Words));
+    return (Words[0] ^ (Words[1] * 0x9E3779B1) ^ (Words[2] * 0x85EBCA77) ^ (Words[3] * 0xC2B2AE3D));
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <Uefi.h>
+
+/**
+ * FNV-1a over the UTF-16 code units of a name
+ *
+ * @param Name          Null-terminated name
+ * @return 32-bit hash; index tables keep its low bits
+ */
+UINT32 IndexHashName(CONST CHAR16 *Name);
+
+/**
+ * Fold the four dwords of a GUID
+ *
+ * @param Guid          GUID to hash
+ * @return 32-bit hash; index tables keep its low bits
+ */
+UINT32 IndexHashGuid(CONST EFI_GUID *Guid);
@@ -0,0 +1,265 @@
+#include "LoadedImageIndex.h"
+#include "IndexHash.h"
+#include "Utility.h"
+#include "TaggedPool.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+LOADED_IMAGE_INDEX gLoadedImageIndex;
+
+/**
+ * Helper: Mix the address bits of a handle
+ */
+STATIC UINT32 LoadedImageIndexHashHandle(EFI_HANDLE Handle)
+{
+    UINT64 Value = (UINT64)(UINTN)Handle;
+
+    Value ^= Value >> 29;
+    Value *= 0x9E3779B97F4A7C15ULL;
+    return (UINT32)(Value >> 32);
+}
+
+/**
+ * Helper: Walk the handle chain of an index without building it
+ */
+STATIC LOADED_IMAGE_ENTRY *LoadedImageIndexHandleEntry(LOADED_IMAGE_INDEX *Index, EFI_HANDLE Handle)
+{
+    UINT32 *HandleBuckets;
+    UINT32 i;
+
+    if (Index->Buckets == NULL)
+        return NULL;
+
+    HandleBuckets = Index->Buckets + 2 * Index->BucketCount;
+    for (i = HandleBuckets[LoadedImageIndexHashHandle(Handle) & (Index->BucketCount - 1)];
+         i != LOADED_IMAGE_NONE;
+         i = Index->Entries[i].NextByHandle)
+    {
+        if (Index->Entries[i].Handle == Handle)
+            return &Index->Entries[i];
+    }
+    return NULL;
+}
+
+/**
+ * Helper: Read the FFS GUID and UI name of a newly seen image
+ */
+STATIC VOID LoadedImageIndexResolve(LOADED_IMAGE_ENTRY *Entry)
+{
+    EFI_GUID *NameGuid;
+
+    if (Entry->LoadedImage->FilePath == NULL)
+        return;
+
+    NameGuid = EfiGetNameGuidFromFwVolDevicePathNode((MEDIA_FW_VOL_FILEPATH_DEVICE_PATH *)Entry->LoadedImage->FilePath);
+    if (NameGuid == NULL)
+        return;
+
+    CopyGuid(&Entry->FileGuid, NameGuid);
+    Entry->Name = FindLoadedImageFileName(Entry->LoadedImage);
+}
+
+/**
+ * Helper: Rebuild the three hash tables over Entries
+ */
+STATIC EFI_STATUS LoadedImageIndexRehash(LOADED_IMAGE_INDEX *Index)
+{
+    UINT32 *NameBuckets;
+    UINT32 *GuidBuckets;
+    UINT32 *HandleBuckets;
+    UINTN Mask;
+    UINTN i;
+
+    Index->BucketCount = 16;
+    while (Index->BucketCount < 2 * Index->Count)
+        Index->BucketCount *= 2;
+
+    Index->Buckets = TaggedAllocatePool(POOL_TAG_FV, 3 * Index->BucketCount * sizeof(UINT32));
+    if (Index->Buckets == NULL)
+        return EFI_OUT_OF_RESOURCES;
+    SetMem(Index->Buckets, 3 * Index->BucketCount * sizeof(UINT32), 0xFF);
+
+    NameBuckets = Index->Buckets;
+    GuidBuckets = Index->Buckets + Index->BucketCount;
+    HandleBuckets = Index->Buckets + 2 * Index->BucketCount;
+    Mask = Index->BucketCount - 1;
+
+    // Inserted back to front so each chain is in handle order, as LocateHandle returned them
+    for (i = Index->Count; i-- > 0;)
+    {
+        LOADED_IMAGE_ENTRY *Entry = &Index->Entries[i];
+        UINTN Slot;
+
+        Entry->NextByName = LOADED_IMAGE_NONE;
+        Entry->NextByGuid = LOADED_IMAGE_NONE;
+
+        if (Entry->Name != NULL)
+        {
+            Slot = IndexHashName(Entry->Name) & Mask;
+            Entry->NextByName = NameBuckets[Slot];
+            NameBuckets[Slot] = (UINT32)i;
+        }
+
+        if (!IsZeroGuid(&Entry->FileGuid))
+        {
+            Slot = IndexHashGuid(&Entry->FileGuid) & Mask;
+            Entry->NextByGuid = GuidBuckets[Slot];
+            GuidBuckets[Slot] = (UINT32)i;
+        }
+
+        Slot = LoadedImageIndexHashHandle(Entry->Handle) & Mask;
+        Entry->NextByHandle = HandleBuckets[Slot];
+        HandleBuckets[Slot] = (UINT32)i;
+    }
+
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS LoadedImageIndexRefresh(LOADED_IMAGE_INDEX *Index)
+{
+    EFI_STATUS Status;
+    EFI_HANDLE *Handles = NULL;
+    UINTN HandleCount = 0;
+    LOADED_IMAGE_ENTRY *Entries;
+    UINTN Count = 0;
+    UINTN NamesRead;
+
+    if (Index == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    Status = gBS->LocateHandleBuffer(ByProtocol, &gEfiLoadedImageProtocolGuid, NULL, &HandleCount, &Handles);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Entries = TaggedAllocateZeroPool(POOL_TAG_FV, HandleCount * sizeof(LOADED_IMAGE_ENTRY));
+    if (Entries == NULL)
+    {
+        FreePool(Handles);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (UINTN i = 0; i < HandleCount; i++)
+    {
+        EFI_LOADED_IMAGE_PROTOCOL *LoadedImage = NULL;
+        LOADED_IMAGE_ENTRY *Entry;
+        LOADED_IMAGE_ENTRY *Old;
+
+        if (EFI_ERROR(gBS->HandleProtocol(Handles[i], &gEfiLoadedImageProtocolGuid, (VOID **)&LoadedImage)) ||
+            LoadedImage == NULL)
+            continue;
+
+        Entry = &Entries[Count++];
+        Entry->Handle = Handles[i];
+        Entry->LoadedImage = LoadedImage;
+        Entry->ImageBase = LoadedImage->ImageBase;
+        Entry->ImageSize = LoadedImage->ImageSize;
+
+        // Still the same image: keep its name instead of reading the FV again
+        Old = LoadedImageIndexHandleEntry(Index, Handles[i]);
+        if (Old != NULL && Old->LoadedImage == LoadedImage && Old->ImageBase == LoadedImage->ImageBase)
+        {
+            CopyGuid(&Entry->FileGuid, &Old->FileGuid);
+            Entry->Name = Old->Name;
+            Old->Name = NULL;
+        }
+        else
+        {
+            LoadedImageIndexResolve(Entry);
+            Index->NamesRead++;
+        }
+    }
+    FreePool(Handles);
+
+    // Drops the names of images that went away
+    NamesRead = Index->NamesRead;
+    LoadedImageIndexFree(Index);
+    Index->NamesRead = NamesRead;
+    Index->Entries = Entries;
+    Index->Count = Count;
+
+    Status = LoadedImageIndexRehash(Index);
+    if (EFI_ERROR(Status))
+    {
+        LoadedImageIndexFree(Index);
+        Index->NamesRead = NamesRead;
+    }
+    return Status;
+}
+
+/**
+ * Helper: Build the index on first use
+ */
+STATIC BOOLEAN LoadedImageIndexReady(LOADED_IMAGE_INDEX *Index)
+{
+    if (Index->Buckets == NULL)
+        LoadedImageIndexRefresh(Index);
+    return Index->Buckets != NULL;
+}
+
+CONST LOADED_IMAGE_ENTRY *LoadedImageIndexFindByName(LOADED_IMAGE_INDEX *Index, CONST CHAR16 *Name)
+{
+    UINT32 i;
+
+    if (Index == NULL || Name == NULL || !LoadedImageIndexReady(Index))
+        return NULL;
+
+    for (i = Index->Buckets[IndexHashName(Name) & (Index->BucketCount - 1)];
+         i != LOADED_IMAGE_NONE;
+         i = Index->Entries[i].NextByName)
+    {
+        if (StrCmp(Index->Entries[i].Name, Name) == 0)
+            return &Index->Entries[i];
+    }
+    return NULL;
+}
+
+CONST LOADED_IMAGE_ENTRY *LoadedImageIndexFindByGuid(LOADED_IMAGE_INDEX *Index, CONST EFI_GUID *FileGuid)
+{
+    UINT32 *GuidBuckets;
+    UINT32 i;
+
+    if (Index == NULL || FileGuid == NULL || !LoadedImageIndexReady(Index))
+        return NULL;
+
+    GuidBuckets = Index->Buckets + Index->BucketCount;
+    for (i = GuidBuckets[IndexHashGuid(FileGuid) & (Index->BucketCount - 1)];
+         i != LOADED_IMAGE_NONE;
+         i = Index->Entries[i].NextByGuid)
+    {
+        if (CompareGuid(&Index->Entries[i].FileGuid, FileGuid))
+            return &Index->Entries[i];
+    }
+    return NULL;
+}
+
+CONST LOADED_IMAGE_ENTRY *LoadedImageIndexFindByBase(LOADED_IMAGE_INDEX *Index, CONST VOID *ImageBase)
+{
+    if (Index == NULL || !LoadedImageIndexReady(Index))
+        return NULL;
+
+    for (UINTN i = 0; i < Index->Count; i++)
+    {
+        if (Index->Entries[i].ImageBase == ImageBase)
+            return &Index->Entries[i];
+    }
+    return NULL;
+}
+
+VOID LoadedImageIndexFree(LOADED_IMAGE_INDEX *Index)
+{
+    if (Index == NULL)
+        return;
+
+    for (UINTN i = 0; i < Index->Count; i++)
+    {
+        if (Index->Entries[i].Name != NULL)
+            TaggedFreePool(Index->Entries[i].Name);
+    }
+
+    if (Index->Entries != NULL)
+        TaggedFreePool(Index->Entries);
+    if (Index->Buckets != NULL)
+        TaggedFreePool(Index->Buckets);
+    ZeroMem(Index, sizeof(LOADED_IMAGE_INDEX));
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <Uefi.h>
+#include <Protocol/LoadedImage.h>
+
+// End of a hash chain
+#define LOADED_IMAGE_NONE MAX_UINT32
+
+// One loaded image
+typedef struct {
+    EFI_HANDLE Handle;
+    EFI_LOADED_IMAGE_PROTOCOL *LoadedImage;
+    VOID *ImageBase;
+    UINT64 ImageSize;
+    EFI_GUID FileGuid;           // FFS file name, zero if not loaded from an FV
+    CHAR16 *Name;                // UI section (owned), NULL if the image has none
+    UINT32 NextByName;           // Hash chains (entry indices)
+    UINT32 NextByGuid;
+    UINT32 NextByHandle;
+} LOADED_IMAGE_ENTRY;
+
+// Every loaded image, hashed by UI name, FFS GUID and handle
+typedef struct {
+    LOADED_IMAGE_ENTRY *Entries;
+    UINTN Count;
+    UINT32 *Buckets;             // 3 * BucketCount heads: name, GUID, handle
+    UINTN BucketCount;           // Power of two
+    UINTN NamesRead;             // UI sections read from FVs, over all builds
+} LOADED_IMAGE_INDEX;
+
+// Index shared by the patch phases; built on first lookup
+extern LOADED_IMAGE_INDEX gLoadedImageIndex;
+
+/**
+ * Build the index, or bring it up to date after images were loaded
+ *
+ * The UI section of an image is read from its FV only the first time the
+ * image is seen; entries of images that are still loaded keep their name.
+ * Unloaded images are dropped. Call this after LoadImage/StartImage before
+ * looking up the new images.
+ *
+ * @param Index         Index to build or refresh
+ * @return EFI_SUCCESS or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS LoadedImageIndexRefresh(LOADED_IMAGE_INDEX *Index);
+
+/**
+ * Find a loaded image by UI name
+ *
+ * @param Index         Built index
+ * @param Name          UI name (case sensitive)
+ * @return Entry, or NULL
+ */
+CONST LOADED_IMAGE_ENTRY *LoadedImageIndexFindByName(LOADED_IMAGE_INDEX *Index, CONST CHAR16 *Name);
+
+/**
+ * Find a loaded image by FFS file GUID
+ *
+ * @param Index         Built index
+ * @param FileGuid      FFS file name
+ * @return Entry, or NULL
+ */
+CONST LOADED_IMAGE_ENTRY *LoadedImageIndexFindByGuid(LOADED_IMAGE_INDEX *Index, CONST EFI_GUID *FileGuid);
+
+/**
+ * Find the entry of an image by its load address
+ *
+ * A linear search; images loaded since the last refresh are not found.
+ *
+ * @param Index         Built index
+ * @param ImageBase     Base address of the image
+ * @return Entry, or NULL
+ */
+CONST LOADED_IMAGE_ENTRY *LoadedImageIndexFindByBase(LOADED_IMAGE_INDEX *Index, CONST VOID *ImageBase);
+
+/**
+ * Free an index and the names it holds
+ *
+ * @param Index         Index to free
+ */
+VOID LoadedImageIndexFree(LOADED_IMAGE_INDEX *Index);
@@ -0,0 +1,180 @@
+#include "Logger.h"
+#include "Constants.h"
+#include "Trace.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/PrintLib.h>
+
+// Log lines buffered in memory; Head and Tail only grow, the ring index is their low bits
+typedef struct {
+    CHAR8 Ring[LOG_RING_SIZE];
+    UINTN Head;                  // Bytes appended
+    UINTN Tail;                  // Bytes written to the file or overwritten
+    EFI_FILE *File;
+    UINT64 FilePos;              // Bytes written to the file
+    UINTN Dropped;               // Bytes overwritten before they were written
+    BOOLEAN WriteFailed;         // The file refused a write; the ring keeps the newest lines
+    BOOLEAN Draining;
+} LOGGER;
+
+STATIC LOGGER mLogger;
+
+/**
+ * Helper: Write the oldest bytes of the ring to the file
+ *
+ * At most two writes: the ring may wrap once.
+ */
+STATIC VOID LoggerDrain(UINTN Length)
+{
+    if (mLogger.File == NULL || mLogger.WriteFailed || mLogger.Draining)
+        return;
+
+    mLogger.Draining = TRUE;
+    while (Length > 0)
+    {
+        UINTN Start = mLogger.Tail & (LOG_RING_SIZE - 1);
+        UINTN Size = MIN(Length, LOG_RING_SIZE - Start);
+        EFI_STATUS Status = mLogger.File->Write(mLogger.File, &Size, &mLogger.Ring[Start]);
+
+        if (EFI_ERROR(Status) || Size == 0)
+        {
+            mLogger.WriteFailed = TRUE;
+            break;
+        }
+
+        mLogger.Tail += Size;
+        mLogger.FilePos += Size;
+        Length -= Size;
+    }
+    mLogger.Draining = FALSE;
+}
+
+/**
+ * Helper: Write buffered bytes up to the last sector boundary of the file
+ */
+STATIC VOID LoggerDrainAligned(VOID)
+{
+    UINT64 End = (mLogger.FilePos + (mLogger.Head - mLogger.Tail)) & ~(UINT64)(LOG_SECTOR_SIZE - 1);
+
+    if (End > mLogger.FilePos)
+        LoggerDrain((UINTN)(End - mLogger.FilePos));
+}
+
+/**
+ * Attach the log file
+ */
+VOID LoggerInit(EFI_FILE *File)
+{
+    CHAR8 Notice[64];
+
+    mLogger.File = File;
+    mLogger.FilePos = 0;
+    mLogger.WriteFailed = FALSE;
+    if (File != NULL)
+        File->GetPosition(File, &mLogger.FilePos);
+
+    if (mLogger.Dropped > 0)
+    {
+        UINTN Length = AsciiSPrint(Notice, sizeof(Notice), "[log: %d bytes lost]\n\r", mLogger.Dropped);
+
+        mLogger.Dropped = 0;
+        LoggerWrite(LOG_LEVEL_WARN, Notice, Length);
+    }
+}
+
+/**
+ * Append text to the log
+ */
+VOID LoggerWrite(UINTN Level, CONST CHAR8 *Text, UINTN Length)
+{
+    if (Level > LOG_MIN_LEVEL || Text == NULL)
+        return;
+
+    // Only the newest ring-full of an oversized text can be kept
+    if (Length > LOG_RING_SIZE)
+    {
+        mLogger.Dropped += Length - LOG_RING_SIZE;
+        Text += Length - LOG_RING_SIZE;
+        Length = LOG_RING_SIZE;
+    }
+
+    if (mLogger.Head - mLogger.Tail + Length > LOG_RING_SIZE)
+    {
+        UINTN Overrun;
+
+        LoggerDrain(mLogger.Head - mLogger.Tail);
+
+        // Still full: nowhere to write, so give up the oldest bytes
+        Overrun = mLogger.Head - mLogger.Tail + Length;
+        if (Overrun > LOG_RING_SIZE)
+        {
+            mLogger.Dropped += Overrun - LOG_RING_SIZE;
+            mLogger.Tail += Overrun - LOG_RING_SIZE;
+        }
+    }
+
+    while (Length > 0)
+    {
+        UINTN Start = mLogger.Head & (LOG_RING_SIZE - 1);
+        UINTN Size = MIN(Length, LOG_RING_SIZE - Start);
+
+        CopyMem(&mLogger.Ring[Start], Text, Size);
+        mLogger.Head += Size;
+        Text += Size;
+        Length -= Size;
+    }
+
+    if (Level == LOG_LEVEL_ERROR)
+        LoggerFlush();
+    else if (mLogger.Head - mLogger.Tail >= LOG_DRAIN_THRESHOLD)
+        LoggerDrainAligned();
+}
+
+/**
+ * Format and append a line to the log
+ */
+VOID EFIAPI LoggerPrint(UINTN Level, CONST CHAR8 *Format, ...)
+{
+    CHAR8 Line[LOG_BUFFER_SIZE];
+    VA_LIST Marker;
+    UINTN Length;
+
+    if (Level > LOG_MIN_LEVEL)
+        return;
+
+    VA_START(Marker, Format);
+    Length = AsciiVSPrint(Line, sizeof(Line), Format, Marker);
+    VA_END(Marker);
+
+    LoggerWrite(Level, Line, Length);
+}
+
+/**
+ * Write everything buffered and flush the log file
+ */
+VOID LoggerFlush(VOID)
+{
+    TraceFlush();
+
+    if (mLogger.File == NULL || mLogger.WriteFailed || mLogger.Draining)
+        return;
+
+    LoggerDrain(mLogger.Head - mLogger.Tail);
+    if (!mLogger.WriteFailed)
+        mLogger.File->Flush(mLogger.File);
+}
+
+/**
+ * Flush and close the log file
+ */
+VOID LoggerClose(VOID)
+{
+    TraceClose();
+
+    if (mLogger.File == NULL)
+        return;
+
+    LoggerFlush();
+    mLogger.File->Close(mLogger.File);
+    mLogger.File = NULL;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+// Severity of a log line; lower is more severe
+#define LOG_LEVEL_ERROR     0
+#define LOG_LEVEL_WARN      1
+#define LOG_LEVEL_INFO      2
+#define LOG_LEVEL_DEBUG     3
+#define LOG_LEVEL_VERBOSE   4
+
+// Lines above this level are compiled out (override with -DLOG_MIN_LEVEL=...)
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#endif
+
+// In-memory log; a power of two
+#define LOG_RING_SIZE SIZE_128KB
+
+// Buffered bytes that trigger a write to the log file
+#define LOG_DRAIN_THRESHOLD SIZE_32KB
+
+// Threshold writes end on this boundary of the log file
+#define LOG_SECTOR_SIZE 512
+
+// Format a line at a level; the call disappears when the level is compiled out
+#define SREP_LOG(Level, ...) \
+    do { \
+        if ((Level) <= LOG_MIN_LEVEL) \
+            LoggerPrint((Level), __VA_ARGS__); \
+    } while (FALSE)
+
+/**
+ * Attach the log file
+ *
+ * Lines logged before are kept in the ring and written with the next drain.
+ *
+ * @param File          Open log file, written from its current position
+ */
+VOID LoggerInit(EFI_FILE *File);
+
+/**
+ * Append text to the log
+ *
+ * The text is copied into the ring. Once LOG_DRAIN_THRESHOLD bytes are
+ * buffered they are written in one call, up to a sector boundary of the
+ * file. Error lines are flushed at once. Without a usable file the oldest
+ * bytes are overwritten when the ring is full.
+ *
+ * @param Level         LOG_LEVEL_* of the text
+ * @param Text          Text to append (not terminated)
+ * @param Length        Bytes of Text
+ */
+VOID LoggerWrite(UINTN Level, CONST CHAR8 *Text, UINTN Length);
+
+/**
+ * Format and append a line to the log
+ *
+ * @param Level         LOG_LEVEL_* of the line
+ * @param Format        AsciiSPrint format
+ */
+VOID EFIAPI LoggerPrint(UINTN Level, CONST CHAR8 *Format, ...);
+
+/**
+ * Write everything buffered and flush the log file, and the trace file
+ *
+ * Safe on fatal paths: allocates nothing, formats nothing, does nothing
+ * without a file and returns at once if called while already writing.
+ */
+VOID LoggerFlush(VOID);
+
+/**
+ * Flush and close the log file; tracing stops and its file is closed first
+ *
+ * Later lines stay in the ring until LoggerInit attaches a file again.
+ */
+VOID LoggerClose(VOID);
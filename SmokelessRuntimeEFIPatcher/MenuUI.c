@@ -1,5 +1,6 @@
 #include "MenuUI.h"
 #include "HiiBrowser.h"
+#include "TaggedPool.h"
 #include <Library/BaseMemoryLib.h>
 #include <Library/PrintLib.h>
 
@@ -78,22 +79,22 @@ MENU_PAGE *MenuCreatePage(CHAR16 *Title, UINTN ItemCount)
     if (Title == NULL || ItemCount == 0)
         return NULL;
     
-    MENU_PAGE *Page = AllocateZeroPool(sizeof(MENU_PAGE));
+    MENU_PAGE *Page = TaggedAllocateZeroPool(POOL_TAG_MENU, sizeof(MENU_PAGE));
     if (Page == NULL)
         return NULL;
     
-    Page->Title = AllocateCopyPool(StrSize(Title), Title);
+    Page->Title = TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Title), Title);
     if (Page->Title == NULL)
     {
-        FreePool(Page);
+        TaggedFreePool(Page);
         return NULL;
     }
     
-    Page->Items = AllocateZeroPool(sizeof(MENU_ITEM) * ItemCount);
+    Page->Items = TaggedAllocateZeroPool(POOL_TAG_MENU, sizeof(MENU_ITEM) * ItemCount);
     if (Page->Items == NULL)
     {
-        FreePool(Page->Title);
-        FreePool(Page);
+        TaggedFreePool(Page->Title);
+        TaggedFreePool(Page);
         return NULL;
     }
     
@@ -121,11 +122,11 @@ EFI_STATUS MenuAddActionItem(
     
     MENU_ITEM *Item = &Page->Items[Index];
     Item->Type = MENU_ITEM_ACTION;
-    Item->Title = AllocateCopyPool(StrSize(Title), Title);
+    Item->Title = TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Title), Title);
     if (Item->Title == NULL)
         return EFI_OUT_OF_RESOURCES;
     
-    Item->Description = Description ? AllocateCopyPool(StrSize(Description), Description) : NULL;
+    Item->Description = Description ? TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Description), Description) : NULL;
     Item->Callback = Callback;
     Item->Data = Data;
     Item->Enabled = TRUE;
@@ -150,11 +151,11 @@ EFI_STATUS MenuAddSubmenuItem(
     
     MENU_ITEM *Item = &Page->Items[Index];
     Item->Type = MENU_ITEM_SUBMENU;
-    Item->Title = AllocateCopyPool(StrSize(Title), Title);
+    Item->Title = TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Title), Title);
     if (Item->Title == NULL)
         return EFI_OUT_OF_RESOURCES;
     
-    Item->Description = Description ? AllocateCopyPool(StrSize(Description), Description) : NULL;
+    Item->Description = Description ? TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Description), Description) : NULL;
     Item->Submenu = Submenu;
     Item->Enabled = TRUE;
     Item->Hidden = FALSE;
@@ -174,7 +175,7 @@ EFI_STATUS MenuAddSeparator(MENU_PAGE *Page, UINTN Index, CHAR16 *Title)
     
     MENU_ITEM *Item = &Page->Items[Index];
     Item->Type = MENU_ITEM_SEPARATOR;
-    Item->Title = Title ? AllocateCopyPool(StrSize(Title), Title) : NULL;
+    Item->Title = Title ? TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Title), Title) : NULL;
     Item->Enabled = FALSE;
     
     return EFI_SUCCESS;
@@ -190,7 +191,7 @@ EFI_STATUS MenuAddInfoItem(MENU_PAGE *Page, UINTN Index, CHAR16 *Title)
     
     MENU_ITEM *Item = &Page->Items[Index];
     Item->Type = MENU_ITEM_INFO;
-    Item->Title = AllocateCopyPool(StrSize(Title), Title);
+    Item->Title = TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Title), Title);
     if (Item->Title == NULL)
         return EFI_OUT_OF_RESOURCES;
     
@@ -208,7 +209,7 @@ EFI_STATUS MenuInitializeTabs(MENU_CONTEXT *Context, UINTN TabCount)
         return EFI_INVALID_PARAMETER;
     
     // Allocate tab array
-    Context->Tabs = AllocateZeroPool(sizeof(MENU_TAB) * TabCount);
+    Context->Tabs = TaggedAllocateZeroPool(POOL_TAG_MENU, sizeof(MENU_TAB) * TabCount);
     if (Context->Tabs == NULL)
         return EFI_OUT_OF_RESOURCES;
     
@@ -236,7 +237,7 @@ EFI_STATUS MenuAddTab(
         return EFI_NOT_READY;
     
     MENU_TAB *Tab = &Context->Tabs[Index];
-    Tab->Name = AllocateCopyPool(StrSize(Name), Name);
+    Tab->Name = TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Name), Name);
     if (Tab->Name == NULL)
         return EFI_OUT_OF_RESOURCES;
     
@@ -956,7 +957,7 @@ EFI_STATUS MenuShowMessage(MENU_CONTEXT *Context, CHAR16 *Title, CHAR16 *Message
     }
     
     // Handle multi-line messages (split by \r\n)
-    CHAR16 *MessageCopy = AllocateCopyPool(StrSize(Message), Message);
+    CHAR16 *MessageCopy = TaggedAllocateCopyPool(POOL_TAG_MENU, StrSize(Message), Message);
     if (MessageCopy != NULL)
     {
         CHAR16 *Line = MessageCopy;
@@ -995,7 +996,7 @@ EFI_STATUS MenuShowMessage(MENU_CONTEXT *Context, CHAR16 *Title, CHAR16 *Message
             Line = NextLine;
         }
         
-        FreePool(MessageCopy);
+        TaggedFreePool(MessageCopy);
         
         // Fill remaining rows
         while (Row < 12 + MaxRows)
@@ -1111,7 +1112,7 @@ VOID MenuFreePage(MENU_PAGE *Page)
         return;
     
     if (Page->Title)
-        FreePool(Page->Title);
+        TaggedFreePool(Page->Title);
     
     if (Page->Items)
     {
@@ -1119,14 +1120,14 @@ VOID MenuFreePage(MENU_PAGE *Page)
         {
             MENU_ITEM *Item = &Page->Items[i];
             if (Item->Title)
-                FreePool(Item->Title);
+                TaggedFreePool(Item->Title);
             if (Item->Description)
-                FreePool(Item->Description);
+                TaggedFreePool(Item->Description);
         }
-        FreePool(Page->Items);
+        TaggedFreePool(Page->Items);
     }
     
-    FreePool(Page);
+    TaggedFreePool(Page);
 }
 
 /**
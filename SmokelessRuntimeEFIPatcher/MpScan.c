@@ -0,0 +1,172 @@
+#include "MpScan.h"
+#include "TaggedPool.h"
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/MpService.h>
+
+// Storage one worker scans with; allocated on the BSP before dispatch
+typedef struct {
+    IFR_OP_NODE *Nodes;
+    PATCH_RECORD *Records;
+    UINTN RecordsUsed;
+} MP_SCAN_WORKSPACE;
+
+// Argument shared by every AP
+typedef struct {
+    MP_SCAN *Scan;
+    volatile UINT32 NextWorkspace;
+    volatile UINT32 NextJob;
+} MP_SCAN_SHARED;
+
+/**
+ * Helper: AP procedure - claim jobs until none are left
+ *
+ * Runs without boot services: no allocation, no logging, no protocol calls.
+ * Each AP claims a workspace first; APs beyond MP_SCAN_MAX_WORKERS find none
+ * and return. Each job gets the unused tail of the workspace's record
+ * storage, so a module with many patches does not need a per-job limit.
+ */
+STATIC VOID EFIAPI MpScanWorker(IN OUT VOID *Buffer)
+{
+    MP_SCAN_SHARED *Shared = (MP_SCAN_SHARED *)Buffer;
+    MP_SCAN *Scan = Shared->Scan;
+    MP_SCAN_WORKSPACE *Workspace;
+    IFR_INDEX Index;
+    UINT32 Slot = InterlockedIncrement(&Shared->NextWorkspace) - 1;
+
+    if (Slot >= Scan->WorkspaceCount)
+        return;
+
+    Workspace = &((MP_SCAN_WORKSPACE *)Scan->Workspaces)[Slot];
+    IfrIndexInitFixed(&Index, Workspace->Nodes, MP_SCAN_INDEX_NODES);
+
+    while (TRUE)
+    {
+        UINT32 Claimed = InterlockedIncrement(&Shared->NextJob) - 1;
+        MODULE_SCAN_JOB *Job;
+
+        if (Claimed >= Scan->JobCount)
+            break;
+
+        Job = &Scan->Jobs[Claimed];
+        if (Job->ImageBase == NULL)
+            continue;
+
+        BuildImageSectionMap(Job->ImageBase, Job->ImageSize, &Job->Map);
+        PatchPlanInitFixed(&Job->Plan, &Workspace->Records[Workspace->RecordsUsed],
+                           MP_SCAN_RECORDS - Workspace->RecordsUsed);
+        Job->Status = IfrPlanHideConditions(&Job->Map, &Job->Plan, &Index, &Job->FormSetCount);
+
+        // A job that ran out of room is rescanned on the BSP; reuse its records
+        if (Job->Status != EFI_OUT_OF_RESOURCES)
+            Workspace->RecordsUsed += Job->Plan.Count;
+    }
+}
+
+/**
+ * Free the workspaces of a scan
+ */
+VOID MpScanFree(MP_SCAN *Scan)
+{
+    MP_SCAN_WORKSPACE *Workspaces;
+    UINTN Index;
+
+    if (Scan == NULL || Scan->Workspaces == NULL)
+        return;
+
+    Workspaces = (MP_SCAN_WORKSPACE *)Scan->Workspaces;
+    for (Index = 0; Index < Scan->WorkspaceCount; Index++)
+    {
+        if (Workspaces[Index].Nodes != NULL)
+            TaggedFreePool(Workspaces[Index].Nodes);
+        if (Workspaces[Index].Records != NULL)
+            TaggedFreePool(Workspaces[Index].Records);
+    }
+
+    TaggedFreePool(Workspaces);
+    Scan->Workspaces = NULL;
+    Scan->WorkspaceCount = 0;
+}
+
+/**
+ * Helper: Allocate one workspace per worker
+ */
+STATIC EFI_STATUS MpScanAllocateWorkspaces(MP_SCAN *Scan, UINTN WorkerCount)
+{
+    MP_SCAN_WORKSPACE *Workspaces;
+    UINTN Index;
+
+    Workspaces = TaggedAllocateZeroPool(POOL_TAG_PATCH, WorkerCount * sizeof(MP_SCAN_WORKSPACE));
+    if (Workspaces == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    Scan->Workspaces = Workspaces;
+    Scan->WorkspaceCount = WorkerCount;
+
+    for (Index = 0; Index < WorkerCount; Index++)
+    {
+        Workspaces[Index].Nodes = TaggedAllocatePool(POOL_TAG_PATCH, MP_SCAN_INDEX_NODES * sizeof(IFR_OP_NODE));
+        Workspaces[Index].Records = TaggedAllocatePool(POOL_TAG_PATCH, MP_SCAN_RECORDS * sizeof(PATCH_RECORD));
+        if (Workspaces[Index].Nodes == NULL || Workspaces[Index].Records == NULL)
+        {
+            MpScanFree(Scan);
+            return EFI_OUT_OF_RESOURCES;
+        }
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Build section maps and plan IFR patches for every job on the APs
+ *
+ * StartupAllAPs is used in blocking mode, so the BSP waits and the jobs are
+ * complete (and visible) when it returns. Under QEMU/OVMF this runs with
+ * -smp N; with a single CPU StartupAllAPs has nobody to start and the caller
+ * scans serially. Workspaces are sized for the enabled APs, at most
+ * MP_SCAN_MAX_WORKERS of them, not for every processor.
+ */
+EFI_STATUS MpScanModules(MP_SCAN *Scan)
+{
+    EFI_STATUS Status;
+    EFI_MP_SERVICES_PROTOCOL *MpServices;
+    MP_SCAN_SHARED Shared;
+    UINTN ProcessorCount;
+    UINTN EnabledCount;
+    UINTN Index;
+
+    if (Scan == NULL || Scan->Jobs == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    Scan->ProcessorCount = 0;
+    Scan->Workspaces = NULL;
+    Scan->WorkspaceCount = 0;
+    for (Index = 0; Index < Scan->JobCount; Index++)
+        Scan->Jobs[Index].Status = EFI_NOT_READY;
+
+    Status = gBS->LocateProtocol(&gEfiMpServiceProtocolGuid, NULL, (VOID **)&MpServices);
+    if (EFI_ERROR(Status))
+        return EFI_UNSUPPORTED;
+
+    Status = MpServices->GetNumberOfProcessors(MpServices, &ProcessorCount, &EnabledCount);
+    if (EFI_ERROR(Status) || EnabledCount < 2)
+        return EFI_UNSUPPORTED;
+
+    Status = MpScanAllocateWorkspaces(Scan, MIN(EnabledCount - 1, MP_SCAN_MAX_WORKERS));
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Shared.Scan = Scan;
+    Shared.NextWorkspace = 0;
+    Shared.NextJob = 0;
+
+    Status = MpServices->StartupAllAPs(MpServices, MpScanWorker, FALSE, NULL, 0, &Shared, NULL);
+    if (EFI_ERROR(Status))
+    {
+        MpScanFree(Scan);
+        return EFI_UNSUPPORTED;
+    }
+
+    Scan->ProcessorCount = MIN(Shared.NextWorkspace, Scan->WorkspaceCount);
+    return EFI_SUCCESS;
+}
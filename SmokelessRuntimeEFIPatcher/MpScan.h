@@ -0,0 +1,53 @@
+#pragma once
+#include <Uefi.h>
+#include <Protocol/LoadedImage.h>
+#include "IfrParser.h"
+
+// IFR nodes each processor can hold for one FormSet
+#define MP_SCAN_INDEX_NODES 32768
+
+// Patch records each processor can hold across all of its modules
+#define MP_SCAN_RECORDS 8192
+
+// APs that scan at most; each needs a workspace of nodes and records
+#define MP_SCAN_MAX_WORKERS 8
+
+// One module to scan; everything but ImageBase/ImageSize is filled by the scan
+typedef struct {
+    VOID *ImageBase;
+    UINTN ImageSize;
+    IMAGE_SECTION_MAP Map;
+    PATCH_PLAN Plan;             // Backed by the scanning processor's workspace
+    UINTN FormSetCount;
+    EFI_STATUS Status;           // IfrPlanHideConditions result, EFI_NOT_READY if never scanned
+} MODULE_SCAN_JOB;
+
+// Parallel scan of a set of modules
+typedef struct {
+    MODULE_SCAN_JOB *Jobs;
+    UINTN JobCount;
+    UINTN ProcessorCount;        // APs that took part
+    VOID *Workspaces;            // Node and record storage, one per worker (owned)
+    UINTN WorkspaceCount;
+} MP_SCAN;
+
+/**
+ * Build section maps and plan IFR patches for every job on the APs
+ *
+ * APs only touch memory: each builds the section map and runs
+ * IfrPlanHideConditions with fixed-capacity storage. Nothing is applied.
+ * The caller applies the plans on the BSP and rescans, serially, any job
+ * left with EFI_OUT_OF_RESOURCES or EFI_NOT_READY.
+ *
+ * @param Scan          Scan to run (Jobs and JobCount set by the caller)
+ * @return EFI_SUCCESS if the APs ran the jobs
+ * @return EFI_UNSUPPORTED if MP services or enabled APs are missing
+ */
+EFI_STATUS MpScanModules(MP_SCAN *Scan);
+
+/**
+ * Free the workspaces of a scan; job plans become invalid
+ *
+ * @param Scan          Scan to free
+ */
+VOID MpScanFree(MP_SCAN *Scan);
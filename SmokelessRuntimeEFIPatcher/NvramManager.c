@@ -1,4 +1,7 @@
 #include "NvramManager.h"
+#include "PatchDb.h"
+#include "TaggedPool.h"
+#include "FwCalls.h"
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/PrintLib.h>
@@ -30,7 +33,7 @@ EFI_STATUS NvramInitialize(NVRAM_MANAGER *Manager)
     
     // Allocate initial variable array with reasonable capacity
     Manager->VariableCapacity = 100;
-    Manager->Variables = AllocateZeroPool(sizeof(NVRAM_VARIABLE) * Manager->VariableCapacity);
+    Manager->Variables = TaggedAllocateZeroPool(POOL_TAG_NVRAM, sizeof(NVRAM_VARIABLE) * Manager->VariableCapacity);
     if (Manager->Variables == NULL)
         return EFI_OUT_OF_RESOURCES;
     
@@ -50,7 +53,7 @@ STATIC EFI_STATUS NvramExpandCapacity(NVRAM_MANAGER *Manager)
     
     // Double the capacity
     UINTN NewCapacity = Manager->VariableCapacity * 2;
-    NVRAM_VARIABLE *NewVariables = AllocateZeroPool(sizeof(NVRAM_VARIABLE) * NewCapacity);
+    NVRAM_VARIABLE *NewVariables = TaggedAllocateZeroPool(POOL_TAG_NVRAM, sizeof(NVRAM_VARIABLE) * NewCapacity);
     
     if (NewVariables == NULL)
         return EFI_OUT_OF_RESOURCES;
@@ -59,7 +62,7 @@ STATIC EFI_STATUS NvramExpandCapacity(NVRAM_MANAGER *Manager)
     CopyMem(NewVariables, Manager->Variables, sizeof(NVRAM_VARIABLE) * Manager->VariableCount);
     
     // Free old array and use new one
-    FreePool(Manager->Variables);
+    TaggedFreePool(Manager->Variables);
     Manager->Variables = NewVariables;
     Manager->VariableCapacity = NewCapacity;
     
@@ -85,20 +88,20 @@ EFI_STATUS NvramReadVariable(
         return EFI_INVALID_PARAMETER;
     
     // First call to get size
-    Status = gRT->GetVariable(Name, Guid, &Attributes, &Size, NULL);
+    Status = gFwCalls.GetVariable(Name, Guid, &Attributes, &Size, NULL);
     if (Status != EFI_BUFFER_TOO_SMALL && EFI_ERROR(Status))
         return Status;
     
     // Allocate buffer
-    *Data = AllocateZeroPool(Size);
+    *Data = TaggedAllocateZeroPool(POOL_TAG_NVRAM, Size);
     if (*Data == NULL)
         return EFI_OUT_OF_RESOURCES;
     
     // Second call to get data
-    Status = gRT->GetVariable(Name, Guid, &Attributes, &Size, *Data);
+    Status = gFwCalls.GetVariable(Name, Guid, &Attributes, &Size, *Data);
     if (EFI_ERROR(Status))
     {
-        FreePool(*Data);
+        TaggedFreePool(*Data);
         *Data = NULL;
         return Status;
     }
@@ -125,16 +128,75 @@ EFI_STATUS NvramWriteVariable(
     return gRT->SetVariable(Name, Guid, Attributes, DataSize, Data);
 }
 
+/**
+ * Helper: Read one variable and add it to the manager
+ */
+STATIC BOOLEAN NvramLoadSetupVariable(NVRAM_MANAGER *Manager, CHAR16 *Name, EFI_GUID *Guid)
+{
+    EFI_STATUS Status;
+    VOID *Data = NULL;
+    UINTN DataSize = 0;
+    
+    Status = NvramReadVariable(Manager, Name, Guid, &Data, &DataSize);
+    if (EFI_ERROR(Status))
+        return FALSE;
+    
+    // Check if we need to expand capacity
+    if (Manager->VariableCount >= Manager->VariableCapacity)
+    {
+        Status = NvramExpandCapacity(Manager);
+        if (EFI_ERROR(Status))
+        {
+            TaggedFreePool(Data);
+            Print(L"Warning: Failed to expand NVRAM capacity\n");
+            return FALSE;
+        }
+    }
+    
+    // Add to our list
+    NVRAM_VARIABLE *Var = &Manager->Variables[Manager->VariableCount];
+    Var->Name = TaggedAllocateCopyPool(POOL_TAG_NVRAM, StrSize(Name), Name);
+    CopyMem(&Var->Guid, Guid, sizeof(EFI_GUID));
+    Var->Data = Data;
+    Var->DataSize = DataSize;
+    Var->OriginalData = TaggedAllocateCopyPool(POOL_TAG_NVRAM, DataSize, Data);
+    Var->Modified = FALSE;
+    
+    // Get attributes
+    gFwCalls.GetVariable(Var->Name, &Var->Guid, &Var->Attributes, &DataSize, NULL);
+    
+    Manager->VariableCount++;
+    return TRUE;
+}
+
 /**
  * Load all Setup-related variables
  */
 EFI_STATUS NvramLoadSetupVariables(NVRAM_MANAGER *Manager)
 {
-    EFI_STATUS Status;
+    UINTN LoadedCount = 0;
     
     if (Manager == NULL)
         return EFI_INVALID_PARAMETER;
     
+    // Variable targets from the signature database replace the built-in lists
+    if (PatchDbIsLoaded(&gPatchDb))
+    {
+        CONST PATCH_DB_VARIABLE *Variable = NULL;
+        
+        while ((Variable = PatchDbNextVariable(&gPatchDb, Variable, BIOS_TYPE_UNKNOWN)) != NULL)
+        {
+            EFI_GUID Guid;
+            
+            CopyMem(&Guid, &Variable->Guid, sizeof(EFI_GUID));
+            if (NvramLoadSetupVariable(Manager, (CHAR16 *)PatchDbVariableName(&gPatchDb, Variable), &Guid))
+                LoadedCount++;
+        }
+        
+        Print(L"Loaded %d NVRAM variables\n\r", LoadedCount);
+        return LoadedCount > 0 ? EFI_SUCCESS : EFI_NOT_FOUND;
+    }
+    
     // Try to load common Setup variables
     CHAR16 *CommonVarNames[] = {
         L"Setup",
@@ -181,46 +243,14 @@ EFI_STATUS NvramLoadSetupVariables(NVRAM_MANAGER *Manager)
     };
     
     UINTN GuidCount = 9;
-    UINTN LoadedCount = 0;
     
     // Try each combination
     for (UINTN g = 0; g < GuidCount; g++)
     {
         for (UINTN v = 0; CommonVarNames[v] != NULL; v++)
         {
-            VOID *Data = NULL;
-            UINTN DataSize = 0;
-            
-            Status = NvramReadVariable(Manager, CommonVarNames[v], CommonGuids[g], &Data, &DataSize);
-            if (!EFI_ERROR(Status))
-            {
-                // Check if we need to expand capacity
-                if (Manager->VariableCount >= Manager->VariableCapacity)
-                {
-                    Status = NvramExpandCapacity(Manager);
-                    if (EFI_ERROR(Status))
-                    {
-                        FreePool(Data);
-                        Print(L"Warning: Failed to expand NVRAM capacity\n");
-                        continue;
-                    }
-                }
-                
-                // Add to our list
-                NVRAM_VARIABLE *Var = &Manager->Variables[Manager->VariableCount];
-                Var->Name = AllocateCopyPool(StrSize(CommonVarNames[v]), CommonVarNames[v]);
-                CopyMem(&Var->Guid, CommonGuids[g], sizeof(EFI_GUID));
-                Var->Data = Data;
-                Var->DataSize = DataSize;
-                Var->OriginalData = AllocateCopyPool(DataSize, Data);
-                Var->Modified = FALSE;
-                
-                // Get attributes
-                gRT->GetVariable(Var->Name, &Var->Guid, &Var->Attributes, &DataSize, NULL);
-                
-                Manager->VariableCount++;
+            if (NvramLoadSetupVariable(Manager, CommonVarNames[v], CommonGuids[g]))
                 LoadedCount++;
-            }
         }
     }
     
@@ -256,12 +286,12 @@ EFI_STATUS NvramStageVariable(
             // Update the data
             if (Var->Data && Var->DataSize != DataSize)
             {
-                FreePool(Var->Data);
-                Var->Data = AllocateZeroPool(DataSize);
+                TaggedFreePool(Var->Data);
+                Var->Data = TaggedAllocateZeroPool(POOL_TAG_NVRAM, DataSize);
             }
             else if (!Var->Data)
             {
-                Var->Data = AllocateZeroPool(DataSize);
+                Var->Data = TaggedAllocateZeroPool(POOL_TAG_NVRAM, DataSize);
             }
             
             CopyMem(Var->Data, NewData, DataSize);
@@ -290,9 +320,9 @@ EFI_STATUS NvramStageVariable(
     }
     
     NVRAM_VARIABLE *Var = &Manager->Variables[Manager->VariableCount];
-    Var->Name = AllocateCopyPool(StrSize(Name), Name);
+    Var->Name = TaggedAllocateCopyPool(POOL_TAG_NVRAM, StrSize(Name), Name);
     CopyMem(&Var->Guid, Guid, sizeof(EFI_GUID));
-    Var->Data = AllocateCopyPool(DataSize, NewData);
+    Var->Data = TaggedAllocateCopyPool(POOL_TAG_NVRAM, DataSize, NewData);
     Var->DataSize = DataSize;
     Var->OriginalData = NULL;
     Var->Modified = TRUE;
@@ -344,8 +374,8 @@ EFI_STATUS NvramCommitChanges(NVRAM_MANAGER *Manager)
                 
                 // Update original data
                 if (Var->OriginalData)
-                    FreePool(Var->OriginalData);
-                Var->OriginalData = AllocateCopyPool(Var->DataSize, Var->Data);
+                    TaggedFreePool(Var->OriginalData);
+                Var->OriginalData = TaggedAllocateCopyPool(POOL_TAG_NVRAM, Var->DataSize, Var->Data);
                 Var->Modified = FALSE;
             }
         }
@@ -430,15 +460,15 @@ VOID NvramCleanup(NVRAM_MANAGER *Manager)
         NVRAM_VARIABLE *Var = &Manager->Variables[i];
         
         if (Var->Name)
-            FreePool(Var->Name);
+            TaggedFreePool(Var->Name);
         if (Var->Data)
-            FreePool(Var->Data);
+            TaggedFreePool(Var->Data);
         if (Var->OriginalData)
-            FreePool(Var->OriginalData);
+            TaggedFreePool(Var->OriginalData);
     }
     
     if (Manager->Variables)
-        FreePool(Manager->Variables);
+        TaggedFreePool(Manager->Variables);
     
     ZeroMem(Manager, sizeof(NVRAM_MANAGER));
 }
@@ -455,7 +485,7 @@ EFI_STATUS DatabaseInitialize(DATABASE_CONTEXT *DbContext)
     
     // Allocate initial capacity
     DbContext->EntryCapacity = 100;
-    DbContext->Entries = AllocateZeroPool(sizeof(DATABASE_ENTRY) * DbContext->EntryCapacity);
+    DbContext->Entries = TaggedAllocateZeroPool(POOL_TAG_NVRAM, sizeof(DATABASE_ENTRY) * DbContext->EntryCapacity);
     
     if (DbContext->Entries == NULL)
         return EFI_OUT_OF_RESOURCES;
@@ -486,13 +516,13 @@ EFI_STATUS DatabaseAddEntry(
     if (DbContext->EntryCount >= DbContext->EntryCapacity)
     {
         UINTN NewCapacity = DbContext->EntryCapacity * 2;
-        DATABASE_ENTRY *NewEntries = AllocateZeroPool(sizeof(DATABASE_ENTRY) * NewCapacity);
+        DATABASE_ENTRY *NewEntries = TaggedAllocateZeroPool(POOL_TAG_NVRAM, sizeof(DATABASE_ENTRY) * NewCapacity);
         
         if (NewEntries == NULL)
             return EFI_OUT_OF_RESOURCES;
         
         CopyMem(NewEntries, DbContext->Entries, sizeof(DATABASE_ENTRY) * DbContext->EntryCount);
-        FreePool(DbContext->Entries);
+        TaggedFreePool(DbContext->Entries);
         DbContext->Entries = NewEntries;
         DbContext->EntryCapacity = NewCapacity;
     }
@@ -500,7 +530,7 @@ EFI_STATUS DatabaseAddEntry(
     // Add new entry
     DATABASE_ENTRY *Entry = &DbContext->Entries[DbContext->EntryCount];
     Entry->QuestionId = QuestionId;
-    Entry->VariableName = AllocateCopyPool(StrSize(VariableName), VariableName);
+    Entry->VariableName = TaggedAllocateCopyPool(POOL_TAG_NVRAM, StrSize(VariableName), VariableName);
     CopyMem(&Entry->VariableGuid, VariableGuid, sizeof(EFI_GUID));
     Entry->Offset = Offset;
     Entry->Size = Size;
@@ -738,12 +768,12 @@ VOID DatabaseCleanup(DATABASE_CONTEXT *DbContext)
     for (UINTN i = 0; i < DbContext->EntryCount; i++)
     {
         if (DbContext->Entries[i].VariableName != NULL)
-            FreePool(DbContext->Entries[i].VariableName);
+            TaggedFreePool(DbContext->Entries[i].VariableName);
     }
     
     // Free entries array
     if (DbContext->Entries != NULL)
-        FreePool(DbContext->Entries);
+        TaggedFreePool(DbContext->Entries);
     
     ZeroMem(DbContext, sizeof(DATABASE_CONTEXT));
 }
@@ -1,5 +1,6 @@
 #include "Opcode.h"
 #include "Utility.h"
+#include "LoadedImageIndex.h"
 EFI_STATUS LoadFS(EFI_HANDLE ImageHandle, CHAR8 *FileName, EFI_LOADED_IMAGE_PROTOCOL **ImageInfo, EFI_HANDLE *AppImageHandle)
 {
     //UINTN ExitDataSize;
@@ -60,14 +61,16 @@ EFI_STATUS LoadFV(EFI_HANDLE ImageHandle, CHAR8 *FileName, EFI_LOADED_IMAGE_PROT
 
     CHAR16 FileName16[255] = {0};
     UnicodeSPrint(FileName16, sizeof(FileName16), L"%a", FileName);
-    UINT8 *Buffer = NULL;
+    CONST UINT8 *Buffer = NULL;
     UINTN BufferSize = 0;
-    Status = LocateAndLoadFvFromName(FileName16, Section_Type, &Buffer, &BufferSize);
 
-    Status = gBS->LoadImage(FALSE, ImageHandle, (VOID *)NULL, Buffer, BufferSize,
-                            AppImageHandle);
-    if (Buffer != NULL)
-        FreePool(Buffer);
+    // In place from flash, or from the section cache so each file is decompressed once
+    Status = LocateAndLoadFvFromName(FileName16, Section_Type, &Buffer, &BufferSize);
+    if (!EFI_ERROR(Status))
+    {
+        Status = gBS->LoadImage(FALSE, ImageHandle, (VOID *)NULL, (VOID *)Buffer, BufferSize,
+                                AppImageHandle);
+    }
     if (Status != EFI_SUCCESS)
     {
         Print(L"Could not Locate the image  from FV %r \n", Status);
@@ -93,34 +96,18 @@ EFI_STATUS Exec(EFI_HANDLE *AppImageHandle)
 
 EFI_STATUS FindLoadedImageFromName(EFI_HANDLE ImageHandle, CHAR8 *FileName, EFI_LOADED_IMAGE_PROTOCOL **ImageInfo)
 {
-    EFI_STATUS Status;
-    UINTN HandleSize = 0;
-    EFI_HANDLE *Handles;
+    CONST LOADED_IMAGE_ENTRY *Entry;
     CHAR16 FileName16[255] = {0};
     UnicodeSPrint(FileName16, sizeof(FileName16), L"%a", FileName);
-    Status = gBS->LocateHandle(ByProtocol, &gEfiLoadedImageProtocolGuid, NULL, &HandleSize, NULL);
-    if (Status == EFI_BUFFER_TOO_SMALL)
-    {
-        Handles = AllocateZeroPool(HandleSize * sizeof(EFI_HANDLE));
-        Status = gBS->LocateHandle(ByProtocol, &gEfiLoadedImageProtocolGuid, NULL, &HandleSize, Handles);
-        Print(L"Retrived %d Handle, with %r\n\r", HandleSize, Status);
-    }
 
-    for (UINTN i = 0; i < HandleSize; i++)
+    // Hash lookup; each image's UI section is read once when it is indexed
+    Entry = LoadedImageIndexFindByName(&gLoadedImageIndex, FileName16);
+    if (Entry == NULL)
     {
-        Status = gBS->HandleProtocol(Handles[i], &gEfiLoadedImageProtocolGuid, (VOID **)ImageInfo);
-        if (Status == EFI_SUCCESS)
-        {
-            CHAR16 *String = FindLoadedImageFileName(*ImageInfo);
-            if (String != NULL)
-            {
-                if (StrCmp(FileName16, String) == 0)
-                {
-                    Print(L"Found %s at Address 0x%X\n\r", String, (*ImageInfo)->ImageBase);
-                    return EFI_SUCCESS;
-                }
-            }
-        }
+        return EFI_NOT_FOUND;
     }
-    return EFI_NOT_FOUND;
+
+    *ImageInfo = Entry->LoadedImage;
+    Print(L"Found %s at Address 0x%X\n\r", Entry->Name, Entry->ImageBase);
+    return EFI_SUCCESS;
 }
\ No newline at end of file
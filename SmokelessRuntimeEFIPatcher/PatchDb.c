@@ -0,0 +1,409 @@
+#include "PatchDb.h"
+#include "TaggedPool.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+PATCH_DB gPatchDb;
+
+/**
+ * Helper: Check that a table of Count elements lies inside the file
+ */
+STATIC BOOLEAN PatchDbTableValid(CONST PATCH_DB_TABLE *Table, UINTN ElementSize, UINTN Alignment, UINTN Size)
+{
+    UINT64 End;
+
+    if (Table->Count == 0)
+        return TRUE;
+
+    if ((Table->Offset & (Alignment - 1)) != 0 || Table->Offset < sizeof(PATCH_DB_HEADER))
+        return FALSE;
+
+    End = (UINT64)Table->Offset + (UINT64)Table->Count * ElementSize;
+    return End <= Size;
+}
+
+/**
+ * Helper: Order of two modules in the name table
+ */
+STATIC INTN PatchDbCompareNames(CONST PATCH_DB *Db, UINTN Left, UINTN Right)
+{
+    return AsciiStrCmp(&Db->AsciiStrings[Db->Modules[Left].NameOffset],
+                       &Db->AsciiStrings[Db->Modules[Right].NameOffset]);
+}
+
+/**
+ * Helper: Order of two variables (GUID, then name)
+ */
+STATIC INTN PatchDbCompareVariables(CONST PATCH_DB *Db, CONST PATCH_DB_VARIABLE *Left, CONST PATCH_DB_VARIABLE *Right)
+{
+    INTN Order = CompareMem(&Left->Guid, &Right->Guid, sizeof(EFI_GUID));
+
+    if (Order != 0)
+        return Order;
+
+    return StrCmp(&Db->UnicodeStrings[Left->NameOffset], &Db->UnicodeStrings[Right->NameOffset]);
+}
+
+/**
+ * Validate a database image and point Db at its tables
+ */
+EFI_STATUS PatchDbOpen(PATCH_DB *Db, VOID *Buffer, UINTN Size)
+{
+    CONST PATCH_DB_HEADER *Header = (CONST PATCH_DB_HEADER *)Buffer;
+    PATCH_DB Candidate;
+    UINTN Index;
+
+    ZeroMem(Db, sizeof(PATCH_DB));
+
+    if (Buffer == NULL || Size < sizeof(PATCH_DB_HEADER) || Header->Signature != PATCH_DB_SIGNATURE)
+        return EFI_VOLUME_CORRUPTED;
+
+    if (Header->Version != PATCH_DB_VERSION || Header->HeaderSize != sizeof(PATCH_DB_HEADER))
+        return EFI_INCOMPATIBLE_VERSION;
+
+    if (Header->FileSize != Size ||
+        !PatchDbTableValid(&Header->Modules, sizeof(PATCH_DB_MODULE), 4, Size) ||
+        !PatchDbTableValid(&Header->GuidIndex, sizeof(UINT16), 2, Size) ||
+        !PatchDbTableValid(&Header->Patterns, sizeof(BYTE_PATTERN), 1, Size) ||
+        !PatchDbTableValid(&Header->Actions, sizeof(PATCH_DB_PATCH), 1, Size) ||
+        !PatchDbTableValid(&Header->Variables, sizeof(PATCH_DB_VARIABLE), 4, Size) ||
+        !PatchDbTableValid(&Header->AsciiStrings, sizeof(CHAR8), 1, Size) ||
+        !PatchDbTableValid(&Header->UnicodeStrings, sizeof(CHAR16), 2, Size) ||
+        Header->Modules.Count > MAX_UINT16 ||
+        Header->GuidIndex.Count > Header->Modules.Count ||
+        Header->Actions.Count != Header->Patterns.Count)
+        return EFI_VOLUME_CORRUPTED;
+
+    ZeroMem(&Candidate, sizeof(Candidate));
+    Candidate.Header = Header;
+    Candidate.Modules = (CONST PATCH_DB_MODULE *)((UINT8 *)Buffer + Header->Modules.Offset);
+    Candidate.GuidIndex = (CONST UINT16 *)((UINT8 *)Buffer + Header->GuidIndex.Offset);
+    Candidate.Patterns = (CONST BYTE_PATTERN *)((UINT8 *)Buffer + Header->Patterns.Offset);
+    Candidate.Actions = (CONST PATCH_DB_PATCH *)((UINT8 *)Buffer + Header->Actions.Offset);
+    Candidate.Variables = (CONST PATCH_DB_VARIABLE *)((UINT8 *)Buffer + Header->Variables.Offset);
+    Candidate.AsciiStrings = (CONST CHAR8 *)Buffer + Header->AsciiStrings.Offset;
+    Candidate.UnicodeStrings = (CONST CHAR16 *)((UINT8 *)Buffer + Header->UnicodeStrings.Offset);
+
+    // String pools must end in NUL so every string in them is terminated
+    if ((Header->Modules.Count > 0 &&
+         (Header->AsciiStrings.Count == 0 || Candidate.AsciiStrings[Header->AsciiStrings.Count - 1] != '\0')) ||
+        (Header->Variables.Count > 0 &&
+         (Header->UnicodeStrings.Count == 0 || Candidate.UnicodeStrings[Header->UnicodeStrings.Count - 1] != L'\0')))
+        return EFI_VOLUME_CORRUPTED;
+
+    for (Index = 0; Index < Header->Modules.Count; Index++)
+    {
+        CONST PATCH_DB_MODULE *Module = &Candidate.Modules[Index];
+
+        if (Module->NameOffset >= Header->AsciiStrings.Count ||
+            Module->FirstPattern > Header->Patterns.Count ||
+            Module->PatternCount > Header->Patterns.Count - Module->FirstPattern)
+            return EFI_VOLUME_CORRUPTED;
+
+        if (Index > 0 && PatchDbCompareNames(&Candidate, Index - 1, Index) >= 0)
+            return EFI_VOLUME_CORRUPTED;
+    }
+
+    for (Index = 0; Index < Header->GuidIndex.Count; Index++)
+    {
+        if (Candidate.GuidIndex[Index] >= Header->Modules.Count)
+            return EFI_VOLUME_CORRUPTED;
+
+        if (Index > 0 &&
+            CompareMem(&Candidate.Modules[Candidate.GuidIndex[Index - 1]].FileGuid,
+                       &Candidate.Modules[Candidate.GuidIndex[Index]].FileGuid, sizeof(EFI_GUID)) > 0)
+            return EFI_VOLUME_CORRUPTED;
+    }
+
+    for (Index = 0; Index < Header->Patterns.Count; Index++)
+    {
+        CONST BYTE_PATTERN *Pattern = &Candidate.Patterns[Index];
+        CONST PATCH_DB_PATCH *Patch = &Candidate.Actions[Index];
+
+        if (Pattern->Length == 0 || Pattern->Length > BYTE_PATTERN_MAX_LENGTH ||
+            (Patch->Kind != IMAGE_SECTION_CODE && Patch->Kind != IMAGE_SECTION_DATA) ||
+            Patch->PatchLength == 0 || Patch->PatchLength > PATCH_RECORD_MAX_BYTES ||
+            (UINTN)Patch->PatchOffset + Patch->PatchLength > Pattern->Length)
+            return EFI_VOLUME_CORRUPTED;
+    }
+
+    for (Index = 0; Index < Header->Variables.Count; Index++)
+    {
+        if (Candidate.Variables[Index].NameOffset >= Header->UnicodeStrings.Count)
+            return EFI_VOLUME_CORRUPTED;
+
+        if (Index > 0 &&
+            PatchDbCompareVariables(&Candidate, &Candidate.Variables[Index - 1], &Candidate.Variables[Index]) > 0)
+            return EFI_VOLUME_CORRUPTED;
+    }
+
+    CopyMem(Db, &Candidate, sizeof(PATCH_DB));
+    Db->Buffer = Buffer;
+    Db->Size = Size;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Load the database file with a single read
+ */
+EFI_STATUS PatchDbLoad(PATCH_DB *Db, EFI_FILE *Root)
+{
+    EFI_STATUS Status;
+    EFI_FILE *File;
+    UINT64 FileSize = 0;
+    VOID *Buffer;
+    UINTN Size;
+
+    ZeroMem(Db, sizeof(PATCH_DB));
+
+    Status = Root->Open(Root, &File, PATCH_DB_FILE_NAME, EFI_FILE_MODE_READ, 0);
+    if (EFI_ERROR(Status))
+        return EFI_NOT_FOUND;
+
+    // Seeking past the end gives the file size without a FILE_INFO round trip
+    Status = File->SetPosition(File, MAX_UINT64);
+    if (!EFI_ERROR(Status))
+        Status = File->GetPosition(File, &FileSize);
+    if (!EFI_ERROR(Status))
+        Status = File->SetPosition(File, 0);
+    if (EFI_ERROR(Status) || FileSize < sizeof(PATCH_DB_HEADER) || FileSize > PATCH_DB_MAX_FILE_SIZE)
+    {
+        File->Close(File);
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    Size = (UINTN)FileSize;
+    Buffer = TaggedAllocatePool(POOL_TAG_PATCH, Size);
+    if (Buffer == NULL)
+    {
+        File->Close(File);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = File->Read(File, &Size, Buffer);
+    File->Close(File);
+
+    if (!EFI_ERROR(Status))
+        Status = PatchDbOpen(Db, Buffer, Size);
+
+    if (EFI_ERROR(Status))
+        TaggedFreePool(Buffer);
+
+    return Status;
+}
+
+/**
+ * Free a database loaded by PatchDbLoad
+ */
+VOID PatchDbUnload(PATCH_DB *Db)
+{
+    if (Db->Buffer != NULL)
+        TaggedFreePool(Db->Buffer);
+
+    ZeroMem(Db, sizeof(PATCH_DB));
+}
+
+/**
+ * Check whether a database is loaded
+ */
+BOOLEAN PatchDbIsLoaded(CONST PATCH_DB *Db)
+{
+    return Db != NULL && Db->Header != NULL;
+}
+
+/**
+ * Find a module by UI name (binary search)
+ */
+CONST PATCH_DB_MODULE *PatchDbFindModule(CONST PATCH_DB *Db, CONST CHAR8 *Name)
+{
+    UINTN Low = 0;
+    UINTN High;
+
+    if (!PatchDbIsLoaded(Db) || Name == NULL)
+        return NULL;
+
+    High = Db->Header->Modules.Count;
+    while (Low < High)
+    {
+        UINTN Middle = Low + (High - Low) / 2;
+        INTN Order = AsciiStrCmp(&Db->AsciiStrings[Db->Modules[Middle].NameOffset], Name);
+
+        if (Order == 0)
+            return &Db->Modules[Middle];
+
+        if (Order < 0)
+            Low = Middle + 1;
+        else
+            High = Middle;
+    }
+
+    return NULL;
+}
+
+/**
+ * Find a module by FFS file GUID (binary search)
+ */
+CONST PATCH_DB_MODULE *PatchDbFindModuleByGuid(CONST PATCH_DB *Db, CONST EFI_GUID *FileGuid)
+{
+    UINTN Low = 0;
+    UINTN High;
+
+    if (!PatchDbIsLoaded(Db) || FileGuid == NULL)
+        return NULL;
+
+    High = Db->Header->GuidIndex.Count;
+    while (Low < High)
+    {
+        UINTN Middle = Low + (High - Low) / 2;
+        CONST PATCH_DB_MODULE *Module = &Db->Modules[Db->GuidIndex[Middle]];
+        INTN Order = CompareMem(&Module->FileGuid, FileGuid, sizeof(EFI_GUID));
+
+        if (Order == 0)
+            return Module;
+
+        if (Order < 0)
+            Low = Middle + 1;
+        else
+            High = Middle;
+    }
+
+    return NULL;
+}
+
+/**
+ * Iterate the modules that have a role for a BIOS type
+ */
+CONST PATCH_DB_MODULE *PatchDbNextModule(
+    CONST PATCH_DB *Db,
+    CONST PATCH_DB_MODULE *Previous,
+    UINT16 Role,
+    BIOS_TYPE Type)
+{
+    UINTN Index;
+
+    if (!PatchDbIsLoaded(Db))
+        return NULL;
+
+    Index = Previous == NULL ? 0 : (UINTN)(Previous - Db->Modules) + 1;
+    for (; Index < Db->Header->Modules.Count; Index++)
+    {
+        CONST PATCH_DB_MODULE *Module = &Db->Modules[Index];
+
+        if ((Module->Roles & Role) == 0)
+            continue;
+
+        if (Type == BIOS_TYPE_UNKNOWN || Module->VendorMask == 0 ||
+            (Module->VendorMask & PATCH_DB_VENDOR(Type)) != 0)
+            return Module;
+    }
+
+    return NULL;
+}
+
+/**
+ * UI name of a module
+ */
+CONST CHAR8 *PatchDbModuleName(CONST PATCH_DB *Db, CONST PATCH_DB_MODULE *Module)
+{
+    return &Db->AsciiStrings[Module->NameOffset];
+}
+
+typedef struct {
+    CONST PATCH_DB_PATCH *Actions;
+    UINTN PatchCount;
+} PATCH_DB_SCAN_CONTEXT;
+
+/**
+ * Helper: ByteScan callback for PatchDbApplyPatterns
+ */
+STATIC BOOLEAN PatchDbPatternMatch(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex)
+{
+    PATCH_DB_SCAN_CONTEXT *Scan = (PATCH_DB_SCAN_CONTEXT *)Context;
+    CONST PATCH_DB_PATCH *Patch = &Scan->Actions[PatternIndex];
+
+    (VOID)PatchPlanWrite(Data, Offset + Patch->PatchOffset, Patch->NewBytes, Patch->PatchLength, PATCH_REASON_DB_PATTERN);
+    Scan->PatchCount++;
+    return TRUE;
+}
+
+/**
+ * Run the patterns of a module over its sections and write their patches
+ *
+ * Patterns run straight from the database buffer, in groups of up to
+ * BYTE_SCAN_MAX_PATTERNS that share a section kind.
+ */
+UINTN PatchDbApplyPatterns(CONST PATCH_DB *Db, CONST PATCH_DB_MODULE *Module, IMAGE_SECTION_MAP *Map)
+{
+    PATCH_DB_SCAN_CONTEXT Scan;
+    UINTN First;
+    UINTN End;
+
+    if (!PatchDbIsLoaded(Db) || Module == NULL || Map == NULL)
+        return 0;
+
+    Scan.PatchCount = 0;
+    First = Module->FirstPattern;
+    End = First + Module->PatternCount;
+
+    while (First < End)
+    {
+        BYTE_SCANNER Scanner;
+        UINT8 Kind = Db->Actions[First].Kind;
+        UINTN Count = 1;
+        UINTN s;
+
+        while (First + Count < End && Count < BYTE_SCAN_MAX_PATTERNS && Db->Actions[First + Count].Kind == Kind)
+            Count++;
+
+        Scan.Actions = &Db->Actions[First];
+        if (!EFI_ERROR(ByteScanInit(&Scanner, &Db->Patterns[First], Count)))
+        {
+            for (s = 0; s < Map->SectionCount; s++)
+            {
+                IMAGE_SECTION *Section = &Map->Sections[s];
+
+                if ((Section->Kind & Kind) == 0)
+                    continue;
+
+                ByteScan(&Scanner, Map->ImageBase, Section->Offset, (UINTN)Section->Offset + Section->Size,
+                         PatchDbPatternMatch, &Scan);
+            }
+        }
+
+        First += Count;
+    }
+
+    return Scan.PatchCount;
+}
+
+/**
+ * Iterate the NVRAM variables of interest
+ */
+CONST PATCH_DB_VARIABLE *PatchDbNextVariable(CONST PATCH_DB *Db, CONST PATCH_DB_VARIABLE *Previous, BIOS_TYPE Type)
+{
+    UINTN Index;
+
+    if (!PatchDbIsLoaded(Db))
+        return NULL;
+
+    Index = Previous == NULL ? 0 : (UINTN)(Previous - Db->Variables) + 1;
+    for (; Index < Db->Header->Variables.Count; Index++)
+    {
+        CONST PATCH_DB_VARIABLE *Variable = &Db->Variables[Index];
+
+        if (Type == BIOS_TYPE_UNKNOWN || Variable->VendorMask == 0 ||
+            (Variable->VendorMask & PATCH_DB_VENDOR(Type)) != 0)
+            return Variable;
+    }
+
+    return NULL;
+}
+
+/**
+ * Name of a variable
+ */
+CONST CHAR16 *PatchDbVariableName(CONST PATCH_DB *Db, CONST PATCH_DB_VARIABLE *Variable)
+{
+    return &Db->UnicodeStrings[Variable->NameOffset];
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+#include "BiosDetector.h"
+#include "ByteScan.h"
+#include "ImageSections.h"
+#include "PatchPlan.h"
+
+// Signature database, next to the log on the volume SREP was started from
+#define PATCH_DB_FILE_NAME L"SREP.db"
+
+#define PATCH_DB_SIGNATURE SIGNATURE_32('S', 'R', 'D', 'B')
+#define PATCH_DB_VERSION 1
+
+// Largest database accepted
+#define PATCH_DB_MAX_FILE_SIZE SIZE_1MB
+
+// Vendor mask bit of a BIOS_TYPE; a mask of 0 matches every vendor
+#define PATCH_DB_VENDOR(Type) ((UINT16)(1U << (Type)))
+
+// PATCH_DB_MODULE.Roles - which phase picks the module up
+#define PATCH_DB_ROLE_SETUP_DEPENDENCY BIT0   // Loaded from FV and patched by PatchSetupDependencies
+#define PATCH_DB_ROLE_VENDOR           BIT1   // Patched in the vendor phase when already loaded
+
+// PATCH_DB_MODULE.Actions - passes run on the module besides its patterns
+#define PATCH_DB_ACTION_WRITE_PROTECT  BIT0   // MODULE_PASS_WRITE_PROTECT
+#define PATCH_DB_ACTION_UNLOCK_FORMS   BIT1   // MODULE_PASS_UNLOCK_FORMS
+
+// Location of a table in the file
+typedef struct {
+    UINT32 Offset;               // From the start of the file
+    UINT32 Count;                // Elements (bytes for AsciiStrings, CHAR16s for UnicodeStrings)
+} PATCH_DB_TABLE;
+
+// File header; every table is read in place from the loaded buffer
+typedef struct {
+    UINT32 Signature;            // PATCH_DB_SIGNATURE
+    UINT16 Version;              // PATCH_DB_VERSION
+    UINT16 HeaderSize;           // sizeof(PATCH_DB_HEADER)
+    UINT32 FileSize;
+    UINT32 Reserved;
+    PATCH_DB_TABLE Modules;      // PATCH_DB_MODULE, sorted by name
+    PATCH_DB_TABLE GuidIndex;    // UINT16 module indices, sorted by FileGuid
+    PATCH_DB_TABLE Patterns;     // BYTE_PATTERN, ready for ByteScanInit
+    PATCH_DB_TABLE Actions;      // PATCH_DB_PATCH, one per pattern
+    PATCH_DB_TABLE Variables;    // PATCH_DB_VARIABLE, sorted by GUID then name
+    PATCH_DB_TABLE AsciiStrings; // NUL-terminated module names
+    PATCH_DB_TABLE UnicodeStrings; // NUL-terminated variable names
+} PATCH_DB_HEADER;
+
+// One known module (32 bytes)
+typedef struct {
+    EFI_GUID FileGuid;           // FFS file name, zero if only the name is known
+    UINT32 NameOffset;           // UI name in AsciiStrings
+    UINT16 VendorMask;           // PATCH_DB_VENDOR bits, 0 = any vendor
+    UINT16 Roles;                // PATCH_DB_ROLE_*
+    UINT16 Actions;              // PATCH_DB_ACTION_*
+    UINT16 PatternCount;
+    UINT32 FirstPattern;         // Code patterns first, then data patterns
+} PATCH_DB_MODULE;
+
+// What a matched pattern writes (8 bytes)
+typedef struct {
+    UINT8 Kind;                  // IMAGE_SECTION_CODE or IMAGE_SECTION_DATA
+    UINT8 PatchOffset;           // From the start of the match
+    UINT8 PatchLength;           // 1..PATCH_RECORD_MAX_BYTES
+    UINT8 Reserved;
+    UINT8 NewBytes[PATCH_RECORD_MAX_BYTES];
+} PATCH_DB_PATCH;
+
+// One NVRAM variable of interest (24 bytes)
+typedef struct {
+    EFI_GUID Guid;
+    UINT32 NameOffset;           // CHAR16 index into UnicodeStrings
+    UINT16 VendorMask;           // PATCH_DB_VENDOR bits, 0 = any vendor
+    UINT16 Reserved;
+} PATCH_DB_VARIABLE;
+
+// Loaded database; all pointers point into Buffer
+typedef struct {
+    VOID *Buffer;
+    UINTN Size;
+    CONST PATCH_DB_HEADER *Header;
+    CONST PATCH_DB_MODULE *Modules;
+    CONST UINT16 *GuidIndex;
+    CONST BYTE_PATTERN *Patterns;
+    CONST PATCH_DB_PATCH *Actions;
+    CONST PATCH_DB_VARIABLE *Variables;
+    CONST CHAR8 *AsciiStrings;
+    CONST CHAR16 *UnicodeStrings;
+} PATCH_DB;
+
+// Database shared by every phase; empty until PatchDbLoad succeeds
+extern PATCH_DB gPatchDb;
+
+/**
+ * Validate a database image and point Db at its tables
+ *
+ * Every offset, count, string and sort order is checked once here so the
+ * lookups can trust the tables. Nothing is allocated or copied.
+ *
+ * @param Db            Database to initialize
+ * @param Buffer        File image (kept by Db, not freed)
+ * @param Size          Size of Buffer
+ * @return EFI_SUCCESS, EFI_INCOMPATIBLE_VERSION or EFI_VOLUME_CORRUPTED
+ */
+EFI_STATUS PatchDbOpen(PATCH_DB *Db, VOID *Buffer, UINTN Size);
+
+/**
+ * Load the database file with a single read
+ *
+ * @param Db            Database to initialize
+ * @param Root          Directory holding PATCH_DB_FILE_NAME
+ * @return EFI_SUCCESS, EFI_NOT_FOUND without a file, or a PatchDbOpen error
+ */
+EFI_STATUS PatchDbLoad(PATCH_DB *Db, EFI_FILE *Root);
+
+/**
+ * Free a database loaded by PatchDbLoad
+ *
+ * @param Db            Database to free
+ */
+VOID PatchDbUnload(PATCH_DB *Db);
+
+/**
+ * Check whether a database is loaded
+ *
+ * @param Db            Database
+ * @return TRUE if the tables can be used
+ */
+BOOLEAN PatchDbIsLoaded(CONST PATCH_DB *Db);
+
+/**
+ * Find a module by UI name (binary search)
+ *
+ * @param Db            Loaded database
+ * @param Name          UI name of the module
+ * @return Module, or NULL
+ */
+CONST PATCH_DB_MODULE *PatchDbFindModule(CONST PATCH_DB *Db, CONST CHAR8 *Name);
+
+/**
+ * Find a module by FFS file GUID (binary search)
+ *
+ * @param Db            Loaded database
+ * @param FileGuid      FFS file name
+ * @return Module, or NULL
+ */
+CONST PATCH_DB_MODULE *PatchDbFindModuleByGuid(CONST PATCH_DB *Db, CONST EFI_GUID *FileGuid);
+
+/**
+ * Iterate the modules that have a role for a BIOS type
+ *
+ * @param Db            Loaded database
+ * @param Previous      Module returned by the previous call, NULL to start
+ * @param Role          PATCH_DB_ROLE_* bit
+ * @param Type          Detected BIOS type (BIOS_TYPE_UNKNOWN matches every vendor)
+ * @return Next module, or NULL
+ */
+CONST PATCH_DB_MODULE *PatchDbNextModule(
+    CONST PATCH_DB *Db,
+    CONST PATCH_DB_MODULE *Previous,
+    UINT16 Role,
+    BIOS_TYPE Type);
+
+/**
+ * UI name of a module
+ *
+ * @param Db            Loaded database
+ * @param Module        Module of Db
+ * @return NUL-terminated name inside the database buffer
+ */
+CONST CHAR8 *PatchDbModuleName(CONST PATCH_DB *Db, CONST PATCH_DB_MODULE *Module);
+
+/**
+ * Run the patterns of a module over its sections and write their patches
+ *
+ * @param Db            Loaded database
+ * @param Module        Module of Db
+ * @param Map           Section map of the loaded module
+ * @return Number of patches written
+ */
+UINTN PatchDbApplyPatterns(CONST PATCH_DB *Db, CONST PATCH_DB_MODULE *Module, IMAGE_SECTION_MAP *Map);
+
+/**
+ * Iterate the NVRAM variables of interest
+ *
+ * @param Db            Loaded database
+ * @param Previous      Variable returned by the previous call, NULL to start
+ * @param Type          Detected BIOS type (BIOS_TYPE_UNKNOWN matches every vendor)
+ * @return Next variable, or NULL
+ */
+CONST PATCH_DB_VARIABLE *PatchDbNextVariable(CONST PATCH_DB *Db, CONST PATCH_DB_VARIABLE *Previous, BIOS_TYPE Type);
+
+/**
+ * Name of a variable
+ *
+ * @param Db            Loaded database
+ * @param Variable      Variable of Db
+ * @return NUL-terminated name inside the database buffer
+ */
+CONST CHAR16 *PatchDbVariableName(CONST PATCH_DB *Db, CONST PATCH_DB_VARIABLE *Variable);
@@ -0,0 +1,498 @@
+#include "PatchManifest.h"
+#include "LoadedImageIndex.h"
+#include "TaggedPool.h"
+#include <Library/BaseCryptLib.h>
+#include <Library/BaseLib.h>
+#include <Library/PrintLib.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+// File layout: header, modules in planning order, then the records they index
+#define PATCH_MANIFEST_SIGNATURE SIGNATURE_32('S', 'R', 'P', 'M')
+#define PATCH_MANIFEST_VERSION 3
+
+// Larger files are not ours (a full manifest is a few KB)
+#define PATCH_MANIFEST_MAX_FILE_SIZE SIZE_4MB
+
+// Initial module capacity; grown by doubling
+#define PATCH_MANIFEST_INITIAL_ENTRIES 16
+
+typedef struct {
+    UINT32 Signature;
+    UINT32 Version;
+    UINT32 ModuleCount;
+    UINT32 RecordCount;
+} PATCH_MANIFEST_HEADER;
+
+PATCH_MANIFEST gPatchManifest;
+
+/**
+ * Helper: Take over the modules and records of a file image
+ */
+STATIC BOOLEAN PatchManifestParse(PATCH_MANIFEST *Manifest, UINT8 *Buffer, UINTN Size)
+{
+    PATCH_MANIFEST_HEADER *Header = (PATCH_MANIFEST_HEADER *)Buffer;
+    PATCH_MANIFEST_MODULE *Modules;
+    PATCH_RECORD *Records;
+
+    if (Size < sizeof(PATCH_MANIFEST_HEADER) ||
+        Header->Signature != PATCH_MANIFEST_SIGNATURE || Header->Version != PATCH_MANIFEST_VERSION)
+        return FALSE;
+
+    if (Size != sizeof(PATCH_MANIFEST_HEADER) +
+                (UINTN)Header->ModuleCount * sizeof(PATCH_MANIFEST_MODULE) +
+                (UINTN)Header->RecordCount * sizeof(PATCH_RECORD))
+        return FALSE;
+
+    Modules = (PATCH_MANIFEST_MODULE *)(Header + 1);
+    Records = (PATCH_RECORD *)&Modules[Header->ModuleCount];
+    for (UINTN i = 0; i < Header->ModuleCount; i++)
+    {
+        if (Modules[i].FirstRecord > Header->RecordCount ||
+            Modules[i].RecordCount > Header->RecordCount - Modules[i].FirstRecord)
+            return FALSE;
+    }
+    for (UINTN i = 0; i < Header->RecordCount; i++)
+    {
+        if (Records[i].Length == 0 || Records[i].Length > PATCH_RECORD_MAX_BYTES)
+            return FALSE;
+    }
+
+    if (Header->RecordCount > 0)
+    {
+        Manifest->Records = TaggedAllocateCopyPool(POOL_TAG_PATCH, Header->RecordCount * sizeof(PATCH_RECORD), Records);
+        if (Manifest->Records == NULL)
+            return FALSE;
+        Manifest->RecordCount = Header->RecordCount;
+    }
+
+    if (Header->ModuleCount > 0)
+    {
+        Manifest->Entries = TaggedAllocateZeroPool(POOL_TAG_PATCH, Header->ModuleCount * sizeof(PATCH_MANIFEST_ENTRY));
+        if (Manifest->Entries == NULL)
+            return FALSE;
+        Manifest->EntryCount = Manifest->EntryCapacity = Header->ModuleCount;
+    }
+
+    // Each module applies a view of the shared records
+    for (UINTN i = 0; i < Manifest->EntryCount; i++)
+    {
+        PATCH_MANIFEST_ENTRY *Entry = &Manifest->Entries[i];
+
+        CopyMem(&Entry->Info, &Modules[i], sizeof(PATCH_MANIFEST_MODULE));
+        Entry->Info.Name[PATCH_MANIFEST_NAME_SIZE - 1] = 0;
+        PatchPlanInitFixed(&Entry->Plan, &Manifest->Records[Entry->Info.FirstRecord], Entry->Info.RecordCount);
+        Entry->Plan.Count = Entry->Info.RecordCount;
+        Entry->Plan.Sorted = FALSE;
+
+        for (UINTN r = 0; r < Entry->Plan.Count; r++)
+            Entry->Plan.Records[r].Flags = 0;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Helper: Read the manifest file
+ */
+STATIC EFI_STATUS PatchManifestLoad(PATCH_MANIFEST *Manifest, EFI_FILE *Root)
+{
+    EFI_STATUS Status;
+    EFI_FILE *File;
+    UINT64 FileSize = 0;
+    UINT8 *Buffer;
+    UINTN Size;
+
+    Status = Root->Open(Root, &File, PATCH_MANIFEST_FILE_NAME, EFI_FILE_MODE_READ, 0);
+    if (EFI_ERROR(Status))
+        return EFI_NOT_FOUND;
+
+    // Seeking past the end gives the file size without a FILE_INFO round trip
+    if (EFI_ERROR(File->SetPosition(File, MAX_UINT64)) || EFI_ERROR(File->GetPosition(File, &FileSize)) ||
+        FileSize == 0 || FileSize > PATCH_MANIFEST_MAX_FILE_SIZE || EFI_ERROR(File->SetPosition(File, 0)))
+    {
+        File->Close(File);
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    Size = (UINTN)FileSize;
+    Buffer = TaggedAllocatePool(POOL_TAG_PATCH, Size);
+    if (Buffer == NULL)
+    {
+        File->Close(File);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = File->Read(File, &Size, Buffer);
+    File->Close(File);
+
+    if (!EFI_ERROR(Status) && !PatchManifestParse(Manifest, Buffer, Size))
+        Status = EFI_VOLUME_CORRUPTED;
+
+    TaggedFreePool(Buffer);
+    return Status;
+}
+
+/**
+ * Choose the mode of this run
+ */
+EFI_STATUS PatchManifestOpen(PATCH_MANIFEST *Manifest, EFI_FILE *Root, CONST CHAR16 *PlanFlagFile)
+{
+    EFI_STATUS Status;
+    EFI_FILE *Flag;
+
+    ZeroMem(Manifest, sizeof(PATCH_MANIFEST));
+    PatchPlanInit(&Manifest->Scratch);
+
+    if (!EFI_ERROR(Root->Open(Root, &Flag, (CHAR16 *)PlanFlagFile, EFI_FILE_MODE_READ, 0)))
+    {
+        Flag->Close(Flag);
+        Manifest->Mode = PATCH_MANIFEST_PLAN;
+    }
+    else
+    {
+        Status = PatchManifestLoad(Manifest, Root);
+        if (EFI_ERROR(Status))
+        {
+            PatchManifestFree(Manifest);
+            return Status;
+        }
+        Manifest->Mode = PATCH_MANIFEST_APPLY;
+    }
+
+    Manifest->HashContext = TaggedAllocatePool(POOL_TAG_PATCH, Sha256GetContextSize());
+    if (Manifest->HashContext == NULL)
+    {
+        PatchManifestFree(Manifest);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Index entry of a mapped image; images loaded since the last refresh are indexed first
+ */
+STATIC CONST LOADED_IMAGE_ENTRY *PatchManifestImage(IMAGE_SECTION_MAP *Map)
+{
+    CONST LOADED_IMAGE_ENTRY *Image = LoadedImageIndexFindByBase(&gLoadedImageIndex, Map->ImageBase);
+
+    if (Image == NULL && !EFI_ERROR(LoadedImageIndexRefresh(&gLoadedImageIndex)))
+        Image = LoadedImageIndexFindByBase(&gLoadedImageIndex, Map->ImageBase);
+    return Image;
+}
+
+/**
+ * Helper: Fill in the name and FFS GUID of a module
+ */
+STATIC VOID PatchManifestIdentify(IMAGE_SECTION_MAP *Map, PATCH_MANIFEST_MODULE *Info)
+{
+    CONST LOADED_IMAGE_ENTRY *Image = PatchManifestImage(Map);
+
+    ZeroMem(Info->Name, sizeof(Info->Name));
+    ZeroMem(&Info->FileGuid, sizeof(EFI_GUID));
+    if (Image == NULL)
+        return;
+
+    CopyGuid(&Info->FileGuid, &Image->FileGuid);
+    if (Image->Name != NULL)
+    {
+        // UI names are ASCII in practice; longer ones are cut
+        for (UINTN i = 0; i < PATCH_MANIFEST_NAME_SIZE - 1 && Image->Name[i] != 0; i++)
+            Info->Name[i] = Image->Name[i] < 0x80 ? (CHAR8)Image->Name[i] : '?';
+    }
+}
+
+/**
+ * Helper: Entry recorded for an image earlier in this plan-only run
+ */
+STATIC PATCH_MANIFEST_ENTRY *PatchManifestFindPlanned(PATCH_MANIFEST *Manifest, IMAGE_SECTION_MAP *Map)
+{
+    for (UINTN i = 0; i < Manifest->EntryCount; i++)
+    {
+        PATCH_MANIFEST_ENTRY *Entry = &Manifest->Entries[i];
+
+        if (Entry->Info.ImageBase == (UINTN)Map->ImageBase && Entry->Info.ImageSize == (UINT32)Map->ImageSize)
+            return Entry;
+    }
+    return NULL;
+}
+
+/**
+ * Helper: Stored entry of a module, matched by GUID or name and checked by hash
+ *
+ * The image is only hashed when an entry names it and was not applied yet.
+ */
+STATIC PATCH_MANIFEST_ENTRY *PatchManifestFindStored(PATCH_MANIFEST *Manifest, IMAGE_SECTION_MAP *Map, BOOLEAN *Stale)
+{
+    PATCH_MANIFEST_MODULE Info;
+    UINT8 Hash[PLAN_CACHE_HASH_SIZE];
+    BOOLEAN Hashed = FALSE;
+
+    *Stale = FALSE;
+    PatchManifestIdentify(Map, &Info);
+
+    for (UINTN i = 0; i < Manifest->EntryCount; i++)
+    {
+        PATCH_MANIFEST_ENTRY *Entry = &Manifest->Entries[i];
+
+        if (Entry->Info.ImageSize != (UINT32)Map->ImageSize ||
+            !CompareGuid(&Entry->Info.FileGuid, &Info.FileGuid) ||
+            AsciiStrCmp(Entry->Info.Name, Info.Name) != 0)
+            continue;
+
+        // A later phase revisiting it has nothing to do
+        if (Entry->Applied)
+            return Entry;
+
+        if (!Hashed)
+        {
+            if (EFI_ERROR(PlanCacheHashFile(Manifest->HashContext, &Info.FileGuid, Map->ImageSize, Hash)))
+                ZeroMem(Hash, sizeof(Hash));
+            Hashed = TRUE;
+        }
+
+        if (CompareMem(Entry->Info.Hash, Hash, PLAN_CACHE_HASH_SIZE) == 0)
+            return Entry;
+        *Stale = TRUE;
+    }
+    return NULL;
+}
+
+/**
+ * Start patching a module
+ */
+BOOLEAN PatchManifestBeginModule(PATCH_MANIFEST *Manifest, IMAGE_SECTION_MAP *Map)
+{
+    PATCH_MANIFEST_ENTRY *Entry;
+    BOOLEAN Stale;
+
+    if (Manifest->Mode == PATCH_MANIFEST_PLAN)
+    {
+        PatchPlanReset(&Manifest->Scratch);
+        Manifest->Current = Map;
+        gPatchRecorder = &Manifest->Scratch;
+        return TRUE;
+    }
+
+    if (Manifest->Mode != PATCH_MANIFEST_APPLY)
+        return TRUE;
+
+    // A module the manifest does not list had nothing to patch
+    Entry = PatchManifestFindStored(Manifest, Map, &Stale);
+    if (Entry != NULL && !Entry->Applied)
+    {
+        UINTN Applied = PatchPlanApply(&Entry->Plan, Map->ImageBase, Map->ImageSize);
+
+        Entry->Applied = TRUE;
+        Manifest->Applied += Applied;
+        AsciiSPrint(Log, 512, "Manifest: %d of %d patches applied to %a\n\r",
+                    Applied, Entry->Plan.Count, Entry->Info.Name[0] != 0 ? Entry->Info.Name : "module");
+        LogToFile(LogFile, Log);
+    }
+    else if (Entry == NULL && Stale)
+    {
+        Manifest->Stale++;
+        AsciiSPrint(Log, 512, "Manifest: module at 0x%lx changed since it was planned, skipped\n\r",
+                    (UINT64)(UINTN)Map->ImageBase);
+        LogToFile(LogFile, Log);
+    }
+
+    return FALSE;
+}
+
+/**
+ * Helper: Check whether a module already holds a record for the same write
+ */
+STATIC BOOLEAN PatchManifestHasRecord(PATCH_PLAN *Plan, CONST PATCH_RECORD *Record)
+{
+    for (UINTN i = 0; i < Plan->Count; i++)
+    {
+        CONST PATCH_RECORD *Other = &Plan->Records[i];
+
+        if (Other->Offset == Record->Offset && Other->Length == Record->Length &&
+            CompareMem(Other->NewBytes, Record->NewBytes, Record->Length) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Helper: Entry for a module planned for the first time
+ */
+STATIC PATCH_MANIFEST_ENTRY *PatchManifestAddEntry(PATCH_MANIFEST *Manifest, IMAGE_SECTION_MAP *Map)
+{
+    PATCH_MANIFEST_ENTRY *Entry;
+
+    if (Manifest->EntryCount == Manifest->EntryCapacity)
+    {
+        UINTN NewCapacity = Manifest->EntryCapacity == 0 ? PATCH_MANIFEST_INITIAL_ENTRIES : Manifest->EntryCapacity * 2;
+        PATCH_MANIFEST_ENTRY *NewEntries = TaggedAllocatePool(POOL_TAG_PATCH, NewCapacity * sizeof(PATCH_MANIFEST_ENTRY));
+
+        if (NewEntries == NULL)
+            return NULL;
+        if (Manifest->Entries != NULL)
+        {
+            CopyMem(NewEntries, Manifest->Entries, Manifest->EntryCount * sizeof(PATCH_MANIFEST_ENTRY));
+            TaggedFreePool(Manifest->Entries);
+        }
+        Manifest->Entries = NewEntries;
+        Manifest->EntryCapacity = NewCapacity;
+    }
+
+    Entry = &Manifest->Entries[Manifest->EntryCount++];
+    ZeroMem(Entry, sizeof(PATCH_MANIFEST_ENTRY));
+    PatchManifestIdentify(Map, &Entry->Info);
+    Entry->Info.ImageBase = (UINTN)Map->ImageBase;
+    Entry->Info.ImageSize = (UINT32)Map->ImageSize;
+    PatchPlanInit(&Entry->Plan);
+
+    // Taken from the FV file, so an apply run sees the same hash at any load address
+    if (EFI_ERROR(PlanCacheHashFile(Manifest->HashContext, &Entry->Info.FileGuid, Map->ImageSize, Entry->Info.Hash)))
+        ZeroMem(Entry->Info.Hash, sizeof(Entry->Info.Hash));
+
+    return Entry;
+}
+
+/**
+ * Finish the module opened by PatchManifestBeginModule
+ *
+ * Phases visit some modules more than once, and a pipeline replay records
+ * the same write again; each location is kept once, in recording order.
+ */
+VOID PatchManifestEndModule(PATCH_MANIFEST *Manifest)
+{
+    PATCH_MANIFEST_ENTRY *Entry;
+    PATCH_PLAN *Scratch = &Manifest->Scratch;
+
+    if (Manifest->Mode != PATCH_MANIFEST_PLAN || Manifest->Current == NULL)
+        return;
+
+    gPatchRecorder = NULL;
+
+    if (Scratch->Count > 0)
+    {
+        Entry = PatchManifestFindPlanned(Manifest, Manifest->Current);
+        if (Entry == NULL)
+            Entry = PatchManifestAddEntry(Manifest, Manifest->Current);
+
+        for (UINTN i = 0; Entry != NULL && i < Scratch->Count; i++)
+        {
+            PATCH_RECORD *Record = &Scratch->Records[i];
+
+            if (PatchManifestHasRecord(&Entry->Plan, Record))
+                continue;
+            (VOID)PatchPlanAdd(&Entry->Plan, Record->Offset, Record->OldBytes, Record->NewBytes,
+                               Record->Length, (PATCH_REASON)Record->Reason);
+        }
+
+        if (Entry == NULL || Scratch->Overflow || Entry->Plan.Overflow)
+        {
+            AsciiSPrint(Log, 512, "Manifest: out of memory, patches of the module at 0x%lx are missing\n\r",
+                        (UINT64)(UINTN)Manifest->Current->ImageBase);
+            LogToFile(LogFile, Log);
+        }
+    }
+
+    Manifest->Current = NULL;
+}
+
+/**
+ * Write the manifest of a plan-only run
+ */
+EFI_STATUS PatchManifestSave(PATCH_MANIFEST *Manifest, EFI_FILE *Root)
+{
+    EFI_STATUS Status;
+    PATCH_MANIFEST_HEADER *Header;
+    PATCH_MANIFEST_MODULE *Modules;
+    PATCH_RECORD *Records;
+    EFI_FILE *File;
+    UINT8 *Buffer;
+    UINTN RecordCount = 0;
+    UINTN Size;
+
+    if (Manifest->Mode != PATCH_MANIFEST_PLAN)
+        return EFI_INVALID_PARAMETER;
+
+    for (UINTN i = 0; i < Manifest->EntryCount; i++)
+        RecordCount += Manifest->Entries[i].Plan.Count;
+
+    Size = sizeof(PATCH_MANIFEST_HEADER) + Manifest->EntryCount * sizeof(PATCH_MANIFEST_MODULE) +
+           RecordCount * sizeof(PATCH_RECORD);
+    Buffer = TaggedAllocateZeroPool(POOL_TAG_PATCH, Size);
+    if (Buffer == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    Header = (PATCH_MANIFEST_HEADER *)Buffer;
+    Modules = (PATCH_MANIFEST_MODULE *)(Header + 1);
+    Records = (PATCH_RECORD *)&Modules[Manifest->EntryCount];
+
+    Header->Signature = PATCH_MANIFEST_SIGNATURE;
+    Header->Version = PATCH_MANIFEST_VERSION;
+    Header->ModuleCount = (UINT32)Manifest->EntryCount;
+    Header->RecordCount = (UINT32)RecordCount;
+
+    // Every record is listed here, not just the few the log shows per module
+    RecordCount = 0;
+    for (UINTN i = 0; i < Manifest->EntryCount; i++)
+    {
+        PATCH_MANIFEST_ENTRY *Entry = &Manifest->Entries[i];
+
+        CopyMem(&Modules[i], &Entry->Info, sizeof(PATCH_MANIFEST_MODULE));
+        Modules[i].FirstRecord = (UINT32)RecordCount;
+        Modules[i].RecordCount = (UINT32)Entry->Plan.Count;
+        CopyMem(&Records[RecordCount], Entry->Plan.Records, Entry->Plan.Count * sizeof(PATCH_RECORD));
+        for (UINTN r = 0; r < Entry->Plan.Count; r++)
+            Records[RecordCount + r].Flags = 0;
+        RecordCount += Entry->Plan.Count;
+
+        AsciiSPrint(Log, 512, "Manifest: %d patches for %a (%g)\n\r", Entry->Plan.Count,
+                    Entry->Info.Name[0] != 0 ? Entry->Info.Name : "unnamed module", &Entry->Info.FileGuid);
+        LogToFile(LogFile, Log);
+    }
+
+    // Delete and recreate, the file protocol cannot truncate on open
+    Status = Root->Open(Root, &File, PATCH_MANIFEST_FILE_NAME, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+    if (!EFI_ERROR(Status))
+        File->Delete(File);
+
+    Status = Root->Open(Root, &File, PATCH_MANIFEST_FILE_NAME,
+                        EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    if (!EFI_ERROR(Status))
+    {
+        Status = File->Write(File, &Size, Buffer);
+        File->Close(File);
+    }
+
+    AsciiSPrint(Log, 512, "Saved patch manifest: %d modules, %d patches (%r)\n\r",
+                Manifest->EntryCount, RecordCount, Status);
+    LogToFile(LogFile, Log);
+
+    TaggedFreePool(Buffer);
+    return Status;
+}
+
+/**
+ * Free a manifest and go back to LIVE mode
+ */
+VOID PatchManifestFree(PATCH_MANIFEST *Manifest)
+{
+    if (gPatchRecorder == &Manifest->Scratch)
+        gPatchRecorder = NULL;
+
+    // Loaded entries are views of Records, which PatchPlanFree leaves alone
+    for (UINTN i = 0; i < Manifest->EntryCount; i++)
+        PatchPlanFree(&Manifest->Entries[i].Plan);
+
+    if (Manifest->Entries != NULL)
+        TaggedFreePool(Manifest->Entries);
+    if (Manifest->Records != NULL)
+        TaggedFreePool(Manifest->Records);
+    if (Manifest->HashContext != NULL)
+        TaggedFreePool(Manifest->HashContext);
+    PatchPlanFree(&Manifest->Scratch);
+
+    ZeroMem(Manifest, sizeof(PATCH_MANIFEST));
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+#include "ImageSections.h"
+#include "PatchPlan.h"
+#include "PlanCache.h"
+
+// Manifest file, next to the log on the volume SREP was started from
+#define PATCH_MANIFEST_FILE_NAME L"SREP.manifest"
+
+// Bytes of a module UI name kept in the manifest, terminator included
+#define PATCH_MANIFEST_NAME_SIZE 48
+
+// How the patchers treat the images this run
+typedef enum {
+    PATCH_MANIFEST_LIVE = 0,     // Scan and write the images (no manifest)
+    PATCH_MANIFEST_PLAN,         // Scan, record every write into the manifest, leave the images alone
+    PATCH_MANIFEST_APPLY         // Write the records of a saved manifest, scan nothing
+} PATCH_MANIFEST_MODE;
+
+// One module of the manifest file
+typedef struct {
+    CHAR8 Name[PATCH_MANIFEST_NAME_SIZE];   // UI name, empty if the image has none
+    EFI_GUID FileGuid;                      // FFS file name, zero if not loaded from an FV
+    UINT8 Hash[PLAN_CACHE_HASH_SIZE];       // PlanCacheHashFile of the module, zero if unhashable
+    UINT64 ImageBase;                       // Load address when planned (informational)
+    UINT32 ImageSize;
+    UINT32 FirstRecord;                     // Index of its first PATCH_RECORD in the file
+    UINT32 RecordCount;
+    UINT32 Reserved;
+} PATCH_MANIFEST_MODULE;
+
+// A module in memory
+typedef struct {
+    PATCH_MANIFEST_MODULE Info;
+    PATCH_PLAN Plan;             // Its records; a view of PATCH_MANIFEST.Records once loaded
+    BOOLEAN Applied;             // Apply-only runs: done, later phases skip it
+} PATCH_MANIFEST_ENTRY;
+
+// Patches of a whole run, module by module
+typedef struct {
+    PATCH_MANIFEST_MODE Mode;
+    PATCH_MANIFEST_ENTRY *Entries;
+    UINTN EntryCount;
+    UINTN EntryCapacity;
+    PATCH_RECORD *Records;       // Records of a loaded manifest
+    UINTN RecordCount;
+    PATCH_PLAN Scratch;          // Writes recorded for the open module
+    IMAGE_SECTION_MAP *Current;  // Open module, NULL between modules
+    VOID *HashContext;
+    UINTN Applied;               // Apply-only runs: records written
+    UINTN Stale;                 // Apply-only runs: modules that changed since planning
+} PATCH_MANIFEST;
+
+// Manifest of the automatic patcher; LIVE unless PatchManifestOpen chose a mode
+extern PATCH_MANIFEST gPatchManifest;
+
+/**
+ * Choose the mode of this run
+ *
+ * The plan flag file selects a plan-only run; otherwise a saved manifest
+ * selects an apply-only run. The whole manifest is read in one call.
+ *
+ * @param Manifest      Manifest to initialize
+ * @param Root          Directory holding the flag and PATCH_MANIFEST_FILE_NAME
+ * @param PlanFlagFile  Name of the plan flag file
+ * @return EFI_SUCCESS with Mode set to PLAN or APPLY
+ * @return EFI_NOT_FOUND if neither file exists (Mode stays LIVE)
+ * @return EFI_VOLUME_CORRUPTED if the manifest is damaged
+ * @return EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS PatchManifestOpen(PATCH_MANIFEST *Manifest, EFI_FILE *Root, CONST CHAR16 *PlanFlagFile);
+
+/**
+ * Start patching a module
+ *
+ * Plan-only runs point gPatchRecorder at the manifest so the writes of the
+ * patchers are recorded. Apply-only runs write the stored records of the
+ * module instead, once, if its hash still matches.
+ *
+ * @param Manifest      Manifest of this run
+ * @param Map           Section map of a loaded module
+ * @return TRUE if the module must be scanned, FALSE if the manifest did the work
+ */
+BOOLEAN PatchManifestBeginModule(PATCH_MANIFEST *Manifest, IMAGE_SECTION_MAP *Map);
+
+/**
+ * Finish the module opened by PatchManifestBeginModule
+ *
+ * In plan-only runs the recorded writes join the entry of the module, one
+ * record per location.
+ *
+ * @param Manifest      Manifest of this run
+ */
+VOID PatchManifestEndModule(PATCH_MANIFEST *Manifest);
+
+/**
+ * Write the manifest of a plan-only run
+ *
+ * Only modules with records are written, in the order they were planned.
+ *
+ * @param Manifest      Manifest of this run
+ * @param Root          Directory to write PATCH_MANIFEST_FILE_NAME to
+ * @return EFI_SUCCESS, or an error from the file system
+ */
+EFI_STATUS PatchManifestSave(PATCH_MANIFEST *Manifest, EFI_FILE *Root);
+
+/**
+ * Free a manifest and go back to LIVE mode
+ *
+ * @param Manifest      Manifest to free
+ */
+VOID PatchManifestFree(PATCH_MANIFEST *Manifest);
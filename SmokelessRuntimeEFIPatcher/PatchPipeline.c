@@ -0,0 +1,166 @@
+#include "PatchPipeline.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+// Stage running on its own (replay) or all stages
+#define PATCH_PIPELINE_ALL_STAGES MAX_UINTN
+
+// Predicates of the stages that see one section, merged into one scanner
+typedef struct {
+    BYTE_PATTERN Patterns[BYTE_SCAN_MAX_PATTERNS];
+    PATCH_PIPELINE_STAGE *Owner[BYTE_SCAN_MAX_PATTERNS];
+    UINT8 Local[BYTE_SCAN_MAX_PATTERNS];         // Index of the predicate within its stage
+    UINTN Count;
+    UINTN ChunkEnd;                              // Matches at or past it belong to the next chunk
+    BYTE_SCANNER Scanner;
+} PATCH_PIPELINE_SCAN;
+
+VOID PatchPipelineInit(PATCH_PIPELINE *Pipeline)
+{
+    ZeroMem(Pipeline, sizeof(PATCH_PIPELINE));
+    Pipeline->ChunkSize = PATCH_PIPELINE_CHUNK_SIZE;
+}
+
+EFI_STATUS PatchPipelineAddStage(PATCH_PIPELINE *Pipeline, CONST PATCH_PIPELINE_STAGE *Stage)
+{
+    if (Pipeline == NULL || Stage == NULL || Stage->KindMask == 0)
+        return EFI_INVALID_PARAMETER;
+    if (Stage->PatternCount > 0 && (Stage->Patterns == NULL || Stage->Match == NULL))
+        return EFI_INVALID_PARAMETER;
+    if (Stage->PatternCount == 0 && Stage->Chunk == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    // A section that is both code and data may see every predicate at once
+    if (Pipeline->StageCount == PATCH_PIPELINE_MAX_STAGES ||
+        Pipeline->PatternCount + Stage->PatternCount > BYTE_SCAN_MAX_PATTERNS)
+        return EFI_OUT_OF_RESOURCES;
+
+    CopyMem(&Pipeline->Stages[Pipeline->StageCount++], Stage, sizeof(PATCH_PIPELINE_STAGE));
+    Pipeline->PatternCount += Stage->PatternCount;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: ByteScan callback that hands a match to the stage owning the predicate
+ */
+STATIC BOOLEAN PatchPipelineDispatch(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex)
+{
+    PATCH_PIPELINE_SCAN *Scan = (PATCH_PIPELINE_SCAN *)Context;
+    PATCH_PIPELINE_STAGE *Stage;
+
+    if (Offset >= Scan->ChunkEnd)
+        return TRUE;
+
+    // One stage cannot stop the scan the others share
+    Stage = Scan->Owner[PatternIndex];
+    (VOID)Stage->Match(Stage->Context, Data, Offset, Scan->Local[PatternIndex]);
+    return TRUE;
+}
+
+/**
+ * Helper: Check whether a stage takes part in the traversal of a section
+ */
+STATIC BOOLEAN PatchPipelineStageSees(CONST PATCH_PIPELINE_STAGE *Stage, CONST IMAGE_SECTION *Section)
+{
+    return (Stage->KindMask & Section->Kind) != 0;
+}
+
+/**
+ * Helper: Merge the predicates of the stages that see a section
+ */
+STATIC VOID PatchPipelinePrepareScan(PATCH_PIPELINE *Pipeline, CONST IMAGE_SECTION *Section, UINTN Only, PATCH_PIPELINE_SCAN *Scan)
+{
+    Scan->Count = 0;
+    for (UINTN i = 0; i < Pipeline->StageCount; i++)
+    {
+        PATCH_PIPELINE_STAGE *Stage = &Pipeline->Stages[i];
+
+        if ((Only != PATCH_PIPELINE_ALL_STAGES && Only != i) || !PatchPipelineStageSees(Stage, Section))
+            continue;
+
+        for (UINTN p = 0; p < Stage->PatternCount; p++)
+        {
+            CopyMem(&Scan->Patterns[Scan->Count], &Stage->Patterns[p], sizeof(BYTE_PATTERN));
+            Scan->Owner[Scan->Count] = Stage;
+            Scan->Local[Scan->Count] = (UINT8)p;
+            Scan->Count++;
+        }
+    }
+
+    if (Scan->Count > 0 && EFI_ERROR(ByteScanInit(&Scan->Scanner, Scan->Patterns, Scan->Count)))
+        Scan->Count = 0;
+}
+
+/**
+ * Helper: Stream every mapped section through all stages, or through one
+ */
+STATIC VOID PatchPipelineStream(PATCH_PIPELINE *Pipeline, IMAGE_SECTION_MAP *Map, UINTN Only)
+{
+    PATCH_PIPELINE_SCAN Scan;
+
+    for (UINTN s = 0; s < Map->SectionCount; s++)
+    {
+        CONST IMAGE_SECTION *Section = &Map->Sections[s];
+        UINTN SectionEnd = (UINTN)Section->Offset + Section->Size;
+        UINTN Start;
+
+        if (Section->Kind == 0 || Section->Size == 0)
+            continue;
+
+        PatchPipelinePrepareScan(Pipeline, Section, Only, &Scan);
+
+        for (Start = Section->Offset; Start < SectionEnd; Start = Scan.ChunkEnd)
+        {
+            Scan.ChunkEnd = MIN(Start + Pipeline->ChunkSize, SectionEnd);
+
+            for (UINTN i = 0; i < Pipeline->StageCount; i++)
+            {
+                PATCH_PIPELINE_STAGE *Stage = &Pipeline->Stages[i];
+
+                if ((Only != PATCH_PIPELINE_ALL_STAGES && Only != i) || Stage->Chunk == NULL ||
+                    !PatchPipelineStageSees(Stage, Section))
+                    continue;
+                Stage->Chunk(Stage->Context, Map, Section, Start, Scan.ChunkEnd);
+            }
+
+            // Predicates starting in this chunk may end in the next one
+            if (Scan.Count > 0)
+            {
+                ByteScan(&Scan.Scanner, Map->ImageBase, Start,
+                         MIN(Scan.ChunkEnd + Scan.Scanner.MaxLength - 1, SectionEnd),
+                         PatchPipelineDispatch, &Scan);
+            }
+
+            Pipeline->Chunks++;
+            Pipeline->Bytes += Scan.ChunkEnd - Start;
+        }
+    }
+}
+
+EFI_STATUS PatchPipelineRun(PATCH_PIPELINE *Pipeline, IMAGE_SECTION_MAP *Map)
+{
+    BOOLEAN Replay[PATCH_PIPELINE_MAX_STAGES];
+
+    if (Pipeline == NULL || Map == NULL || Map->ImageBase == NULL || Pipeline->ChunkSize == 0)
+        return EFI_INVALID_PARAMETER;
+
+    PatchPipelineStream(Pipeline, Map, PATCH_PIPELINE_ALL_STAGES);
+
+    // Every Finish runs before any replay, so a replay sees what all stages learned
+    for (UINTN i = 0; i < Pipeline->StageCount; i++)
+    {
+        PATCH_PIPELINE_STAGE *Stage = &Pipeline->Stages[i];
+
+        Replay[i] = Stage->Finish != NULL && Stage->Finish(Stage->Context);
+    }
+
+    for (UINTN i = 0; i < Pipeline->StageCount; i++)
+    {
+        if (!Replay[i])
+            continue;
+        Pipeline->Replays++;
+        PatchPipelineStream(Pipeline, Map, i);
+    }
+
+    return EFI_SUCCESS;
+}
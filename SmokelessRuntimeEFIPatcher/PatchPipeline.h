@@ -0,0 +1,95 @@
+#pragma once
+#include <Uefi.h>
+#include "ByteScan.h"
+#include "ImageSections.h"
+
+// Bytes streamed per step, small enough to stay in L2 while every stage reads it
+#define PATCH_PIPELINE_CHUNK_SIZE SIZE_64KB
+
+// Most stages one pipeline runs
+#define PATCH_PIPELINE_MAX_STAGES 8
+
+/**
+ * Called for every chunk of the sections a stage sees
+ *
+ * The chunk callbacks of a chunk run in registration order, before the byte
+ * predicates of that chunk are matched. A callback owns the work that starts
+ * in [Start, End) but may read on to the end of the section; those bytes have
+ * not been seen by any stage yet.
+ *
+ * @param Context       Stage context
+ * @param Map           Section map of the image
+ * @param Section       Section the chunk belongs to
+ * @param Start         First offset of the chunk (Section->Offset for the first chunk)
+ * @param End           End of the chunk
+ */
+typedef VOID (*PATCH_PIPELINE_CHUNK_CALLBACK)(
+    VOID *Context,
+    IMAGE_SECTION_MAP *Map,
+    CONST IMAGE_SECTION *Section,
+    UINTN Start,
+    UINTN End);
+
+/**
+ * Called once after the traversal
+ *
+ * @param Context       Stage context
+ * @return TRUE to run the stage again, on its own, over its sections
+ */
+typedef BOOLEAN (*PATCH_PIPELINE_FINISH_CALLBACK)(VOID *Context);
+
+// One patcher fed by the pipeline
+typedef struct {
+    CONST CHAR8 *Name;
+    UINT8 KindMask;                          // IMAGE_SECTION_CODE/DATA sections the stage sees
+    CONST BYTE_PATTERN *Patterns;            // Byte predicates, matched by the scan all stages share
+    UINTN PatternCount;
+    BYTE_SCAN_CALLBACK Match;                // Per predicate match; PatternIndex is the stage's own
+    PATCH_PIPELINE_CHUNK_CALLBACK Chunk;     // Optional
+    PATCH_PIPELINE_FINISH_CALLBACK Finish;   // Optional
+    VOID *Context;
+} PATCH_PIPELINE_STAGE;
+
+// Stages that share one traversal of an image
+typedef struct {
+    PATCH_PIPELINE_STAGE Stages[PATCH_PIPELINE_MAX_STAGES];
+    UINTN StageCount;
+    UINTN PatternCount;          // Predicates of all stages (at most BYTE_SCAN_MAX_PATTERNS)
+    UINTN ChunkSize;
+    UINTN Chunks;                // Chunks streamed, replays included
+    UINTN Bytes;                 // Bytes streamed, replays included
+    UINTN Replays;               // Stages that asked for a second run
+} PATCH_PIPELINE;
+
+/**
+ * Initialize an empty pipeline
+ *
+ * @param Pipeline      Pipeline to initialize
+ */
+VOID PatchPipelineInit(PATCH_PIPELINE *Pipeline);
+
+/**
+ * Register a stage
+ *
+ * Stages run in registration order within each chunk.
+ *
+ * @param Pipeline      Pipeline
+ * @param Stage         Stage to copy in; needs predicates (with Match) or a Chunk callback
+ * @return EFI_SUCCESS, EFI_INVALID_PARAMETER, or EFI_OUT_OF_RESOURCES when
+ *         the stages or predicates do not fit
+ */
+EFI_STATUS PatchPipelineAddStage(PATCH_PIPELINE *Pipeline, CONST PATCH_PIPELINE_STAGE *Stage);
+
+/**
+ * Stream an image once through every stage
+ *
+ * Each mapped section is read in chunks of ChunkSize. For every chunk the
+ * chunk callbacks run first, then one ByteScan matches the predicates of
+ * all stages that see the section; a match is reported for the chunk it
+ * starts in. Stages whose Finish asks for it are then run once more alone.
+ *
+ * @param Pipeline      Pipeline with its stages
+ * @param Map           Section map of the image
+ * @return EFI_SUCCESS or EFI_INVALID_PARAMETER
+ */
+EFI_STATUS PatchPipelineRun(PATCH_PIPELINE *Pipeline, IMAGE_SECTION_MAP *Map);
@@ -0,0 +1,324 @@
+#include "PatchPlan.h"
+#include "Trace.h"
+#include "TaggedPool.h"
+#include <Library/UefiLib.h>
+#include <Library/PrintLib.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+// Initial record capacity; most Setup images plan a few hundred patches
+#define PATCH_PLAN_INITIAL_CAPACITY 64
+
+// Individual patches logged per apply before only the total is reported
+#define PATCH_PLAN_LOG_LIMIT 5
+
+STATIC CONST CHAR8 *mPatchReasonNames[PATCH_REASON_MAX] = {
+    "SuppressIf condition",
+    "GrayoutIf condition",
+    "DisableIf condition",
+    "write protection check",
+    "AMI SuppressIf TRUE",
+    "Insyde form flag",
+    "hidden form condition",
+    "form visibility flag",
+    "database pattern",
+    "BIOS data value",
+    "script patch"
+};
+
+PATCH_PLAN *gPatchRecorder = NULL;
+PATCH_PLAN *gPatchJournal = NULL;
+
+/**
+ * Initialize an empty plan that grows from pool
+ */
+VOID PatchPlanInit(PATCH_PLAN *Plan)
+{
+    ZeroMem(Plan, sizeof(PATCH_PLAN));
+    Plan->Sorted = TRUE;
+}
+
+/**
+ * Initialize an empty plan backed by caller storage
+ */
+VOID PatchPlanInitFixed(PATCH_PLAN *Plan, PATCH_RECORD *Buffer, UINTN Capacity)
+{
+    PatchPlanInit(Plan);
+    Plan->Records = Buffer;
+    Plan->Capacity = Capacity;
+    Plan->FixedCapacity = TRUE;
+}
+
+/**
+ * Drop all records but keep the storage for reuse
+ */
+VOID PatchPlanReset(PATCH_PLAN *Plan)
+{
+    Plan->Count = 0;
+    Plan->Sorted = TRUE;
+    Plan->Overflow = FALSE;
+}
+
+/**
+ * Free the storage of a plan (caller storage is left alone)
+ */
+VOID PatchPlanFree(PATCH_PLAN *Plan)
+{
+    if (Plan->Records != NULL && !Plan->FixedCapacity)
+        TaggedFreePool(Plan->Records);
+
+    PatchPlanInit(Plan);
+}
+
+/**
+ * Helper: Make room for one more record
+ */
+STATIC BOOLEAN PatchPlanReserve(PATCH_PLAN *Plan)
+{
+    PATCH_RECORD *NewRecords;
+    UINTN NewCapacity;
+
+    if (Plan->Count < Plan->Capacity)
+        return TRUE;
+
+    if (Plan->FixedCapacity)
+        return FALSE;
+
+    NewCapacity = Plan->Capacity == 0 ? PATCH_PLAN_INITIAL_CAPACITY : Plan->Capacity * 2;
+    NewRecords = TaggedAllocatePool(POOL_TAG_PATCH, NewCapacity * sizeof(PATCH_RECORD));
+    if (NewRecords == NULL)
+        return FALSE;
+
+    if (Plan->Records != NULL)
+    {
+        CopyMem(NewRecords, Plan->Records, Plan->Count * sizeof(PATCH_RECORD));
+        TaggedFreePool(Plan->Records);
+    }
+
+    Plan->Records = NewRecords;
+    Plan->Capacity = NewCapacity;
+    return TRUE;
+}
+
+/**
+ * Add a patch to the plan
+ */
+EFI_STATUS PatchPlanAdd(
+    PATCH_PLAN *Plan,
+    UINTN Offset,
+    CONST UINT8 *OldBytes,
+    CONST UINT8 *NewBytes,
+    UINTN Length,
+    PATCH_REASON Reason)
+{
+    PATCH_RECORD *Record;
+
+    if (Plan == NULL || OldBytes == NULL || NewBytes == NULL ||
+        Length == 0 || Length > PATCH_RECORD_MAX_BYTES || Offset > MAX_UINT32 || Reason >= PATCH_REASON_MAX)
+        return EFI_INVALID_PARAMETER;
+
+    if (!PatchPlanReserve(Plan))
+    {
+        Plan->Overflow = TRUE;
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Record = &Plan->Records[Plan->Count];
+    ZeroMem(Record, sizeof(PATCH_RECORD));
+    Record->Offset = (UINT32)Offset;
+    Record->Length = (UINT8)Length;
+    Record->Reason = (UINT8)Reason;
+    CopyMem(Record->OldBytes, OldBytes, Length);
+    CopyMem(Record->NewBytes, NewBytes, Length);
+
+    if (Plan->Count > 0 && Plan->Records[Plan->Count - 1].Offset > Record->Offset)
+        Plan->Sorted = FALSE;
+
+    Plan->Count++;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Sort records by offset
+ *
+ * Scanners add records in offset order, so this is normally a no-op; an
+ * insertion sort handles the occasional out-of-order record cheaply.
+ */
+STATIC VOID PatchPlanSort(PATCH_PLAN *Plan)
+{
+    UINTN i;
+
+    if (Plan->Sorted)
+        return;
+
+    for (i = 1; i < Plan->Count; i++)
+    {
+        PATCH_RECORD Record = Plan->Records[i];
+        UINTN j = i;
+
+        while (j > 0 && Plan->Records[j - 1].Offset > Record.Offset)
+        {
+            Plan->Records[j] = Plan->Records[j - 1];
+            j--;
+        }
+        Plan->Records[j] = Record;
+    }
+
+    Plan->Sorted = TRUE;
+}
+
+/**
+ * Format a human readable description of a record
+ */
+UINTN PatchRecordDescribe(CONST PATCH_RECORD *Record, CHAR8 *Buffer, UINTN BufferSize)
+{
+    CONST CHAR8 *Name = Record->Reason < PATCH_REASON_MAX ? mPatchReasonNames[Record->Reason] : "Unknown";
+
+    return AsciiSPrint(Buffer, BufferSize, "Patch %a at 0x%x", Name, Record->Offset);
+}
+
+/**
+ * Write patch bytes into an image, or record them
+ */
+BOOLEAN PatchPlanWrite(UINT8 *Data, UINTN Offset, CONST VOID *Bytes, UINTN Length, PATCH_REASON Reason)
+{
+    CONST UINT8 *New = (CONST UINT8 *)Bytes;
+
+    if (gTraceEnabled)
+    {
+        UINT64 Packed = 0;
+
+        CopyMem(&Packed, Bytes, MIN(Length, sizeof(Packed)));
+        TraceEvent(TRACE_PATCH_WRITE, 4, Offset, Reason, Length, Packed);
+    }
+
+    if (gPatchRecorder == NULL && gPatchJournal == NULL)
+    {
+        CopyMem(&Data[Offset], Bytes, Length);
+        return TRUE;
+    }
+
+    for (UINTN Done = 0; Done < Length; Done += PATCH_RECORD_MAX_BYTES)
+    {
+        UINTN Size = MIN(Length - Done, PATCH_RECORD_MAX_BYTES);
+
+        if (CompareMem(&Data[Offset + Done], &New[Done], Size) == 0)
+            continue;
+
+        if (gPatchJournal != NULL &&
+            !EFI_ERROR(PatchPlanAdd(gPatchJournal, Offset + Done, &Data[Offset + Done], &New[Done], Size, Reason)) &&
+            gPatchRecorder == NULL)
+            gPatchJournal->Records[gPatchJournal->Count - 1].Flags |= PATCH_RECORD_APPLIED;
+
+        if (gPatchRecorder != NULL)
+            (VOID)PatchPlanAdd(gPatchRecorder, Offset + Done, &Data[Offset + Done], &New[Done], Size, Reason);
+    }
+
+    if (gPatchRecorder != NULL)
+        return FALSE;
+
+    CopyMem(&Data[Offset], Bytes, Length);
+    return TRUE;
+}
+
+/**
+ * Apply the plan to an image in one pass
+ */
+UINTN PatchPlanApply(PATCH_PLAN *Plan, VOID *ImageBase, UINTN ImageSize)
+{
+    PATCH_PLAN *Journal = gPatchJournal;
+    UINT8 *Data = (UINT8 *)ImageBase;
+    UINTN AppliedCount = 0;
+    UINTN i;
+
+    if (Plan == NULL || ImageBase == NULL)
+        return 0;
+
+    PatchPlanSort(Plan);
+
+    // Journaling the plan into itself would grow it while it is walked
+    if (Journal == Plan)
+        gPatchJournal = NULL;
+
+    for (i = 0; i < Plan->Count; i++)
+    {
+        PATCH_RECORD *Record = &Plan->Records[i];
+
+        if ((Record->Flags & PATCH_RECORD_APPLIED) != 0 ||
+            Record->Offset + (UINTN)Record->Length > ImageSize)
+            continue;
+
+        // Verify original bytes match; already patched locations are skipped silently
+        if (CompareMem(&Data[Record->Offset], Record->OldBytes, Record->Length) != 0)
+            continue;
+
+        if (PatchPlanWrite(Data, Record->Offset, Record->NewBytes, Record->Length, (PATCH_REASON)Record->Reason))
+            Record->Flags |= PATCH_RECORD_APPLIED;
+        AppliedCount++;
+
+        // Only log individual patches if there are few of them
+        // Otherwise just log the count
+        if (AppliedCount <= PATCH_PLAN_LOG_LIMIT)
+        {
+            CHAR8 Description[64];
+
+            PatchRecordDescribe(Record, Description, sizeof(Description));
+            AsciiSPrint(Log, 512, "  %a: %a (0x%02x -> 0x%02x)\n\r",
+                        gPatchRecorder != NULL ? "Planned" : "Patched", Description,
+                        Record->OldBytes[0], Record->NewBytes[0]);
+            LogToFile(LogFile, Log);
+        }
+    }
+
+    // Only log if patches were applied
+    if (AppliedCount > 0)
+    {
+        AsciiSPrint(Log, 512, "%a %d IFR patches\n\r", gPatchRecorder != NULL ? "Planned" : "Applied", AppliedCount);
+        LogToFile(LogFile, Log);
+    }
+
+    gPatchJournal = Journal;
+    return AppliedCount;
+}
+
+/**
+ * Restore the original bytes of every applied record
+ */
+UINTN PatchPlanRevert(PATCH_PLAN *Plan, VOID *ImageBase, UINTN ImageSize)
+{
+    UINT8 *Data = (UINT8 *)ImageBase;
+    UINTN RevertedCount = 0;
+    UINTN i;
+
+    if (Plan == NULL || ImageBase == NULL)
+        return 0;
+
+    // The sort keeps records of one offset in the order they were written
+    PatchPlanSort(Plan);
+
+    for (i = Plan->Count; i > 0; i--)
+    {
+        PATCH_RECORD *Record = &Plan->Records[i - 1];
+
+        if ((Record->Flags & PATCH_RECORD_APPLIED) == 0 ||
+            Record->Offset + (UINTN)Record->Length > ImageSize)
+            continue;
+
+        if (CompareMem(&Data[Record->Offset], Record->NewBytes, Record->Length) != 0)
+            continue;
+
+        CopyMem(&Data[Record->Offset], Record->OldBytes, Record->Length);
+        Record->Flags &= ~PATCH_RECORD_APPLIED;
+        RevertedCount++;
+    }
+
+    if (RevertedCount > 0)
+    {
+        AsciiSPrint(Log, 512, "Reverted %d patches\n\r", RevertedCount);
+        LogToFile(LogFile, Log);
+    }
+
+    return RevertedCount;
+}
@@ -0,0 +1,163 @@
+#pragma once
+#include <Uefi.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+// Largest byte run one record can patch
+#define PATCH_RECORD_MAX_BYTES 4
+
+// Why a record was planned; descriptions are derived from this on demand
+typedef enum {
+    PATCH_REASON_SUPPRESS_IF = 0,
+    PATCH_REASON_GRAY_OUT_IF,
+    PATCH_REASON_DISABLE_IF,
+    PATCH_REASON_WRITE_PROTECT,
+    PATCH_REASON_AMI_FORM,
+    PATCH_REASON_INSYDE_FORM,
+    PATCH_REASON_UNLOCK_FORM,
+    PATCH_REASON_FORM_VISIBILITY,
+    PATCH_REASON_DB_PATTERN,
+    PATCH_REASON_BIOS_DATA,
+    PATCH_REASON_SCRIPT,
+    PATCH_REASON_MAX
+} PATCH_REASON;
+
+// PATCH_RECORD.Flags
+#define PATCH_RECORD_APPLIED BIT0   // NewBytes are currently in the image
+
+// One planned patch (16 bytes)
+typedef struct {
+    UINT32 Offset;               // Offset in the image
+    UINT8 Length;                // Bytes used in OldBytes/NewBytes
+    UINT8 Reason;                // PATCH_REASON
+    UINT8 Flags;                 // PATCH_RECORD_*
+    UINT8 Reserved;
+    UINT8 OldBytes[PATCH_RECORD_MAX_BYTES];
+    UINT8 NewBytes[PATCH_RECORD_MAX_BYTES];
+} PATCH_RECORD;
+
+// Patches planned for one module, sorted by offset before use
+typedef struct {
+    PATCH_RECORD *Records;
+    UINTN Count;
+    UINTN Capacity;
+    BOOLEAN Sorted;              // Records are in ascending offset order
+    BOOLEAN FixedCapacity;       // Records is caller storage and never grows
+    BOOLEAN Overflow;            // A record was dropped because the plan was full
+} PATCH_PLAN;
+
+// Plan that receives image writes instead of the image (plan-only runs), NULL to write
+extern PATCH_PLAN *gPatchRecorder;
+
+// Plan that also keeps every write with its old bytes, so it can be reverted, NULL for none
+extern PATCH_PLAN *gPatchJournal;
+
+/**
+ * Initialize an empty plan that grows from pool
+ *
+ * @param Plan          Plan to initialize
+ */
+VOID PatchPlanInit(PATCH_PLAN *Plan);
+
+/**
+ * Initialize an empty plan backed by caller storage
+ *
+ * The plan never allocates; once Capacity records are planned further adds
+ * fail and set Overflow.
+ *
+ * @param Plan          Plan to initialize
+ * @param Buffer        Record storage
+ * @param Capacity      Number of records in Buffer
+ */
+VOID PatchPlanInitFixed(PATCH_PLAN *Plan, PATCH_RECORD *Buffer, UINTN Capacity);
+
+/**
+ * Drop all records but keep the storage for reuse
+ *
+ * @param Plan          Plan to reset
+ */
+VOID PatchPlanReset(PATCH_PLAN *Plan);
+
+/**
+ * Free the storage of a plan (caller storage is left alone)
+ *
+ * @param Plan          Plan to free
+ */
+VOID PatchPlanFree(PATCH_PLAN *Plan);
+
+/**
+ * Add a patch to the plan
+ *
+ * @param Plan          Plan to add to
+ * @param Offset        Offset in the image
+ * @param OldBytes      Bytes expected at Offset
+ * @param NewBytes      Bytes to write
+ * @param Length        Number of bytes (1..PATCH_RECORD_MAX_BYTES)
+ * @param Reason        PATCH_REASON of the patch
+ * @return EFI_SUCCESS, EFI_INVALID_PARAMETER or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS PatchPlanAdd(
+    PATCH_PLAN *Plan,
+    UINTN Offset,
+    CONST UINT8 *OldBytes,
+    CONST UINT8 *NewBytes,
+    UINTN Length,
+    PATCH_REASON Reason);
+
+/**
+ * Write patch bytes into an image, or record them
+ *
+ * Every patcher writes through here. While gPatchRecorder is set the image
+ * is left alone and the write is added to that plan instead, split into
+ * records of at most PATCH_RECORD_MAX_BYTES with the current bytes as the
+ * old ones; bytes that would not change are not recorded. While
+ * gPatchJournal is set the same records are added there as well, marked
+ * PATCH_RECORD_APPLIED when the image was written.
+ *
+ * @param Data          Image base
+ * @param Offset        Offset of the write from Data
+ * @param Bytes         Bytes to write
+ * @param Length        Number of bytes
+ * @param Reason        PATCH_REASON of the write
+ * @return TRUE if the image was written, FALSE if the write was recorded
+ */
+BOOLEAN PatchPlanWrite(UINT8 *Data, UINTN Offset, CONST VOID *Bytes, UINTN Length, PATCH_REASON Reason);
+
+/**
+ * Apply the plan to an image in one pass
+ *
+ * Records whose old bytes are no longer in the image are skipped, so a plan
+ * can be applied again safely. Writes go through PatchPlanWrite, so while
+ * gPatchRecorder is set the records are copied there instead. A plan that is
+ * itself gPatchJournal is not journaled again; its APPLIED flags are enough.
+ *
+ * @param Plan          Plan to apply
+ * @param ImageBase     Base address of the module
+ * @param ImageSize     Size of the module image
+ * @return Number of records applied (or recorded)
+ */
+UINTN PatchPlanApply(PATCH_PLAN *Plan, VOID *ImageBase, UINTN ImageSize);
+
+/**
+ * Restore the original bytes of every applied record
+ *
+ * Records are undone in reverse offset order, so of two writes to the same
+ * bytes the later one is undone first; a record whose new bytes were since
+ * overwritten by someone else is left alone.
+ *
+ * @param Plan          Plan to revert
+ * @param ImageBase     Base address of the module
+ * @param ImageSize     Size of the module image
+ * @return Number of records reverted
+ */
+UINTN PatchPlanRevert(PATCH_PLAN *Plan, VOID *ImageBase, UINTN ImageSize);
+
+/**
+ * Format a human readable description of a record
+ *
+ * @param Record        Record to describe
+ * @param Buffer        Output buffer
+ * @param BufferSize    Size of Buffer in bytes
+ * @return Number of characters written
+ */
+UINTN PatchRecordDescribe(CONST PATCH_RECORD *Record, CHAR8 *Buffer, UINTN BufferSize);
@@ -0,0 +1,754 @@
+#include "PatchScript.h"
+#include "Opcode.h"
+#include "PatchPlan.h"
+#include "StringMatch.h"
+#include "TaggedPool.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+// Longest module name (LoadFS/LoadFV convert it into a CHAR16[255])
+#define PATCH_SCRIPT_MAX_NAME_LENGTH 254
+
+// Line reader over the script text
+typedef struct {
+    CONST CHAR8 *Text;
+    UINTN Size;
+    UINTN Pos;
+    UINTN Line;                  // Line of Token, 1-based
+    CONST CHAR8 *Token;          // Current line without surrounding blanks
+    UINTN Length;
+} PATCH_SCRIPT_READER;
+
+// Exact run of a pattern fed to the matcher
+typedef struct {
+    UINT32 Op;                   // Op index
+    UINT32 Start;                // Offset of the run in the pattern
+} PATCH_SCRIPT_ANCHOR;
+
+// State of the scan that locates the patterns of one module
+typedef struct {
+    CONST PATCH_SCRIPT *Script;
+    CONST PATCH_SCRIPT_MODULE *Module;
+    CONST PATCH_SCRIPT_ANCHOR *Anchors;
+    UINTN *Match;                // Per op of the module: pattern offset, MAX_UINTN if not found
+    UINTN Remaining;
+    UINTN ImageSize;
+} PATCH_SCRIPT_SCAN;
+
+/**
+ * Helper: Timestamp for the per-op timings
+ */
+STATIC UINT64 PatchScriptTicks(VOID)
+{
+#if defined(MDE_CPU_IA32) || defined(MDE_CPU_X64)
+    return AsmReadTsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Helper: Advance to the next line that carries a token
+ */
+STATIC BOOLEAN PatchScriptReadLine(PATCH_SCRIPT_READER *Reader)
+{
+    while (Reader->Pos < Reader->Size)
+    {
+        UINTN Start = Reader->Pos;
+        UINTN End;
+
+        while (Reader->Pos < Reader->Size && Reader->Text[Reader->Pos] != '\n' && Reader->Text[Reader->Pos] != '\0')
+            Reader->Pos++;
+        End = Reader->Pos;
+        if (Reader->Pos < Reader->Size)
+            Reader->Pos++;
+        Reader->Line++;
+
+        while (Start < End && (Reader->Text[Start] == ' ' || Reader->Text[Start] == '\t'))
+            Start++;
+        while (End > Start && (Reader->Text[End - 1] == ' ' || Reader->Text[End - 1] == '\t' || Reader->Text[End - 1] == '\r'))
+            End--;
+
+        if (Start == End || Reader->Text[Start] == '#')
+            continue;
+        if (End - Start == 3 && AsciiStrnCmp(&Reader->Text[Start], "End", 3) == 0)
+            continue;
+
+        Reader->Token = &Reader->Text[Start];
+        Reader->Length = End - Start;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Helper: Check whether the current token is exactly Word
+ */
+STATIC BOOLEAN PatchScriptTokenIs(CONST PATCH_SCRIPT_READER *Reader, UINTN Skip, CONST CHAR8 *Word)
+{
+    UINTN Length = AsciiStrLen(Word);
+
+    return Reader->Length == Skip + Length && AsciiStrnCmp(&Reader->Token[Skip], Word, Length) == 0;
+}
+
+/**
+ * Helper: Value of a hex digit, or -1
+ */
+STATIC INTN PatchScriptHexDigit(CHAR8 c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Helper: Parse a hex byte string; ?? is a wildcard when Mask is given
+ */
+STATIC BOOLEAN PatchScriptParseBytes(CONST PATCH_SCRIPT_READER *Reader, UINT8 *Bytes, UINT8 *Mask, UINTN *Count)
+{
+    UINTN i = 0;
+
+    *Count = 0;
+    while (i < Reader->Length)
+    {
+        CHAR8 c = Reader->Token[i];
+        INTN High;
+        INTN Low;
+
+        if (c == ' ' || c == '\t')
+        {
+            i++;
+            continue;
+        }
+        if (i + 1 >= Reader->Length || *Count == PATCH_SCRIPT_MAX_BYTES)
+            return FALSE;
+
+        if (c == '?' && Reader->Token[i + 1] == '?')
+        {
+            if (Mask == NULL)
+                return FALSE;
+            Bytes[*Count] = 0;
+            Mask[(*Count)++] = 0x00;
+            i += 2;
+            continue;
+        }
+
+        High = PatchScriptHexDigit(c);
+        Low = PatchScriptHexDigit(Reader->Token[i + 1]);
+        if (High < 0 || Low < 0)
+            return FALSE;
+        Bytes[*Count] = (UINT8)((High << 4) | Low);
+        if (Mask != NULL)
+            Mask[*Count] = 0xFF;
+        (*Count)++;
+        i += 2;
+    }
+    return *Count > 0;
+}
+
+/**
+ * Helper: Parse a hex offset, with or without 0x
+ */
+STATIC BOOLEAN PatchScriptParseOffset(CONST PATCH_SCRIPT_READER *Reader, UINT32 *Offset)
+{
+    UINTN i = 0;
+    UINT64 Value = 0;
+
+    if (Reader->Length > 2 && Reader->Token[0] == '0' && (Reader->Token[1] == 'x' || Reader->Token[1] == 'X'))
+        i = 2;
+    if (i == Reader->Length)
+        return FALSE;
+
+    for (; i < Reader->Length; i++)
+    {
+        INTN Digit = PatchScriptHexDigit(Reader->Token[i]);
+
+        if (Digit < 0)
+            return FALSE;
+        Value = (Value << 4) | (UINT64)Digit;
+        if (Value > MAX_UINT32)
+            return FALSE;
+    }
+    *Offset = (UINT32)Value;
+    return TRUE;
+}
+
+/**
+ * Helper: Grow an array of Size-byte elements to hold one more
+ */
+STATIC EFI_STATUS PatchScriptGrow(VOID **Array, UINTN Count, UINTN *Capacity, UINTN Size)
+{
+    UINTN NewCapacity;
+    VOID *NewArray;
+
+    if (Count < *Capacity)
+        return EFI_SUCCESS;
+
+    NewCapacity = *Capacity == 0 ? 16 : *Capacity * 2;
+    NewArray = TaggedReallocatePool(POOL_TAG_PATCH, *Capacity * Size, NewCapacity * Size, *Array);
+    if (NewArray == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    *Array = NewArray;
+    *Capacity = NewCapacity;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Copy bytes into the pool and return their offset
+ */
+STATIC EFI_STATUS PatchScriptPoolAdd(PATCH_SCRIPT *Script, CONST VOID *Data, UINTN Size, UINT32 *Offset)
+{
+    UINTN Capacity = Script->PoolCapacity == 0 ? SIZE_4KB : Script->PoolCapacity;
+    UINT8 *Pool;
+
+    while (Script->PoolSize + Size > Capacity)
+        Capacity *= 2;
+    if (Capacity > MAX_UINT32)
+        return EFI_OUT_OF_RESOURCES;
+
+    if (Capacity != Script->PoolCapacity)
+    {
+        Pool = TaggedReallocatePool(POOL_TAG_PATCH, Script->PoolCapacity, Capacity, Script->Pool);
+        if (Pool == NULL)
+            return EFI_OUT_OF_RESOURCES;
+        Script->Pool = Pool;
+        Script->PoolCapacity = Capacity;
+    }
+
+    CopyMem(&Script->Pool[Script->PoolSize], Data, Size);
+    *Offset = (UINT32)Script->PoolSize;
+    Script->PoolSize += Size;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Compile the operands of an Op Patch
+ */
+STATIC EFI_STATUS PatchScriptCompilePatch(PATCH_SCRIPT *Script, PATCH_SCRIPT_READER *Reader, PATCH_SCRIPT_OP *Op, BOOLEAN HavePattern)
+{
+    EFI_STATUS Status;
+    UINT8 *Bytes;
+    UINTN Count;
+    UINT32 Mask;
+
+    if (!PatchScriptReadLine(Reader))
+        return EFI_INVALID_PARAMETER;
+
+    if (PatchScriptTokenIs(Reader, 0, "Offset"))
+        Op->Target = PATCH_TARGET_OFFSET;
+    else if (PatchScriptTokenIs(Reader, 0, "Pattern"))
+        Op->Target = PATCH_TARGET_PATTERN;
+    else if (PatchScriptTokenIs(Reader, 0, "RelNegOffset"))
+        Op->Target = PATCH_TARGET_REL_NEG_OFFSET;
+    else if (PatchScriptTokenIs(Reader, 0, "RelPosOffset"))
+        Op->Target = PATCH_TARGET_REL_POS_OFFSET;
+    else
+        return EFI_INVALID_PARAMETER;
+
+    // A relative offset needs a pattern match to count from
+    if ((Op->Target == PATCH_TARGET_REL_NEG_OFFSET || Op->Target == PATCH_TARGET_REL_POS_OFFSET) && !HavePattern)
+        return EFI_INVALID_PARAMETER;
+
+    if (!PatchScriptReadLine(Reader))
+        return EFI_INVALID_PARAMETER;
+
+    // Pattern bytes followed by the mask
+    Bytes = TaggedAllocatePool(POOL_TAG_PATCH, 2 * PATCH_SCRIPT_MAX_BYTES);
+    if (Bytes == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    Status = EFI_INVALID_PARAMETER;
+    if (Op->Target == PATCH_TARGET_PATTERN)
+    {
+        if (PatchScriptParseBytes(Reader, Bytes, &Bytes[PATCH_SCRIPT_MAX_BYTES], &Count))
+        {
+            // The matcher needs at least one exact byte to anchor on
+            for (UINTN i = 0; i < Count && Status == EFI_INVALID_PARAMETER; i++)
+            {
+                if (Bytes[PATCH_SCRIPT_MAX_BYTES + i] == 0xFF)
+                    Status = EFI_SUCCESS;
+            }
+        }
+        if (!EFI_ERROR(Status))
+        {
+            Op->PatternLength = (UINT32)Count;
+            Status = PatchScriptPoolAdd(Script, Bytes, Count, &Op->Pattern);
+        }
+        if (!EFI_ERROR(Status))
+            Status = PatchScriptPoolAdd(Script, &Bytes[PATCH_SCRIPT_MAX_BYTES], Count, &Mask);
+    }
+    else if (PatchScriptParseOffset(Reader, &Op->Offset))
+    {
+        Status = EFI_SUCCESS;
+    }
+
+    if (!EFI_ERROR(Status))
+        Status = PatchScriptReadLine(Reader) && PatchScriptParseBytes(Reader, Bytes, NULL, &Count) ? EFI_SUCCESS : EFI_INVALID_PARAMETER;
+    if (!EFI_ERROR(Status))
+    {
+        Op->ReplaceLength = (UINT32)Count;
+        Status = PatchScriptPoolAdd(Script, Bytes, Count, &Op->Replace);
+    }
+
+    TaggedFreePool(Bytes);
+    return Status;
+}
+
+EFI_STATUS PatchScriptCompile(PATCH_SCRIPT *Script, CONST CHAR8 *Text, UINTN Size, UINTN *ErrorLine)
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+    PATCH_SCRIPT_READER Reader;
+    BOOLEAN HavePattern = FALSE;
+
+    if (Script == NULL || Text == NULL || ErrorLine == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    ZeroMem(Script, sizeof(PATCH_SCRIPT));
+    ZeroMem(&Reader, sizeof(Reader));
+    Reader.Text = Text;
+    Reader.Size = Size;
+    *ErrorLine = 0;
+
+    while (!EFI_ERROR(Status) && PatchScriptReadLine(&Reader))
+    {
+        PATCH_SCRIPT_OP Op;
+
+        ZeroMem(&Op, sizeof(Op));
+        Op.Line = (UINT32)Reader.Line;
+        Op.Module = (UINT32)Script->ModuleCount - 1;
+
+        if (PatchScriptTokenIs(&Reader, 0, "Op Loaded"))
+            Op.OpCode = PATCH_OP_LOADED;
+        else if (PatchScriptTokenIs(&Reader, 0, "Op LoadFromFS"))
+            Op.OpCode = PATCH_OP_LOAD_FS;
+        else if (PatchScriptTokenIs(&Reader, 0, "Op LoadFromFV"))
+            Op.OpCode = PATCH_OP_LOAD_FV;
+        else if (PatchScriptTokenIs(&Reader, 0, "Op Patch"))
+            Op.OpCode = PATCH_OP_PATCH;
+        else if (PatchScriptTokenIs(&Reader, 0, "Op Exec"))
+            Op.OpCode = PATCH_OP_EXEC;
+        else
+            Status = EFI_INVALID_PARAMETER;
+
+        if (!EFI_ERROR(Status) && Op.OpCode != PATCH_OP_PATCH && Op.OpCode != PATCH_OP_EXEC)
+        {
+            // Load ops open a new module
+            PATCH_SCRIPT_MODULE Module;
+            CHAR8 Name[PATCH_SCRIPT_MAX_NAME_LENGTH + 1];
+
+            ZeroMem(&Module, sizeof(Module));
+            if (!PatchScriptReadLine(&Reader) || Reader.Length > PATCH_SCRIPT_MAX_NAME_LENGTH)
+                Status = EFI_INVALID_PARAMETER;
+            if (!EFI_ERROR(Status))
+            {
+                CopyMem(Name, Reader.Token, Reader.Length);
+                Name[Reader.Length] = '\0';
+                Status = PatchScriptPoolAdd(Script, Name, Reader.Length + 1, &Module.Name);
+            }
+            if (!EFI_ERROR(Status))
+                Status = PatchScriptGrow((VOID **)&Script->Modules, Script->ModuleCount, &Script->ModuleCapacity, sizeof(PATCH_SCRIPT_MODULE));
+            if (!EFI_ERROR(Status))
+            {
+                Module.FirstOp = (UINT32)Script->OpCount;
+                Op.Module = (UINT32)Script->ModuleCount;
+                Script->Modules[Script->ModuleCount++] = Module;
+                HavePattern = FALSE;
+            }
+        }
+        else if (!EFI_ERROR(Status) && Script->ModuleCount == 0)
+        {
+            // Patch and Exec need a module
+            Status = EFI_INVALID_PARAMETER;
+        }
+        else if (!EFI_ERROR(Status) && Op.OpCode == PATCH_OP_PATCH)
+        {
+            Status = PatchScriptCompilePatch(Script, &Reader, &Op, HavePattern);
+            HavePattern |= Op.Target == PATCH_TARGET_PATTERN;
+        }
+
+        if (!EFI_ERROR(Status))
+            Status = PatchScriptGrow((VOID **)&Script->Ops, Script->OpCount, &Script->OpCapacity, sizeof(PATCH_SCRIPT_OP));
+        if (!EFI_ERROR(Status))
+        {
+            Script->Ops[Script->OpCount++] = Op;
+            Script->Modules[Op.Module].OpCount++;
+            if (Op.OpCode == PATCH_OP_PATCH)
+                Script->Modules[Op.Module].PatchCount++;
+        }
+    }
+
+    if (EFI_ERROR(Status))
+    {
+        if (Status == EFI_INVALID_PARAMETER)
+            *ErrorLine = Reader.Line;
+        PatchScriptFree(Script);
+    }
+    return Status;
+}
+
+EFI_STATUS PatchScriptLoad(PATCH_SCRIPT *Script, EFI_FILE *Root)
+{
+    EFI_STATUS Status;
+    EFI_FILE *File;
+    UINT64 FileSize = 0;
+    CHAR8 *Text;
+    UINTN Size;
+    UINTN ErrorLine;
+
+    ZeroMem(Script, sizeof(PATCH_SCRIPT));
+
+    Status = Root->Open(Root, &File, PATCH_SCRIPT_FILE_NAME, EFI_FILE_MODE_READ, 0);
+    if (EFI_ERROR(Status))
+        return EFI_NOT_FOUND;
+
+    Status = File->SetPosition(File, MAX_UINT64);
+    if (!EFI_ERROR(Status))
+        Status = File->GetPosition(File, &FileSize);
+    if (!EFI_ERROR(Status))
+        Status = File->SetPosition(File, 0);
+    if (EFI_ERROR(Status) || FileSize == 0 || FileSize > PATCH_SCRIPT_MAX_FILE_SIZE)
+    {
+        File->Close(File);
+        return EFI_VOLUME_CORRUPTED;
+    }
+
+    Size = (UINTN)FileSize;
+    Text = TaggedAllocatePool(POOL_TAG_PATCH, Size);
+    if (Text == NULL)
+    {
+        File->Close(File);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = File->Read(File, &Size, Text);
+    File->Close(File);
+
+    // The compiled script keeps copies of everything it needs
+    if (!EFI_ERROR(Status))
+    {
+        Status = PatchScriptCompile(Script, Text, Size, &ErrorLine);
+        if (Status == EFI_INVALID_PARAMETER)
+        {
+            AsciiSPrint(Log, 512, "%s: syntax error on line %d\n\r", PATCH_SCRIPT_FILE_NAME, ErrorLine);
+            LogToFile(LogFile, Log);
+        }
+    }
+
+    TaggedFreePool(Text);
+    return Status;
+}
+
+/**
+ * Helper: Longest run of exact bytes in a pattern
+ */
+STATIC VOID PatchScriptAnchor(CONST UINT8 *Mask, UINTN Length, UINTN *Start, UINTN *RunLength)
+{
+    UINTN Run = 0;
+
+    *Start = 0;
+    *RunLength = 0;
+    for (UINTN i = 0; i < Length; i++)
+    {
+        Run = Mask[i] == 0xFF ? Run + 1 : 0;
+        if (Run > *RunLength)
+        {
+            *RunLength = Run;
+            *Start = i + 1 - Run;
+        }
+    }
+}
+
+/**
+ * Helper: Verify a candidate and record the first match of its op
+ */
+STATIC BOOLEAN PatchScriptMatch(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex)
+{
+    PATCH_SCRIPT_SCAN *Scan = (PATCH_SCRIPT_SCAN *)Context;
+    CONST PATCH_SCRIPT_ANCHOR *Anchor = &Scan->Anchors[PatternIndex];
+    CONST PATCH_SCRIPT_OP *Op = &Scan->Script->Ops[Anchor->Op];
+    CONST UINT8 *Bytes = &Scan->Script->Pool[Op->Pattern];
+    CONST UINT8 *Mask = Bytes + Op->PatternLength;
+    UINTN Slot = Anchor->Op - Scan->Module->FirstOp;
+    UINTN Start;
+
+    // Anchors are reported in ascending order, so the first full match is the lowest
+    if (Scan->Match[Slot] != MAX_UINTN || Offset < Anchor->Start)
+        return TRUE;
+    Start = Offset - Anchor->Start;
+    if (Op->PatternLength > Scan->ImageSize - Start)
+        return TRUE;
+
+    for (UINTN i = 0; i < Op->PatternLength; i++)
+    {
+        if (((Data[Start + i] ^ Bytes[i]) & Mask[i]) != 0)
+            return TRUE;
+    }
+
+    Scan->Match[Slot] = Start;
+    return --Scan->Remaining > 0;
+}
+
+/**
+ * Helper: Locate every pattern of a module in one scan of the image
+ */
+STATIC EFI_STATUS PatchScriptLocate(
+    CONST PATCH_SCRIPT *Script,
+    CONST PATCH_SCRIPT_MODULE *Module,
+    UINT8 *ImageBase,
+    UINTN ImageSize,
+    UINTN *Match)
+{
+    EFI_STATUS Status;
+    PATCH_SCRIPT_SCAN Scan;
+    PATCH_SCRIPT_ANCHOR *Anchors;
+    CONST UINT8 **Runs;
+    UINTN *Lengths;
+    UINTN Count = 0;
+    STRING_MATCHER Matcher;
+
+    SetMem(Match, Module->OpCount * sizeof(UINTN), 0xFF);
+
+    Anchors = TaggedAllocatePool(POOL_TAG_PATCH, Module->PatchCount * sizeof(PATCH_SCRIPT_ANCHOR));
+    Runs = TaggedAllocatePool(POOL_TAG_PATCH, Module->PatchCount * sizeof(CONST UINT8 *));
+    Lengths = TaggedAllocatePool(POOL_TAG_PATCH, Module->PatchCount * sizeof(UINTN));
+    if (Anchors == NULL || Runs == NULL || Lengths == NULL)
+    {
+        if (Anchors != NULL)
+            TaggedFreePool(Anchors);
+        if (Runs != NULL)
+            TaggedFreePool(Runs);
+        if (Lengths != NULL)
+            TaggedFreePool(Lengths);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (UINTN i = Module->FirstOp; i < Module->FirstOp + Module->OpCount; i++)
+    {
+        CONST PATCH_SCRIPT_OP *Op = &Script->Ops[i];
+        UINTN Start;
+
+        if (Op->OpCode != PATCH_OP_PATCH || Op->Target != PATCH_TARGET_PATTERN)
+            continue;
+
+        PatchScriptAnchor(&Script->Pool[Op->Pattern + Op->PatternLength], Op->PatternLength, &Start, &Lengths[Count]);
+        Anchors[Count].Op = (UINT32)i;
+        Anchors[Count].Start = (UINT32)Start;
+        Runs[Count] = &Script->Pool[Op->Pattern + Start];
+        Count++;
+    }
+
+    Status = EFI_SUCCESS;
+    if (Count > 0)
+        Status = StringMatcherBuild(&Matcher, Runs, Lengths, Count);
+    if (Count > 0 && !EFI_ERROR(Status))
+    {
+        Scan.Script = Script;
+        Scan.Module = Module;
+        Scan.Anchors = Anchors;
+        Scan.Match = Match;
+        Scan.Remaining = Count;
+        Scan.ImageSize = ImageSize;
+        StringMatcherScan(&Matcher, ImageBase, 0, ImageSize, PatchScriptMatch, &Scan);
+        StringMatcherFree(&Matcher);
+    }
+
+    TaggedFreePool(Lengths);
+    TaggedFreePool(Runs);
+    TaggedFreePool(Anchors);
+    return Status;
+}
+
+/**
+ * Helper: Log one op and store its result
+ */
+STATIC VOID PatchScriptReport(
+    CONST PATCH_SCRIPT *Script,
+    UINTN OpIndex,
+    CONST PATCH_SCRIPT_RESULT *Result,
+    PATCH_SCRIPT_RESULT *Results)
+{
+    STATIC CONST CHAR8 *CONST OpNames[] = { "Nop", "Loaded", "LoadFromFS", "LoadFromFV", "Patch", "Exec" };
+    CONST PATCH_SCRIPT_OP *Op = &Script->Ops[OpIndex];
+
+    AsciiSPrint(Log, 512, "Line %d: %a %a at 0x%lx: %r (%ld ticks)\n\r",
+                Op->Line, OpNames[Op->OpCode], &Script->Pool[Script->Modules[Op->Module].Name],
+                (UINT64)Result->Address, Result->Status, Result->Ticks);
+    LogToFile(LogFile, Log);
+
+    if (Results != NULL)
+        Results[OpIndex] = *Result;
+}
+
+/**
+ * Helper: Write one patch of a located module
+ */
+STATIC EFI_STATUS PatchScriptApply(
+    CONST PATCH_SCRIPT *Script,
+    CONST PATCH_SCRIPT_OP *Op,
+    UINTN Match,
+    UINTN *LastPattern,
+    UINT8 *ImageBase,
+    UINTN ImageSize,
+    UINTN *Address)
+{
+    UINTN Target;
+
+    switch (Op->Target)
+    {
+    case PATCH_TARGET_OFFSET:
+        Target = Op->Offset;
+        break;
+    case PATCH_TARGET_PATTERN:
+        *LastPattern = Match;
+        Target = Match;
+        break;
+    case PATCH_TARGET_REL_NEG_OFFSET:
+        if (*LastPattern == MAX_UINTN || Op->Offset > *LastPattern)
+            return EFI_NOT_FOUND;
+        Target = *LastPattern - Op->Offset;
+        break;
+    default:
+        if (*LastPattern == MAX_UINTN)
+            return EFI_NOT_FOUND;
+        Target = *LastPattern + Op->Offset;
+        break;
+    }
+
+    if (Target == MAX_UINTN)
+        return EFI_NOT_FOUND;
+    if (Target > ImageSize || Op->ReplaceLength > ImageSize - Target)
+        return EFI_INVALID_PARAMETER;
+
+    (VOID)PatchPlanWrite(ImageBase, Target, &Script->Pool[Op->Replace], Op->ReplaceLength, PATCH_REASON_SCRIPT);
+    *Address = (UINTN)&ImageBase[Target];
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Resolve, locate, patch and start one module
+ */
+STATIC EFI_STATUS PatchScriptRunModule(
+    CONST PATCH_SCRIPT *Script,
+    CONST PATCH_SCRIPT_MODULE *Module,
+    EFI_HANDLE ImageHandle,
+    PATCH_SCRIPT_RESULT *Results)
+{
+    EFI_STATUS Status;
+    EFI_STATUS FirstError;
+    PATCH_SCRIPT_RESULT Result;
+    CONST PATCH_SCRIPT_OP *Load = &Script->Ops[Module->FirstOp];
+    CHAR8 *Name = (CHAR8 *)&Script->Pool[Module->Name];
+    EFI_LOADED_IMAGE_PROTOCOL *ImageInfo = NULL;
+    EFI_HANDLE AppImageHandle = NULL;
+    UINT8 *ImageBase = NULL;
+    UINTN ImageSize = 0;
+    UINTN *Match;
+    UINTN LastPattern = MAX_UINTN;
+    UINT64 Start;
+
+    ZeroMem(&Result, sizeof(Result));
+    Start = PatchScriptTicks();
+    switch (Load->OpCode)
+    {
+    case PATCH_OP_LOADED:
+        Status = FindLoadedImageFromName(ImageHandle, Name, &ImageInfo);
+        break;
+    case PATCH_OP_LOAD_FS:
+        Status = LoadFS(ImageHandle, Name, &ImageInfo, &AppImageHandle);
+        break;
+    default:
+        Status = LoadFV(ImageHandle, Name, &ImageInfo, &AppImageHandle, EFI_SECTION_PE32);
+        break;
+    }
+    if (!EFI_ERROR(Status))
+    {
+        ImageBase = (UINT8 *)ImageInfo->ImageBase;
+        ImageSize = (UINTN)ImageInfo->ImageSize;
+    }
+    Result.Status = Status;
+    Result.Address = (UINTN)ImageBase;
+    Result.Ticks = PatchScriptTicks() - Start;
+    PatchScriptReport(Script, Module->FirstOp, &Result, Results);
+    FirstError = Status;
+
+    Match = EFI_ERROR(Status) ? NULL : TaggedAllocatePool(POOL_TAG_PATCH, Module->OpCount * sizeof(UINTN));
+    if (!EFI_ERROR(Status) && Match == NULL)
+        Status = EFI_OUT_OF_RESOURCES;
+
+    if (!EFI_ERROR(Status) && Module->PatchCount > 0)
+    {
+        Start = PatchScriptTicks();
+        Status = PatchScriptLocate(Script, Module, ImageBase, ImageSize, Match);
+        AsciiSPrint(Log, 512, "%a: located %d patches in one scan: %r (%ld ticks)\n\r",
+                    Name, Module->PatchCount, Status, PatchScriptTicks() - Start);
+        LogToFile(LogFile, Log);
+    }
+
+    for (UINTN i = Module->FirstOp + 1; i < Module->FirstOp + Module->OpCount; i++)
+    {
+        CONST PATCH_SCRIPT_OP *Op = &Script->Ops[i];
+
+        ZeroMem(&Result, sizeof(Result));
+        Start = PatchScriptTicks();
+        if (EFI_ERROR(Status))
+            Result.Status = EFI_ABORTED;
+        else if (Op->OpCode == PATCH_OP_PATCH)
+            Result.Status = PatchScriptApply(Script, Op, Match[i - Module->FirstOp], &LastPattern, ImageBase, ImageSize, &Result.Address);
+        else if (AppImageHandle == NULL)
+            Result.Status = EFI_UNSUPPORTED;   // Loaded images were already started by the firmware
+        else
+            Result.Status = Exec(&AppImageHandle);
+        Result.Ticks = PatchScriptTicks() - Start;
+
+        PatchScriptReport(Script, i, &Result, Results);
+        if (!EFI_ERROR(FirstError))
+            FirstError = Result.Status;
+    }
+
+    if (Match != NULL)
+        TaggedFreePool(Match);
+    return FirstError;
+}
+
+EFI_STATUS PatchScriptRun(PATCH_SCRIPT *Script, EFI_HANDLE ImageHandle, PATCH_SCRIPT_RESULT *Results)
+{
+    EFI_STATUS Status = EFI_SUCCESS;
+
+    if (Script == NULL || Script->Ops == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    for (UINTN m = 0; m < Script->ModuleCount; m++)
+    {
+        EFI_STATUS ModuleStatus = PatchScriptRunModule(Script, &Script->Modules[m], ImageHandle, Results);
+
+        if (!EFI_ERROR(Status))
+            Status = ModuleStatus;
+    }
+
+    return Status;
+}
+
+VOID PatchScriptFree(PATCH_SCRIPT *Script)
+{
+    if (Script == NULL)
+        return;
+
+    if (Script->Ops != NULL)
+        TaggedFreePool(Script->Ops);
+    if (Script->Modules != NULL)
+        TaggedFreePool(Script->Modules);
+    if (Script->Pool != NULL)
+        TaggedFreePool(Script->Pool);
+    ZeroMem(Script, sizeof(PATCH_SCRIPT));
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+// Manual patch script, next to the log on the volume SREP was started from
+#define PATCH_SCRIPT_FILE_NAME L"SREP_Config.cfg"
+
+// Largest script accepted
+#define PATCH_SCRIPT_MAX_FILE_SIZE SIZE_256KB
+
+// Longest pattern or replacement on one line
+#define PATCH_SCRIPT_MAX_BYTES 1024
+
+// No module / no match
+#define PATCH_SCRIPT_NONE MAX_UINT32
+
+// Operations
+typedef enum {
+    PATCH_OP_LOADED = 1,         // Find an image that is already loaded
+    PATCH_OP_LOAD_FS,            // Load an image from a file system
+    PATCH_OP_LOAD_FV,            // Load an image from a firmware volume
+    PATCH_OP_PATCH,              // Patch the current module
+    PATCH_OP_EXEC                // Start the current module
+} PATCH_OPCODE;
+
+// Where a PATCH_OP_PATCH writes
+typedef enum {
+    PATCH_TARGET_OFFSET = 1,     // Offset from the image base
+    PATCH_TARGET_PATTERN,        // First match of a masked pattern
+    PATCH_TARGET_REL_NEG_OFFSET, // Before the last pattern match of the module
+    PATCH_TARGET_REL_POS_OFFSET  // After the last pattern match of the module
+} PATCH_TARGET;
+
+// One compiled operation (32 bytes); byte strings live in the script pool
+typedef struct {
+    UINT8 OpCode;                // PATCH_OPCODE
+    UINT8 Target;                // PATCH_TARGET, PATCH_OP_PATCH only
+    UINT16 Reserved;
+    UINT32 Module;               // Module index
+    UINT32 Line;                 // Line of the Op keyword, for the log
+    UINT32 Pattern;              // Pool offset of the pattern bytes, then as many mask bytes
+    UINT32 PatternLength;
+    UINT32 Replace;              // Pool offset of the replacement bytes
+    UINT32 ReplaceLength;
+    UINT32 Offset;               // PATCH_TARGET_*OFFSET distance
+} PATCH_SCRIPT_OP;
+
+// One module the script loads or finds
+typedef struct {
+    UINT32 Name;                 // Pool offset of the NUL-terminated ASCII name
+    UINT32 FirstOp;              // The Loaded / LoadFromFS / LoadFromFV op
+    UINT32 OpCount;              // Ops up to the next module
+    UINT32 PatchCount;
+} PATCH_SCRIPT_MODULE;
+
+// Compiled script
+typedef struct {
+    PATCH_SCRIPT_OP *Ops;
+    UINTN OpCount;
+    UINTN OpCapacity;
+    PATCH_SCRIPT_MODULE *Modules;
+    UINTN ModuleCount;
+    UINTN ModuleCapacity;
+    UINT8 *Pool;
+    UINTN PoolSize;
+    UINTN PoolCapacity;
+} PATCH_SCRIPT;
+
+// Outcome of one op after PatchScriptRun
+typedef struct {
+    EFI_STATUS Status;
+    UINTN Address;               // Where a patch was written, or the module base
+    UINT64 Ticks;                // Time spent on the op
+} PATCH_SCRIPT_RESULT;
+
+/**
+ * Compile script text
+ *
+ * The text is a sequence of ops, one keyword per line:
+ *
+ *   Op Loaded | LoadFromFS | LoadFromFV
+ *   <module name>
+ *   Op Patch
+ *   Offset | Pattern | RelNegOffset | RelPosOffset
+ *   <hex offset, or hex pattern with ?? for any byte>
+ *   <hex replacement>
+ *   Op Exec
+ *
+ * Blank lines, lines starting with '#' and End lines are ignored. Patch and
+ * Exec apply to the module of the last load op.
+ *
+ * @param Script        Script to fill (freed with PatchScriptFree)
+ * @param Text          Script text (need not be NUL-terminated)
+ * @param Size          Size of Text in bytes
+ * @param ErrorLine     Set to the offending line on EFI_INVALID_PARAMETER
+ * @return EFI_SUCCESS, EFI_INVALID_PARAMETER or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS PatchScriptCompile(PATCH_SCRIPT *Script, CONST CHAR8 *Text, UINTN Size, UINTN *ErrorLine);
+
+/**
+ * Load and compile PATCH_SCRIPT_FILE_NAME
+ *
+ * @param Script        Script to fill
+ * @param Root          Volume root
+ * @return EFI_NOT_FOUND without a script, otherwise as PatchScriptCompile
+ */
+EFI_STATUS PatchScriptLoad(PATCH_SCRIPT *Script, EFI_FILE *Root);
+
+/**
+ * Run a compiled script
+ *
+ * Each module is resolved once. All patches of a module are located in one
+ * scan of the unpatched image and then written in script order, so a
+ * pattern never matches bytes written by an earlier op. Every op is logged
+ * with its status and time.
+ *
+ * @param Script        Compiled script
+ * @param ImageHandle   Handle of SREP, parent of loaded images
+ * @param Results       Optional, Script->OpCount entries
+ * @return EFI_SUCCESS if every op succeeded, otherwise the first error
+ */
+EFI_STATUS PatchScriptRun(PATCH_SCRIPT *Script, EFI_HANDLE ImageHandle, PATCH_SCRIPT_RESULT *Results);
+
+/**
+ * Free a compiled script
+ *
+ * @param Script        Script to free
+ */
+VOID PatchScriptFree(PATCH_SCRIPT *Script);
@@ -0,0 +1,542 @@
+#include "PlanCache.h"
+#include "FvFileIndex.h"
+#include "TaggedPool.h"
+#include <Library/BaseCryptLib.h>
+#include <Library/BaseLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Protocol/LoadedImage.h>
+#include <Protocol/SimpleFileSystem.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+// File layout: header, entries sorted by hash, then the records they index
+#define PLAN_CACHE_SIGNATURE SIGNATURE_32('S', 'R', 'P', 'C')
+#define PLAN_CACHE_VERSION 4
+
+// Larger files are not ours (a full cache is a few KB)
+#define PLAN_CACHE_MAX_FILE_SIZE SIZE_4MB
+
+// Initial capacities; grown by doubling
+#define PLAN_CACHE_INITIAL_ENTRIES 64
+#define PLAN_CACHE_INITIAL_RECORDS 256
+
+typedef struct {
+    UINT32 Signature;
+    UINT32 Version;
+    UINT8 FirmwareId[PLAN_CACHE_HASH_SIZE];
+    UINT32 EntryCount;
+    UINT32 RecordCount;
+} PLAN_CACHE_HEADER;
+
+/**
+ * Helper: Open the cache file on the volume SREP was started from
+ */
+STATIC EFI_STATUS PlanCacheOpenFile(EFI_HANDLE ImageHandle, UINT64 Mode, EFI_FILE **File)
+{
+    EFI_STATUS Status;
+    EFI_LOADED_IMAGE_PROTOCOL *LoadedImage;
+    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *FileSystem;
+    EFI_FILE *Root;
+
+    Status = gBS->HandleProtocol(ImageHandle, &gEfiLoadedImageProtocolGuid, (VOID **)&LoadedImage);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Status = gBS->HandleProtocol(LoadedImage->DeviceHandle, &gEfiSimpleFileSystemProtocolGuid, (VOID **)&FileSystem);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Status = FileSystem->OpenVolume(FileSystem, &Root);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Status = Root->Open(Root, File, PLAN_CACHE_FILE_NAME, Mode, 0);
+    Root->Close(Root);
+    return Status;
+}
+
+/**
+ * Helper: Identity of the running firmware; any update changes it
+ */
+STATIC VOID PlanCacheFirmwareId(PLAN_CACHE *Cache, BIOS_INFO *BiosInfo, UINT8 *Id)
+{
+    Sha256Init(Cache->HashContext);
+
+    if (gST->FirmwareVendor != NULL)
+        Sha256Update(Cache->HashContext, gST->FirmwareVendor, StrSize(gST->FirmwareVendor));
+    Sha256Update(Cache->HashContext, &gST->FirmwareRevision, sizeof(gST->FirmwareRevision));
+
+    if (BiosInfo != NULL)
+    {
+        Sha256Update(Cache->HashContext, BiosInfo->VendorName, StrSize(BiosInfo->VendorName));
+        Sha256Update(Cache->HashContext, BiosInfo->Version, StrSize(BiosInfo->Version));
+    }
+
+    Sha256Final(Cache->HashContext, Id);
+}
+
+/**
+ * Helper: Take over the entries and records of a file image
+ */
+STATIC BOOLEAN PlanCacheParse(PLAN_CACHE *Cache, UINT8 *Buffer, UINTN Size)
+{
+    PLAN_CACHE_HEADER *Header = (PLAN_CACHE_HEADER *)Buffer;
+    PLAN_CACHE_ENTRY *Entries;
+    UINTN Index;
+
+    if (Size < sizeof(PLAN_CACHE_HEADER) ||
+        Header->Signature != PLAN_CACHE_SIGNATURE || Header->Version != PLAN_CACHE_VERSION)
+        return FALSE;
+
+    if (Size != sizeof(PLAN_CACHE_HEADER) +
+                (UINTN)Header->EntryCount * sizeof(PLAN_CACHE_ENTRY) +
+                (UINTN)Header->RecordCount * sizeof(PATCH_RECORD))
+        return FALSE;
+
+    if (CompareMem(Header->FirmwareId, Cache->FirmwareId, PLAN_CACHE_HASH_SIZE) != 0)
+    {
+        AsciiSPrint(Log, 512, "Plan cache was written by other firmware, discarding it\n\r");
+        LogToFile(LogFile, Log);
+        return FALSE;
+    }
+
+    Entries = (PLAN_CACHE_ENTRY *)(Header + 1);
+    for (Index = 0; Index < Header->EntryCount; Index++)
+    {
+        if (Entries[Index].FirstRecord > Header->RecordCount ||
+            Entries[Index].RecordCount > Header->RecordCount - Entries[Index].FirstRecord)
+            return FALSE;
+    }
+
+    if (Header->EntryCount > 0)
+    {
+        Cache->Entries = TaggedAllocateCopyPool(POOL_TAG_PATCH, Header->EntryCount * sizeof(PLAN_CACHE_ENTRY), Entries);
+        if (Cache->Entries == NULL)
+            return FALSE;
+        Cache->EntryCount = Cache->EntryCapacity = Cache->LoadedCount = Header->EntryCount;
+
+        for (Index = 0; Index < Cache->EntryCount; Index++)
+            Cache->Entries[Index].Flags = 0;
+    }
+
+    if (Header->RecordCount > 0)
+    {
+        Cache->Records = TaggedAllocateCopyPool(POOL_TAG_PATCH, Header->RecordCount * sizeof(PATCH_RECORD),
+                                                &Entries[Header->EntryCount]);
+        if (Cache->Records == NULL)
+        {
+            TaggedFreePool(Cache->Entries);
+            Cache->Entries = NULL;
+            Cache->EntryCount = Cache->EntryCapacity = Cache->LoadedCount = 0;
+            return FALSE;
+        }
+        Cache->RecordCount = Cache->RecordCapacity = Header->RecordCount;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Load the plan cache of this firmware
+ */
+EFI_STATUS PlanCacheLoad(PLAN_CACHE *Cache, EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo)
+{
+    EFI_STATUS Status;
+    EFI_FILE *File;
+    UINT64 FileSize = 0;
+    UINT8 *Buffer;
+    UINTN Size;
+
+    ZeroMem(Cache, sizeof(PLAN_CACHE));
+    Cache->HashContext = TaggedAllocatePool(POOL_TAG_PATCH, Sha256GetContextSize());
+    if (Cache->HashContext == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    PlanCacheFirmwareId(Cache, BiosInfo, Cache->FirmwareId);
+
+    Status = PlanCacheOpenFile(ImageHandle, EFI_FILE_MODE_READ, &File);
+    if (EFI_ERROR(Status))
+    {
+        AsciiSPrint(Log, 512, "No plan cache, scanning every module\n\r");
+        LogToFile(LogFile, Log);
+        return EFI_SUCCESS;
+    }
+
+    // Seeking past the end gives the file size without a FILE_INFO round trip
+    if (EFI_ERROR(File->SetPosition(File, MAX_UINT64)) || EFI_ERROR(File->GetPosition(File, &FileSize)) ||
+        FileSize == 0 || FileSize > PLAN_CACHE_MAX_FILE_SIZE || EFI_ERROR(File->SetPosition(File, 0)))
+    {
+        File->Close(File);
+        return EFI_SUCCESS;
+    }
+
+    Size = (UINTN)FileSize;
+    Buffer = TaggedAllocatePool(POOL_TAG_PATCH, Size);
+    if (Buffer == NULL)
+    {
+        File->Close(File);
+        return EFI_SUCCESS;
+    }
+
+    Status = File->Read(File, &Size, Buffer);
+    File->Close(File);
+
+    if (!EFI_ERROR(Status) && PlanCacheParse(Cache, Buffer, Size))
+    {
+        AsciiSPrint(Log, 512, "Loaded plan cache: %d modules, %d patches\n\r",
+                    Cache->EntryCount, Cache->RecordCount);
+        LogToFile(LogFile, Log);
+    }
+
+    TaggedFreePool(Buffer);
+    return EFI_SUCCESS;
+}
+
+/**
+ * Hash a module like PlanCacheHashImage, with a caller SHA-256 context
+ *
+ * The raw FFS file is hashed, so a compressed module is never decompressed
+ * just for its key. It is used in place when its volume is memory-mapped;
+ * otherwise it is read through the FV2 protocol.
+ */
+EFI_STATUS PlanCacheHashFile(VOID *HashContext, CONST EFI_GUID *FileGuid, UINT64 ImageSize, UINT8 *Hash)
+{
+    CONST FV_FILE_ENTRY *File;
+    CONST VOID *Data;
+    VOID *Buffer = NULL;
+    UINTN DataSize = 0;
+    UINT32 AuthenticationStatus;
+    UINT32 Size;
+    UINT64 FileSize;
+
+    if (HashContext == NULL || FileGuid == NULL || IsZeroGuid(FileGuid) || ImageSize > MAX_UINT32)
+        return EFI_UNSUPPORTED;
+
+    File = FvFileIndexFindByGuid(&gFvFileIndex, FileGuid);
+    if (File == NULL)
+        return EFI_NOT_FOUND;
+
+    Data = File->Data;
+    DataSize = File->FileSize;
+    if (Data == NULL)
+    {
+        if (EFI_ERROR(FvFileIndexReadFile(File, &Buffer, &DataSize, &AuthenticationStatus)))
+            return EFI_NOT_FOUND;
+        Data = Buffer;
+    }
+
+    Size = (UINT32)ImageSize;
+    FileSize = DataSize;
+    Sha256Init(HashContext);
+    Sha256Update(HashContext, FileGuid, sizeof(EFI_GUID));
+    Sha256Update(HashContext, &Size, sizeof(Size));
+    Sha256Update(HashContext, &FileSize, sizeof(FileSize));
+    Sha256Update(HashContext, Data, DataSize);
+    Sha256Final(HashContext, Hash);
+
+    // ReadFile allocated it
+    if (Buffer != NULL)
+        FreePool(Buffer);
+    return EFI_SUCCESS;
+}
+
+/**
+ * Hash a loaded module by the file it was loaded from
+ */
+EFI_STATUS PlanCacheHashImage(PLAN_CACHE *Cache, CONST EFI_GUID *FileGuid, UINT64 ImageSize, UINT8 *Hash)
+{
+    return PlanCacheHashFile(Cache->HashContext, FileGuid, ImageSize, Hash);
+}
+
+/**
+ * Find the entry of a module
+ *
+ * Only entries loaded from the file are searched; they are sorted by hash.
+ */
+UINTN PlanCacheFind(PLAN_CACHE *Cache, CONST UINT8 *Hash, UINTN ImageSize)
+{
+    UINTN Low = 0;
+    UINTN High = Cache->LoadedCount;
+
+    while (Low < High)
+    {
+        UINTN Middle = Low + (High - Low) / 2;
+        PLAN_CACHE_ENTRY *Entry = &Cache->Entries[Middle];
+        INTN Order = CompareMem(Entry->Hash, Hash, PLAN_CACHE_HASH_SIZE);
+
+        if (Order == 0)
+        {
+            if (Entry->ImageSize != ImageSize)
+                break;
+            return Middle;
+        }
+
+        if (Order < 0)
+            Low = Middle + 1;
+        else
+            High = Middle;
+    }
+
+    return PLAN_CACHE_NONE;
+}
+
+/**
+ * Restore the cached plan of an entry
+ */
+EFI_STATUS PlanCacheRestore(
+    PLAN_CACHE *Cache,
+    UINTN Entry,
+    VOID *ImageBase,
+    UINTN ImageSize,
+    PATCH_PLAN *Plan)
+{
+    PLAN_CACHE_ENTRY *CacheEntry;
+    PATCH_RECORD *Records;
+    UINT8 *Image = (UINT8 *)ImageBase;
+    UINTN Index;
+
+    if (Entry >= Cache->EntryCount)
+        return EFI_INVALID_PARAMETER;
+
+    CacheEntry = &Cache->Entries[Entry];
+    Records = &Cache->Records[CacheEntry->FirstRecord];
+
+    // Either the original or the patched bytes must be there (a second run in one boot)
+    for (Index = 0; Index < CacheEntry->RecordCount; Index++)
+    {
+        PATCH_RECORD *Record = &Records[Index];
+
+        if (Record->Length == 0 || Record->Length > PATCH_RECORD_MAX_BYTES ||
+            Record->Offset > ImageSize || Record->Length > ImageSize - Record->Offset ||
+            (CompareMem(&Image[Record->Offset], Record->OldBytes, Record->Length) != 0 &&
+             CompareMem(&Image[Record->Offset], Record->NewBytes, Record->Length) != 0))
+            return EFI_VOLUME_CORRUPTED;
+    }
+
+    CacheEntry->Flags |= PLAN_CACHE_ENTRY_LIVE;
+    Cache->Hits++;
+
+    for (Index = 0; Index < CacheEntry->RecordCount; Index++)
+    {
+        PATCH_RECORD *Record = &Records[Index];
+        PatchPlanAdd(Plan, Record->Offset, Record->OldBytes, Record->NewBytes, Record->Length,
+                     (PATCH_REASON)Record->Reason);
+    }
+
+    return CacheEntry->RecordCount > 0 ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+/**
+ * Helper: Make room for one more entry and Count more records
+ */
+STATIC BOOLEAN PlanCacheReserve(PLAN_CACHE *Cache, UINTN Count)
+{
+    if (Cache->EntryCount == Cache->EntryCapacity)
+    {
+        UINTN NewCapacity = Cache->EntryCapacity == 0 ? PLAN_CACHE_INITIAL_ENTRIES : Cache->EntryCapacity * 2;
+        PLAN_CACHE_ENTRY *NewEntries = TaggedAllocatePool(POOL_TAG_PATCH, NewCapacity * sizeof(PLAN_CACHE_ENTRY));
+
+        if (NewEntries == NULL)
+            return FALSE;
+
+        if (Cache->Entries != NULL)
+        {
+            CopyMem(NewEntries, Cache->Entries, Cache->EntryCount * sizeof(PLAN_CACHE_ENTRY));
+            TaggedFreePool(Cache->Entries);
+        }
+
+        Cache->Entries = NewEntries;
+        Cache->EntryCapacity = NewCapacity;
+    }
+
+    if (Cache->RecordCapacity - Cache->RecordCount < Count)
+    {
+        UINTN NewCapacity = Cache->RecordCapacity == 0 ? PLAN_CACHE_INITIAL_RECORDS : Cache->RecordCapacity * 2;
+        PATCH_RECORD *NewRecords;
+
+        while (NewCapacity - Cache->RecordCount < Count)
+            NewCapacity *= 2;
+
+        NewRecords = TaggedAllocatePool(POOL_TAG_PATCH, NewCapacity * sizeof(PATCH_RECORD));
+        if (NewRecords == NULL)
+            return FALSE;
+
+        if (Cache->Records != NULL)
+        {
+            CopyMem(NewRecords, Cache->Records, Cache->RecordCount * sizeof(PATCH_RECORD));
+            TaggedFreePool(Cache->Records);
+        }
+
+        Cache->Records = NewRecords;
+        Cache->RecordCapacity = NewCapacity;
+    }
+
+    return TRUE;
+}
+
+/**
+ * Record the writes made to a scanned module
+ *
+ * Every module that gets here was scanned, because it had no entry or a
+ * stale one, so this is where misses are counted.
+ */
+EFI_STATUS PlanCacheStore(PLAN_CACHE *Cache, CONST UINT8 *Hash, UINTN ImageSize, PATCH_PLAN *Plan)
+{
+    PLAN_CACHE_ENTRY *Entry;
+    UINTN Count = 0;
+    UINTN Index;
+
+    if (Cache->HashContext == NULL || ImageSize > MAX_UINT32)
+        return EFI_INVALID_PARAMETER;
+
+    // Planned records a pass got to first were never written
+    for (Index = 0; Plan != NULL && Index < Plan->Count; Index++)
+    {
+        if ((Plan->Records[Index].Flags & PATCH_RECORD_APPLIED) != 0)
+            Count++;
+    }
+
+    Cache->Misses++;
+
+    if (!PlanCacheReserve(Cache, Count))
+        return EFI_OUT_OF_RESOURCES;
+
+    Entry = &Cache->Entries[Cache->EntryCount++];
+    CopyMem(Entry->Hash, Hash, PLAN_CACHE_HASH_SIZE);
+    Entry->ImageSize = (UINT32)ImageSize;
+    Entry->FirstRecord = (UINT32)Cache->RecordCount;
+    Entry->RecordCount = (UINT32)Count;
+    Entry->Flags = PLAN_CACHE_ENTRY_LIVE;
+
+    for (Index = 0; Count > 0 && Index < Plan->Count; Index++)
+    {
+        PATCH_RECORD *Record;
+
+        if ((Plan->Records[Index].Flags & PATCH_RECORD_APPLIED) == 0)
+            continue;
+
+        Record = &Cache->Records[Cache->RecordCount++];
+        CopyMem(Record, &Plan->Records[Index], sizeof(PATCH_RECORD));
+        Record->Flags = 0;
+    }
+
+    Cache->Dirty = TRUE;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Write the live entries back if anything changed
+ *
+ * Entries of modules that were not seen this run are dropped, so the file
+ * only ever describes the current firmware.
+ */
+EFI_STATUS PlanCacheSave(PLAN_CACHE *Cache, EFI_HANDLE ImageHandle)
+{
+    EFI_STATUS Status;
+    PLAN_CACHE_HEADER *Header;
+    PLAN_CACHE_ENTRY *Entries;
+    PATCH_RECORD *Records;
+    EFI_FILE *File;
+    UINT8 *Buffer;
+    UINTN LiveCount = 0;
+    UINTN RecordCount = 0;
+    UINTN Size;
+    UINTN Index;
+
+    for (Index = 0; Index < Cache->EntryCount; Index++)
+    {
+        if ((Cache->Entries[Index].Flags & PLAN_CACHE_ENTRY_LIVE) != 0)
+        {
+            LiveCount++;
+            RecordCount += Cache->Entries[Index].RecordCount;
+        }
+    }
+
+    if (!Cache->Dirty && LiveCount == Cache->EntryCount)
+        return EFI_SUCCESS;
+
+    Size = sizeof(PLAN_CACHE_HEADER) + LiveCount * sizeof(PLAN_CACHE_ENTRY) + RecordCount * sizeof(PATCH_RECORD);
+    Buffer = TaggedAllocateZeroPool(POOL_TAG_PATCH, Size);
+    if (Buffer == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    Header = (PLAN_CACHE_HEADER *)Buffer;
+    Entries = (PLAN_CACHE_ENTRY *)(Header + 1);
+    Records = (PATCH_RECORD *)&Entries[LiveCount];
+
+    Header->Signature = PLAN_CACHE_SIGNATURE;
+    Header->Version = PLAN_CACHE_VERSION;
+    CopyMem(Header->FirmwareId, Cache->FirmwareId, PLAN_CACHE_HASH_SIZE);
+    Header->EntryCount = (UINT32)LiveCount;
+    Header->RecordCount = (UINT32)RecordCount;
+
+    // Insertion sort by hash: loaded entries are already in order
+    LiveCount = 0;
+    for (Index = 0; Index < Cache->EntryCount; Index++)
+    {
+        PLAN_CACHE_ENTRY *Entry = &Cache->Entries[Index];
+        UINTN Slot = LiveCount;
+
+        if ((Entry->Flags & PLAN_CACHE_ENTRY_LIVE) == 0)
+            continue;
+
+        while (Slot > 0 && CompareMem(Entries[Slot - 1].Hash, Entry->Hash, PLAN_CACHE_HASH_SIZE) > 0)
+        {
+            CopyMem(&Entries[Slot], &Entries[Slot - 1], sizeof(PLAN_CACHE_ENTRY));
+            Slot--;
+        }
+
+        CopyMem(&Entries[Slot], Entry, sizeof(PLAN_CACHE_ENTRY));
+        LiveCount++;
+    }
+
+    // Pack the records behind the sorted entries
+    RecordCount = 0;
+    for (Index = 0; Index < LiveCount; Index++)
+    {
+        CopyMem(&Records[RecordCount], &Cache->Records[Entries[Index].FirstRecord],
+                Entries[Index].RecordCount * sizeof(PATCH_RECORD));
+        Entries[Index].FirstRecord = (UINT32)RecordCount;
+        Entries[Index].Flags = 0;
+        RecordCount += Entries[Index].RecordCount;
+    }
+
+    // Delete and recreate, the file protocol cannot truncate on open
+    Status = PlanCacheOpenFile(ImageHandle, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+    if (!EFI_ERROR(Status))
+        File->Delete(File);
+
+    Status = PlanCacheOpenFile(ImageHandle, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, &File);
+    if (!EFI_ERROR(Status))
+    {
+        Status = File->Write(File, &Size, Buffer);
+        File->Close(File);
+    }
+
+    AsciiSPrint(Log, 512, "Saved plan cache: %d modules, %d patches (%r)\n\r", LiveCount, RecordCount, Status);
+    LogToFile(LogFile, Log);
+
+    TaggedFreePool(Buffer);
+    if (!EFI_ERROR(Status))
+        Cache->Dirty = FALSE;
+    return Status;
+}
+
+/**
+ * Free a cache
+ */
+VOID PlanCacheFree(PLAN_CACHE *Cache)
+{
+    if (Cache->Entries != NULL)
+        TaggedFreePool(Cache->Entries);
+    if (Cache->Records != NULL)
+        TaggedFreePool(Cache->Records);
+    if (Cache->HashContext != NULL)
+        TaggedFreePool(Cache->HashContext);
+
+    ZeroMem(Cache, sizeof(PLAN_CACHE));
+}
@@ -0,0 +1,148 @@
+#pragma once
+#include <Uefi.h>
+#include "BiosDetector.h"
+#include "PatchPlan.h"
+
+// Cache file, next to the log on the volume SREP was started from
+#define PLAN_CACHE_FILE_NAME L"SREP.cache"
+
+// SHA-256 digest size, used for module and firmware identities
+#define PLAN_CACHE_HASH_SIZE 32
+
+// PlanCacheFind result when a module has no entry
+#define PLAN_CACHE_NONE MAX_UINTN
+
+// One cached module
+typedef struct {
+    UINT8 Hash[PLAN_CACHE_HASH_SIZE];   // PlanCacheHashImage of the module
+    UINT32 ImageSize;
+    UINT32 FirstRecord;                 // Index into PLAN_CACHE.Records
+    UINT32 RecordCount;                 // 0: the module has nothing to patch
+    UINT32 Flags;                       // PLAN_CACHE_ENTRY_* (in memory only)
+} PLAN_CACHE_ENTRY;
+
+// PLAN_CACHE_ENTRY.Flags
+#define PLAN_CACHE_ENTRY_LIVE BIT0      // Seen this run; only live entries are saved
+
+// Patch plans of previously scanned modules
+typedef struct {
+    UINT8 FirmwareId[PLAN_CACHE_HASH_SIZE];
+    PLAN_CACHE_ENTRY *Entries;
+    UINTN EntryCount;
+    UINTN EntryCapacity;
+    UINTN LoadedCount;                  // Entries [0, LoadedCount) are sorted by hash
+    PATCH_RECORD *Records;
+    UINTN RecordCount;
+    UINTN RecordCapacity;
+    VOID *HashContext;
+    BOOLEAN Dirty;
+    UINTN Hits;                         // Plans restored by PlanCacheRestore
+    UINTN Misses;                       // Plans stored by PlanCacheStore after a scan
+} PLAN_CACHE;
+
+/**
+ * Load the plan cache of this firmware
+ *
+ * The whole file is read in one call. A missing or damaged file, or one
+ * written under different firmware (vendor, version or revision), leaves an
+ * empty cache so every module is scanned and the file is rewritten.
+ *
+ * @param Cache         Cache to initialize
+ * @param ImageHandle   Image handle of SREP (locates the volume)
+ * @param BiosInfo      Detected BIOS information
+ * @return EFI_SUCCESS if the cache is usable, even if empty
+ * @return EFI_OUT_OF_RESOURCES if the hash context could not be allocated
+ */
+EFI_STATUS PlanCacheLoad(PLAN_CACHE *Cache, EFI_HANDLE ImageHandle, BIOS_INFO *BiosInfo);
+
+/**
+ * Hash a loaded module by the file it was loaded from
+ *
+ * Covers the FFS file GUID, the image size and the raw FFS file (size and
+ * bytes) as stored in the firmware volume, still compressed and before
+ * relocation. The key stays the same when the module is loaded at another
+ * address; a cached plan is still checked against the image before it is
+ * used.
+ *
+ * @param Cache         Loaded cache
+ * @param FileGuid      FFS file name of the module
+ * @param ImageSize     Size of the module image
+ * @param Hash          Receives PLAN_CACHE_HASH_SIZE bytes
+ * @return EFI_SUCCESS, EFI_UNSUPPORTED if the module was not loaded from an FV,
+ *         or EFI_NOT_FOUND if its file is not found or cannot be read
+ */
+EFI_STATUS PlanCacheHashImage(PLAN_CACHE *Cache, CONST EFI_GUID *FileGuid, UINT64 ImageSize, UINT8 *Hash);
+
+/**
+ * Hash a module like PlanCacheHashImage, with a caller SHA-256 context
+ *
+ * @param HashContext   Sha256GetContextSize bytes
+ * @param FileGuid      FFS file name of the module
+ * @param ImageSize     Size of the module image
+ * @param Hash          Receives PLAN_CACHE_HASH_SIZE bytes
+ * @return As PlanCacheHashImage
+ */
+EFI_STATUS PlanCacheHashFile(VOID *HashContext, CONST EFI_GUID *FileGuid, UINT64 ImageSize, UINT8 *Hash);
+
+/**
+ * Find the entry of a module
+ *
+ * @param Cache         Loaded cache
+ * @param Hash          PlanCacheHashImage of the module
+ * @param ImageSize     Size of the module image
+ * @return Entry index, or PLAN_CACHE_NONE
+ */
+UINTN PlanCacheFind(PLAN_CACHE *Cache, CONST UINT8 *Hash, UINTN ImageSize);
+
+/**
+ * Restore the cached plan of an entry
+ *
+ * Every record is checked against the image first. If any original bytes
+ * differ the entry is stale: it is dropped and the module must be rescanned.
+ *
+ * @param Cache         Loaded cache
+ * @param Entry         Index from PlanCacheFind
+ * @param ImageBase     Base address of the module
+ * @param ImageSize     Size of the module image
+ * @param Plan          Empty plan that receives the records
+ * @return EFI_SUCCESS if patches were restored
+ * @return EFI_NOT_FOUND if the module has nothing to patch
+ * @return EFI_VOLUME_CORRUPTED if the entry is stale
+ */
+EFI_STATUS PlanCacheRestore(
+    PLAN_CACHE *Cache,
+    UINTN Entry,
+    VOID *ImageBase,
+    UINTN ImageSize,
+    PATCH_PLAN *Plan);
+
+/**
+ * Record the writes made to a scanned module
+ *
+ * Only records marked PATCH_RECORD_APPLIED are stored, so a later run that
+ * applies the entry writes exactly what this one did.
+ *
+ * @param Cache         Loaded cache
+ * @param Hash          PlanCacheHashImage of the module
+ * @param ImageSize     Size of the module image
+ * @param Plan          Plan PatchModuleImage journaled the writes into,
+ *                      NULL or empty if nothing was patched
+ * @return EFI_SUCCESS or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS PlanCacheStore(PLAN_CACHE *Cache, CONST UINT8 *Hash, UINTN ImageSize, PATCH_PLAN *Plan);
+
+/**
+ * Write the live entries back if anything changed
+ *
+ * @param Cache         Loaded cache
+ * @param ImageHandle   Image handle of SREP (locates the volume)
+ * @return EFI_SUCCESS if written or unchanged, error from the file system otherwise
+ */
+EFI_STATUS PlanCacheSave(PLAN_CACHE *Cache, EFI_HANDLE ImageHandle);
+
+/**
+ * Free a cache
+ *
+ * @param Cache         Cache to free
+ */
+VOID PlanCacheFree(PLAN_CACHE *Cache);
@@ -0,0 +1,257 @@
+#include "Profile.h"
+#include "Constants.h"
+#include "LoadedImageIndex.h"
+#include "TaggedPool.h"
+#include "Trace.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+// Initial module capacity; grown by doubling
+#define PROFILE_INITIAL_MODULES 64
+
+STATIC CONST CHAR8 *mProfilePhaseNames[PROFILE_PHASE_MAX] = {
+    "Phase 1: loaded modules",
+    "Phase 2: Setup dependencies",
+    "Phase 3: vendor patches",
+    "Setup load and start",
+    "HII browser init",
+    "HII form enumeration",
+    "HII dynamic tabs"
+};
+
+PROFILE gProfile;
+
+/**
+ * Measure the time stamp counter against gBS->Stall
+ */
+VOID ProfileInit(EFI_FILE *Root, CONST CHAR16 *FlagFile)
+{
+    EFI_FILE *Flag;
+    UINT64 Start;
+
+    // Without a time stamp counter the frequency stays 0 and ProfileReport logs nothing
+    Start = TraceTicks();
+    if (Start != 0)
+    {
+        gBS->Stall(PROFILE_CALIBRATION_US);
+        gProfile.TscFrequency = DivU64x32(MultU64x32(TraceTicks() - Start, 1000000), PROFILE_CALIBRATION_US);
+    }
+
+    if (!EFI_ERROR(Root->Open(Root, &Flag, (CHAR16 *)FlagFile, EFI_FILE_MODE_READ, 0)))
+    {
+        Flag->Close(Flag);
+        gProfile.OnScreen = TRUE;
+    }
+
+    AsciiSPrint(Log, 512, "Time stamp counter: %ld kHz\n\r", DivU64x32(gProfile.TscFrequency, 1000));
+    LogToFile(LogFile, Log);
+}
+
+/**
+ * Open a span
+ */
+VOID ProfileBegin(PROFILE_SPAN *Span)
+{
+    Span->StartBytes = gProfile.ModuleBytes;
+    Span->Start = TraceTicks();
+}
+
+/**
+ * Close a span and add it to a phase
+ */
+VOID ProfileEndPhase(PROFILE_SPAN *Span, PROFILE_PHASE Phase)
+{
+    PROFILE_PHASE_STATS *Stats = &gProfile.Phases[Phase];
+
+    Stats->Ticks += TraceTicks() - Span->Start;
+    Stats->Bytes += gProfile.ModuleBytes - Span->StartBytes;
+    Stats->Calls++;
+}
+
+/**
+ * Helper: Stats of a module, added on first use; NULL if the table cannot grow
+ */
+STATIC PROFILE_MODULE_STATS *ProfileModule(VOID *ImageBase, UINT64 ImageSize)
+{
+    PROFILE_MODULE_STATS *Stats;
+
+    for (UINTN i = gProfile.ModuleCount; i > 0; i--)
+    {
+        if (gProfile.Modules[i - 1].ImageBase == ImageBase)
+            return &gProfile.Modules[i - 1];
+    }
+
+    if (gProfile.ModuleCount == gProfile.ModuleCapacity)
+    {
+        UINTN NewCapacity = gProfile.ModuleCapacity == 0 ? PROFILE_INITIAL_MODULES : gProfile.ModuleCapacity * 2;
+        PROFILE_MODULE_STATS *NewModules = TaggedAllocatePool(POOL_TAG_OTHER, NewCapacity * sizeof(PROFILE_MODULE_STATS));
+
+        if (NewModules == NULL)
+            return NULL;
+        if (gProfile.Modules != NULL)
+        {
+            CopyMem(NewModules, gProfile.Modules, gProfile.ModuleCount * sizeof(PROFILE_MODULE_STATS));
+            TaggedFreePool(gProfile.Modules);
+        }
+        gProfile.Modules = NewModules;
+        gProfile.ModuleCapacity = NewCapacity;
+    }
+
+    Stats = &gProfile.Modules[gProfile.ModuleCount++];
+    ZeroMem(Stats, sizeof(PROFILE_MODULE_STATS));
+    Stats->ImageBase = ImageBase;
+    Stats->ImageSize = ImageSize;
+    return Stats;
+}
+
+/**
+ * Close a span and add it to a module
+ */
+VOID ProfileEndModule(PROFILE_SPAN *Span, VOID *ImageBase, UINT64 ImageSize, UINT64 Bytes)
+{
+    UINT64 Ticks = TraceTicks() - Span->Start;
+    PROFILE_MODULE_STATS *Stats = ProfileModule(ImageBase, ImageSize);
+
+    gProfile.ModuleBytes += Bytes;
+    if (Stats == NULL)
+        return;
+
+    Stats->Ticks += Ticks;
+    Stats->Bytes += Bytes;
+    Stats->Scans++;
+}
+
+/**
+ * Helper: Ticks in microseconds
+ */
+STATIC UINT64 ProfileMicroseconds(UINT64 Ticks)
+{
+    if (gProfile.TscFrequency == 0)
+        return 0;
+
+    return DivU64x64Remainder(MultU64x32(Ticks, 1000000), gProfile.TscFrequency, NULL);
+}
+
+/**
+ * Helper: Format one table row: name, count, milliseconds, KB and MB/s
+ */
+STATIC VOID ProfileRow(CHAR8 *Line, UINTN LineSize, CONST CHAR8 *Name, CONST CHAR16 *Name16,
+                       UINTN Count, UINT64 Ticks, UINT64 Bytes)
+{
+    UINT64 Us = ProfileMicroseconds(Ticks);
+    UINT64 MBps = Us != 0 ? DivU64x64Remainder(Bytes, Us, NULL) : 0;
+    UINT32 Fraction;
+    UINT64 Ms = DivU64x32Remainder(Us, 1000, &Fraction);
+
+    if (Name16 != NULL)
+    {
+        AsciiSPrint(Line, LineSize, "  %-28s %5d %8ld.%03d %9ld %7ld\n\r",
+                    Name16, Count, Ms, Fraction, DivU64x32(Bytes, 1024), MBps);
+    }
+    else
+    {
+        AsciiSPrint(Line, LineSize, "  %-28a %5d %8ld.%03d %9ld %7ld\n\r",
+                    Name, Count, Ms, Fraction, DivU64x32(Bytes, 1024), MBps);
+    }
+}
+
+/**
+ * Helper: Send one line to the chosen destinations
+ */
+STATIC VOID ProfileEmit(CHAR8 *Line, UINT32 Destinations)
+{
+    if ((Destinations & PROFILE_REPORT_LOG) != 0)
+        LogToFile(LogFile, Line);
+    if ((Destinations & PROFILE_REPORT_SCREEN) != 0)
+        Print(L"%a", Line);
+}
+
+/**
+ * Print the phase table and the slowest modules
+ */
+VOID ProfileReport(UINT32 Destinations)
+{
+    CHAR8 Line[LOG_BUFFER_SIZE];
+    BOOLEAN *Listed = NULL;
+
+    if (!gProfile.OnScreen)
+        Destinations &= ~PROFILE_REPORT_SCREEN;
+    if (Destinations == 0 || gProfile.TscFrequency == 0)
+        return;
+
+    AsciiSPrint(Line, sizeof(Line), "\n=== Timing (TSC %ld MHz) ===\n\r", DivU64x32(gProfile.TscFrequency, 1000000));
+    ProfileEmit(Line, Destinations);
+    AsciiSPrint(Line, sizeof(Line), "  %-28a %5a %12a %9a %7a\n\r", "Phase", "Calls", "ms", "KB", "MB/s");
+    ProfileEmit(Line, Destinations);
+
+    for (UINTN i = 0; i < PROFILE_PHASE_MAX; i++)
+    {
+        PROFILE_PHASE_STATS *Stats = &gProfile.Phases[i];
+
+        if (Stats->Calls == 0)
+            continue;
+        ProfileRow(Line, sizeof(Line), mProfilePhaseNames[i], NULL, Stats->Calls, Stats->Ticks, Stats->Bytes);
+        ProfileEmit(Line, Destinations);
+    }
+
+    if (gProfile.ModuleCount == 0)
+        return;
+
+    // Images loaded by the phases (Setup and its dependencies) are named too
+    LoadedImageIndexRefresh(&gLoadedImageIndex);
+    Listed = TaggedAllocateZeroPool(POOL_TAG_OTHER, gProfile.ModuleCount * sizeof(BOOLEAN));
+    if (Listed == NULL)
+        return;
+
+    AsciiSPrint(Line, sizeof(Line), "  %-28a %5a %12a %9a %7a\n\r", "Slowest modules", "Scans", "ms", "KB", "MB/s");
+    ProfileEmit(Line, Destinations);
+
+    for (UINTN n = 0; n < PROFILE_TOP_MODULES && n < gProfile.ModuleCount; n++)
+    {
+        PROFILE_MODULE_STATS *Stats;
+        CONST LOADED_IMAGE_ENTRY *Image;
+        CHAR8 Unnamed[32];
+        UINTN Slowest = MAX_UINTN;
+
+        for (UINTN i = 0; i < gProfile.ModuleCount; i++)
+        {
+            if (!Listed[i] && (Slowest == MAX_UINTN || gProfile.Modules[i].Ticks > gProfile.Modules[Slowest].Ticks))
+                Slowest = i;
+        }
+        Listed[Slowest] = TRUE;
+        Stats = &gProfile.Modules[Slowest];
+
+        Image = LoadedImageIndexFindByBase(&gLoadedImageIndex, Stats->ImageBase);
+        AsciiSPrint(Unnamed, sizeof(Unnamed), "image at 0x%lx", (UINT64)(UINTN)Stats->ImageBase);
+        ProfileRow(Line, sizeof(Line), Unnamed, Image != NULL ? Image->Name : NULL,
+                   Stats->Scans, Stats->Ticks, Stats->Bytes);
+        ProfileEmit(Line, Destinations);
+    }
+
+    AsciiSPrint(Line, sizeof(Line), "  %d modules, %ld KB scanned\n\r", gProfile.ModuleCount,
+                DivU64x32(gProfile.ModuleBytes, 1024));
+    ProfileEmit(Line, Destinations);
+
+    TaggedFreePool(Listed);
+}
+
+/**
+ * Free the module table; the phase totals are kept
+ */
+VOID ProfileFree(VOID)
+{
+    if (gProfile.Modules != NULL)
+        TaggedFreePool(gProfile.Modules);
+
+    gProfile.Modules = NULL;
+    gProfile.ModuleCount = 0;
+    gProfile.ModuleCapacity = 0;
+}
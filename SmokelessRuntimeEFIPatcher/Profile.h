@@ -0,0 +1,108 @@
+#pragma once
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+// Stall used to measure the time stamp counter frequency
+#define PROFILE_CALIBRATION_US 10000
+
+// Slowest modules listed in the summary
+#define PROFILE_TOP_MODULES 10
+
+// Timed stages of a run
+typedef enum {
+    PROFILE_PHASE_LOADED_MODULES = 0,    // AutoPatchBios phase 1
+    PROFILE_PHASE_SETUP_DEPENDENCIES,    // Phase 2
+    PROFILE_PHASE_VENDOR,                // Phase 3
+    PROFILE_PHASE_SETUP_BROWSER,         // Loading, patching and starting Setup (not the UI session)
+    PROFILE_PHASE_HII_INIT,              // HiiBrowserInitialize
+    PROFILE_PHASE_HII_ENUMERATE,         // HiiBrowserEnumerateForms
+    PROFILE_PHASE_HII_TABS,              // HiiBrowserCreateDynamicTabs
+    PROFILE_PHASE_MAX
+} PROFILE_PHASE;
+
+// ProfileReport destinations
+#define PROFILE_REPORT_LOG      BIT0
+#define PROFILE_REPORT_SCREEN   BIT1     // Only if the profile flag file was present
+
+// An open span; lives on the caller's stack between ProfileBegin and ProfileEnd*
+typedef struct {
+    UINT64 Start;                // Time stamp counter
+    UINT64 StartBytes;           // Module bytes scanned before the span
+} PROFILE_SPAN;
+
+// Time and bytes of one phase
+typedef struct {
+    UINTN Calls;
+    UINT64 Ticks;
+    UINT64 Bytes;                // Bytes scanned by the modules patched inside the phase
+} PROFILE_PHASE_STATS;
+
+// Time and bytes of one module, by load address
+typedef struct {
+    VOID *ImageBase;
+    UINT64 ImageSize;
+    UINTN Scans;
+    UINT64 Ticks;
+    UINT64 Bytes;
+} PROFILE_MODULE_STATS;
+
+// Timings of a run
+typedef struct {
+    UINT64 TscFrequency;         // Ticks per second, 0 before ProfileInit and off IA32/X64
+    BOOLEAN OnScreen;            // The profile flag file was present
+    PROFILE_PHASE_STATS Phases[PROFILE_PHASE_MAX];
+    PROFILE_MODULE_STATS *Modules;
+    UINTN ModuleCount;
+    UINTN ModuleCapacity;
+    UINT64 ModuleBytes;          // Sum of all module bytes scanned
+} PROFILE;
+
+extern PROFILE gProfile;
+
+/**
+ * Measure the time stamp counter against gBS->Stall
+ *
+ * Takes PROFILE_CALIBRATION_US. The flag file asks for the summary to be
+ * shown on screen as well.
+ *
+ * @param Root          Directory holding the flag file
+ * @param FlagFile      Name of the profile flag file
+ */
+VOID ProfileInit(EFI_FILE *Root, CONST CHAR16 *FlagFile);
+
+/**
+ * Open a span
+ *
+ * @param Span          Span to start
+ */
+VOID ProfileBegin(PROFILE_SPAN *Span);
+
+/**
+ * Close a span and add it to a phase, with the module bytes scanned meanwhile
+ *
+ * @param Span          Span opened by ProfileBegin
+ * @param Phase         Phase to charge
+ */
+VOID ProfileEndPhase(PROFILE_SPAN *Span, PROFILE_PHASE Phase);
+
+/**
+ * Close a span and add it to a module
+ *
+ * @param Span          Span opened by ProfileBegin
+ * @param ImageBase     Load address of the module
+ * @param ImageSize     Size of the module
+ * @param Bytes         Bytes scanned during the span
+ */
+VOID ProfileEndModule(PROFILE_SPAN *Span, VOID *ImageBase, UINT64 ImageSize, UINT64 Bytes);
+
+/**
+ * Print the phase table and the slowest modules
+ *
+ * @param Destinations  PROFILE_REPORT_* flags
+ */
+VOID ProfileReport(UINT32 Destinations);
+
+/**
+ * Free the module table; the phase totals are kept
+ */
+VOID ProfileFree(VOID);
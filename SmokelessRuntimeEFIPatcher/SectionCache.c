@@ -0,0 +1,143 @@
+#include "SectionCache.h"
+#include "TaggedPool.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+SECTION_CACHE gSectionCache;
+
+/**
+ * Helper: Find a cached section
+ */
+STATIC SECTION_CACHE_ENTRY *SectionCacheLookup(SECTION_CACHE *Cache, CONST EFI_GUID *FileGuid, EFI_SECTION_TYPE SectionType)
+{
+    // A session caches a handful of modules; a linear scan is enough
+    for (UINTN i = 0; i < Cache->Count; i++)
+    {
+        if (Cache->Entries[i].SectionType == SectionType && CompareGuid(&Cache->Entries[i].FileGuid, FileGuid))
+            return &Cache->Entries[i];
+    }
+    return NULL;
+}
+
+/**
+ * Helper: Drop least recently used sections until Incoming more bytes fit
+ */
+STATIC VOID SectionCacheEvict(SECTION_CACHE *Cache, UINTN Incoming)
+{
+    while (Cache->Count > 0 && Cache->Bytes + Incoming > Cache->Budget)
+    {
+        UINTN Oldest = 0;
+
+        for (UINTN i = 1; i < Cache->Count; i++)
+        {
+            if (Cache->Entries[i].LastUse < Cache->Entries[Oldest].LastUse)
+                Oldest = i;
+        }
+
+        Cache->Bytes -= Cache->Entries[Oldest].Size;
+        FreePool(Cache->Entries[Oldest].Data);
+        Cache->Entries[Oldest] = Cache->Entries[--Cache->Count];
+        Cache->Evictions++;
+    }
+}
+
+/**
+ * Helper: Make room for one more entry
+ */
+STATIC EFI_STATUS SectionCacheGrow(SECTION_CACHE *Cache)
+{
+    SECTION_CACHE_ENTRY *Entries;
+    UINTN Capacity;
+
+    if (Cache->Count < Cache->Capacity)
+        return EFI_SUCCESS;
+
+    Capacity = Cache->Capacity == 0 ? 8 : Cache->Capacity * 2;
+    Entries = TaggedReallocatePool(POOL_TAG_FV, Cache->Capacity * sizeof(SECTION_CACHE_ENTRY),
+                                   Capacity * sizeof(SECTION_CACHE_ENTRY), Cache->Entries);
+    if (Entries == NULL)
+        return EFI_OUT_OF_RESOURCES;
+
+    Cache->Entries = Entries;
+    Cache->Capacity = Capacity;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS SectionCacheRead(
+    SECTION_CACHE *Cache,
+    CONST FV_FILE_ENTRY *File,
+    EFI_SECTION_TYPE SectionType,
+    CONST VOID **Data,
+    UINTN *Size)
+{
+    EFI_STATUS Status;
+    SECTION_CACHE_ENTRY *Entry;
+    VOID *Buffer = NULL;
+    UINTN BufferSize = 0;
+    UINT32 AuthenticationStatus;
+
+    if (Cache == NULL || File == NULL || Data == NULL || Size == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    if (Cache->Budget == 0)
+        Cache->Budget = SECTION_CACHE_DEFAULT_BUDGET;
+
+    // Nothing to decompress: point into flash
+    if (!EFI_ERROR(FvFileIndexMapSection(File, SectionType, Data, Size)))
+    {
+        Cache->Mapped++;
+        return EFI_SUCCESS;
+    }
+
+    Entry = SectionCacheLookup(Cache, &File->FileGuid, SectionType);
+    if (Entry != NULL)
+    {
+        Entry->LastUse = ++Cache->Clock;
+        Cache->Hits++;
+        *Data = Entry->Data;
+        *Size = Entry->Size;
+        return EFI_SUCCESS;
+    }
+
+    Cache->Misses++;
+    Status = FvFileIndexReadSection(File, SectionType, &Buffer, &BufferSize, &AuthenticationStatus);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    SectionCacheEvict(Cache, BufferSize);
+    Status = SectionCacheGrow(Cache);
+    if (EFI_ERROR(Status))
+    {
+        FreePool(Buffer);
+        return Status;
+    }
+
+    Entry = &Cache->Entries[Cache->Count++];
+    CopyGuid(&Entry->FileGuid, &File->FileGuid);
+    Entry->SectionType = SectionType;
+    Entry->Data = Buffer;
+    Entry->Size = BufferSize;
+    Entry->LastUse = ++Cache->Clock;
+    Cache->Bytes += BufferSize;
+
+    *Data = Buffer;
+    *Size = BufferSize;
+    return EFI_SUCCESS;
+}
+
+VOID SectionCacheFree(SECTION_CACHE *Cache)
+{
+    if (Cache == NULL)
+        return;
+
+    for (UINTN i = 0; i < Cache->Count; i++)
+        FreePool(Cache->Entries[i].Data);
+
+    if (Cache->Entries != NULL)
+        TaggedFreePool(Cache->Entries);
+    Cache->Entries = NULL;
+    Cache->Count = 0;
+    Cache->Capacity = 0;
+    Cache->Bytes = 0;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <Uefi.h>
+#include "FvFileIndex.h"
+
+// Decompressed bytes kept across LoadFV calls by default
+#define SECTION_CACHE_DEFAULT_BUDGET SIZE_16MB
+
+// One section read from a firmware volume (decompressed if it was encoded)
+typedef struct {
+    EFI_GUID FileGuid;
+    EFI_SECTION_TYPE SectionType;
+    VOID *Data;                  // Pool buffer from ReadSection (owned)
+    UINTN Size;
+    UINT64 LastUse;              // SECTION_CACHE.Clock at the last hit
+} SECTION_CACHE_ENTRY;
+
+// Least recently used sections of compressed FV files, within a byte budget
+typedef struct {
+    SECTION_CACHE_ENTRY *Entries;
+    UINTN Count;
+    UINTN Capacity;
+    UINTN Budget;                // 0: SECTION_CACHE_DEFAULT_BUDGET
+    UINTN Bytes;                 // Sum of the cached section sizes
+    UINT64 Clock;
+    UINTN Hits;
+    UINTN Misses;
+    UINTN Mapped;                // Served in place from a memory-mapped volume
+    UINTN Evictions;
+} SECTION_CACHE;
+
+// Cache of the sections LocateAndLoadFvFromName reads for LoadFV
+extern SECTION_CACHE gSectionCache;
+
+/**
+ * Get a section of an indexed FV file, reading it at most once
+ *
+ * Uncompressed sections of memory-mapped volumes are returned in place.
+ * Anything else is read (and decompressed) through the FV2 protocol once
+ * and kept until it is the least recently used entry and the budget is
+ * exceeded. A section larger than the budget is kept alone until the next
+ * read.
+ *
+ * @param Cache         Section cache
+ * @param File          Indexed file
+ * @param SectionType   Section to get
+ * @param Data          Receives the section; read only, valid until the next
+ *                      SectionCacheRead or SectionCacheFree
+ * @param Size          Receives the section size
+ * @return EFI_SUCCESS, EFI_OUT_OF_RESOURCES, or the ReadSection error
+ */
+EFI_STATUS SectionCacheRead(
+    SECTION_CACHE *Cache,
+    CONST FV_FILE_ENTRY *File,
+    EFI_SECTION_TYPE SectionType,
+    CONST VOID **Data,
+    UINTN *Size);
+
+/**
+ * Free every cached section
+ *
+ * Counters and the budget are kept for the session log.
+ *
+ * @param Cache         Cache to empty
+ */
+VOID SectionCacheFree(SECTION_CACHE *Cache);
@@ -27,129 +27,44 @@
 #include "HiiBrowser.h"
 #include "ConfigManager.h"
 #include "NvramManager.h"
+#include "PatchDb.h"
+#include "LoadedImageIndex.h"
+#include "FvFileIndex.h"
+#include "SectionCache.h"
+#include "FormSetGuids.h"
+#include "PatchScript.h"
+#include "PatchManifest.h"
+#include "Logger.h"
+#include "Trace.h"
+#include "Profile.h"
+#include "TaggedPool.h"
+#include "FwCalls.h"
 
 EFI_BOOT_SERVICES *_gBS = NULL;
 EFI_RUNTIME_SERVICES *_gRS = NULL;
 EFI_FILE *LogFile = NULL;
 char Log[LOG_BUFFER_SIZE];
-enum
-{
-    OFFSET = 1,
-    PATTERN,
-    REL_NEG_OFFSET,
-    REL_POS_OFFSET
-};
-
-enum OPCODE
-{
-    NO_OP,
-    LOADED,
-    LOAD_FS,
-    LOAD_FV,
-    PATCH,
-    EXEC
-};
-
-struct OP_DATA
-{
-    enum OPCODE ID;
-    CHAR8 *Name;
-    BOOLEAN Name_Dyn_Alloc;
-    UINT64 PatterType;
-    BOOLEAN PatterType_Dyn_Alloc;
-    INT64 ARG3;
-    BOOLEAN ARG3_Dyn_Alloc;
-    UINT64 ARG4;
-    BOOLEAN ARG4_Dyn_Alloc;
-    UINT64 ARG5;
-    BOOLEAN ARG5_Dyn_Alloc;
-    UINT64 ARG6;
-    BOOLEAN ARG6_Dyn_Alloc;
-    UINT64 ARG7;
-    BOOLEAN ARG7_Dyn_Alloc;
-    struct OP_DATA *next;
-    struct OP_DATA *prev;
-};
 
 
+// Buffered by the logger; the file is written in large chunks, not per line
 void LogToFile( EFI_FILE *LogFile, char *String)
 {
-        UINTN Size = AsciiStrLen(String);
-        LogFile->Write(LogFile,&Size,String);
-        LogFile->Flush(LogFile);
+        LoggerWrite(LOG_LEVEL_INFO, String, AsciiStrLen(String));
 }
 
 
-VOID Add_OP_CODE(struct OP_DATA *Start, struct OP_DATA *opCode)
-{
-    struct OP_DATA *next = Start;
-    while (next->next != NULL)
-    {
-        next = next->next;
-    }
-    next->next = opCode;
-    opCode->prev = next;
-}
-
-VOID PrintOPChain(struct OP_DATA *Start)
+VOID PrintDump(UINT16 Size, UINT8 *DUMP)
 {
-    struct OP_DATA *next = Start;
-    while (next != NULL)
+    for (UINT16 i = 0; i < Size; i += 0x10)
     {
-        AsciiSPrint(Log,512,"%a","OPCODE : ");
-        LogToFile(LogFile,Log);
-        switch (next->ID)
-        {
-        case NO_OP:
-            AsciiSPrint(Log,512,"%a","NOP\n\r");
-            LogToFile(LogFile,Log);
-            break;
-        case LOADED:
-            AsciiSPrint(Log,512,"%a","LOADED\n\r");
-            LogToFile(LogFile,Log);
-            break;
-        case LOAD_FS:
-            AsciiSPrint(Log,512,"%a","LOAD_FS\n\r");
-            LogToFile(LogFile,Log);
-            AsciiSPrint(Log,512,"%a","\t FileName %a\n\r", next->Name);
-            LogToFile(LogFile,Log);
-            break;
-        case LOAD_FV:
-            AsciiSPrint(Log,512,"%a","LOAD_FV\n\r");
-            LogToFile(LogFile,Log);
-            AsciiSPrint(Log,512,"%a","\t FileName %a\n\r", next->Name);
-            LogToFile(LogFile,Log);
-            break;
-        case PATCH:
-            AsciiSPrint(Log,512,"%a","PATCH\n\r");
-            LogToFile(LogFile,Log);
-            break;
-        case EXEC:
-            AsciiSPrint(Log,512,"%a","EXEC\n\r");
-            LogToFile(LogFile,Log);
-            break;
+        CHAR8 Line[3 * 0x10 + 4];
+        UINTN Length = AsciiSPrint(Line, sizeof(Line), "\t");
 
-        default:
-            break;
-        }
-        next = next->next;
-    }
-}
+        for (UINT16 j = i; j < Size && j < i + 0x10; j++)
+            Length += AsciiSPrint(&Line[Length], sizeof(Line) - Length, "%02x ", DUMP[j]);
 
-VOID PrintDump(UINT16 Size, UINT8 *DUMP)
-{
-    for (UINT16 i = 0; i < Size; i++)
-    {
-        if (i % 0x10 == 0)
-        {
-            AsciiSPrint(Log,512,"%a","\n\t");
-            LogToFile(LogFile,Log);
-        }
-        AsciiSPrint(Log,512,"%02x ", DUMP[i]);
-        LogToFile(LogFile,Log);
+        SREP_LOG(LOG_LEVEL_DEBUG, "%a\n", Line);
     }
-    AsciiSPrint(Log,512,"%a","\n\t");
-    LogToFile(LogFile,Log);
 }
 
 
@@ -176,9 +91,10 @@ EFI_STATUS CreateBiosStyleTabbedMenu(SREP_CONTEXT *SrepCtx)
 {
     EFI_STATUS Status;
     MENU_CONTEXT *MenuCtx = SrepCtx->MenuContext;
+    PROFILE_SPAN Span;
     
     // Allocate HiiCtx dynamically so it persists
-    HII_BROWSER_CONTEXT *HiiCtx = AllocateZeroPool(sizeof(HII_BROWSER_CONTEXT));
+    HII_BROWSER_CONTEXT *HiiCtx = TaggedAllocateZeroPool(POOL_TAG_HII, sizeof(HII_BROWSER_CONTEXT));
     if (HiiCtx == NULL)
     {
         Print(L"Failed to allocate HII browser context\n");
@@ -188,11 +104,13 @@ EFI_STATUS CreateBiosStyleTabbedMenu(SREP_CONTEXT *SrepCtx)
     Print(L"\n=== Extracting Real BIOS Forms ===\n");
     
     // Initialize HII browser to extract forms
+    ProfileBegin(&Span);
     Status = HiiBrowserInitialize(HiiCtx);
+    ProfileEndPhase(&Span, PROFILE_PHASE_HII_INIT);
     if (EFI_ERROR(Status))
     {
         Print(L"Failed to initialize HII browser: %r\n", Status);
-        FreePool(HiiCtx);
+        TaggedFreePool(HiiCtx);
         return Status;
     }
     
@@ -202,23 +120,27 @@ EFI_STATUS CreateBiosStyleTabbedMenu(SREP_CONTEXT *SrepCtx)
     MenuCtx->UserData = (VOID *)HiiCtx;
     
     // Enumerate and parse real BIOS forms
+    ProfileBegin(&Span);
     Status = HiiBrowserEnumerateForms(HiiCtx);
+    ProfileEndPhase(&Span, PROFILE_PHASE_HII_ENUMERATE);
     if (EFI_ERROR(Status))
     {
         Print(L"Failed to enumerate BIOS forms: %r\n", Status);
         HiiBrowserCleanup(HiiCtx);
-        FreePool(HiiCtx);
+        TaggedFreePool(HiiCtx);
         MenuCtx->UserData = NULL;
         return Status;
     }
     
     // Create dynamic tabs based on extracted forms
+    ProfileBegin(&Span);
     Status = HiiBrowserCreateDynamicTabs(HiiCtx, MenuCtx);
+    ProfileEndPhase(&Span, PROFILE_PHASE_HII_TABS);
     if (EFI_ERROR(Status))
     {
         Print(L"Failed to create dynamic tabs: %r\n", Status);
         HiiBrowserCleanup(HiiCtx);
-        FreePool(HiiCtx);
+        TaggedFreePool(HiiCtx);
         MenuCtx->UserData = NULL;
         return Status;
     }
@@ -229,6 +151,25 @@ EFI_STATUS CreateBiosStyleTabbedMenu(SREP_CONTEXT *SrepCtx)
     return EFI_SUCCESS;
 }
 
+/**
+ * Free the signature database and the indexes and caches built this session
+ */
+STATIC VOID ReleaseSessionData(VOID)
+{
+    PatchDbUnload(&gPatchDb);
+    PatchManifestFree(&gPatchManifest);
+    ProfileFree();
+    SectionCacheFree(&gSectionCache);
+    FormSetGuidSetFree(&gFormSetGuids);
+    LoadedImageIndexFree(&gLoadedImageIndex);
+    FvFileIndexFree(&gFvFileIndex);
+
+    FwCallsReport();
+
+    // Whatever is still allocated now is leaked by the session
+    TaggedPoolReport(TRUE);
+}
+
 /**
  * Main entry point - Direct BIOS Editor Launch
  */
@@ -240,6 +181,7 @@ EFI_STATUS EFIAPI SREPEntry(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *Syst
     EFI_FILE *Root;
     SREP_CONTEXT SrepCtx;
     MENU_CONTEXT MenuCtx;
+    PATCH_SCRIPT Script;
     
     Print(L"Welcome to SREP (Smokeless Runtime EFI Patcher) %s\n\r", SREP_VERSION_STRING);
     Print(L"AMI BIOS Configuration Editor\n\r");
@@ -278,11 +220,91 @@ EFI_STATUS EFIAPI SREPEntry(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *Syst
         Root->Close(Root);
         return Status;
     }
+    LoggerInit(LogFile);
     
     AsciiSPrint(Log, LOG_BUFFER_SIZE, "Welcome to SREP (Smokeless Runtime EFI Patcher) %s\n\r", SREP_VERSION_STRING);
     LogToFile(LogFile, Log);
     AsciiSPrint(Log, LOG_BUFFER_SIZE, "AMI BIOS Configuration Editor - Direct Launch Mode\n\r");
     LogToFile(LogFile, Log);
+
+    // Time stamp counter rate for the timing summary and the trace
+    ProfileInit(Root, PROFILE_FLAG_FILE);
+
+    // Binary event trace (SREP.trace) when the trace flag file exists; closed with the log
+    (VOID)TraceOpen(Root, TRACE_FLAG_FILE, gProfile.TscFrequency);
+
+    // Counts and latencies of the firmware services when their flag file exists
+    (VOID)FwCallsOpen(Root, FWCALLS_FLAG_FILE, gProfile.TscFrequency);
+    
+    // Board data: falls back to the built-in module and variable lists without it
+    Status = PatchDbLoad(&gPatchDb, Root);
+    if (!EFI_ERROR(Status))
+    {
+        AsciiSPrint(Log, LOG_BUFFER_SIZE, "Loaded signature database: %d modules, %d patterns, %d variables\n\r",
+                    gPatchDb.Header->Modules.Count, gPatchDb.Header->Patterns.Count, gPatchDb.Header->Variables.Count);
+    }
+    else
+    {
+        AsciiSPrint(Log, LOG_BUFFER_SIZE, "No signature database (%r), using built-in lists\n\r", Status);
+    }
+    LogToFile(LogFile, Log);
+    
+    // Manual mode: a patch script on the volume replaces the editor
+    Status = PatchScriptLoad(&Script, Root);
+    if (Status != EFI_NOT_FOUND)
+    {
+        if (!EFI_ERROR(Status))
+        {
+            AsciiSPrint(Log, LOG_BUFFER_SIZE, "\n=== MANUAL MODE: %d ops on %d modules ===\n\r",
+                        Script.OpCount, Script.ModuleCount);
+            LogToFile(LogFile, Log);
+            Status = PatchScriptRun(&Script, ImageHandle, NULL);
+            PatchScriptFree(&Script);
+        }
+        AsciiSPrint(Log, LOG_BUFFER_SIZE, "Manual mode finished: %r\n\r", Status);
+        LogToFile(LogFile, Log);
+        Print(L"Manual mode finished: %r\n\r", Status);
+        ReleaseSessionData();
+        LoggerClose();
+        Root->Close(Root);
+        return Status;
+    }
+
+    // Plan-only run (flag file) or apply-only run (saved manifest) of the automatic patcher
+    Status = PatchManifestOpen(&gPatchManifest, Root, PLAN_MODE_FLAG_FILE);
+    if (Status != EFI_NOT_FOUND)
+    {
+        if (!EFI_ERROR(Status))
+        {
+            BIOS_INFO BiosInfo;
+            BOOLEAN Planning = gPatchManifest.Mode == PATCH_MANIFEST_PLAN;
+
+            if (Planning)
+            {
+                AsciiSPrint(Log, LOG_BUFFER_SIZE, "\n=== PLAN-ONLY MODE: images are not written ===\n\r");
+            }
+            else
+            {
+                AsciiSPrint(Log, LOG_BUFFER_SIZE, "\n=== APPLY-ONLY MODE: %d modules, %d patches ===\n\r",
+                            gPatchManifest.EntryCount, gPatchManifest.RecordCount);
+            }
+            LogToFile(LogFile, Log);
+
+            Status = DetectBiosType(&BiosInfo);
+            if (!EFI_ERROR(Status))
+                Status = AutoPatchBios(ImageHandle, &BiosInfo);
+            ProfileReport(PROFILE_REPORT_LOG | PROFILE_REPORT_SCREEN);
+            if (Planning)
+                Status = PatchManifestSave(&gPatchManifest, Root);
+        }
+        AsciiSPrint(Log, LOG_BUFFER_SIZE, "Automatic mode finished: %r\n\r", Status);
+        LogToFile(LogFile, Log);
+        Print(L"Automatic mode finished: %r\n\r", Status);
+        ReleaseSessionData();
+        LoggerClose();
+        Root->Close(Root);
+        return Status;
+    }
     
     // Always use BIOS-style interface (direct launch)
     AsciiSPrint(Log, LOG_BUFFER_SIZE, "\n=== BIOS EDITOR MODE: Launching directly ===\n\r");
@@ -293,7 +315,8 @@ EFI_STATUS EFIAPI SREPEntry(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *Syst
     if (EFI_ERROR(Status))
     {
         Print(L"Failed to initialize menu system: %r\n\r", Status);
-        LogFile->Close(LogFile);
+        ReleaseSessionData();
+        LoggerClose();
         Root->Close(Root);
         return Status;
     }
@@ -310,12 +333,16 @@ EFI_STATUS EFIAPI SREPEntry(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *Syst
     if (EFI_ERROR(Status))
     {
         Print(L"Failed to create BIOS interface: %r\n\r", Status);
-        LogFile->Close(LogFile);
+        ReleaseSessionData();
+        LoggerClose();
         Root->Close(Root);
         return Status;
     }
     
     // Run menu loop directly (no StartPage needed with tabs)
+    ProfileReport(PROFILE_REPORT_LOG);
+    TaggedPoolReport(FALSE);
+    LoggerFlush();
     Status = MenuRun(&MenuCtx, NULL);
     
     // Clean up HII browser context if it was allocated
@@ -323,13 +350,20 @@ EFI_STATUS EFIAPI SREPEntry(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *Syst
     {
         HII_BROWSER_CONTEXT *HiiCtx = (HII_BROWSER_CONTEXT *)MenuCtx.UserData;
         HiiBrowserCleanup(HiiCtx);
-        FreePool(HiiCtx);
+        TaggedFreePool(HiiCtx);
         MenuCtx.UserData = NULL;
     }
     
     MenuCleanup(&MenuCtx);
+    ProfileReport(PROFILE_REPORT_SCREEN);
+
+    AsciiSPrint(Log, LOG_BUFFER_SIZE, "Section cache: %d hits, %d misses, %d in place, %d evicted\n\r",
+                gSectionCache.Hits, gSectionCache.Misses, gSectionCache.Mapped, gSectionCache.Evictions);
+    LogToFile(LogFile, Log);
+
+    ReleaseSessionData();
     
-    LogFile->Close(LogFile);
+    LoggerClose();
     Root->Close(Root);
     return Status;
 }
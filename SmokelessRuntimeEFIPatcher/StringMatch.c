@@ -0,0 +1,226 @@
+#include "StringMatch.h"
+#include "TaggedPool.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+/**
+ * Helper: Insert the patterns into a trie (Next holds only trie edges)
+ */
+STATIC VOID StringMatcherAddPatterns(
+    STRING_MATCHER *Matcher,
+    CONST UINT8 *CONST *Patterns,
+    CONST UINTN *Lengths,
+    UINTN Count)
+{
+    for (UINTN p = 0; p < Count; p++)
+    {
+        UINT32 State = 0;
+
+        for (UINTN i = 0; i < Lengths[p]; i++)
+        {
+            UINT32 *Edge = &Matcher->Next[State * Matcher->ClassCount + Matcher->ClassOf[Patterns[p][i]]];
+
+            if (*Edge == STRING_MATCH_NONE)
+                *Edge = (UINT32)Matcher->StateCount++;
+            State = *Edge;
+        }
+
+        // Patterns sharing the final state are chained in index order
+        if (Matcher->Pattern[State] == STRING_MATCH_NONE)
+        {
+            Matcher->Pattern[State] = (UINT32)p;
+        }
+        else
+        {
+            UINT32 Last = Matcher->Pattern[State];
+
+            while (Matcher->SamePattern[Last] != STRING_MATCH_NONE)
+                Last = Matcher->SamePattern[Last];
+            Matcher->SamePattern[Last] = (UINT32)p;
+        }
+        Matcher->Lengths[p] = (UINT32)Lengths[p];
+    }
+}
+
+/**
+ * Helper: Turn the trie into a DFA (failure links folded into Next)
+ */
+STATIC EFI_STATUS StringMatcherLink(STRING_MATCHER *Matcher)
+{
+    UINT32 *Fail;
+    UINT32 *Queue;
+    UINTN Head = 0;
+    UINTN Tail = 0;
+    UINTN Classes = Matcher->ClassCount;
+
+    Fail = TaggedAllocateZeroPool(POOL_TAG_PATCH, Matcher->StateCount * sizeof(UINT32));
+    Queue = TaggedAllocatePool(POOL_TAG_PATCH, Matcher->StateCount * sizeof(UINT32));
+    if (Fail == NULL || Queue == NULL)
+    {
+        if (Fail != NULL)
+            TaggedFreePool(Fail);
+        if (Queue != NULL)
+            TaggedFreePool(Queue);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    // Breadth first, so the failure target of a state is complete before the state
+    for (UINTN c = 0; c < Classes; c++)
+    {
+        UINT32 Child = Matcher->Next[c];
+
+        if (Child == STRING_MATCH_NONE)
+        {
+            Matcher->Next[c] = 0;
+            continue;
+        }
+        Fail[Child] = 0;
+        Matcher->DictLink[Child] = STRING_MATCH_NONE;
+        Queue[Tail++] = Child;
+    }
+
+    while (Head < Tail)
+    {
+        UINT32 State = Queue[Head++];
+
+        for (UINTN c = 0; c < Classes; c++)
+        {
+            UINT32 *Edge = &Matcher->Next[State * Classes + c];
+            UINT32 Target = Matcher->Next[Fail[State] * Classes + c];
+
+            if (*Edge == STRING_MATCH_NONE)
+            {
+                *Edge = Target;
+                continue;
+            }
+
+            Fail[*Edge] = Target;
+            Matcher->DictLink[*Edge] = Matcher->Pattern[Target] != STRING_MATCH_NONE ? Target : Matcher->DictLink[Target];
+            Queue[Tail++] = *Edge;
+        }
+    }
+
+    for (UINTN s = 0; s < Matcher->StateCount; s++)
+        Matcher->Output[s] = Matcher->Pattern[s] != STRING_MATCH_NONE ? (UINT32)s : Matcher->DictLink[s];
+
+    TaggedFreePool(Queue);
+    TaggedFreePool(Fail);
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS StringMatcherBuild(
+    STRING_MATCHER *Matcher,
+    CONST UINT8 *CONST *Patterns,
+    CONST UINTN *Lengths,
+    UINTN Count)
+{
+    EFI_STATUS Status;
+    UINTN MaxStates = 1;
+    UINTN Classes = 1;
+
+    if (Matcher == NULL || Patterns == NULL || Lengths == NULL || Count == 0)
+        return EFI_INVALID_PARAMETER;
+
+    ZeroMem(Matcher, sizeof(STRING_MATCHER));
+
+    // Only bytes that occur in a pattern get their own column
+    for (UINTN p = 0; p < Count; p++)
+    {
+        if (Patterns[p] == NULL || Lengths[p] == 0)
+            return EFI_INVALID_PARAMETER;
+
+        MaxStates += Lengths[p];
+        for (UINTN i = 0; i < Lengths[p]; i++)
+        {
+            if (Matcher->ClassOf[Patterns[p][i]] != 0)
+                continue;
+            if (Classes > MAX_UINT8)
+                return EFI_INVALID_PARAMETER;   // Class 0 must stay free for unused bytes
+            Matcher->ClassOf[Patterns[p][i]] = (UINT8)Classes++;
+        }
+    }
+    if (MaxStates >= STRING_MATCH_NONE)
+        return EFI_INVALID_PARAMETER;
+
+    Matcher->ClassCount = Classes;
+    Matcher->PatternCount = Count;
+    Matcher->StateCount = 1;
+    Matcher->Next = TaggedAllocatePool(POOL_TAG_PATCH, MaxStates * Classes * sizeof(UINT32));
+    Matcher->Output = TaggedAllocatePool(POOL_TAG_PATCH, MaxStates * sizeof(UINT32));
+    Matcher->Pattern = TaggedAllocatePool(POOL_TAG_PATCH, MaxStates * sizeof(UINT32));
+    Matcher->DictLink = TaggedAllocatePool(POOL_TAG_PATCH, MaxStates * sizeof(UINT32));
+    Matcher->SamePattern = TaggedAllocatePool(POOL_TAG_PATCH, Count * sizeof(UINT32));
+    Matcher->Lengths = TaggedAllocatePool(POOL_TAG_PATCH, Count * sizeof(UINT32));
+    if (Matcher->Next == NULL || Matcher->Output == NULL || Matcher->Pattern == NULL ||
+        Matcher->DictLink == NULL || Matcher->SamePattern == NULL || Matcher->Lengths == NULL)
+    {
+        StringMatcherFree(Matcher);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    SetMem(Matcher->Next, MaxStates * Classes * sizeof(UINT32), 0xFF);
+    SetMem(Matcher->Pattern, MaxStates * sizeof(UINT32), 0xFF);
+    SetMem(Matcher->DictLink, MaxStates * sizeof(UINT32), 0xFF);
+    SetMem(Matcher->SamePattern, Count * sizeof(UINT32), 0xFF);
+
+    StringMatcherAddPatterns(Matcher, Patterns, Lengths, Count);
+    Status = StringMatcherLink(Matcher);
+    if (EFI_ERROR(Status))
+        StringMatcherFree(Matcher);
+    return Status;
+}
+
+UINTN StringMatcherScan(
+    CONST STRING_MATCHER *Matcher,
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    STRING_MATCH_CALLBACK Callback,
+    VOID *Context)
+{
+    UINTN Matches = 0;
+    UINT32 State = 0;
+
+    if (Matcher == NULL || Matcher->Next == NULL || Data == NULL || Callback == NULL)
+        return 0;
+
+    for (UINTN i = Start; i < End; i++)
+    {
+        State = Matcher->Next[State * Matcher->ClassCount + Matcher->ClassOf[Data[i]]];
+        if (Matcher->Output[State] == STRING_MATCH_NONE)
+            continue;
+
+        for (UINT32 Out = Matcher->Output[State]; Out != STRING_MATCH_NONE; Out = Matcher->DictLink[Out])
+        {
+            for (UINT32 p = Matcher->Pattern[Out]; p != STRING_MATCH_NONE; p = Matcher->SamePattern[p])
+            {
+                Matches++;
+                if (!Callback(Context, Data, i + 1 - Matcher->Lengths[p], p))
+                    return Matches;
+            }
+        }
+    }
+
+    return Matches;
+}
+
+VOID StringMatcherFree(STRING_MATCHER *Matcher)
+{
+    if (Matcher == NULL)
+        return;
+
+    if (Matcher->Next != NULL)
+        TaggedFreePool(Matcher->Next);
+    if (Matcher->Output != NULL)
+        TaggedFreePool(Matcher->Output);
+    if (Matcher->Pattern != NULL)
+        TaggedFreePool(Matcher->Pattern);
+    if (Matcher->DictLink != NULL)
+        TaggedFreePool(Matcher->DictLink);
+    if (Matcher->SamePattern != NULL)
+        TaggedFreePool(Matcher->SamePattern);
+    if (Matcher->Lengths != NULL)
+        TaggedFreePool(Matcher->Lengths);
+    ZeroMem(Matcher, sizeof(STRING_MATCHER));
+}
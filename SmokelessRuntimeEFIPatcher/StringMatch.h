@@ -0,0 +1,79 @@
+#pragma once
+#include <Uefi.h>
+
+// No state / no pattern
+#define STRING_MATCH_NONE MAX_UINT32
+
+/**
+ * Called for every occurrence of a pattern
+ *
+ * Occurrences are reported in ascending order of their last byte; patterns
+ * ending at the same byte are reported longest first.
+ *
+ * @param Context       Caller context
+ * @param Data          Buffer being scanned
+ * @param Offset        Offset of the first byte of the occurrence
+ * @param PatternIndex  Index of the pattern
+ * @return FALSE to stop the scan
+ */
+typedef BOOLEAN (*STRING_MATCH_CALLBACK)(VOID *Context, UINT8 *Data, UINTN Offset, UINTN PatternIndex);
+
+// Aho-Corasick automaton over a set of byte strings, as a full DFA
+typedef struct {
+    UINT8 ClassOf[256];          // Byte -> column; class 0 holds bytes no pattern uses
+    UINTN ClassCount;
+    UINTN StateCount;
+    UINT32 *Next;                // StateCount * ClassCount transitions
+    UINT32 *Output;              // Per state: first state whose pattern ends here (STRING_MATCH_NONE if none)
+    UINT32 *Pattern;             // Per state: pattern ending exactly at it
+    UINT32 *DictLink;            // Per state: next state with a pattern on the failure chain
+    UINT32 *SamePattern;         // Per pattern: next pattern with the same bytes
+    UINT32 *Lengths;             // Per pattern: length
+    UINTN PatternCount;
+} STRING_MATCHER;
+
+/**
+ * Build the automaton for a set of patterns
+ *
+ * The pattern bytes are not referenced after the build. Duplicate patterns
+ * are all reported.
+ *
+ * @param Matcher       Matcher to build
+ * @param Patterns      Pattern bytes
+ * @param Lengths       Pattern lengths (non-zero)
+ * @param Count         Number of patterns
+ * @return EFI_SUCCESS, EFI_INVALID_PARAMETER or EFI_OUT_OF_RESOURCES
+ */
+EFI_STATUS StringMatcherBuild(
+    STRING_MATCHER *Matcher,
+    CONST UINT8 *CONST *Patterns,
+    CONST UINTN *Lengths,
+    UINTN Count);
+
+/**
+ * Report every occurrence of every pattern in one pass
+ *
+ * Occurrences must lie entirely in [Start, End).
+ *
+ * @param Matcher       Built matcher
+ * @param Data          Buffer; offsets are relative to it
+ * @param Start         First offset to scan
+ * @param End           End of the range
+ * @param Callback      Called for each occurrence
+ * @param Context       Passed to Callback
+ * @return Number of occurrences reported
+ */
+UINTN StringMatcherScan(
+    CONST STRING_MATCHER *Matcher,
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    STRING_MATCH_CALLBACK Callback,
+    VOID *Context);
+
+/**
+ * Free a matcher
+ *
+ * @param Matcher       Matcher to free
+ */
+VOID StringMatcherFree(STRING_MATCHER *Matcher);
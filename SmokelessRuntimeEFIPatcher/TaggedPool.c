@@ -0,0 +1,235 @@
+#include "TaggedPool.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+#define POOL_HEADER_SIGNATURE   SIGNATURE_32('S', 'R', 'P', 'L')
+
+// Prepended to every tagged allocation; a multiple of 8 bytes so the
+// buffer keeps the pool alignment
+typedef struct POOL_HEADER {
+    UINT32 Signature;
+    UINT32 Tag;
+    UINTN Size;                  // Bytes asked for, without the header
+    struct POOL_HEADER *Prev;    // Live allocations, newest first
+    struct POOL_HEADER *Next;
+    VOID *Caller;                // Return address of the allocating call
+} POOL_HEADER;
+
+STATIC CONST CHAR8 *mPoolTagNames[POOL_TAG_MAX] = {
+    "IFR",
+    "HII",
+    "NVRAM",
+    "MENU",
+    "FV",
+    "PATCH",
+    "OTHER"
+};
+
+STATIC POOL_TAG_STATS mPoolStats[POOL_TAG_MAX];
+STATIC POOL_HEADER *mPoolLive = NULL;
+STATIC UINTN mPoolCurrentBytes = 0;
+STATIC UINTN mPoolPeakBytes = 0;
+STATIC UINTN mPoolFailures = 0;
+
+/**
+ * Helper: Allocate a buffer behind a header and charge it to a tag
+ */
+STATIC VOID *PoolAllocate(POOL_TAG Tag, UINTN Size, BOOLEAN Zero, VOID *Caller)
+{
+    POOL_HEADER *Header;
+    POOL_TAG_STATS *Stats;
+
+    if (Tag >= POOL_TAG_MAX)
+        Tag = POOL_TAG_OTHER;
+    if (Size > MAX_UINTN - sizeof(POOL_HEADER))
+        return NULL;
+
+    Header = Zero ? AllocateZeroPool(sizeof(POOL_HEADER) + Size) : AllocatePool(sizeof(POOL_HEADER) + Size);
+    if (Header == NULL)
+    {
+        mPoolFailures++;
+        return NULL;
+    }
+
+    Header->Signature = POOL_HEADER_SIGNATURE;
+    Header->Tag = Tag;
+    Header->Size = Size;
+    Header->Caller = Caller;
+    Header->Prev = NULL;
+    Header->Next = mPoolLive;
+    if (mPoolLive != NULL)
+        mPoolLive->Prev = Header;
+    mPoolLive = Header;
+
+    Stats = &mPoolStats[Tag];
+    Stats->CurrentBytes += Size;
+    Stats->CurrentCount++;
+    Stats->TotalCount++;
+    if (Stats->CurrentBytes > Stats->PeakBytes)
+        Stats->PeakBytes = Stats->CurrentBytes;
+
+    mPoolCurrentBytes += Size;
+    if (mPoolCurrentBytes > mPoolPeakBytes)
+        mPoolPeakBytes = mPoolCurrentBytes;
+
+    return Header + 1;
+}
+
+/**
+ * Helper: Header of a tagged buffer, NULL if it is not a live allocation
+ */
+STATIC POOL_HEADER *PoolHeader(VOID *Buffer)
+{
+    POOL_HEADER *Header = (POOL_HEADER *)Buffer - 1;
+
+    if (Header->Signature != POOL_HEADER_SIGNATURE || Header->Tag >= POOL_TAG_MAX)
+        return NULL;
+
+    // Must be linked in, or the list would be corrupted by the unlink
+    if (Header->Prev == NULL ? mPoolLive != Header : Header->Prev->Next != Header)
+        return NULL;
+
+    return Header;
+}
+
+/**
+ * AllocatePool charged to a tag
+ */
+VOID *TaggedAllocatePool(POOL_TAG Tag, UINTN Size)
+{
+    return PoolAllocate(Tag, Size, FALSE, RETURN_ADDRESS(0));
+}
+
+/**
+ * AllocateZeroPool charged to a tag
+ */
+VOID *TaggedAllocateZeroPool(POOL_TAG Tag, UINTN Size)
+{
+    return PoolAllocate(Tag, Size, TRUE, RETURN_ADDRESS(0));
+}
+
+/**
+ * AllocateCopyPool charged to a tag
+ */
+VOID *TaggedAllocateCopyPool(POOL_TAG Tag, UINTN Size, CONST VOID *Buffer)
+{
+    VOID *Copy = PoolAllocate(Tag, Size, FALSE, RETURN_ADDRESS(0));
+
+    if (Copy != NULL)
+        CopyMem(Copy, Buffer, Size);
+    return Copy;
+}
+
+/**
+ * ReallocatePool charged to a tag
+ */
+VOID *TaggedReallocatePool(POOL_TAG Tag, UINTN OldSize, UINTN NewSize, VOID *OldBuffer)
+{
+    VOID *NewBuffer = PoolAllocate(Tag, NewSize, TRUE, RETURN_ADDRESS(0));
+
+    if (NewBuffer != NULL && OldBuffer != NULL)
+    {
+        CopyMem(NewBuffer, OldBuffer, MIN(OldSize, NewSize));
+        TaggedFreePool(OldBuffer);
+    }
+    return NewBuffer;
+}
+
+/**
+ * Free a tagged buffer
+ *
+ * A buffer whose header does not check out is left allocated: freeing it
+ * from the wrong address would corrupt the pool.
+ */
+VOID TaggedFreePool(VOID *Buffer)
+{
+    POOL_HEADER *Header;
+    POOL_TAG_STATS *Stats;
+
+    if (Buffer == NULL)
+        return;
+
+    Header = PoolHeader(Buffer);
+    if (Header == NULL)
+    {
+        AsciiSPrint(Log, 512, "Pool: 0x%lx is not a live tagged buffer, not freed\n\r", (UINT64)(UINTN)Buffer);
+        LogToFile(LogFile, Log);
+        return;
+    }
+
+    if (Header->Prev != NULL)
+        Header->Prev->Next = Header->Next;
+    else
+        mPoolLive = Header->Next;
+    if (Header->Next != NULL)
+        Header->Next->Prev = Header->Prev;
+
+    Stats = &mPoolStats[Header->Tag];
+    Stats->CurrentBytes -= Header->Size;
+    Stats->CurrentCount--;
+    mPoolCurrentBytes -= Header->Size;
+
+    Header->Signature = 0;
+    FreePool(Header);
+}
+
+/**
+ * Usage of a tag
+ */
+CONST POOL_TAG_STATS *TaggedPoolStats(POOL_TAG Tag)
+{
+    return &mPoolStats[Tag < POOL_TAG_MAX ? Tag : POOL_TAG_OTHER];
+}
+
+/**
+ * Log the current, peak and outstanding usage of every tag
+ */
+VOID TaggedPoolReport(BOOLEAN ListOutstanding)
+{
+    UINTN Outstanding = 0;
+    UINTN Listed = 0;
+
+    AsciiSPrint(Log, 512, "\n=== Pool usage: peak %ld bytes, %ld in use, %d failed allocations ===\n\r",
+                (UINT64)mPoolPeakBytes, (UINT64)mPoolCurrentBytes, mPoolFailures);
+    LogToFile(LogFile, Log);
+    AsciiSPrint(Log, 512, "  %-8a %12a %12a %8a %8a\n\r", "Tag", "Peak bytes", "In use", "Live", "Allocs");
+    LogToFile(LogFile, Log);
+
+    for (UINTN i = 0; i < POOL_TAG_MAX; i++)
+    {
+        POOL_TAG_STATS *Stats = &mPoolStats[i];
+
+        if (Stats->TotalCount == 0)
+            continue;
+        AsciiSPrint(Log, 512, "  %-8a %12ld %12ld %8d %8d\n\r", mPoolTagNames[i],
+                    (UINT64)Stats->PeakBytes, (UINT64)Stats->CurrentBytes, Stats->CurrentCount, Stats->TotalCount);
+        LogToFile(LogFile, Log);
+        Outstanding += Stats->CurrentCount;
+    }
+
+    if (!ListOutstanding || Outstanding == 0)
+        return;
+
+    AsciiSPrint(Log, 512, "  %d allocations outstanding:\n\r", Outstanding);
+    LogToFile(LogFile, Log);
+
+    for (POOL_HEADER *Header = mPoolLive; Header != NULL && Listed < POOL_REPORT_MAX_OUTSTANDING;
+         Header = Header->Next, Listed++)
+    {
+        AsciiSPrint(Log, 512, "    %-8a %8ld bytes at 0x%lx, allocated from 0x%lx\n\r", mPoolTagNames[Header->Tag],
+                    (UINT64)Header->Size, (UINT64)(UINTN)(Header + 1), (UINT64)(UINTN)Header->Caller);
+        LogToFile(LogFile, Log);
+    }
+
+    if (Outstanding > Listed)
+    {
+        AsciiSPrint(Log, 512, "    ... and %d more\n\r", Outstanding - Listed);
+        LogToFile(LogFile, Log);
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <Uefi.h>
+
+// Subsystem an allocation is charged to
+typedef enum {
+    POOL_TAG_IFR = 0,            // IFR indexes, form and question parsing
+    POOL_TAG_HII,                // HII browser: package lists, strings, forms
+    POOL_TAG_NVRAM,              // Variable lists and configuration
+    POOL_TAG_MENU,               // Menu pages and items
+    POOL_TAG_FV,                 // FV file, section and loaded image indexes
+    POOL_TAG_PATCH,              // Patchers, plans, caches, manifests, scripts
+    POOL_TAG_OTHER,
+    POOL_TAG_MAX
+} POOL_TAG;
+
+// Outstanding allocations listed by TaggedPoolReport at most
+#define POOL_REPORT_MAX_OUTSTANDING 20
+
+// Usage of one tag
+typedef struct {
+    UINTN CurrentBytes;
+    UINTN PeakBytes;
+    UINTN CurrentCount;          // Live allocations
+    UINTN TotalCount;            // Allocations made
+} POOL_TAG_STATS;
+
+/**
+ * AllocatePool charged to a tag
+ *
+ * @param Tag           Subsystem
+ * @param Size          Bytes to allocate
+ * @return Buffer to free with TaggedFreePool, or NULL
+ */
+VOID *TaggedAllocatePool(POOL_TAG Tag, UINTN Size);
+
+/**
+ * AllocateZeroPool charged to a tag
+ */
+VOID *TaggedAllocateZeroPool(POOL_TAG Tag, UINTN Size);
+
+/**
+ * AllocateCopyPool charged to a tag
+ */
+VOID *TaggedAllocateCopyPool(POOL_TAG Tag, UINTN Size, CONST VOID *Buffer);
+
+/**
+ * ReallocatePool charged to a tag
+ *
+ * @param Tag           Subsystem
+ * @param OldSize       Bytes of OldBuffer to keep
+ * @param NewSize       Bytes to allocate
+ * @param OldBuffer     Tagged buffer to replace and free, or NULL
+ * @return New buffer, or NULL (OldBuffer is then left alone)
+ */
+VOID *TaggedReallocatePool(POOL_TAG Tag, UINTN OldSize, UINTN NewSize, VOID *OldBuffer);
+
+/**
+ * Free a tagged buffer
+ *
+ * Only for buffers from the Tagged* allocators. Buffers the firmware
+ * allocated, such as those returned by ReadSection or LocateHandleBuffer,
+ * have no header and go to FreePool.
+ *
+ * @param Buffer        Tagged buffer to free, or NULL
+ */
+VOID TaggedFreePool(VOID *Buffer);
+
+/**
+ * Usage of a tag
+ *
+ * @param Tag           Subsystem
+ * @return Its counters
+ */
+CONST POOL_TAG_STATS *TaggedPoolStats(POOL_TAG Tag);
+
+/**
+ * Log the current, peak and outstanding usage of every tag
+ *
+ * @param ListOutstanding   Also list the live allocations (size, tag and
+ *                          caller), meant for cleanup where they are leaks
+ */
+VOID TaggedPoolReport(BOOLEAN ListOutstanding);
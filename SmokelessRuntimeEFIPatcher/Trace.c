@@ -0,0 +1,162 @@
+#include "Trace.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/PrintLib.h>
+
+extern char Log[512];
+extern EFI_FILE *LogFile;
+void LogToFile(EFI_FILE *LogFile, char *String);
+
+BOOLEAN gTraceEnabled = FALSE;
+
+// Events not yet written; UINT64 keeps the records and their arguments aligned
+STATIC UINT64 mTraceBuffer[TRACE_BUFFER_SIZE / sizeof(UINT64)];
+STATIC UINTN mTraceUsed;
+STATIC EFI_FILE *mTraceFile;
+STATIC UINTN mTraceEvents;
+STATIC UINTN mTraceDropped;
+
+/**
+ * Helper: Write the buffered events to the trace file
+ */
+STATIC VOID TraceWriteBuffer(VOID)
+{
+    UINTN Size = mTraceUsed;
+
+    if (mTraceFile == NULL || Size == 0)
+        return;
+
+    if (EFI_ERROR(mTraceFile->Write(mTraceFile, &Size, mTraceBuffer)))
+        mTraceDropped += mTraceEvents;
+    mTraceUsed = 0;
+    mTraceEvents = 0;
+}
+
+/**
+ * Time stamp counter, for trace records and timing spans
+ */
+UINT64 TraceTicks(VOID)
+{
+#if defined(MDE_CPU_IA32) || defined(MDE_CPU_X64)
+    return AsmReadTsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Start tracing if the flag file exists
+ */
+EFI_STATUS TraceOpen(EFI_FILE *Root, CONST CHAR16 *FlagFile, UINT64 TscFrequency)
+{
+    EFI_STATUS Status;
+    EFI_FILE *File;
+    TRACE_FILE_HEADER Header;
+    UINTN Size = sizeof(Header);
+
+    Status = Root->Open(Root, &File, (CHAR16 *)FlagFile, EFI_FILE_MODE_READ, 0);
+    if (EFI_ERROR(Status))
+        return EFI_NOT_FOUND;
+    File->Close(File);
+
+    // Delete and recreate, the file protocol cannot truncate on open
+    Status = Root->Open(Root, &File, TRACE_FILE_NAME, EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+    if (!EFI_ERROR(Status))
+        File->Delete(File);
+
+    Status = Root->Open(Root, &File, TRACE_FILE_NAME,
+                        EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    if (!EFI_ERROR(Status))
+    {
+        ZeroMem(&Header, sizeof(Header));
+        Header.Signature = TRACE_FILE_SIGNATURE;
+        Header.Version = TRACE_FILE_VERSION;
+#if defined(MDE_CPU_IA32) || defined(MDE_CPU_X64)
+        Header.TscFrequency = TscFrequency;
+#endif
+        Status = File->Write(File, &Size, &Header);
+        if (EFI_ERROR(Status))
+            File->Close(File);
+    }
+
+    AsciiSPrint(Log, 512, "Tracing to SREP.trace: %r\n\r", Status);
+    LogToFile(LogFile, Log);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    mTraceFile = File;
+    mTraceUsed = 0;
+    mTraceEvents = 0;
+    mTraceDropped = 0;
+    gTraceEnabled = TRUE;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Append an event
+ */
+VOID TraceEvent(UINT16 Event, UINTN ArgCount, UINT64 Arg0, UINT64 Arg1, UINT64 Arg2, UINT64 Arg3)
+{
+    TRACE_RECORD *Record;
+    UINT64 *Args;
+    UINTN Size;
+
+    if (!gTraceEnabled)
+        return;
+
+    ArgCount = MIN(ArgCount, TRACE_MAX_ARGS);
+    Size = sizeof(TRACE_RECORD) + ArgCount * sizeof(UINT64);
+    if (mTraceUsed + Size > TRACE_BUFFER_SIZE)
+        TraceWriteBuffer();
+
+    Record = (TRACE_RECORD *)((UINT8 *)mTraceBuffer + mTraceUsed);
+    Record->Timestamp = TraceTicks();
+    Record->Event = Event;
+    Record->ArgCount = (UINT16)ArgCount;
+    Record->Reserved = 0;
+
+    Args = (UINT64 *)(Record + 1);
+    if (ArgCount > 0)
+        Args[0] = Arg0;
+    if (ArgCount > 1)
+        Args[1] = Arg1;
+    if (ArgCount > 2)
+        Args[2] = Arg2;
+    if (ArgCount > 3)
+        Args[3] = Arg3;
+
+    mTraceUsed += Size;
+    mTraceEvents++;
+}
+
+/**
+ * Write the buffered events and flush the trace file
+ */
+VOID TraceFlush(VOID)
+{
+    if (mTraceFile == NULL)
+        return;
+
+    TraceWriteBuffer();
+    mTraceFile->Flush(mTraceFile);
+}
+
+/**
+ * Flush and close the trace file and stop tracing
+ */
+VOID TraceClose(VOID)
+{
+    if (mTraceFile == NULL)
+        return;
+
+    gTraceEnabled = FALSE;
+    TraceFlush();
+    mTraceFile->Close(mTraceFile);
+    mTraceFile = NULL;
+
+    if (mTraceDropped > 0)
+    {
+        AsciiSPrint(Log, 512, "Trace: %d events lost to write errors\n\r", mTraceDropped);
+        LogToFile(LogFile, Log);
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Protocol/SimpleFileSystem.h>
+
+// Trace file, next to the log; written only when the trace flag file exists
+#define TRACE_FILE_NAME L"SREP.trace"
+
+#define TRACE_FILE_SIGNATURE SIGNATURE_32('S', 'R', 'T', 'R')
+#define TRACE_FILE_VERSION 1
+
+// Arguments of one event at most
+#define TRACE_MAX_ARGS 4
+
+// Events buffered before a write to the trace file
+#define TRACE_BUFFER_SIZE SIZE_64KB
+
+//
+// Event catalog: X(Name, Id, Arguments). Ids are part of the file format and
+// never reused. Arguments are "<kind> <name>" pairs, read by the host decoder:
+//   u  decimal          x  hex          r  EFI_STATUS
+//   g  GUID (takes two arguments)
+//   b  bytes, little endian; the argument before it is the byte count (at most 8 shown)
+//
+#define TRACE_EVENT_LIST(X) \
+    X(TRACE_PHASE,          1, "u phase") \
+    X(TRACE_MODULE_BEGIN,   2, "x base, x size, x passes") \
+    X(TRACE_MODULE_END,     3, "x base, u write_protections, u vendor_patches, u ifr_applied") \
+    X(TRACE_PATCH_WRITE,    4, "x offset, u reason, u length, b bytes") \
+    X(TRACE_FV_SECTION,     5, "g file, x section, r status")
+
+#define TRACE_EVENT_ENUM(Name, Id, Args) Name = Id,
+typedef enum {
+    TRACE_EVENT_LIST(TRACE_EVENT_ENUM)
+    TRACE_EVENT_MAX
+} TRACE_EVENT;
+#undef TRACE_EVENT_ENUM
+
+// Start of the trace file
+typedef struct {
+    UINT32 Signature;
+    UINT32 Version;
+    UINT64 TscFrequency;         // Timestamp ticks per second, 0 if not measured
+} TRACE_FILE_HEADER;
+
+// One event, followed by ArgCount UINT64 arguments
+typedef struct {
+    UINT64 Timestamp;            // Time stamp counter
+    UINT16 Event;                // TRACE_EVENT
+    UINT16 ArgCount;
+    UINT32 Reserved;
+} TRACE_RECORD;
+
+// TRUE while events are recorded; tested inline so disabled tracing costs one branch
+extern BOOLEAN gTraceEnabled;
+
+#define TRACE1(Event, A) \
+    do { if (gTraceEnabled) TraceEvent((Event), 1, (UINT64)(A), 0, 0, 0); } while (FALSE)
+#define TRACE2(Event, A, B) \
+    do { if (gTraceEnabled) TraceEvent((Event), 2, (UINT64)(A), (UINT64)(B), 0, 0); } while (FALSE)
+#define TRACE3(Event, A, B, C) \
+    do { if (gTraceEnabled) TraceEvent((Event), 3, (UINT64)(A), (UINT64)(B), (UINT64)(C), 0); } while (FALSE)
+#define TRACE4(Event, A, B, C, D) \
+    do { if (gTraceEnabled) TraceEvent((Event), 4, (UINT64)(A), (UINT64)(B), (UINT64)(C), (UINT64)(D)); } while (FALSE)
+
+// A GUID and up to two more arguments
+#define TRACE_GUID(Event, Guid, A, B) \
+    do { \
+        if (gTraceEnabled) \
+            TraceEvent((Event), 4, ReadUnaligned64((CONST UINT64 *)(Guid)), \
+                       ReadUnaligned64((CONST UINT64 *)(Guid) + 1), (UINT64)(A), (UINT64)(B)); \
+    } while (FALSE)
+
+/**
+ * Time stamp counter, for trace records and timing spans
+ *
+ * @return Current tick on IA32/X64; 0 on the other architectures, which
+ *         have no time stamp counter in BaseLib
+ */
+UINT64 TraceTicks(VOID);
+
+/**
+ * Start tracing if the flag file exists
+ *
+ * SREP.trace is recreated and starts with a TRACE_FILE_HEADER.
+ *
+ * @param Root          Directory holding the flag and TRACE_FILE_NAME
+ * @param FlagFile      Name of the trace flag file
+ * @param TscFrequency  Time stamp counter ticks per second for the header, 0 if
+ *                      unknown; always 0 where TraceTicks reads 0
+ * @return EFI_SUCCESS if tracing, EFI_NOT_FOUND without the flag file, or a
+ *         file system error
+ */
+EFI_STATUS TraceOpen(EFI_FILE *Root, CONST CHAR16 *FlagFile, UINT64 TscFrequency);
+
+/**
+ * Append an event; use the TRACE macros
+ *
+ * Nothing is formatted: the event id, the time stamp counter and the raw
+ * arguments are copied into the trace buffer, which is written to the file
+ * when full.
+ *
+ * @param Event         TRACE_EVENT
+ * @param ArgCount      Arguments used, at most TRACE_MAX_ARGS
+ */
+VOID TraceEvent(UINT16 Event, UINTN ArgCount, UINT64 Arg0, UINT64 Arg1, UINT64 Arg2, UINT64 Arg3);
+
+/**
+ * Write the buffered events and flush the trace file
+ *
+ * Called by LoggerFlush, so the trace is on disk wherever the log is.
+ */
+VOID TraceFlush(VOID);
+
+/**
+ * Flush and close the trace file and stop tracing
+ */
+VOID TraceClose(VOID);
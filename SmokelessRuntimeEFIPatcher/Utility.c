@@ -1,4 +1,10 @@
 #include "Utility.h"
+#include "LoadedImageIndex.h"
+#include "FvFileIndex.h"
+#include "SectionCache.h"
+#include "Trace.h"
+#include "TaggedPool.h"
+#include "FwCalls.h"
 CHAR16 *
 FindLoadedImageFileName(
     IN EFI_LOADED_IMAGE_PROTOCOL *LoadedImage)
@@ -9,6 +15,7 @@ FindLoadedImageFileName(
     VOID *Buffer;
     UINTN BufferSize;
     UINT32 AuthenticationStatus;
+    CHAR16 *Name;
 
     if ((LoadedImage == NULL) || (LoadedImage->FilePath == NULL))
     {
@@ -39,7 +46,7 @@ FindLoadedImageFileName(
     // Read the user interface section of the image.
     //
     Buffer = NULL;
-    Status = Fv->ReadSection(Fv, NameGuid, EFI_SECTION_USER_INTERFACE, 0, &Buffer, &BufferSize, &AuthenticationStatus);
+    Status = gFwCalls.ReadSection(Fv, NameGuid, EFI_SECTION_USER_INTERFACE, 0, &Buffer, &BufferSize, &AuthenticationStatus);
 
     if (EFI_ERROR(Status))
     {
@@ -48,43 +55,25 @@ FindLoadedImageFileName(
 
     //
     // ReadSection returns just the section data, without any section header. For
-    // a user interface section, the only data is the file name.
+    // a user interface section, the only data is the file name. The copy is
+    // charged to the FV tag with the loaded image index that keeps it.
     //
-    return Buffer;
+    Name = TaggedAllocateCopyPool(POOL_TAG_FV, BufferSize, Buffer);
+    FreePool(Buffer);
+    return Name;
 }
 
 UINT8 *FindBaseAddressFromName(const CHAR16 *Name)
 {
-    EFI_STATUS Status;
-    UINTN HandleSize = 0;
-    EFI_HANDLE *Handles;
+    CONST LOADED_IMAGE_ENTRY *Entry = LoadedImageIndexFindByName(&gLoadedImageIndex, Name);
 
-    Status = gBS->LocateHandle(ByProtocol, &gEfiLoadedImageProtocolGuid, NULL, &HandleSize, NULL);
-    if (Status == EFI_BUFFER_TOO_SMALL)
+    if (Entry == NULL)
     {
-        Handles = AllocateZeroPool(HandleSize * sizeof(EFI_HANDLE));
-        Status = gBS->LocateHandle(ByProtocol, &gEfiLoadedImageProtocolGuid, NULL, &HandleSize, Handles);
-        Print(L"Retrived %d Handle, with %r\n\r", HandleSize, Status);
+        return NULL;
     }
 
-    EFI_LOADED_IMAGE_PROTOCOL *LoadedImageProtocol;
-    for (UINTN i = 0; i < HandleSize; i++)
-    {
-        Status = gBS->HandleProtocol(Handles[i], &gEfiLoadedImageProtocolGuid, (VOID **)&LoadedImageProtocol);
-        if (Status == EFI_SUCCESS)
-        {
-            CHAR16 *String = FindLoadedImageFileName(LoadedImageProtocol);
-            if (String != NULL)
-            {
-                if (StrCmp(Name, String) == 0)
-                {
-                    Print(L"Found %s at Address 0x%X\n\r", String, LoadedImageProtocol->ImageBase);
-                    return LoadedImageProtocol->ImageBase;
-                }
-            }
-        }
-    }
-    return NULL;
+    Print(L"Found %s at Address 0x%X\n\r", Entry->Name, Entry->ImageBase);
+    return Entry->ImageBase;
 }
 
 EFI_STATUS LoadandRunImage(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable, CHAR16 *FileName, EFI_HANDLE *AppImageHandle)
@@ -150,150 +139,47 @@ EFI_STATUS LoadandRunImage(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable
  * 
  * @param Name          Name of the module to find
  * @param Section_Type  Type of section to read
- * @param Buffer        Output buffer for section data
+ * @param Buffer        Receives the section data, owned by gSectionCache and
+ *                      valid until the next section cache read
  * @param BufferSize    Size of the output buffer
  * @param DumpInfo      If TRUE, dump detailed section information to log
  * 
  * @return EFI_SUCCESS if found and loaded, error otherwise
  */
 EFI_STATUS
-LocateAndLoadFvFromName(CHAR16 *Name, EFI_SECTION_TYPE Section_Type, UINT8 **Buffer, UINTN *BufferSize)
+LocateAndLoadFvFromName(CHAR16 *Name, EFI_SECTION_TYPE Section_Type, CONST UINT8 **Buffer, UINTN *BufferSize)
 {
     EFI_STATUS Status;
-    EFI_HANDLE *HandleBuffer;
-    UINTN NumberOfHandles;
-    UINTN Index;
-    EFI_FIRMWARE_VOLUME2_PROTOCOL *FvInstance;
-    BOOLEAN Found = FALSE;
+    CONST FV_FILE_ENTRY *File;
 
     if (Name == NULL || Buffer == NULL || BufferSize == NULL)
     {
         return EFI_INVALID_PARAMETER;
     }
 
-    // Locate firmware volume protocol
-    Status = gBS->LocateHandleBuffer(
-        ByProtocol,
-        &gEfiFirmwareVolume2ProtocolGuid,
-        NULL,
-        &NumberOfHandles,
-        &HandleBuffer);
-    if (EFI_ERROR(Status))
+    // Hash lookup in the FV file index; only the first call sweeps the volumes
+    File = FvFileIndexFindByName(&gFvFileIndex, Name);
+    if (File == NULL)
     {
-        // Defined errors at this time are not found and out of resources
-        return Status;
+        Print(L"Module '%s' not found in any firmware volume\n\r", Name);
+        return EFI_NOT_FOUND;
     }
 
-    // Looking for FV with requested module
-    Print(L"Searching %d firmware volume instances for '%s'\n\r", NumberOfHandles, Name);
-    
-    for (Index = 0; Index < NumberOfHandles; Index++)
-    {
-        // Get the protocol on this handle
-        // This should not fail because of LocateHandleBuffer
-        Status = gBS->HandleProtocol(
-            HandleBuffer[Index],
-            &gEfiFirmwareVolume2ProtocolGuid,
-            (VOID **)&FvInstance);
-        
-        if (EFI_ERROR(Status))
-        {
-            continue;
-        }
-
-        EFI_FV_FILETYPE FileType = EFI_FV_FILETYPE_ALL;
-        EFI_FV_FILE_ATTRIBUTES FileAttributes;
-        UINTN FileSize;
-        EFI_GUID NameGuid = {0};
-        VOID *Keys = AllocateZeroPool(FvInstance->KeySize);
-        
-        if (Keys == NULL)
-        {
-            continue;
-        }
-        
-        // Iterate through all files in this firmware volume
-        while (TRUE)
-        {
-            FileType = EFI_FV_FILETYPE_ALL;
-            ZeroMem(&NameGuid, sizeof(EFI_GUID));
-            Status = FvInstance->GetNextFile(FvInstance, Keys, &FileType, &NameGuid, &FileAttributes, &FileSize);
-            
-            if (EFI_ERROR(Status))
-            {
-                // No more files in this volume
-                break;
-            }
-            
-            // Read UI section to get module name
-            VOID *String = NULL;
-            UINTN StringSize = 0;
-            UINT32 AuthenticationStatus;
-            Status = FvInstance->ReadSection(
-                FvInstance, 
-                &NameGuid, 
-                EFI_SECTION_USER_INTERFACE, 
-                0, 
-                &String, 
-                &StringSize, 
-                &AuthenticationStatus);
-            
-            if (!EFI_ERROR(Status) && String != NULL && StrCmp(Name, String) == 0)
-            {
-                // Found the requested module
-                Print(L"Found module: GUID=%g, Size=%d bytes, Name='%s', Type=0x%x\n\r", 
-                      NameGuid, FileSize, String, FileType);
+    Print(L"Found module: GUID=%g, Size=%d bytes, Name='%s', Type=0x%x\n\r",
+          &File->FileGuid, File->FileSize, File->Name, File->FileType);
+    Print(L"  File Attributes: 0x%08x\n\r", File->Attributes);
 
-                // Dump section instance information
-                Print(L"  Section Type: 0x%02x, Authentication Status: 0x%08x\n\r", 
-                      Section_Type, AuthenticationStatus);
-                Print(L"  File Attributes: 0x%08x\n\r", FileAttributes);
-                
-                // Read the requested section
-                Status = FvInstance->ReadSection(
-                    FvInstance, 
-                    &NameGuid, 
-                    Section_Type, 
-                    0,
-                    (VOID **)Buffer, 
-                    BufferSize, 
-                    &AuthenticationStatus);
-                
-                if (EFI_ERROR(Status))
-                {
-                    Print(L"  Warning: Failed to read section type 0x%02x: %r\n\r", Section_Type, Status);
-                }
-                else
-                {
-                    Print(L"  Successfully loaded section: %d bytes\n\r", *BufferSize);
-                    Found = TRUE;
-                }
-                
-                FreePool(String);
-                FreePool(Keys);
-                
-                if (Found)
-                {
-                    FreePool(HandleBuffer);
-                    return EFI_SUCCESS;
-                }
-                else
-                {
-                    FreePool(HandleBuffer);
-                    return Status;
-                }
-            }
-            
-            if (String != NULL)
-            {
-                FreePool(String);
-            }
-        }
-        
-        FreePool(Keys);
+    // Compressed files are decompressed once per session; later reads are cache hits
+    Status = SectionCacheRead(&gSectionCache, File, Section_Type, (CONST VOID **)Buffer, BufferSize);
+    TRACE_GUID(TRACE_FV_SECTION, &File->FileGuid, Section_Type, Status);
+    if (EFI_ERROR(Status))
+    {
+        Print(L"  Warning: Failed to read section type 0x%02x: %r\n\r", Section_Type, Status);
+        return Status;
     }
-    
-    FreePool(HandleBuffer);
-    Print(L"Module '%s' not found in any firmware volume\n\r", Name);
-    return EFI_NOT_FOUND;
+
+    Print(L"  Section Type: 0x%02x (cache: %d hits, %d misses, %d in place)\n\r",
+          Section_Type, gSectionCache.Hits, gSectionCache.Misses, gSectionCache.Mapped);
+    Print(L"  Successfully loaded section: %d bytes\n\r", *BufferSize);
+    return EFI_SUCCESS;
 }
\ No newline at end of file
@@ -34,4 +34,4 @@ EFI_STATUS LoadandRunImage(EFI_HANDLE ImageHandle,
 
 UINT8 *FindBaseAddressFromName(const CHAR16 *Name);
 
-EFI_STATUS LocateAndLoadFvFromName(CHAR16 *Name, EFI_SECTION_TYPE Section_Type,UINT8 **Buffer,UINTN *BufferSize);
+EFI_STATUS LocateAndLoadFvFromName(CHAR16 *Name, EFI_SECTION_TYPE Section_Type,CONST UINT8 **Buffer,UINTN *BufferSize);
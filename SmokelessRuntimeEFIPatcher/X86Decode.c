@@ -0,0 +1,372 @@
+#include "X86Decode.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+
+// Operand layout of an opcode
+#define X86_OP_MODRM    BIT0     // ModRM (plus SIB and displacement)
+#define X86_OP_IMM8     BIT1
+#define X86_OP_IMMZ     BIT2     // 16 bits with 66, otherwise 32
+#define X86_OP_IMM16    BIT3
+#define X86_OP_IMMV     BIT4     // 64 bits with REX.W, 16 with 66, otherwise 32
+#define X86_OP_MOFFS    BIT5     // 64-bit address, 32 with 67
+#define X86_OP_INVALID  BIT6     // Invalid in 64-bit mode
+#define X86_OP_REL32    BIT7     // Branch displacement, 32 bits even with 66
+
+#define M   X86_OP_MODRM
+#define I8  X86_OP_IMM8
+#define IZ  X86_OP_IMMZ
+#define I16 X86_OP_IMM16
+#define IV  X86_OP_IMMV
+#define MO  X86_OP_MOFFS
+#define X   X86_OP_INVALID
+#define R32 X86_OP_REL32
+
+// One-byte opcodes; prefixes, REX, 0F and VEX/EVEX are handled before the lookup
+STATIC CONST UINT8 mPrimaryOps[256] = {
+    /* 00 */ M,    M,    M,    M,    I8,   IZ,   X,    X,    M,    M,    M,    M,    I8,   IZ,   X,    0,
+    /* 10 */ M,    M,    M,    M,    I8,   IZ,   X,    X,    M,    M,    M,    M,    I8,   IZ,   X,    X,
+    /* 20 */ M,    M,    M,    M,    I8,   IZ,   0,    X,    M,    M,    M,    M,    I8,   IZ,   0,    X,
+    /* 30 */ M,    M,    M,    M,    I8,   IZ,   0,    X,    M,    M,    M,    M,    I8,   IZ,   0,    X,
+    /* 40 */ 0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    /* 50 */ 0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    /* 60 */ X,    X,    X,    M,    0,    0,    0,    0,    IZ,   M|IZ, I8,   M|I8, 0,    0,    0,    0,
+    /* 70 */ I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,
+    /* 80 */ M|I8, M|IZ, X,    M|I8, M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 90 */ 0,    0,    0,    0,    0,    0,    0,    0,    0,    0,    X,    0,    0,    0,    0,    0,
+    /* A0 */ MO,   MO,   MO,   MO,   0,    0,    0,    0,    I8,   IZ,   0,    0,    0,    0,    0,    0,
+    /* B0 */ I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   IV,   IV,   IV,   IV,   IV,   IV,   IV,   IV,
+    /* C0 */ M|I8, M|I8, I16,  0,    X,    X,    M|I8, M|IZ, I16|I8, 0,  I16,  0,    0,    I8,   X,    0,
+    /* D0 */ M,    M,    M,    M,    X,    X,    X,    0,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* E0 */ I8,   I8,   I8,   I8,   I8,   I8,   I8,   I8,   R32,  R32,  X,    I8,   0,    0,    0,    0,
+    /* F0 */ 0,    0,    0,    0,    0,    0,    M,    M,    0,    0,    0,    0,    0,    0,    M,    M
+};
+
+// Two-byte opcodes (0F xx); 0F 38 and 0F 3A are escapes to the three-byte maps
+STATIC CONST UINT8 mSecondaryOps[256] = {
+    /* 00 */ M,    M,    M,    M,    X,    0,    0,    0,    0,    0,    X,    0,    X,    M,    0,    M|I8,
+    /* 10 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 20 */ M,    M,    M,    M,    X,    X,    X,    X,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 30 */ 0,    0,    0,    0,    0,    0,    X,    0,    0,    X,    0,    X,    X,    X,    X,    X,
+    /* 40 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 50 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 60 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* 70 */ M|I8, M|I8, M|I8, M|I8, M,    M,    M,    0,    M,    M,    X,    X,    M,    M,    M,    M,
+    /* 80 */ R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,  R32,
+    /* 90 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* A0 */ 0,    0,    0,    M,    M|I8, M,    X,    X,    0,    0,    0,    M,    M|I8, M,    M,    M,
+    /* B0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M|I8, M,    M,    M,    M,    M,
+    /* C0 */ M,    M,    M|I8, M,    M|I8, M|I8, M|I8, M,    0,    0,    0,    0,    0,    0,    0,    0,
+    /* D0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* E0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,
+    /* F0 */ M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M,    M
+};
+
+#undef M
+#undef I8
+#undef IZ
+#undef I16
+#undef IV
+#undef MO
+#undef X
+#undef R32
+
+/**
+ * Helper: Operand layout of an opcode in any map
+ */
+STATIC UINT8 X86OperandLayout(UINT8 Map, UINT8 Opcode)
+{
+    switch (Map)
+    {
+    case X86_MAP_PRIMARY:
+        return mPrimaryOps[Opcode];
+    case X86_MAP_0F:
+        return mSecondaryOps[Opcode];
+    case X86_MAP_0F38:
+        return X86_OP_MODRM;
+    default:
+        return X86_OP_MODRM | X86_OP_IMM8;
+    }
+}
+
+/**
+ * Helper: X86_PREFIX_* flag of a legacy prefix byte, 0 for other bytes
+ */
+STATIC UINT8 X86LegacyPrefix(UINT8 Byte)
+{
+    switch (Byte)
+    {
+    case 0x66:
+        return X86_PREFIX_OPERAND_SIZE;
+    case 0x67:
+        return X86_PREFIX_ADDRESS_SIZE;
+    case 0xF0:
+        return X86_PREFIX_LOCK;
+    case 0xF2:
+    case 0xF3:
+        return X86_PREFIX_REP;
+    case 0x26:
+    case 0x2E:
+    case 0x36:
+    case 0x3E:
+    case 0x64:
+    case 0x65:
+        return X86_PREFIX_SEGMENT;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Helper: Check the ModRM reg field of one-byte opcodes with unused extensions
+ *
+ * Data in code sections often decodes as these; rejecting them brings the
+ * sweep back into step sooner.
+ */
+STATIC BOOLEAN X86GroupEncodingValid(UINT8 Opcode, UINT8 ModRm)
+{
+    UINT8 Reg = (ModRm >> 3) & 0x07;
+
+    switch (Opcode)
+    {
+    case 0x8F:
+        return Reg == 0;                     // POP r/m (other values are XOP)
+    case 0xC6:
+    case 0xC7:
+        return Reg == 0 || ModRm == 0xF8;    // MOV r/m, imm; XABORT/XBEGIN
+    case 0xFE:
+        return Reg <= 1;                     // INC/DEC r/m8
+    case 0xFF:
+        return Reg != 7;
+    default:
+        return TRUE;
+    }
+}
+
+/**
+ * Helper: Decode a VEX (C4/C5) or EVEX (62) prefix
+ *
+ * In 64-bit mode these bytes are always a vector prefix. On success *Pos is
+ * at the opcode byte and Map is set.
+ */
+STATIC EFI_STATUS X86DecodeVectorPrefix(CONST UINT8 *Code, UINTN Size, UINTN *Pos, X86_INSTRUCTION *Instruction)
+{
+    UINT8 Escape = Code[*Pos];
+    UINTN PrefixLength = Escape == 0xC5 ? 2 : (Escape == 0xC4 ? 3 : 4);
+    UINT8 Map;
+
+    // REX or a mandatory-prefix byte before VEX/EVEX is #UD
+    if (Instruction->Rex != 0 || (Instruction->Prefixes & (X86_PREFIX_OPERAND_SIZE | X86_PREFIX_REP | X86_PREFIX_LOCK)) != 0)
+        return EFI_UNSUPPORTED;
+    if (*Pos + PrefixLength >= Size)
+        return EFI_BUFFER_TOO_SMALL;
+
+    if (Escape == 0xC5)
+    {
+        Map = X86_MAP_0F;
+    }
+    else if (Escape == 0xC4)
+    {
+        Map = Code[*Pos + 1] & 0x1F;
+        if (Map < X86_MAP_0F || Map > X86_MAP_0F3A)
+            return EFI_UNSUPPORTED;
+    }
+    else
+    {
+        // EVEX: P1 bit 2 is fixed to 1; maps 5 and 6 (FP16) have no immediate
+        if ((Code[*Pos + 2] & BIT2) == 0)
+            return EFI_UNSUPPORTED;
+        Map = Code[*Pos + 1] & 0x07;
+        if (Map == 5 || Map == 6)
+            Map = X86_MAP_0F38;
+        else if (Map < X86_MAP_0F || Map > X86_MAP_0F3A)
+            return EFI_UNSUPPORTED;
+    }
+
+    Instruction->Prefixes |= X86_PREFIX_VEX;
+    Instruction->Map = Map;
+    *Pos += PrefixLength;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Helper: Size of the ModRM byte with its SIB byte and displacement
+ */
+STATIC EFI_STATUS X86ModRmLength(CONST UINT8 *Code, UINTN Size, UINTN Pos, UINTN *Length)
+{
+    UINT8 ModRm;
+    UINT8 Mod;
+    UINT8 Rm;
+    UINTN Bytes = 1;
+
+    if (Pos >= Size)
+        return EFI_BUFFER_TOO_SMALL;
+
+    ModRm = Code[Pos];
+    Mod = ModRm >> 6;
+    Rm = ModRm & 0x07;
+
+    if (Mod != 3)
+    {
+        if (Rm == 4)
+        {
+            // SIB byte; base 101 without displacement means disp32
+            if (Pos + 1 >= Size)
+                return EFI_BUFFER_TOO_SMALL;
+            Bytes++;
+            if (Mod == 0 && (Code[Pos + 1] & 0x07) == 5)
+                Bytes += 4;
+        }
+        else if (Mod == 0 && Rm == 5)
+        {
+            Bytes += 4;          // RIP-relative
+        }
+
+        if (Mod == 1)
+            Bytes += 1;
+        else if (Mod == 2)
+            Bytes += 4;
+    }
+
+    *Length = Bytes;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS X86DecodeInstruction(CONST UINT8 *Code, UINTN Size, X86_INSTRUCTION *Instruction)
+{
+    EFI_STATUS Status;
+    UINTN Pos;
+    UINT8 Layout;
+    UINTN ImmSize = 0;
+
+    if (Code == NULL || Instruction == NULL)
+        return EFI_INVALID_PARAMETER;
+
+    ZeroMem(Instruction, sizeof(X86_INSTRUCTION));
+
+    // Legacy prefixes and REX; a REX only counts right before the opcode
+    for (Pos = 0; ; Pos++)
+    {
+        UINT8 Prefix;
+
+        if (Pos >= Size)
+            return EFI_BUFFER_TOO_SMALL;
+        if (Pos >= X86_MAX_INSTRUCTION_LENGTH)
+            return EFI_UNSUPPORTED;
+
+        Prefix = X86LegacyPrefix(Code[Pos]);
+        if (Prefix != 0)
+        {
+            Instruction->Prefixes |= Prefix;
+            Instruction->Rex = 0;
+            continue;
+        }
+
+        if ((Code[Pos] & 0xF0) != 0x40)
+            break;
+        Instruction->Rex = Code[Pos];
+    }
+
+    if (Code[Pos] == 0xC4 || Code[Pos] == 0xC5 || Code[Pos] == 0x62)
+    {
+        Status = X86DecodeVectorPrefix(Code, Size, &Pos, Instruction);
+        if (EFI_ERROR(Status))
+            return Status;
+    }
+    else if (Code[Pos] == 0x0F)
+    {
+        if (++Pos >= Size)
+            return EFI_BUFFER_TOO_SMALL;
+        Instruction->Map = X86_MAP_0F;
+        if (Code[Pos] == 0x38 || Code[Pos] == 0x3A)
+        {
+            Instruction->Map = Code[Pos] == 0x38 ? X86_MAP_0F38 : X86_MAP_0F3A;
+            if (++Pos >= Size)
+                return EFI_BUFFER_TOO_SMALL;
+        }
+    }
+
+    Instruction->Opcode = Code[Pos];
+    Instruction->OpcodeOffset = (UINT8)Pos;
+    Layout = X86OperandLayout(Instruction->Map, Instruction->Opcode);
+    if ((Layout & X86_OP_INVALID) != 0)
+        return EFI_UNSUPPORTED;
+    Pos++;
+
+    if ((Layout & X86_OP_MODRM) != 0)
+    {
+        UINTN ModRmLength;
+
+        Status = X86ModRmLength(Code, Size, Pos, &ModRmLength);
+        if (EFI_ERROR(Status))
+            return Status;
+        Instruction->HasModRm = TRUE;
+        Instruction->ModRm = Code[Pos];
+        Pos += ModRmLength;
+
+        if (Instruction->Map == X86_MAP_PRIMARY && !X86GroupEncodingValid(Instruction->Opcode, Instruction->ModRm))
+            return EFI_UNSUPPORTED;
+
+        // TEST (F6 /0, F7 /0 and /1) is the only group 3 member with an immediate
+        if (Instruction->Map == X86_MAP_PRIMARY && (Instruction->Opcode == 0xF6 || Instruction->Opcode == 0xF7) &&
+            ((Instruction->ModRm >> 3) & 0x07) <= 1)
+        {
+            Layout |= Instruction->Opcode == 0xF6 ? X86_OP_IMM8 : X86_OP_IMMZ;
+        }
+    }
+
+    if ((Layout & X86_OP_IMM16) != 0)
+        ImmSize += 2;
+    if ((Layout & X86_OP_IMM8) != 0)
+        ImmSize += 1;
+    if ((Layout & X86_OP_IMMZ) != 0)
+        ImmSize += (Instruction->Prefixes & X86_PREFIX_OPERAND_SIZE) != 0 ? 2 : 4;
+    if ((Layout & X86_OP_IMMV) != 0)
+        ImmSize += (Instruction->Rex & X86_REX_W) != 0 ? 8 : ((Instruction->Prefixes & X86_PREFIX_OPERAND_SIZE) != 0 ? 2 : 4);
+    if ((Layout & X86_OP_MOFFS) != 0)
+        ImmSize += (Instruction->Prefixes & X86_PREFIX_ADDRESS_SIZE) != 0 ? 4 : 8;
+    if ((Layout & X86_OP_REL32) != 0)
+        ImmSize += 4;
+
+    Instruction->ImmOffset = (UINT8)Pos;
+    Instruction->ImmSize = (UINT8)ImmSize;
+    Pos += ImmSize;
+
+    if (Pos > X86_MAX_INSTRUCTION_LENGTH)
+        return EFI_UNSUPPORTED;
+    if (Pos > Size)
+        return EFI_BUFFER_TOO_SMALL;
+
+    Instruction->Length = (UINT8)Pos;
+    return EFI_SUCCESS;
+}
+
+UINTN X86WalkCode(
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    UINTN Limit,
+    X86_WALK_CALLBACK Callback,
+    VOID *Context)
+{
+    X86_INSTRUCTION Instruction;
+    UINTN Offset = Start;
+
+    if (Data == NULL || Callback == NULL)
+        return End;
+
+    while (Offset < End && Offset < Limit)
+    {
+        // Not an instruction: step one byte and try again
+        if (EFI_ERROR(X86DecodeInstruction(&Data[Offset], Limit - Offset, &Instruction)))
+        {
+            Offset++;
+            continue;
+        }
+
+        if (!Callback(Context, Data, Offset, &Instruction))
+            return Offset + Instruction.Length;
+        Offset += Instruction.Length;
+    }
+
+    return Offset;
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <Uefi.h>
+
+// Longest instruction the CPU accepts
+#define X86_MAX_INSTRUCTION_LENGTH 15
+
+// X86_INSTRUCTION.Map
+#define X86_MAP_PRIMARY 0
+#define X86_MAP_0F      1
+#define X86_MAP_0F38    2
+#define X86_MAP_0F3A    3
+
+// X86_INSTRUCTION.Prefixes
+#define X86_PREFIX_OPERAND_SIZE BIT0   // 66
+#define X86_PREFIX_ADDRESS_SIZE BIT1   // 67
+#define X86_PREFIX_LOCK         BIT2   // F0
+#define X86_PREFIX_REP          BIT3   // F2 or F3
+#define X86_PREFIX_SEGMENT      BIT4   // 26 2E 36 3E 64 65
+#define X86_PREFIX_VEX          BIT5   // VEX or EVEX encoded
+
+// REX bits
+#define X86_REX_B BIT0
+#define X86_REX_X BIT1
+#define X86_REX_R BIT2
+#define X86_REX_W BIT3
+
+// One decoded 64-bit mode instruction (lengths and offsets only, no operands)
+typedef struct {
+    UINT8 Length;
+    UINT8 Prefixes;              // X86_PREFIX_*
+    UINT8 Rex;                   // REX byte, 0 without one
+    UINT8 Map;                   // X86_MAP_*
+    UINT8 Opcode;                // Opcode byte within Map
+    UINT8 OpcodeOffset;          // Offset of the opcode byte (after prefixes and escapes)
+    BOOLEAN HasModRm;
+    UINT8 ModRm;
+    UINT8 ImmOffset;             // Offset of the immediate (or branch displacement)
+    UINT8 ImmSize;               // 0 without one
+} X86_INSTRUCTION;
+
+/**
+ * Decode the length of one x86-64 instruction
+ *
+ * Prefixes, REX, VEX/EVEX, ModRM, SIB, displacement and immediate are
+ * sized from opcode tables; operands are not interpreted. Opcodes that are
+ * invalid in 64-bit mode are rejected.
+ *
+ * @param Code          First byte of the instruction
+ * @param Size          Bytes readable at Code
+ * @param Instruction   Receives the decoded instruction
+ * @return EFI_SUCCESS, EFI_BUFFER_TOO_SMALL if the instruction runs past
+ *         Size, or EFI_UNSUPPORTED for bytes that are not an instruction
+ */
+EFI_STATUS X86DecodeInstruction(CONST UINT8 *Code, UINTN Size, X86_INSTRUCTION *Instruction);
+
+/**
+ * Called for each instruction of a walk
+ *
+ * The callback may rewrite the instruction or ones before it, as long as
+ * their lengths stay the same.
+ *
+ * @param Context       Caller context
+ * @param Data          Image base
+ * @param Offset        Offset of the instruction from Data
+ * @param Instruction   Decoded instruction
+ * @return TRUE to continue, FALSE to stop the walk
+ */
+typedef BOOLEAN (*X86_WALK_CALLBACK)(VOID *Context, UINT8 *Data, UINTN Offset, CONST X86_INSTRUCTION *Instruction);
+
+/**
+ * Walk code on instruction boundaries
+ *
+ * A linear sweep: each instruction starts where the last one ended. Bytes
+ * that do not decode are stepped over one at a time, so the sweep falls
+ * back into step after padding or embedded data.
+ *
+ * @param Data          Image base
+ * @param Start         Offset of the first instruction
+ * @param End           Instructions starting at or past End are not walked
+ * @param Limit         Instructions may extend up to Limit (the end of the section)
+ * @param Callback      Called for each instruction
+ * @param Context       Passed to Callback
+ * @return Offset after the last instruction walked (may lie past End), the
+ *         point to resume a walk of [End, Limit) from
+ */
+UINTN X86WalkCode(
+    UINT8 *Data,
+    UINTN Start,
+    UINTN End,
+    UINTN Limit,
+    X86_WALK_CALLBACK Callback,
+    VOID *Context);